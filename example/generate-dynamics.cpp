@@ -0,0 +1,1377 @@
+/*
+ * This utility generates C++ code for the kinematics and dynamics of a given
+ * reduced-coordinate articulated body.  The generated code computes the link
+ * transforms, the link velocities, the joint-space inertia matrix (composite
+ * rigid body method), the inverse dynamics (recursive Newton-Euler), and the
+ * forward dynamics (the latter via Featherstone's LTL factorization, which
+ * exploits the branch-induced sparsity of the joint-space inertia matrix).
+ * The topology, joint axes, link offsets, and link inertias of the body are
+ * compiled into the code: all traversals of the tree are unrolled and all
+ * terms that are zero for the particular model are dropped.
+ *
+ * The generated class derives from RCArticulatedBody and the generated source
+ * file defines the factory() function expected by the
+ * RCArticulatedBodySymbolicPlugin XML tag, e.g.:
+ *
+ *   generate-dynamics arm.xml arm arm-dynamics
+ *   g++ -O2 -shared -fPIC arm-dynamics.cpp -o libarm-dynamics.so -lMoby
+ *
+ *   <RCArticulatedBodySymbolicPlugin plugin="./libarm-dynamics.so" id="arm"
+ *     ... (same attributes and links / joints as the RCArticulatedBody) >
+ *
+ * The generated code checks the topology and all of the folded constants
+ * (joint axes and offsets, link offsets, masses, and inertias) against the
+ * body when the body is compiled and again after any of the masses, 
+ * inertias, or joint axes change; the generic RCArticulatedBody methods are
+ * used if any of them differ.
+ *
+ * Only tree-structured bodies with revolute and prismatic joints are
+ * supported.  The generated dynamics treat the base as fixed; the generated
+ * forward dynamics fall back to the generic algorithms for floating bases
+ * and for the advanced friction model.
+ */
+
+#include <cctype>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <limits>
+#include <queue>
+#include <Moby/XMLReader.h>
+#include <Moby/RCArticulatedBody.h>
+#include <Moby/Joint.h>
+#include <Moby/RevoluteJoint.h>
+#include <Moby/PrismaticJoint.h>
+
+using namespace Moby;
+using std::string;
+using std::vector;
+using std::endl;
+
+/// A scalar expression in the generated code: a numerical constant or source code
+/**
+ * Arithmetic on expressions folds constants, so products with the (many)
+ * zero entries of joint axes, offsets, and inertias disappear from the
+ * generated code.
+ */
+class Expr
+{
+  public:
+    enum Kind { eConst, eAtom, eProduct, eSum, eNegation };
+    Expr(Real x = (Real) 0.0) : kind(eConst), inner(eConst), value(x) {}
+    Expr(const string& name) : kind(eAtom), inner(eConst), value((Real) 0.0), code(name) {}
+    bool is(Real x) const { return kind == eConst && value == x; }
+
+    /// The kind of expression
+    Kind kind;
+
+    /// The kind of the negated expression (negations only)
+    Kind inner;
+
+    /// The value of the expression (constants only)
+    Real value;
+
+    /// The source code of the expression (for negations, of the negated expression)
+    string code;
+};
+
+typedef vector<Expr> Exprs;
+
+/// The data for a (non-base) link and its inner joint
+struct LinkData
+{
+  /// The link ID
+  string id;
+
+  /// The inner joint ID
+  string joint_id;
+
+  /// The index of the link in the body
+  unsigned index;
+
+  /// The position of the parent link in the topological ordering (-1 for the base)
+  int parent;
+
+  /// Whether the inner joint is revolute (otherwise, it is prismatic)
+  bool revolute;
+
+  /// The joint axis (in the joint frame)
+  Vector3 axis;
+
+  /// The joint position offset
+  Real q_tare;
+
+  /// The vector from the parent link c.o.m. to the joint (parent link frame)
+  Vector3 com_to_joint;
+
+  /// The vector from the joint to the link c.o.m. (joint frame)
+  Vector3 joint_to_com;
+
+  /// The spatial axis of the joint (link frame)
+  SVector6 s;
+
+  /// The joint-space coordinate index of the joint
+  unsigned coord;
+
+  /// The link mass
+  Real mass;
+
+  /// The link inertia matrix (link frame)
+  Matrix3 J;
+};
+
+/// The model for which code is generated; links are stored in topological order
+struct Model
+{
+  string id;
+  string class_name;
+  unsigned nlinks;
+  vector<LinkData> links;
+};
+
+/// Symbols computed by the generated code for each (non-base) link
+struct Symbols
+{
+  Exprs q, qd;
+  vector<Exprs> R, t, v, ab, a, f;
+};
+
+/// Counter used to name temporaries
+static unsigned ntemps = 0;
+
+/// The number of constants per link that are folded into the generated code (and verified at run time)
+static const unsigned NCONSTANTS = 26;
+
+/// Converts an index to a string
+std::string str(unsigned i)
+{
+  std::ostringstream s;
+  s << i;
+  return s.str();
+}
+
+/// Converts a number to a C++ floating point literal
+std::string literal(Real x)
+{
+  std::ostringstream s;
+  s << std::setprecision(std::numeric_limits<double>::digits10+2) << (double) x;
+  string lit = s.str();
+  if (lit.find_first_of(".en") == string::npos)
+    lit += ".0";
+  return lit;
+}
+
+/// Converts an ID to a C++ identifier
+std::string identifier(const string& id)
+{
+  string s = id;
+  for (unsigned i=0; i< s.size(); i++)
+    if (!std::isalnum(s[i]))
+      s[i] = '_';
+  if (s.empty() || std::isdigit(s[0]))
+    s = "_" + s;
+  return s;
+}
+
+/// Makes a string safe for use within a C++ string literal or comment
+std::string escape(const string& s)
+{
+  string es;
+  for (unsigned i=0; i< s.size(); i++)
+  {
+    if (s[i] == '"' || s[i] == '\\')
+      es += '\\';
+    es += s[i];
+  }
+  return es;
+}
+
+std::string paren(const string& s) { return "(" + s + ")"; }
+
+/// Gets the source code for an expression
+std::string text(const Expr& e)
+{
+  switch (e.kind)
+  {
+    case Expr::eConst:
+      return literal(e.value);
+
+    case Expr::eNegation:
+      return "-" + ((e.inner == Expr::eSum) ? paren(e.code) : e.code);
+
+    default:
+      return e.code;
+  }
+}
+
+/// Gets the source code for an expression used as a factor
+std::string factor(const Expr& e)
+{
+  if ((e.kind == Expr::eConst && e.value < (Real) 0.0) || e.kind == Expr::eSum || e.kind == Expr::eNegation)
+    return paren(text(e));
+  return text(e);
+}
+
+Expr operator-(const Expr& a)
+{
+  if (a.kind == Expr::eConst)
+    return Expr(-a.value);
+
+  Expr r;
+  if (a.kind == Expr::eNegation)
+    r.kind = a.inner;
+  else
+  {
+    r.kind = Expr::eNegation;
+    r.inner = a.kind;
+  }
+  r.code = a.code;
+  return r;
+}
+
+Expr operator+(const Expr& a, const Expr& b)
+{
+  if (a.kind == Expr::eConst && b.kind == Expr::eConst)
+    return Expr(a.value + b.value);
+  if (a.is((Real) 0.0))
+    return b;
+  if (b.is((Real) 0.0))
+    return a;
+
+  Expr r;
+  r.kind = Expr::eSum;
+  if (b.kind == Expr::eConst && b.value < (Real) 0.0)
+    r.code = text(a) + " - " + literal(-b.value);
+  else if (b.kind == Expr::eNegation)
+    r.code = text(a) + " - " + ((b.inner == Expr::eSum) ? paren(b.code) : b.code);
+  else
+    r.code = text(a) + " + " + text(b);
+  return r;
+}
+
+Expr operator-(const Expr& a, const Expr& b)
+{
+  return a + (-b);
+}
+
+Expr operator*(const Expr& a, const Expr& b)
+{
+  if (a.kind == Expr::eConst && b.kind == Expr::eConst)
+    return Expr(a.value * b.value);
+  if (a.is((Real) 0.0) || b.is((Real) 0.0))
+    return Expr((Real) 0.0);
+
+  // keep signs outermost
+  if ((a.kind == Expr::eConst && a.value < (Real) 0.0) || a.kind == Expr::eNegation)
+    return -((-a) * b);
+  if ((b.kind == Expr::eConst && b.value < (Real) 0.0) || b.kind == Expr::eNegation)
+    return -(a * (-b));
+  if (a.is((Real) 1.0))
+    return b;
+  if (b.is((Real) 1.0))
+    return a;
+
+  Expr r;
+  r.kind = Expr::eProduct;
+  r.code = factor(a) + "*" + factor(b);
+  return r;
+}
+
+Expr operator/(const Expr& a, const Expr& b)
+{
+  if (a.kind == Expr::eConst && b.kind == Expr::eConst)
+    return Expr(a.value / b.value);
+  if (a.is((Real) 0.0) || b.is((Real) 1.0))
+    return a;
+  if ((a.kind == Expr::eConst && a.value < (Real) 0.0) || a.kind == Expr::eNegation)
+    return -((-a) / b);
+
+  Expr r;
+  r.kind = Expr::eProduct;
+  r.code = factor(a) + "/" + ((b.kind == Expr::eAtom) ? text(b) : paren(text(b)));
+  return r;
+}
+
+/// Forms the expression for a call to a function of one argument
+Expr call(const string& func, const Expr& a)
+{
+  Expr r;
+  r.kind = Expr::eProduct;
+  r.code = func + "(" + text(a) + ")";
+  return r;
+}
+
+/// Emits the definition of a named variable for an expression (unless the expression is trivial) and returns the variable
+Expr def(std::ostream& out, const string& name, const Expr& e)
+{
+  if (e.kind == Expr::eConst || e.kind == Expr::eAtom || (e.kind == Expr::eNegation && e.inner == Expr::eAtom))
+    return e;
+
+  out << "  const Real " << name << " = " << text(e) << ";" << endl;
+  return Expr(name);
+}
+
+/// Emits the definitions of named variables for a vector of expressions
+Exprs def(std::ostream& out, const string& prefix, const Exprs& v)
+{
+  Exprs result(v.size());
+  for (unsigned i=0; i< v.size(); i++)
+    result[i] = def(out, prefix + str(i), v[i]);
+  return result;
+}
+
+/// Emits the definition of a temporary variable for an expression
+Expr temp(std::ostream& out, const Expr& e)
+{
+  return def(out, "tmp" + str(ntemps++), e);
+}
+
+/// Emits the definitions of temporary variables for a vector of expressions
+Exprs temp(std::ostream& out, const Exprs& v)
+{
+  Exprs result(v.size());
+  for (unsigned i=0; i< v.size(); i++)
+    result[i] = temp(out, v[i]);
+  return result;
+}
+
+Exprs constant(const Vector3& v)
+{
+  Exprs e(3);
+  for (unsigned i=0; i< 3; i++)
+    e[i] = Expr(v[i]);
+  return e;
+}
+
+Exprs constant(const SVector6& v)
+{
+  Exprs e(6);
+  for (unsigned i=0; i< 6; i++)
+    e[i] = Expr(v[i]);
+  return e;
+}
+
+/// Converts a 3x3 matrix to expressions (row-major)
+Exprs constant(const Matrix3& m)
+{
+  Exprs e(9);
+  for (unsigned i=0; i< 3; i++)
+    for (unsigned j=0; j< 3; j++)
+      e[i*3+j] = Expr(m(i,j));
+  return e;
+}
+
+Exprs zeros(unsigned n) { return Exprs(n, Expr((Real) 0.0)); }
+
+Exprs upper(const Exprs& v) { return Exprs(v.begin(), v.begin()+3); }
+Exprs lower(const Exprs& v) { return Exprs(v.begin()+3, v.end()); }
+
+Exprs concat(const Exprs& top, const Exprs& bottom)
+{
+  Exprs result = top;
+  result.insert(result.end(), bottom.begin(), bottom.end());
+  return result;
+}
+
+Exprs operator+(const Exprs& a, const Exprs& b)
+{
+  Exprs result(a.size());
+  for (unsigned i=0; i< a.size(); i++)
+    result[i] = a[i] + b[i];
+  return result;
+}
+
+Exprs operator-(const Exprs& a, const Exprs& b)
+{
+  Exprs result(a.size());
+  for (unsigned i=0; i< a.size(); i++)
+    result[i] = a[i] - b[i];
+  return result;
+}
+
+Exprs operator*(const Exprs& a, const Expr& x)
+{
+  Exprs result(a.size());
+  for (unsigned i=0; i< a.size(); i++)
+    result[i] = a[i] * x;
+  return result;
+}
+
+Expr dot(const Exprs& a, const Exprs& b)
+{
+  Expr result;
+  for (unsigned i=0; i< a.size(); i++)
+    result = result + a[i]*b[i];
+  return result;
+}
+
+Exprs cross(const Exprs& a, const Exprs& b)
+{
+  Exprs result(3);
+  result[0] = a[1]*b[2] - a[2]*b[1];
+  result[1] = a[2]*b[0] - a[0]*b[2];
+  result[2] = a[0]*b[1] - a[1]*b[0];
+  return result;
+}
+
+/// Multiplies a 3x3 matrix (row-major) by a vector
+Exprs mult(const Exprs& A, const Exprs& x)
+{
+  Exprs result(3);
+  for (unsigned i=0; i< 3; i++)
+    result[i] = A[i*3]*x[0] + A[i*3+1]*x[1] + A[i*3+2]*x[2];
+  return result;
+}
+
+/// Multiplies the transpose of a 3x3 matrix (row-major) by a vector
+Exprs transpose_mult(const Exprs& A, const Exprs& x)
+{
+  Exprs result(3);
+  for (unsigned i=0; i< 3; i++)
+    result[i] = A[i]*x[0] + A[3+i]*x[1] + A[6+i]*x[2];
+  return result;
+}
+
+/// Multiplies two 3x3 matrices (row-major)
+Exprs mult33(const Exprs& A, const Exprs& B)
+{
+  Exprs result(9);
+  for (unsigned i=0; i< 3; i++)
+    for (unsigned j=0; j< 3; j++)
+      result[i*3+j] = A[i*3]*B[j] + A[i*3+1]*B[3+j] + A[i*3+2]*B[6+j];
+  return result;
+}
+
+/// Computes the spatial cross product of a spatial velocity and a spatial vector (see SVector6::spatial_cross())
+Exprs spatial_cross(const Exprs& v, const Exprs& x)
+{
+  Exprs top = cross(upper(v), upper(x));
+  Exprs bottom = cross(lower(v), upper(x)) + cross(upper(v), lower(x));
+  return concat(top, bottom);
+}
+
+/// Computes the spatial transpose of a spatial axis times a spatial vector
+Expr transpose_mult(const SVector6& s, const Exprs& x)
+{
+  return dot(constant(s.get_upper()), lower(x)) + dot(constant(s.get_lower()), upper(x));
+}
+
+/// Multiplies a spatial rigid body inertia (m, h, J) by a spatial vector (see SpatialRBInertia::operator*())
+Exprs inertia_mult(const Expr& m, const Exprs& h, const Exprs& J, const Exprs& x)
+{
+  Exprs top = lower(x)*m - cross(h, upper(x));
+  Exprs bottom = mult(J, upper(x)) + cross(h, lower(x));
+  return concat(top, bottom);
+}
+
+/// Transforms a spatial vector from the parent link frame to the link frame
+/**
+ * \param R the rotation of the link frame relative to the parent link frame
+ * \param t the origin of the link frame in the parent link frame
+ */
+Exprs transform_forward(std::ostream& out, const Exprs& R, const Exprs& t, const Exprs& x)
+{
+  Exprs bottom = temp(out, lower(x) - cross(t, upper(x)));
+  return concat(transpose_mult(R, upper(x)), transpose_mult(R, bottom));
+}
+
+/// Transforms a spatial vector from the link frame to the parent link frame
+Exprs transform_backward(std::ostream& out, const Exprs& R, const Exprs& t, const Exprs& x)
+{
+  Exprs top = temp(out, mult(R, upper(x)));
+  return concat(top, mult(R, lower(x)) + cross(t, top));
+}
+
+/// Writes the file header comment
+void write_header_comment(std::ostream& out, const string& xml_file)
+{
+  out << "/* Generated automatically by generate-dynamics from " << xml_file << "; do not edit */" << endl << endl;
+}
+
+/// Emits code that gets the joint positions and/or velocities
+void emit_joint_values(std::ostream& out, const Model& model, Symbols& sym, bool positions, bool velocities)
+{
+  const vector<LinkData>& links = model.links;
+
+  out << "  // get the joint " << (positions ? (velocities ? "positions and velocities" : "positions") : "velocities") << endl;
+  sym.q.resize(links.size());
+  sym.qd.resize(links.size());
+  for (unsigned k=0; k< links.size(); k++)
+  {
+    string i = str(links[k].index);
+    if (positions)
+    {
+      out << "  const Real q" << i << " = _link_joints[" << i << "]->q[0];" << endl;
+      sym.q[k] = Expr("q" + i);
+    }
+    if (velocities)
+    {
+      out << "  const Real qd" << i << " = _link_joints[" << i << "]->qd[0];" << endl;
+      sym.qd[k] = Expr("qd" + i);
+    }
+  }
+  out << endl;
+}
+
+/// Emits code that computes the transforms of the links relative to their parents
+void emit_relative_transforms(std::ostream& out, const Model& model, Symbols& sym)
+{
+  const vector<LinkData>& links = model.links;
+
+  out << "  // compute the link transforms relative to the parent links" << endl;
+  sym.R.resize(links.size());
+  sym.t.resize(links.size());
+  for (unsigned k=0; k< links.size(); k++)
+  {
+    const LinkData& link = links[k];
+    string i = str(link.index);
+    Exprs c = constant(link.com_to_joint);
+    Exprs d = constant(link.joint_to_com);
+    Expr q = sym.q[k] + Expr(link.q_tare);
+
+    out << "  // link '" << escape(link.id) << "', joint '" << escape(link.joint_id) << "'" << endl;
+    if (link.revolute)
+    {
+      // rotation about the joint axis (Rodrigues' formula)
+      const Vector3& u = link.axis;
+      out << "  const Real c" << i << " = std::cos(" << text(q) << ");" << endl;
+      out << "  const Real s" << i << " = std::sin(" << text(q) << ");" << endl;
+      Expr cq("c" + i), sq("s" + i);
+      Real skew[9] = { 0, -u[2], u[1], u[2], 0, -u[0], -u[1], u[0], 0 };
+      Exprs R(9);
+      for (unsigned r=0; r< 3; r++)
+        for (unsigned col=0; col< 3; col++)
+        {
+          Real uu = u[r]*u[col];
+          if (r == col)
+            R[r*3+col] = Expr(uu) + Expr((Real) 1.0 - uu)*cq;
+          else
+            R[r*3+col] = Expr(uu) - Expr(uu)*cq + Expr(skew[r*3+col])*sq;
+        }
+      sym.R[k] = def(out, "R" + i + "_", R);
+      sym.t[k] = def(out, "t" + i + "_", c + mult(sym.R[k], d));
+    }
+    else
+    {
+      // translation along the joint axis
+      Exprs R = zeros(9);
+      R[0] = R[4] = R[8] = Expr((Real) 1.0);
+      sym.R[k] = R;
+      sym.t[k] = def(out, "t" + i + "_", c + d + constant(link.axis)*q);
+    }
+  }
+  out << endl;
+}
+
+/// Emits code that computes the link velocities (in link frames) given the base velocity
+void emit_velocities(std::ostream& out, const Model& model, Symbols& sym, const Exprs& v0)
+{
+  const vector<LinkData>& links = model.links;
+
+  out << "  // compute the link velocities" << endl;
+  sym.v.resize(links.size());
+  for (unsigned k=0; k< links.size(); k++)
+  {
+    const LinkData& link = links[k];
+    const Exprs& vp = (link.parent < 0) ? v0 : sym.v[link.parent];
+    Exprs v = transform_forward(out, sym.R[k], sym.t[k], vp) + constant(link.s)*sym.qd[k];
+    sym.v[k] = def(out, "v" + str(link.index) + "_", v);
+  }
+  out << endl;
+}
+
+/// Emits the recursive Newton-Euler algorithm
+/**
+ * The generated code computes the link accelerations (stored in sym.a) and
+ * the joint forces (returned) necessary to obtain joint accelerations qdd
+ * given the current external forces on the links; the base is treated as
+ * fixed.  The velocity-dependent parts of the link accelerations are stored
+ * in sym.ab.
+ */
+Exprs emit_rne(std::ostream& out, const Model& model, Symbols& sym, const Exprs& qdd, const string& prefix)
+{
+  const vector<LinkData>& links = model.links;
+
+  // forward pass: compute the link accelerations
+  out << "  // compute the link accelerations" << endl;
+  sym.ab.resize(links.size());
+  sym.a.resize(links.size());
+  for (unsigned k=0; k< links.size(); k++)
+  {
+    const LinkData& link = links[k];
+    string i = str(link.index);
+    sym.ab[k] = def(out, "ab" + i + "_", spatial_cross(sym.v[k], constant(link.s)*sym.qd[k]));
+    Exprs a = sym.ab[k] + constant(link.s)*qdd[k];
+    if (link.parent >= 0)
+      a = a + transform_forward(out, sym.R[k], sym.t[k], sym.a[link.parent]);
+    sym.a[k] = def(out, "a" + i + "_", a);
+  }
+  out << endl;
+
+  // get the external forces
+  out << "  // get the external forces on the links (link frames)" << endl;
+  vector<Exprs> fx(links.size());
+  for (unsigned k=0; k< links.size(); k++)
+  {
+    string i = str(links[k].index);
+    out << "  const Matrix4& T" << i << " = links[" << i << "]->get_transform();" << endl;
+    out << "  const Vector3 fx" << i << " = T" << i << ".transpose_mult_vector(links[" << i << "]->sum_forces());" << endl;
+    out << "  const Vector3 tx" << i << " = T" << i << ".transpose_mult_vector(links[" << i << "]->sum_torques());" << endl;
+    fx[k].resize(6);
+    for (unsigned j=0; j< 3; j++)
+    {
+      fx[k][j] = Expr("fx" + i + "[" + str(j) + "]");
+      fx[k][j+3] = Expr("tx" + i + "[" + str(j) + "]");
+    }
+  }
+  out << endl;
+
+  // backward pass: compute the link forces
+  out << "  // compute the link forces and the joint forces" << endl;
+  sym.f.resize(links.size());
+  vector<Exprs> fchild(links.size(), zeros(6));
+  Exprs tau(links.size());
+  for (unsigned k=links.size(); k-- > 0; )
+  {
+    const LinkData& link = links[k];
+    string i = str(link.index);
+    Expr m(link.mass);
+    Exprs J = constant(link.J);
+    Exprs Iv = temp(out, inertia_mult(m, zeros(3), J, sym.v[k]));
+    Exprs f = inertia_mult(m, zeros(3), J, sym.a[k]) + spatial_cross(sym.v[k], Iv) - fx[k] + fchild[k];
+    sym.f[k] = def(out, "f" + i + "_", f);
+    tau[k] = def(out, prefix + i, transpose_mult(link.s, sym.f[k]));
+    if (link.parent >= 0)
+      fchild[link.parent] = temp(out, fchild[link.parent] + transform_backward(out, sym.R[k], sym.t[k], sym.f[k]));
+  }
+  out << endl;
+
+  return tau;
+}
+
+/// Emits the composite rigid body method for computing the joint-space inertia matrix
+/**
+ * \return the lower triangle of the matrix (H[k][l] for l <= k, with indices
+ *         in topological order); entries not computed are structurally zero
+ */
+vector<Exprs> emit_crb(std::ostream& out, const Model& model, Symbols& sym)
+{
+  const vector<LinkData>& links = model.links;
+  const unsigned n = links.size();
+
+  // compute the composite inertias (m, h, J) in the link frames
+  out << "  // compute the composite rigid body inertias" << endl;
+  vector<Real> mc(n);
+  vector<Exprs> hc(n), Jc(n), hchild(n, zeros(3)), Jchild(n, zeros(9));
+  vector<Real> mchild(n, (Real) 0.0);
+  for (unsigned k=n; k-- > 0; )
+  {
+    const LinkData& link = links[k];
+    string i = str(link.index);
+
+    // add the inertias of the child links
+    mc[k] = link.mass + mchild[k];
+    hc[k] = def(out, "hc" + i + "_", hchild[k]);
+    Exprs J = constant(link.J) + Jchild[k];
+    Jc[k].resize(9);
+    for (unsigned r=0; r< 3; r++)
+      for (unsigned c=r; c< 3; c++)
+        Jc[k][r*3+c] = Jc[k][c*3+r] = def(out, "Jc" + i + "_" + str(r) + str(c), J[r*3+c]);
+
+    // transform the composite inertia to the parent link frame
+    // (see SpatialTransform::transform(const SpatialRBInertia&))
+    if (link.parent < 0)
+      continue;
+    const Exprs& R = sym.R[k];
+    const Exprs& t = sym.t[k];
+    Expr m(mc[k]);
+    Exprs g = temp(out, mult(R, hc[k]));
+    Exprs RJ = temp(out, mult33(R, Jc[k]));
+    Expr gt = temp(out, dot(g, t));
+    Expr tt = temp(out, dot(t, t));
+    Expr diag = Expr((Real) 2.0)*gt + m*tt;
+    Exprs& Jp = Jchild[link.parent];
+    for (unsigned r=0; r< 3; r++)
+      for (unsigned c=r; c< 3; c++)
+      {
+        Expr RJRT = RJ[r*3]*R[c*3] + RJ[r*3+1]*R[c*3+1] + RJ[r*3+2]*R[c*3+2];
+        Expr Jrc = RJRT - g[r]*t[c] - t[r]*g[c] - m*t[r]*t[c];
+        if (r == c)
+          Jrc = Jrc + diag;
+        Jp[r*3+c] = Jp[c*3+r] = temp(out, Jp[r*3+c] + Jrc);
+      }
+    hchild[link.parent] = temp(out, hchild[link.parent] + g + t*m);
+    mchild[link.parent] += mc[k];
+  }
+  out << endl;
+
+  // compute the joint-space inertia matrix
+  out << "  // compute the joint-space inertia matrix" << endl;
+  vector<Exprs> H(n, zeros(n));
+  for (unsigned k=0; k< n; k++)
+  {
+    string i = str(links[k].index);
+    Exprs F = temp(out, inertia_mult(Expr(mc[k]), hc[k], Jc[k], constant(links[k].s)));
+    H[k][k] = def(out, "H" + i + "_" + i, transpose_mult(links[k].s, F));
+    for (unsigned j = k; links[j].parent >= 0; )
+    {
+      F = temp(out, transform_backward(out, sym.R[j], sym.t[j], F));
+      j = links[j].parent;
+      H[k][j] = def(out, "H" + i + "_" + str(links[j].index), transpose_mult(links[j].s, F));
+    }
+  }
+  out << endl;
+
+  return H;
+}
+
+/// Emits the LTL factorization of the joint-space inertia matrix and the solution of H*x = b
+/**
+ * This is the factorization of [Featherstone 2005]; because the links are in
+ * topological order, the factorization introduces no fill-in beyond the
+ * branch-induced sparsity pattern of H.
+ */
+Exprs emit_ltl_solve(std::ostream& out, const Model& model, const vector<Exprs>& H, const Exprs& b, const string& class_name)
+{
+  const vector<LinkData>& links = model.links;
+  const unsigned n = links.size();
+
+  // factorize H = L'*L
+  out << "  // factorize the joint-space inertia matrix (H = L'*L)" << endl;
+  vector<Exprs> L = H;
+  Exprs iL(n);
+  for (unsigned k=n; k-- > 0; )
+  {
+    string i = str(links[k].index);
+    if (L[k][k].kind != Expr::eConst)
+      out << "  if (!(" << text(L[k][k]) << " > (Real) 0.0))" << endl << "    throw std::runtime_error(\"" << class_name << "::calc_fwd_dyn() - joint-space inertia matrix is not positive definite\");" << endl;
+    else if (L[k][k].value <= (Real) 0.0)
+      throw std::runtime_error("joint-space inertia matrix is not positive definite (zero mass links?)");
+    Expr Lkk = (L[k][k].kind == Expr::eConst) ? Expr(std::sqrt(L[k][k].value)) : call("std::sqrt", L[k][k]);
+    L[k][k] = def(out, "L" + i + "_" + i, Lkk);
+    iL[k] = def(out, "iL" + i, Expr((Real) 1.0)/L[k][k]);
+    for (int j = links[k].parent; j >= 0; j = links[j].parent)
+      L[k][j] = def(out, "L" + i + "_" + str(links[j].index), L[k][j]*iL[k]);
+    for (int j = links[k].parent; j >= 0; j = links[j].parent)
+      for (int l = j; l >= 0; l = links[l].parent)
+        L[j][l] = def(out, "H" + str(links[j].index) + "_" + str(links[l].index) + "_" + i, L[j][l] - L[k][j]*L[k][l]);
+  }
+  out << endl;
+
+  // solve L'*y = b
+  out << "  // solve H*x = b using the factorization" << endl;
+  Exprs y = b;
+  for (unsigned k=n; k-- > 0; )
+  {
+    string i = str(links[k].index);
+    y[k] = def(out, "y" + i, y[k]*iL[k]);
+    for (int j = links[k].parent; j >= 0; j = links[j].parent)
+      y[j] = def(out, "y" + str(links[j].index) + "_" + i, y[j] - L[k][j]*y[k]);
+  }
+
+  // solve L*x = y
+  Exprs x(n);
+  for (unsigned k=0; k< n; k++)
+  {
+    Expr xk = y[k];
+    for (int j = links[k].parent; j >= 0; j = links[j].parent)
+      xk = xk - L[k][j]*x[j];
+    x[k] = def(out, "x" + str(links[k].index), xk*iL[k]);
+  }
+  out << endl;
+
+  return x;
+}
+
+/// Converts a 6-dimensional vector of expressions to a SVector6 constructor call
+std::string svector6(const Exprs& v)
+{
+  string s = "SVector6(";
+  for (unsigned i=0; i< 6; i++)
+    s += ((i > 0) ? ", " : "") + text(v[i]);
+  return s + ")";
+}
+
+/// Writes the header file for the generated class
+void write_header(std::ostream& out, const Model& model, const string& xml_file)
+{
+  const string& name = model.class_name;
+  string guard = "_" + identifier(name) + "_GENERATED_H";
+  for (unsigned i=0; i< guard.size(); i++)
+    guard[i] = std::toupper(guard[i]);
+
+  write_header_comment(out, xml_file);
+  out << "#ifndef " << guard << endl;
+  out << "#define " << guard << endl << endl;
+  out << "#include <vector>" << endl;
+  out << "#include <Moby/RCArticulatedBody.h>" << endl << endl;
+  out << "namespace Moby {" << endl << endl;
+  out << "/// Kinematics and dynamics generated for the articulated body '" << escape(model.id) << "'" << endl;
+  out << "/**" << endl;
+  out << " * The generated code is used once the body has been verified to match the" << endl;
+  out << " * model from which the code was generated; the dynamics treat the base as" << endl;
+  out << " * fixed." << endl;
+  out << " */" << endl;
+  out << "class " << name << " : public RCArticulatedBody" << endl;
+  out << "{" << endl;
+  out << "  public:" << endl;
+  out << "    " << name << "() { _model_checked = false; }" << endl;
+  out << "    virtual ~" << name << "() {}" << endl;
+  out << "    virtual void load_from_xml(XMLTreeConstPtr node, std::map<std::string, BasePtr>& id_map);" << endl;
+  out << "    virtual void update_link_transforms();" << endl;
+  out << "    virtual void update_link_velocities();" << endl;
+  out << "    virtual void calc_fwd_dyn(Real dt);" << endl;
+  out << "    MatrixN& calc_joint_space_inertia(MatrixN& H);" << endl;
+  out << "    VectorN& calc_inv_dyn(const VectorN& qdd, VectorN& Q);" << endl;
+  out << "    virtual void invalidate_parameters();" << endl << endl;
+  out << "  protected:" << endl;
+  out << "    virtual void compile();" << endl << endl;
+  out << "  private:" << endl;
+  out << "    bool verified();" << endl;
+  out << "    void verify_model();" << endl << endl;
+  out << "    /// The inner joints of the links (empty unless the body has been verified)" << endl;
+  out << "    std::vector<JointPtr> _link_joints;" << endl << endl;
+  out << "    /// Set to false when the body must be (re)verified before the generated code is used" << endl;
+  out << "    bool _model_checked;" << endl;
+  out << "}; // end class" << endl << endl;
+  out << "} // end namespace" << endl << endl;
+  out << "#endif" << endl << endl;
+}
+
+/// Writes the source file for the generated class
+void write_source(std::ostream& out, const Model& model, const string& xml_file, const string& header)
+{
+  const string& name = model.class_name;
+  const vector<LinkData>& links = model.links;
+  const unsigned n = links.size();
+  Symbols sym;
+
+  write_header_comment(out, xml_file);
+  out << "#include <algorithm>" << endl;
+  out << "#include <cmath>" << endl;
+  out << "#include <iostream>" << endl;
+  out << "#include <stdexcept>" << endl;
+  out << "#include <Moby/Constants.h>" << endl;
+  out << "#include <Moby/RigidBody.h>" << endl;
+  out << "#include <Moby/Joint.h>" << endl;
+  out << "#include <Moby/RevoluteJoint.h>" << endl;
+  out << "#include <Moby/PrismaticJoint.h>" << endl;
+  out << "#include \"" << header << "\"" << endl << endl;
+  out << "using namespace Moby;" << endl << endl;
+
+  // write the factory so that the class can be loaded as a plugin
+  out << "// write the factory so that we can load this class as a plugin" << endl;
+  out << "extern \"C\" boost::shared_ptr<RCArticulatedBody> factory() { return boost::shared_ptr<RCArticulatedBody>(new " << name << "); }" << endl << endl;
+
+  // write the model data
+  vector<int> parents(model.nlinks, -1), coords(model.nlinks, -1), revolute(model.nlinks, -1);
+  vector<string> ids(model.nlinks);
+  for (unsigned k=0; k< n; k++)
+  {
+    unsigned i = links[k].index;
+    parents[i] = (links[k].parent < 0) ? 0 : links[links[k].parent].index;
+    coords[i] = links[k].coord;
+    revolute[i] = links[k].revolute ? 1 : 0;
+    ids[i] = links[k].id;
+  }
+  out << "// the model from which the code was generated (indexed by link)" << endl;
+  out << "static const unsigned NLINKS = " << model.nlinks << ";" << endl;
+  out << "static const unsigned NDOF = " << n << ";" << endl;
+  out << "static const char* LINK_ID[NLINKS] = { ";
+  for (unsigned i=0; i< model.nlinks; i++)
+    out << ((i > 0) ? ", " : "") << "\"" << escape(ids[i]) << "\"";
+  out << " };" << endl;
+  out << "static const int PARENT[NLINKS] = { ";
+  for (unsigned i=0; i< model.nlinks; i++)
+    out << ((i > 0) ? ", " : "") << parents[i];
+  out << " };" << endl;
+  out << "static const int COORD[NLINKS] = { ";
+  for (unsigned i=0; i< model.nlinks; i++)
+    out << ((i > 0) ? ", " : "") << coords[i];
+  out << " };" << endl;
+  out << "static const int REVOLUTE[NLINKS] = { ";
+  for (unsigned i=0; i< model.nlinks; i++)
+    out << ((i > 0) ? ", " : "") << revolute[i];
+  out << " };" << endl << endl;
+
+  // write the constants that are folded into the generated code
+  vector<vector<Real> > consts(model.nlinks, vector<Real>(NCONSTANTS, (Real) 0.0));
+  for (unsigned k=0; k< n; k++)
+  {
+    const LinkData& link = links[k];
+    vector<Real>& c = consts[link.index];
+    for (unsigned j=0; j< 3; j++)
+    {
+      c[j] = link.axis[j];
+      c[3+j] = link.com_to_joint[j];
+      c[6+j] = link.joint_to_com[j];
+    }
+    for (unsigned j=0; j< 6; j++)
+      c[9+j] = link.s[j];
+    for (unsigned j=0; j< 9; j++)
+      c[15+j] = link.J.data()[j];
+    c[24] = link.q_tare;
+    c[25] = link.mass;
+  }
+  out << "// the constants folded into the generated code (indexed by link): joint" << endl;
+  out << "// axis, vector from the parent c.o.m. to the joint, vector from the joint to" << endl;
+  out << "// the c.o.m., spatial axis, inertia matrix, joint position offset, and mass" << endl;
+  out << "static const unsigned NCONSTANTS = " << NCONSTANTS << ";" << endl;
+  out << "static const Real CONSTANTS[NLINKS][NCONSTANTS] = {" << endl;
+  for (unsigned i=0; i< model.nlinks; i++)
+  {
+    out << "  { ";
+    for (unsigned j=0; j< NCONSTANTS; j++)
+      out << ((j > 0) ? ", " : "") << literal(consts[i][j]);
+    out << " }" << ((i+1 < model.nlinks) ? "," : "") << endl;
+  }
+  out << "};" << endl << endl;
+
+  // write the function that compares the constants against the body
+  out << "/// Determines whether the parameters of the body match those from which the code was generated" << endl;
+  out << "static bool matches_model(const std::vector<RigidBodyPtr>& links, const std::vector<JointPtr>& joints)" << endl;
+  out << "{" << endl;
+  out << "  Real c[NCONSTANTS];" << endl;
+  out << "  for (unsigned i=1; i< NLINKS; i++)" << endl;
+  out << "  {" << endl;
+  out << "    // get the current values of the constants" << endl;
+  out << "    const Vector3& axis = (REVOLUTE[i]) ? boost::dynamic_pointer_cast<RevoluteJoint>(joints[i])->get_axis_local() : boost::dynamic_pointer_cast<PrismaticJoint>(joints[i])->get_axis_local();" << endl;
+  out << "    const Vector3& com_to_joint = links[PARENT[i]]->get_outer_joint_data(joints[i]).com_to_joint_vec;" << endl;
+  out << "    const Vector3& joint_to_com = links[i]->get_inner_joint_data(joints[i]).joint_to_com_vec_jf;" << endl;
+  out << "    const SMatrix6N& s = joints[i]->get_spatial_axes(eLink);" << endl;
+  out << "    const Real* J = links[i]->get_inertia().data();" << endl;
+  out << "    for (unsigned j=0; j< 3; j++)" << endl;
+  out << "    {" << endl;
+  out << "      c[j] = axis[j];" << endl;
+  out << "      c[3+j] = com_to_joint[j];" << endl;
+  out << "      c[6+j] = joint_to_com[j];" << endl;
+  out << "    }" << endl;
+  out << "    for (unsigned j=0; j< 6; j++)" << endl;
+  out << "      c[9+j] = s(j,0);" << endl;
+  out << "    for (unsigned j=0; j< 9; j++)" << endl;
+  out << "      c[15+j] = J[j];" << endl;
+  out << "    c[24] = joints[i]->get_q_tare()[0];" << endl;
+  out << "    c[25] = links[i]->get_mass();" << endl << endl;
+  out << "    // compare them against the generated values" << endl;
+  out << "    for (unsigned j=0; j< NCONSTANTS; j++)" << endl;
+  out << "      if (std::fabs(c[j] - CONSTANTS[i][j]) > NEAR_ZERO*std::max((Real) 1.0, std::fabs(CONSTANTS[i][j])))" << endl;
+  out << "        return false;" << endl;
+  out << "  }" << endl << endl;
+  out << "  return true;" << endl;
+  out << "}" << endl << endl;
+
+  // write verify_model()
+  out << "/// Verifies that the body matches the model from which the code was generated" << endl;
+  out << "void " << name << "::verify_model()" << endl;
+  out << "{" << endl;
+  out << "  _link_joints.clear();" << endl;
+  out << "  _model_checked = true;" << endl << endl;
+  out << "  // verify the links and joints" << endl;
+  out << "  const std::vector<RigidBodyPtr>& links = get_links();" << endl;
+  out << "  if (links.size() != NLINKS || get_joints().size() != NLINKS-1 || num_joint_dof_implicit() != NDOF)" << endl;
+  out << "    return;" << endl;
+  out << "  const unsigned START_GC = (is_floating_base()) ? 6 : 0;" << endl;
+  out << "  std::vector<JointPtr> joints(NLINKS);" << endl;
+  out << "  for (unsigned i=1; i< NLINKS; i++)" << endl;
+  out << "  {" << endl;
+  out << "    joints[i] = links[i]->get_inner_joint_implicit();" << endl;
+  out << "    if (!joints[i] || links[i]->id != LINK_ID[i] || links[i]->get_parent_link() != links[PARENT[i]])" << endl;
+  out << "      return;" << endl;
+  out << "    if (joints[i]->get_coord_index() != START_GC + COORD[i])" << endl;
+  out << "      return;" << endl;
+  out << "    if (REVOLUTE[i] ? !boost::dynamic_pointer_cast<RevoluteJoint>(joints[i]) : !boost::dynamic_pointer_cast<PrismaticJoint>(joints[i]))" << endl;
+  out << "      return;" << endl;
+  out << "  }" << endl;
+  out << "  if (!matches_model(links, joints))" << endl;
+  out << "    return;" << endl << endl;
+  out << "  // body is verified; use the generated code" << endl;
+  out << "  _link_joints = joints;" << endl;
+  out << "}" << endl << endl;
+
+  // write verified()
+  out << "/// Determines whether the generated code may be used, reverifying the body if its parameters have changed" << endl;
+  out << "bool " << name << "::verified()" << endl;
+  out << "{" << endl;
+  out << "  if (!_model_checked)" << endl;
+  out << "    verify_model();" << endl;
+  out << "  return !_link_joints.empty();" << endl;
+  out << "}" << endl << endl;
+
+  // write compile()
+  out << "/// Compiles the body and verifies that it matches the model from which the code was generated" << endl;
+  out << "void " << name << "::compile()" << endl;
+  out << "{" << endl;
+  out << "  // the generic methods are used until the body is verified (compile() is" << endl;
+  out << "  // called repeatedly as the body is assembled)" << endl;
+  out << "  _link_joints.clear();" << endl;
+  out << "  _model_checked = true;" << endl;
+  out << "  RCArticulatedBody::compile();" << endl << endl;
+  out << "  verify_model();" << endl;
+  out << "  if (_link_joints.empty())" << endl;
+  out << "    return;" << endl;
+  out << "  update_link_transforms();" << endl;
+  out << "  update_link_velocities();" << endl;
+  out << "}" << endl << endl;
+
+  // write invalidate_parameters()
+  out << "/// Stops using the generated code until the body has been reverified against the model" << endl;
+  out << "void " << name << "::invalidate_parameters()" << endl;
+  out << "{" << endl;
+  out << "  RCArticulatedBody::invalidate_parameters();" << endl;
+  out << "  _link_joints.clear();" << endl;
+  out << "  _model_checked = false;" << endl;
+  out << "}" << endl << endl;
+
+  // write load_from_xml()
+  out << "/// Loads the body from XML and verifies that it matches the model from which the code was generated" << endl;
+  out << "void " << name << "::load_from_xml(XMLTreeConstPtr node, std::map<std::string, BasePtr>& id_map)" << endl;
+  out << "{" << endl;
+  out << "  RCArticulatedBody::load_from_xml(node, id_map);" << endl;
+  out << "  if (_link_joints.empty())" << endl;
+  out << "    std::cerr << \"" << name << "::load_from_xml() - body does not match the model from which the code was generated; using generic methods\" << std::endl;" << endl;
+  out << "}" << endl << endl;
+
+  // write update_link_transforms()
+  std::ostringstream body;
+  body << "/// Updates the transforms of the links based on the current joint positions" << endl;
+  body << "void " << name << "::update_link_transforms()" << endl;
+  body << "{" << endl;
+  body << "  if (!verified())" << endl;
+  body << "  {" << endl;
+  body << "    RCArticulatedBody::update_link_transforms();" << endl;
+  body << "    return;" << endl;
+  body << "  }" << endl << endl;
+  body << "  const std::vector<RigidBodyPtr>& links = get_links();" << endl << endl;
+  emit_joint_values(body, model, sym, true, false);
+  emit_relative_transforms(body, model, sym);
+  body << "  // get the base transform" << endl;
+  body << "  const Matrix4& T0 = links[0]->get_transform();" << endl << endl;
+  body << "  // compute and set the link transforms" << endl;
+  vector<Exprs> R(n), x(n);
+  Exprs R0(9), x0(3);
+  for (unsigned r=0; r< 3; r++)
+  {
+    for (unsigned c=0; c< 3; c++)
+      R0[r*3+c] = Expr("T0(" + str(r) + "," + str(c) + ")");
+    x0[r] = Expr("T0(" + str(r) + ",3)");
+  }
+  for (unsigned k=0; k< n; k++)
+  {
+    string i = str(links[k].index);
+    const Exprs& Rp = (links[k].parent < 0) ? R0 : R[links[k].parent];
+    const Exprs& xp = (links[k].parent < 0) ? x0 : x[links[k].parent];
+    R[k] = def(body, "Rg" + i + "_", mult33(Rp, sym.R[k]));
+    x[k] = def(body, "xg" + i + "_", xp + mult(Rp, sym.t[k]));
+    body << "  links[" << i << "]->set_transform(Matrix4(";
+    for (unsigned r=0; r< 3; r++)
+      body << ((r > 0) ? ", " : "") << text(R[k][r*3]) << ", " << text(R[k][r*3+1]) << ", " << text(R[k][r*3+2]) << ", " << text(x[k][r]);
+    body << "));" << endl;
+  }
+  body << "}" << endl << endl;
+  out << body.str();
+
+  // write update_link_velocities()
+  body.str("");
+  ntemps = 0;
+  body << "/// Updates the link velocities based on the current joint velocities" << endl;
+  body << "void " << name << "::update_link_velocities()" << endl;
+  body << "{" << endl;
+  body << "  if (!verified())" << endl;
+  body << "  {" << endl;
+  body << "    RCArticulatedBody::update_link_velocities();" << endl;
+  body << "    return;" << endl;
+  body << "  }" << endl << endl;
+  body << "  const std::vector<RigidBodyPtr>& links = get_links();" << endl << endl;
+  emit_joint_values(body, model, sym, true, true);
+  emit_relative_transforms(body, model, sym);
+  body << "  // get the spatial velocity of the base (link frame)" << endl;
+  body << "  const SVector6 vbase = links[0]->get_spatial_velocity(eLink);" << endl << endl;
+  Exprs v0(6);
+  for (unsigned j=0; j< 6; j++)
+    v0[j] = Expr("vbase[" + str(j) + "]");
+  emit_velocities(body, model, sym, v0);
+  body << "  // set the link velocities" << endl;
+  for (unsigned k=0; k< n; k++)
+    body << "  links[" << links[k].index << "]->set_spatial_velocity(" << svector6(sym.v[k]) << ", eLink);" << endl;
+  body << "}" << endl << endl;
+  out << body.str();
+
+  // write calc_joint_space_inertia()
+  body.str("");
+  ntemps = 0;
+  body << "/// Computes the joint-space inertia matrix" << endl;
+  body << "MatrixN& " << name << "::calc_joint_space_inertia(MatrixN& H)" << endl;
+  body << "{" << endl;
+  body << "  if (!verified())" << endl;
+  body << "    throw std::runtime_error(\"" << name << "::calc_joint_space_inertia() - body does not match the model from which the code was generated\");" << endl << endl;
+  emit_joint_values(body, model, sym, true, false);
+  emit_relative_transforms(body, model, sym);
+  vector<Exprs> H = emit_crb(body, model, sym);
+  body << "  // set the matrix" << endl;
+  body << "  H.set_zero(NDOF, NDOF);" << endl;
+  for (unsigned k=0; k< n; k++)
+    for (int j = k; j >= 0; j = links[j].parent)
+    {
+      body << "  H(" << links[k].coord << "," << links[j].coord << ") = ";
+      if ((unsigned) j != k)
+        body << "H(" << links[j].coord << "," << links[k].coord << ") = ";
+      body << text(H[k][j]) << ";" << endl;
+    }
+  body << "  return H;" << endl;
+  body << "}" << endl << endl;
+  out << body.str();
+
+  // write calc_inv_dyn()
+  body.str("");
+  ntemps = 0;
+  body << "/// Computes the joint forces necessary to realize the given joint accelerations" << endl;
+  body << "/**" << endl;
+  body << " * The external forces currently applied to the links are accounted for;" << endl;
+  body << " * joint friction is not." << endl;
+  body << " * \\param qdd the joint accelerations (indexed by joint coordinate)" << endl;
+  body << " * \\param Q the joint forces on return (indexed by joint coordinate)" << endl;
+  body << " */" << endl;
+  body << "VectorN& " << name << "::calc_inv_dyn(const VectorN& qdd, VectorN& Q)" << endl;
+  body << "{" << endl;
+  body << "  if (!verified())" << endl;
+  body << "    throw std::runtime_error(\"" << name << "::calc_inv_dyn() - body does not match the model from which the code was generated\");" << endl;
+  body << "  if (qdd.size() != NDOF)" << endl;
+  body << "    throw std::runtime_error(\"" << name << "::calc_inv_dyn() - incorrect number of joint accelerations\");" << endl << endl;
+  body << "  const std::vector<RigidBodyPtr>& links = get_links();" << endl << endl;
+  emit_joint_values(body, model, sym, true, true);
+  Exprs qdd(n);
+  for (unsigned k=0; k< n; k++)
+    qdd[k] = Expr("qdd[" + str(links[k].coord) + "]");
+  emit_relative_transforms(body, model, sym);
+  emit_velocities(body, model, sym, zeros(6));
+  Exprs tau = emit_rne(body, model, sym, qdd, "Q");
+  body << "  // set the joint forces" << endl;
+  body << "  Q.resize(NDOF);" << endl;
+  for (unsigned k=0; k< n; k++)
+    body << "  Q[" << links[k].coord << "] = " << text(tau[k]) << ";" << endl;
+  body << "  return Q;" << endl;
+  body << "}" << endl << endl;
+  out << body.str();
+
+  // write calc_fwd_dyn()
+  body.str("");
+  ntemps = 0;
+  body << "/// Computes the forward dynamics" << endl;
+  body << "/**" << endl;
+  body << " * Computes the joint accelerations and link accelerations as the" << endl;
+  body << " * composite rigid body method (CRBAlgorithm) does.  The generic" << endl;
+  body << " * algorithms are used for floating bases and for the advanced friction" << endl;
+  body << " * model." << endl;
+  body << " */" << endl;
+  body << "void " << name << "::calc_fwd_dyn(Real dt)" << endl;
+  body << "{" << endl;
+  body << "  if (is_floating_base() || use_advanced_friction_model || !verified())" << endl;
+  body << "  {" << endl;
+  body << "    RCArticulatedBody::calc_fwd_dyn(dt);" << endl;
+  body << "    return;" << endl;
+  body << "  }" << endl << endl;
+  body << "  const std::vector<RigidBodyPtr>& links = get_links();" << endl << endl;
+  emit_joint_values(body, model, sym, true, true);
+  body << "  // apply joint friction and get the (limited) actuator forces" << endl;
+  Exprs Q(n);
+  for (unsigned k=0; k< n; k++)
+  {
+    string i = str(links[k].index);
+    body << "  Joint& j" << i << " = *_link_joints[" << i << "];" << endl;
+    body << "  j" << i << ".force[0] += ((qd" << i << " < (Real) 0.0) ? j" << i << ".mu_fc : -j" << i << ".mu_fc) - qd" << i << "*j" << i << ".mu_fv;" << endl;
+    body << "  const Real Q" << i << " = std::max(-j" << i << ".maxforce[0], std::min(j" << i << ".force[0], j" << i << ".maxforce[0])) + j" << i << ".ff[0];" << endl;
+    Q[k] = Expr("Q" + i);
+  }
+  body << endl;
+  emit_relative_transforms(body, model, sym);
+  emit_velocities(body, model, sym, zeros(6));
+  Exprs C = emit_rne(body, model, sym, zeros(n), "C");
+  H = emit_crb(body, model, sym);
+  Exprs qdd_sol = emit_ltl_solve(body, model, H, Q - C, name);
+
+  // compute the link accelerations
+  body << "  // set the joint accelerations" << endl;
+  for (unsigned k=0; k< n; k++)
+    body << "  j" << links[k].index << ".qdd[0] = " << text(qdd_sol[k]) << ";" << endl;
+  body << endl;
+  body << "  // compute and set the link accelerations" << endl;
+  vector<Exprs> a(n);
+  for (unsigned k=0; k< n; k++)
+  {
+    const LinkData& link = links[k];
+    Exprs ak = sym.ab[k] + constant(link.s)*qdd_sol[k];
+    if (link.parent >= 0)
+      ak = ak + transform_forward(body, sym.R[k], sym.t[k], a[link.parent]);
+    a[k] = def(body, "acc" + str(link.index) + "_", ak);
+    body << "  links[" << link.index << "]->set_spatial_accel(" << svector6(a[k]) << ", eLink);" << endl;
+  }
+  body << "  links[0]->set_laccel(ZEROS_3);" << endl;
+  body << "  links[0]->set_aaccel(ZEROS_3);" << endl;
+  body << "}" << endl << endl;
+  out << body.str();
+}
+
+/// Extracts the model data from the articulated body
+bool setup_model(RCArticulatedBodyPtr body, Model& model)
+{
+  const vector<RigidBodyPtr>& links = body->get_links();
+  if (links.size() < 2)
+  {
+    std::cerr << "generate-dynamics error: body has no joints!" << std::endl;
+    return false;
+  }
+  if (body->num_joint_dof_explicit() > 0 || body->get_joints().size() != links.size()-1)
+  {
+    std::cerr << "generate-dynamics error: only tree-structured bodies are supported!" << std::endl;
+    return false;
+  }
+
+  model.id = body->id;
+  model.class_name = identifier(body->id);
+  model.nlinks = links.size();
+  const unsigned START_GC = (body->is_floating_base()) ? 6 : 0;
+
+  // process the links in breadth-first order from the base, so that every
+  // link is preceded by its parent
+  vector<int> order(links.size(), -1);
+  std::queue<RigidBodyPtr> link_queue;
+  link_queue.push(links.front());
+  while (!link_queue.empty())
+  {
+    RigidBodyPtr link = link_queue.front();
+    link_queue.pop();
+
+    // add the children to the queue
+    std::list<RigidBodyPtr> child_links;
+    link->get_child_links(std::back_inserter(child_links));
+    for (std::list<RigidBodyPtr>::const_iterator i = child_links.begin(); i != child_links.end(); i++)
+      link_queue.push(*i);
+
+    // nothing more to do for the base
+    if (link == links.front())
+      continue;
+
+    // get the joint and the parent link
+    JointPtr joint(link->get_inner_joint_implicit());
+    RigidBodyPtr parent(link->get_parent_link());
+    LinkData data;
+    data.id = link->id;
+    data.joint_id = joint->id;
+    data.index = link->get_index();
+    data.parent = order[parent->get_index()];
+    if (boost::dynamic_pointer_cast<RevoluteJoint>(joint))
+    {
+      data.revolute = true;
+      data.axis = boost::dynamic_pointer_cast<RevoluteJoint>(joint)->get_axis_local();
+    }
+    else if (boost::dynamic_pointer_cast<PrismaticJoint>(joint))
+    {
+      data.revolute = false;
+      data.axis = boost::dynamic_pointer_cast<PrismaticJoint>(joint)->get_axis_local();
+    }
+    else
+    {
+      std::cerr << "generate-dynamics error: joint '" << joint->id << "' is not a revolute or prismatic joint!" << std::endl;
+      return false;
+    }
+    data.q_tare = joint->get_q_tare()[0];
+    data.com_to_joint = parent->get_outer_joint_data(joint).com_to_joint_vec;
+    data.joint_to_com = link->get_inner_joint_data(joint).joint_to_com_vec_jf;
+    const SMatrix6N& s = joint->get_spatial_axes(eLink);
+    for (unsigned i=0; i< 6; i++)
+      data.s[i] = s(i,0);
+    data.coord = joint->get_coord_index() - START_GC;
+    data.mass = link->get_mass();
+    data.J = link->get_inertia();
+    order[link->get_index()] = model.links.size();
+    model.links.push_back(data);
+  }
+
+  if (model.links.size() != links.size()-1)
+  {
+    std::cerr << "generate-dynamics error: not all links are reachable from the base!" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  // verify syntax correct
+  if (argc != 4)
+  {
+    std::cerr << "syntax: generate-dynamics <XML file> <body ID> <output basename>" << std::endl;
+    std::cerr << "  (writes <output basename>.h and <output basename>.cpp)" << std::endl;
+    return -1;
+  }
+
+  // get the arguments
+  std::string xml_file(argv[1]);
+  std::string body_ID(argv[2]);
+  std::string output_base(argv[3]);
+
+  // read in the XML file
+  std::map<std::string, BasePtr> obj_map = XMLReader::read(xml_file);
+
+  // look for the object
+  BasePtr object = obj_map[body_ID];
+  if (!object)
+  {
+    std::cerr << "generate-dynamics error: unable to find object '" << body_ID << "'" << std::endl;
+    return -1;
+  }
+
+  // convert the object to a RCArticulated body
+  RCArticulatedBodyPtr body = boost::dynamic_pointer_cast<RCArticulatedBody>(object);
+  if (!body)
+  {
+    std::cerr << "generate-dynamics error: unable to cast body as RCArticulatedBody!" << std::endl;
+    return -1;
+  }
+
+  // get the model data
+  Model model;
+  if (!setup_model(body, model))
+    return -1;
+
+  // generate the code
+  std::string header = output_base + ".h";
+  std::string source = output_base + ".cpp";
+  std::string header_name = header.substr(header.find_last_of('/') == std::string::npos ? 0 : header.find_last_of('/')+1);
+  std::ostringstream hout, sout;
+  try
+  {
+    write_header(hout, model, xml_file);
+    write_source(sout, model, xml_file, header_name);
+  }
+  catch (const std::runtime_error& e)
+  {
+    std::cerr << "generate-dynamics error: " << e.what() << std::endl;
+    return -1;
+  }
+
+  // write the files
+  std::ofstream out(header.c_str());
+  if (out.fail())
+  {
+    std::cerr << "generate-dynamics error: unable to open " << header << " for writing" << std::endl;
+    return -1;
+  }
+  out << hout.str();
+  out.close();
+  out.open(source.c_str());
+  if (out.fail())
+  {
+    std::cerr << "generate-dynamics error: unable to open " << source << " for writing" << std::endl;
+    return -1;
+  }
+  out << sout.str();
+  out.close();
+
+  return 0;
+}
+
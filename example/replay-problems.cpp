@@ -0,0 +1,376 @@
+/*****************************************************************************
+ * Utility for replaying captured LCPs and QPs (see ProblemCapture) through
+ * the available solvers, for benchmarking and regression tracking
+ *****************************************************************************/
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <Moby/Optimization.h>
+#include <Moby/ProblemCapture.h>
+#include <Moby/WallClock.h>
+
+using namespace Moby;
+
+/// The maximum number of iterations for the iterative solvers
+unsigned MAX_ITER = 1000;
+
+/// The tolerance for the solvers
+Real TOL = NEAR_ZERO;
+
+/// The residual (or relative objective gap) above which a solution is reported as failed
+Real FAIL_TOL = 1e-6;
+
+/// The result of running a solver on a problem
+struct Result
+{
+  bool ok;               // whether the solver succeeded (and the residual is small)
+  Real time;             // the wall-clock time taken by the solver
+  int iterations;        // the number of iterations (-1 if not reported)
+  Real residual;         // the complementarity/feasibility/optimality residual
+};
+
+/// Totals for a solver over all problems
+struct Summary
+{
+  Summary() { n = nsolved = 0; time = max_residual = (Real) 0.0; }
+  unsigned n, nsolved;
+  Real time, max_residual;
+};
+
+/// The QP being solved by SQP
+const ProblemCapture::Problem* SQP_QP = NULL;
+
+/// Objective function for solving a QP using SQP
+Real sqp_f0(const VectorN& x, void* data)
+{
+  VectorN Gx;
+  SQP_QP->M.mult(x, Gx);
+  return x.dot(Gx)*(Real) 0.5 + x.dot(SQP_QP->q);
+}
+
+/// Objective gradient for solving a QP using SQP
+void sqp_grad0(const VectorN& x, VectorN& g, void* data)
+{
+  SQP_QP->M.mult(x, g) += SQP_QP->q;
+}
+
+/// Computes the residual of an LCP solution: the largest violation of z >= 0, w >= 0, and z'w = 0 (componentwise)
+Real calc_lcp_residual(const MatrixN& M, const VectorN& q, const VectorN& z)
+{
+  if (z.size() != q.size())
+    return std::numeric_limits<Real>::max();
+  VectorN w;
+  M.mult(z, w) += q;
+  Real r = (Real) 0.0;
+  for (unsigned i=0; i< z.size(); i++)
+  {
+    r = std::max(r, -z[i]);
+    r = std::max(r, -w[i]);
+    r = std::max(r, std::fabs(z[i]*w[i]));
+  }
+  return r;
+}
+
+/// Computes the residual of a QP solution: the largest violation of A*x >= b and x >= 0
+Real calc_qp_residual(const ProblemCapture::Problem& p, const VectorN& x)
+{
+  if (x.size() != p.q.size())
+    return std::numeric_limits<Real>::max();
+  VectorN Ax;
+  p.A.mult(x, Ax) -= p.b;
+  Real r = (Real) 0.0;
+  for (unsigned i=0; i< x.size(); i++)
+    r = std::max(r, -x[i]);
+  for (unsigned i=0; i< Ax.size(); i++)
+    r = std::max(r, -Ax[i]);
+  return r;
+}
+
+/// Computes the QP objective 0.5*x'*M*x + q'*x
+Real calc_qp_objective(const ProblemCapture::Problem& p, const VectorN& x)
+{
+  VectorN Mx;
+  p.M.mult(x, Mx);
+  return x.dot(Mx)*(Real) 0.5 + x.dot(p.q);
+}
+
+/// Computes the optimal value of a QP, against which the solvers' objectives are checked
+/**
+ * The optimal value is the smaller of the objectives of the captured solution
+ * and of the solution of the QP's KKT conditions (as an LCP) found by Lemke's
+ * algorithm, considering only those that are (to FAIL_TOL) solutions.
+ * \return the optimal value, or the maximum Real value if neither is a
+ *         solution
+ */
+Real calc_qp_optimum(const ProblemCapture::Problem& p)
+{
+  const unsigned N = p.q.size();
+  Real f = std::numeric_limits<Real>::max();
+
+  // check the captured solution
+  if (p.solved && calc_qp_residual(p, p.z) <= FAIL_TOL)
+    f = calc_qp_objective(p, p.z);
+
+  // solve the KKT conditions
+  MatrixN MM;
+  VectorN qq, z;
+  try
+  {
+    Optimization::qp_to_lcp1(p.M, p.q, p.A, p.b, MM, qq);
+    if (Optimization::lcp_lemke(MM, qq, z) && calc_lcp_residual(MM, qq, z) <= FAIL_TOL)
+      f = std::min(f, calc_qp_objective(p, z.resize(N, true)));
+  }
+  catch (std::exception& e)
+  {
+    // Lemke's algorithm failed; only the captured solution is used
+  }
+
+  return f;
+}
+
+/// Computes the relative gap between the QP objective at x and the optimal value (zero if the optimal value is unknown)
+Real calc_qp_gap(const ProblemCapture::Problem& p, const VectorN& x, Real f_opt)
+{
+  if (x.size() != p.q.size())
+    return std::numeric_limits<Real>::max();
+  if (f_opt == std::numeric_limits<Real>::max())
+    return (Real) 0.0;
+  return std::max((Real) 0.0, (calc_qp_objective(p, x) - f_opt)/((Real) 1.0 + std::fabs(f_opt)));
+}
+
+/// Converts a problem to the QP minimize 0.5*x'*G*x + c'*x subject to M*x >= q, x >= 0 (returns false if this is not possible)
+bool get_qp(const ProblemCapture::Problem& p, ProblemCapture::Problem& qp)
+{
+  qp.type = ProblemCapture::eQP;
+  qp.M.copy_from(p.M);
+  qp.q.copy_from(p.q);
+
+  // QPs need no conversion
+  if (p.type == ProblemCapture::eQP)
+  {
+    qp.A.copy_from(p.A);
+    qp.b.copy_from(p.b);
+    return true;
+  }
+
+  // an LCP with symmetric M is the QP minimize 0.5*z'*M*z + q'*z subject to
+  // M*z >= -q, z >= 0 (if the LCP has a solution, the QP has optimal value
+  // zero)
+  for (unsigned i=0; i< p.M.rows(); i++)
+    for (unsigned j=i+1; j< p.M.columns(); j++)
+      if (std::fabs(p.M(i,j) - p.M(j,i)) > NEAR_ZERO*((Real) 1.0 + std::fabs(p.M(i,j))))
+        return false;
+  qp.A.copy_from(p.M);
+  qp.b.copy_from(p.q).negate();
+  return true;
+}
+
+/// Determines whether a solver solves QPs (rather than LCPs)
+bool is_qp_solver(const std::string& solver)
+{
+  return solver == "qp_convex_activeset" || solver == "qp_convex_ip" || solver == "sqp";
+}
+
+/// Runs a solver on a problem
+/**
+ * \param f_opt the optimal value of the problem, if it is a QP (see 
+ *        calc_qp_optimum())
+ */
+Result run_solver(const std::string& solver, const ProblemCapture::Problem& p, const ProblemCapture::Problem& qp, Real f_opt)
+{
+  Result result;
+  result.ok = false;
+  result.time = (Real) 0.0;
+  result.iterations = -1;
+  result.residual = std::numeric_limits<Real>::max();
+
+  // get the LCP (QPs are converted)
+  MatrixN MM;
+  VectorN qq, z;
+  if (p.type == ProblemCapture::eLCP)
+  {
+    MM.copy_from(p.M);
+    qq.copy_from(p.q);
+  }
+  else
+    Optimization::qp_to_lcp1(p.M, p.q, p.A, p.b, MM, qq);
+
+  // setup QP solver parameters
+  const unsigned N = p.q.size();
+  OptParams oparams;
+  oparams.n = N;
+  oparams.m = oparams.r = 0;
+  oparams.max_iterations = MAX_ITER;
+  oparams.eps = oparams.eps_feas = TOL;
+  oparams.M.copy_from(qp.A);
+  oparams.q.copy_from(qp.b);
+  oparams.A.resize(0, N);
+  oparams.b.resize(0);
+  oparams.lb.set_zero(N);
+  oparams.ub.resize(0);
+
+  try
+  {
+    const double T0 = WallClock::now();
+    if (solver == "lcp_lemke")
+      result.ok = Optimization::lcp_lemke(MM, qq, z);
+    else if (solver == "lcp_lemke_regularized")
+      result.ok = Optimization::lcp_lemke_regularized(MM, qq, z);
+    else if (solver == "lcp_convex_ip")
+      result.ok = Optimization::lcp_convex_ip(MM, qq, z, TOL, TOL, TOL, MAX_ITER);
+    else if (solver == "lcp_iter_PD")
+      result.ok = Optimization::lcp_iter_PD(MM, qq, z, TOL, MAX_ITER);
+    else if (solver == "qp_convex_activeset")
+    {
+      Optimization::qp_convex_activeset(qp.M, qp.q, oparams, z);
+      result.ok = true;
+    }
+    else if (solver == "qp_convex_ip")
+      result.ok = Optimization::qp_convex_ip(qp.M, qp.q, oparams, z);
+    else if (solver == "sqp")
+    {
+      // SQP takes x >= 0 as linear inequalities
+      oparams.lb.resize(0);
+      oparams.M.resize(qp.A.rows() + N, N);
+      oparams.M.set_sub_mat(0, 0, qp.A);
+      oparams.M.set_sub_mat(qp.A.rows(), 0, MatrixN::identity(N));
+      oparams.q.resize(qp.b.size() + N);
+      oparams.q.set_sub_vec(0, qp.b);
+      oparams.q.set_sub_vec(qp.b.size(), VectorN::zero(N));
+      oparams.f0 = &sqp_f0;
+      oparams.grad0 = &sqp_grad0;
+      SQP_QP = &qp;
+      z.set_zero(N);
+      Optimization::sqp(oparams, z);
+      result.iterations = (int) oparams.iterations;
+      result.ok = true;
+    }
+    result.time = (Real) (WallClock::now() - T0);
+  }
+  catch (std::exception& e)
+  {
+    result.ok = false;
+    return result;
+  }
+
+  // compute the residual; solutions of the LCP form of a QP contain the
+  // multipliers after the QP variables (and their LCP residual measures the
+  // KKT conditions); solutions of QPs are also checked against the optimal
+  // value, since feasibility alone says nothing about optimality
+  if (p.type == ProblemCapture::eLCP)
+    result.residual = calc_lcp_residual(p.M, p.q, z);
+  else if (is_qp_solver(solver))
+    result.residual = std::max(calc_qp_residual(p, z), calc_qp_gap(p, z, f_opt));
+  else
+  {
+    result.residual = calc_lcp_residual(MM, qq, z);
+    if (z.size() >= N)
+      z.resize(N, true);
+    result.residual = std::max(result.residual, calc_qp_residual(p, z));
+    result.residual = std::max(result.residual, calc_qp_gap(p, z, f_opt));
+  }
+  result.ok = result.ok && result.residual <= FAIL_TOL;
+
+  return result;
+}
+
+int main(int argc, char** argv)
+{
+  const unsigned TWOCHAR_ARG = 4;
+  const char* SOLVERS[] = { "lcp_lemke", "lcp_lemke_regularized", "lcp_convex_ip", "lcp_iter_PD", "qp_convex_activeset", "qp_convex_ip", "sqp" };
+  const unsigned N_SOLVERS = sizeof(SOLVERS)/sizeof(SOLVERS[0]);
+
+  // check that syntax is ok
+  if (argc < 2)
+  {
+    std::cerr << "syntax: replay-problems [OPTIONS] <capture file 1> ... <capture file N>" << std::endl;
+    std::cerr << "  -mi=<n>    maximum number of iterations for the iterative solvers (default 1000)" << std::endl;
+    std::cerr << "  -ft=<tol>  residual or relative objective gap above which a solution is considered to have failed (default 1e-6)" << std::endl;
+    std::cerr << "  -s=<name>  only run the given solver (may be repeated)" << std::endl;
+    return -1;
+  }
+
+  // get all options and files
+  std::vector<std::string> solvers, files;
+  for (int i=1; i< argc; i++)
+  {
+    std::string option(argv[i]);
+    if (option.find("-mi=") == 0)
+      MAX_ITER = std::atoi(&argv[i][TWOCHAR_ARG]);
+    else if (option.find("-ft=") == 0)
+      FAIL_TOL = std::atof(&argv[i][TWOCHAR_ARG]);
+    else if (option.find("-s=") == 0)
+      solvers.push_back(option.substr(3));
+    else
+      files.push_back(option);
+  }
+  if (solvers.empty())
+    solvers.insert(solvers.end(), SOLVERS, SOLVERS+N_SOLVERS);
+
+  // output the header
+  std::cout << "# problem type size captured-solver captured-time solver status time iterations residual" << std::endl;
+
+  // replay all problems
+  std::map<std::string, Summary> summaries;
+  unsigned idx = 0;
+  for (unsigned f=0; f< files.size(); f++)
+  {
+    std::ifstream in(files[f].c_str(), std::ios::in | std::ios::binary);
+    if (in.fail())
+    {
+      std::cerr << "replay-problems: unable to open " << files[f] << std::endl;
+      continue;
+    }
+
+    ProblemCapture::Problem p, qp;
+    try
+    {
+      while (ProblemCapture::read(in, p))
+      {
+        const bool HAS_QP = get_qp(p, qp);
+        const Real F_OPT = (p.type == ProblemCapture::eQP) ? calc_qp_optimum(p) : std::numeric_limits<Real>::max();
+        for (unsigned s=0; s< solvers.size(); s++)
+        {
+          // the QP solvers can only solve LCPs with symmetric matrices
+          if (!HAS_QP && is_qp_solver(solvers[s]))
+            continue;
+          const Result R = run_solver(solvers[s], p, qp, F_OPT);
+
+          std::cout << idx << " " << ((p.type == ProblemCapture::eLCP) ? "LCP" : "QP") << " " << p.q.size() << " " << ((p.solver.empty()) ? "-" : p.solver) << " " << p.time << " " << solvers[s] << " " << ((R.ok) ? "ok" : "FAIL") << " " << R.time << " ";
+          if (R.iterations >= 0)
+            std::cout << R.iterations;
+          else
+            std::cout << "-";
+          std::cout << " " << R.residual << std::endl;
+
+          // update the summary
+          Summary& sum = summaries[solvers[s]];
+          sum.n++;
+          if (R.ok)
+          {
+            sum.nsolved++;
+            sum.max_residual = std::max(sum.max_residual, R.residual);
+          }
+          sum.time += R.time;
+        }
+        idx++;
+      }
+    }
+    catch (std::runtime_error& e)
+    {
+      std::cerr << "replay-problems: " << files[f] << ": " << e.what() << std::endl;
+    }
+  }
+
+  // output the summary
+  std::cout << "# solver problems solved total-time max-residual(solved)" << std::endl;
+  for (std::map<std::string, Summary>::const_iterator i = summaries.begin(); i != summaries.end(); i++)
+    std::cout << "# " << i->first << " " << i->second.n << " " << i->second.nsolved << " " << i->second.time << " " << i->second.max_residual << std::endl;
+
+  return 0;
+}
+
@@ -103,6 +103,9 @@ class ArticulatedBody : public DynamicBody
     /// Invalidates the link velocities (manually)
     virtual void invalidate_velocities() { _velocities_valid = false; }
 
+    /// Called when a mass, inertia, or joint axis of one of the links or joints changes
+    virtual void invalidate_parameters() { }
+
     /// Validates the link positions (manually)
     void validate_positions() { _positions_valid = true; }
 
@@ -34,6 +34,9 @@ class CRBAlgorithm
     std::vector<unsigned> _lambda;
     void setup_parent_array();
 
+    /// Determines whether the generalized coordinates are numbered such that the parent array can be used to factorize M
+    bool _sparse_factorization;
+
     /// Is positional data valid?
     bool _position_data_valid;
 
@@ -79,6 +82,7 @@ class CRBAlgorithm
     static void to_spatial7_inertia(const SpatialRBInertia& I, const Quat& q, MatrixN& I7);
     VectorN& M_solve_noprecalc(const VectorN& v, VectorN& result) const;
     MatrixN& M_solve_noprecalc(const MatrixN& v, MatrixN& result) const;
+    void solve_cholesky_sparse(Real* x) const;
 };
 }
 
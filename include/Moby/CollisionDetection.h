@@ -36,6 +36,15 @@ struct CollidingTriPair
   const IndexedTriArray* mesh2;  // second triangle mesh
 };
 
+/// Structure for holding the nearest intersection of a ray with the geometries
+struct RayHit
+{
+  CollisionGeometryPtr geom;     // geometry hit by the ray (NULL if no hit) 
+  Real dist;                     // distance from the ray origin to the hit 
+  Vector3 point;                 // point of intersection (global frame)
+  Vector3 normal;                // surface normal at the hit (global frame)
+};
+
 /// Defines an abstract collision detection mechanism
 /**
  * Contact finding and collision detection are two separate, but related, 
@@ -68,6 +77,7 @@ class CollisionDetection : public virtual Base
     virtual void set_enabled(BasePtr b1, BasePtr b2, bool enabled);
     virtual void set_enabled(BasePtr b, bool enabled);
     bool is_checked(CollisionGeometryPtr cg1, CollisionGeometryPtr cg2) const;
+    unsigned cast_rays(const std::vector<LineSeg3>& rays, std::vector<RayHit>& hits);
 
     /// Get the shared pointer for this
     boost::shared_ptr<CollisionDetection> get_this() { return boost::dynamic_pointer_cast<CollisionDetection>(shared_from_this()); }
@@ -7,6 +7,7 @@
 #ifndef _DYNAMIC_BODY_H
 #define _DYNAMIC_BODY_H
 
+#include <limits>
 #include <boost/shared_ptr.hpp>
 #include <boost/foreach.hpp>
 #include <Moby/Base.h>
@@ -33,6 +34,7 @@ class DynamicBody : public Visualizable
     DynamicBody() 
     { 
       controller = NULL; 
+      _index = std::numeric_limits<unsigned>::max();
     }
 
     virtual ~DynamicBody() {}
@@ -127,8 +129,23 @@ class DynamicBody : public Visualizable
     /// Gets the angular speed of this body (or maximum angular speed of the links, if this body is articulated)
     virtual Real get_aspeed() const = 0; 
 
+    /// Gets the dense index of this body, assigned by the simulator containing it (see Simulator::add_dynamic_body())
+    /**
+     * A body added to a simulator has the index of its position in
+     * Simulator::get_dynamic_bodies(); the links of articulated bodies are 
+     * indexed following these.  Bodies not in a simulator have index
+     * std::numeric_limits<unsigned>::max().
+     */
+    unsigned get_index() const { return _index; }
+
+    /// Sets the dense index of this body (used by Simulator)
+    void set_index(unsigned index) { _index = index; }
+
   private:
 
+    /// The dense index of this body
+    unsigned _index;
+
     /// Set of recurrent forces applied to this body
     std::list<RecurrentForcePtr> _rfs;
 
@@ -12,6 +12,7 @@
 #include <boost/shared_ptr.hpp>
 #include <Moby/Constants.h>
 #include <Moby/Types.h>
+#include <Moby/Vector2.h>
 #include <Moby/Vector3.h>
 #include <Moby/Joint.h>
 #include <Moby/RigidBody.h>
@@ -33,6 +34,8 @@ class Event
     static void determine_connected_events(const std::vector<Event>& events, std::list<std::list<Event*> >& groups);
     static void remove_nonimpacting_groups(std::list<std::list<Event*> >& groups, Real tol);
     Event& operator=(const Event& e);
+    void swap(Event& e);
+    static void sort_events(std::vector<Event>& events);
     Real calc_event_vel() const;
     Real calc_event_tol() const;
     EventClass determine_event_class(Real tol = NEAR_ZERO) const;
@@ -125,6 +128,10 @@ class Event
     static void insertion_sort(BidirectionalIterator begin, BidirectionalIterator end);
     static void compute_contact_jacobians(const Event& e, MatrixN& Jc, MatrixN& Dc, MatrixN& iM_JcT, MatrixN& iM_DcT, unsigned ci, const std::map<DynamicBodyPtr, unsigned>& gc_indices);
     static unsigned gauss_elim(MatrixN& A, std::vector<unsigned>& piv);
+    static void reduce_contact_manifolds(std::list<Event*>& group);
+    static unsigned select_max_area_quad(const std::vector<Vector2>& hull, unsigned quad[4]);
+    static bool compare_event_order(const std::pair<Real, unsigned>& a, const std::pair<Real, unsigned>& b) { return a.first < b.first; }
+    static unsigned get_island_index(DynamicBodyPtr body, unsigned NINDEXED, std::vector<DynamicBodyPtr>& unindexed);
 }; // end class
 
 std::ostream& operator<<(std::ostream& out, const Event& e);
@@ -11,6 +11,7 @@
 #include <Moby/sorted_pair>
 #include <Moby/Simulator.h>
 #include <Moby/ImpactEventHandler.h>
+#include <Moby/SolverStats.h>
 #include <Moby/Event.h>
 
 namespace Moby {
@@ -39,6 +40,34 @@ class EventDrivenSimulator : public Simulator
     /// The maximum step size taken when handling a Zeno point (default is INF)
     Real max_Zeno_step;
 
+    /// The wall-clock time (in seconds) that a call to step() may take (default is INF)
+    /**
+     * Each time events are handled during a step, the time remaining in the
+     * step (if less than the impact event handler's own time budget) is 
+     * used as the time budget for computing impulses; the impulses are then
+     * the best found before the deadline (see 
+     * ImpactEventHandler::time_budget).  The step itself is not shortened.
+     */
+    Real step_time_budget;
+
+    /// Set by step() to indicate whether event handling during the step exhausted its time budget
+    bool step_budget_exceeded;
+
+    /// The number of steps for which event handling exhausted its time budget
+    unsigned num_budget_exceeded_steps;
+
+    /// Set by step() to the statistics of the solver calls made during the step
+    /**
+     * step() installs this as the SolverStats collector for the thread that
+     * calls it (and for the event handling threads that it starts), so solver
+     * calls made between steps, or by other simulators stepping concurrently
+     * in other threads, are not counted.
+     */
+    SolverStats step_solver_stats;
+
+    /// The statistics of the solver calls made during all steps
+    SolverStats total_solver_stats;
+
     /// The collision detection mechanisms
     std::list<boost::shared_ptr<CollisionDetection> > collision_detectors;
 
@@ -65,6 +94,9 @@ class EventDrivenSimulator : public Simulator
     /// Gets the (sorted) event data
     std::vector<Event>& get_events() { return _events; }
 
+    /// Gets the object used to handle impact events (for setting solver options)
+    ImpactEventHandler& get_impact_event_handler() { return _impact_event_handler; }
+
     /// Mapping from objects to contact parameters
     std::map<sorted_pair<BasePtr>, boost::shared_ptr<ContactParameters> > contact_params;
 
@@ -73,7 +105,8 @@ class EventDrivenSimulator : public Simulator
   private:
     void handle_Zeno_point(Real dt, const std::vector<std::pair<VectorN, VectorN> >& q0, std::vector<std::pair<VectorN, VectorN> >& q1);
     static void copy(const std::vector<std::pair<VectorN, VectorN> >& source, std::vector<std::pair<VectorN, VectorN> >& dest);
-    static void determine_treated_bodies(std::list<std::list<Event*> >& groups, std::vector<DynamicBodyPtr>& bodies);
+    void mark_treated_bodies(const Event& e, std::vector<bool>& treated) const;
+    static void move_events(std::vector<Event>& source, std::vector<Event>& dest);
     Real find_and_handle_events(Real dt, const std::vector<std::pair<VectorN, VectorN> >& q0, const std::vector<std::pair<VectorN, VectorN> >& q1, bool& Zeno);
     bool will_impact(Event& e, const std::vector<std::pair<VectorN, VectorN> >& q0, const std::vector<std::pair<VectorN, VectorN> >& q1, Real dt) const;
     void get_coords_and_velocities(std::vector<std::pair<VectorN, VectorN> >& q) const;
@@ -88,11 +121,14 @@ class EventDrivenSimulator : public Simulator
     boost::shared_ptr<ContactParameters> get_contact_parameters(CollisionGeometryPtr geom1, CollisionGeometryPtr geom2) const;
 
     // Visualization functions
-    void visualize_contact( Event& event );
+    void visualize_contact( const Event& event );
 
     /// Determines whether the simulation constraints have been violated
     bool _simulation_violated;
 
+    /// The time (see WallClock) by which the current step must be completed
+    double _step_deadline;
+
     /// The vector of events
     std::vector<Event> _events;
 
@@ -2,9 +2,13 @@
 #define _MOBY_EVENT_PROBLEM_DATA_H
 
 #include <vector>
+#include <algorithm>
+#include <limits>
 #include <Moby/MatrixN.h>
 #include <Moby/VectorN.h>
+#include <Moby/Vector3.h>
 #include <Moby/Types.h>
+#include <Moby/WallClock.h>
 
 namespace Moby {
 
@@ -15,6 +19,8 @@ struct EventProblemData
   // setup reasonable defaults
   EventProblemData()
   {
+    deadline = WallClock::never();
+    n_truncated_solves = n_skipped_solves = 0;
     reset();
   }
 
@@ -32,6 +38,15 @@ struct EventProblemData
     contact_events.clear();
     limit_events.clear();
     constraint_events.clear();
+    super_body_contacts.clear();
+    super_body_limits.clear();
+    contact_blocks.clear();
+    contact_block_entries.clear();
+    last_contacts.clear();
+    last_limits.clear();
+    last_constraints.clear();
+    last_gc.clear();
+    has_last_state = false;
 
     // reset all VectorN sizes
     Jc_v.resize(0);
@@ -45,15 +60,14 @@ struct EventProblemData
     beta_t.resize(0);
     alpha_x.resize(0);
     beta_x.resize(0);
+    alpha_c0.resize(0);
+    beta_c0.resize(0);
 
     // reset all MatrixN sizes
-    Jc_iM_JcT.resize(0,0);
-    Jc_iM_DcT.resize(0,0);
     Jc_iM_JlT.resize(0,0);
     Jc_iM_DtT.resize(0,0);
     Jc_iM_JxT.resize(0,0);
     Jc_iM_DxT.resize(0,0);
-    Dc_iM_DcT.resize(0,0);
     Dc_iM_JlT.resize(0,0);
     Dc_iM_DtT.resize(0,0);
     Dc_iM_JxT.resize(0,0);
@@ -107,13 +121,77 @@ struct EventProblemData
   // the vectors of events
   std::vector<Event*> contact_events, limit_events, constraint_events;
 
-  // cross-event terms
-  MatrixN Jc_iM_JcT, Jc_iM_DcT, Jc_iM_JlT, Jc_iM_DtT, Jc_iM_JxT, Jc_iM_DxT;
-  MatrixN            Dc_iM_DcT, Dc_iM_JlT, Dc_iM_DtT, Dc_iM_JxT, Dc_iM_DxT;
-  MatrixN                       Jl_iM_JlT, Jl_iM_DtT, Jl_iM_JxT, Jl_iM_DxT;
-  MatrixN                                  Dt_iM_DtT, Dt_iM_JxT, Dt_iM_DxT;
-  MatrixN                                             Jx_iM_JxT, Jx_iM_DxT;
-  MatrixN                                                        Dx_iM_DxT;
+  // gets the index of a super body in super_bodies (or super_bodies.size() if the body is not a super body)
+  unsigned get_super_body_index(DynamicBodyPtr body) const
+  {
+    std::vector<DynamicBodyPtr>::const_iterator i = std::lower_bound(super_bodies.begin(), super_bodies.end(), body);
+    return (i != super_bodies.end() && *i == body) ? i - super_bodies.begin() : super_bodies.size();
+  }
+
+  // gets the (sorted) indices of the contact events that involve a super body
+  const std::vector<unsigned>& get_super_body_contacts(DynamicBodyPtr body) const
+  {
+    static const std::vector<unsigned> EMPTY;
+    unsigned i = get_super_body_index(body);
+    return (i < super_body_contacts.size()) ? super_body_contacts[i] : EMPTY;
+  }
+
+  // the (sorted) indices of the contact events that involve each super body
+  // (parallel to super_bodies); this is the block structure of the contact
+  // cross-event terms: the entries for contacts i and j can be nonzero only
+  // if i and j involve a common super body.  Disabled bodies are not 
+  // considered to be involved in events.
+  std::vector<std::vector<unsigned> > super_body_contacts;
+
+  // the (sorted) indices of the limit events that involve each super body 
+  // (parallel to super_bodies)
+  std::vector<std::vector<unsigned> > super_body_limits;
+
+  // the contact-contact cross-event terms contributed by one super body:
+  // entry (a,b) of Jc_iM_JcT is the term for the contact events 
+  // super_body_contacts[s][a] and super_body_contacts[s][b]; the tangent 
+  // directions of the a'th contact are rows (and columns) 2a and 2a+1 of the
+  // tangent terms
+  struct ContactBlock
+  {
+    MatrixN Jc_iM_JcT, Jc_iM_DcT, Dc_iM_DcT;
+  };
+
+  // the contact-contact cross-event terms, as one block per super body 
+  // (parallel to super_bodies); each term is the sum of the blocks, so a 
+  // contact between two super bodies receives contributions from both.  Only
+  // the nonzero blocks are stored; use get_contact_terms() to assemble the
+  // dense terms.
+  std::vector<ContactBlock> contact_blocks;
+
+  // the blocks in which each contact event appears: (index of super body, 
+  // index of the contact event in super_body_contacts) for each of the (up 
+  // to two) super bodies of the contact event
+  std::vector<std::vector<std::pair<unsigned, unsigned> > > contact_block_entries;
+
+  // sizes and zeros the contact blocks
+  void init_contact_blocks();
+
+  // gets single entries of the contact-contact cross-event terms (i and j 
+  // index contacts; k and l index tangent directions)
+  Real get_Jc_iM_JcT(unsigned i, unsigned j) const;
+  Real get_Jc_iM_DcT(unsigned i, unsigned l) const;
+  Real get_Dc_iM_DcT(unsigned k, unsigned l) const;
+
+  // adds Jc*inv(M)*[Jc' Dc']*[alpha_c; beta_c] to Jc_v and 
+  // Dc*inv(M)*[Jc' Dc']*[alpha_c; beta_c] to Dc_v
+  void add_contact_velocity_changes(const VectorN& alpha_c, const VectorN& beta_c, VectorN& Jc_v, VectorN& Dc_v) const;
+
+  // assembles the dense contact-contact cross-event terms
+  void get_contact_terms(MatrixN& Jc_iM_JcT, MatrixN& Jc_iM_DcT, MatrixN& Dc_iM_DcT) const;
+
+  // cross-event terms (the contact-contact terms are in contact_blocks)
+  MatrixN Jc_iM_JlT, Jc_iM_DtT, Jc_iM_JxT, Jc_iM_DxT;
+  MatrixN Dc_iM_JlT, Dc_iM_DtT, Dc_iM_JxT, Dc_iM_DxT;
+  MatrixN Jl_iM_JlT, Jl_iM_DtT, Jl_iM_JxT, Jl_iM_DxT;
+  MatrixN            Dt_iM_DtT, Dt_iM_JxT, Dt_iM_DxT;
+  MatrixN                       Jx_iM_JxT, Jx_iM_DxT;
+  MatrixN                                  Dx_iM_DxT;
 
   // vector-based terms
   VectorN Jc_v, Dc_v, Jl_v, Jx_v, Dx_v;
@@ -126,6 +204,47 @@ struct EventProblemData
 
   // impulse magnitudes determined by solve_qp()
   VectorN alpha_c, beta_c, alpha_l, beta_t, alpha_x, beta_x;
+
+  // initial guesses for contact impulse magnitudes, used to warm start the
+  // solvers (empty if no guess is available)
+  VectorN alpha_c0, beta_c0;
+
+  // the state of a contact event from which the cross-event terms were 
+  // computed
+  struct ContactState
+  {
+    CollisionGeometryPtr geom1, geom2;
+    unsigned NK;
+    Vector3 point, normal, tan1, tan2;
+  };
+
+  // the state of a limit event from which the cross-event terms were computed
+  struct LimitState
+  {
+    JointPtr joint;
+    unsigned dof;
+    bool upper;
+  };
+
+  // the events and super body configurations (parallel to contact_events, 
+  // limit_events, constraint_events, and super_bodies) from which the 
+  // cross-event terms were computed; these are used to update the terms 
+  // incrementally when the events barely change between problems
+  std::vector<ContactState> last_contacts;
+  std::vector<LimitState> last_limits;
+  std::vector<JointPtr> last_constraints;
+  std::vector<VectorN> last_gc;
+
+  // whether the state above is valid
+  bool has_last_state;
+
+  // the time (see WallClock) after which the solvers return the best 
+  // impulses found so far, rather than converging
+  double deadline;
+
+  // the number of solves that were stopped early and the number that were
+  // skipped because the deadline passed
+  unsigned n_truncated_solves, n_skipped_solves;
 }; // end struct
 
 } // end namespace Moby
@@ -96,6 +96,7 @@ class FSABAlgorithm
 
     static Real sgn(Real x);
     static void push_children(RigidBodyPtr link, std::queue<RigidBodyPtr>& q);
+    static void push_children(RigidBodyPtr link, std::vector<unsigned>& q);
     void apply_coulomb_joint_friction(RCArticulatedBodyPtr body, ReferenceFrameType rftype);
     void calc_impulse_dyn(RCArticulatedBodyPtr body, ReferenceFrameType rftype);
     void apply_generalized_impulse(unsigned index, const std::vector<MatrixN>& sTI, VectorN& vgj) const;
@@ -10,12 +10,21 @@
 #include <list>
 #include <vector>
 #include <map>
+#include <string>
+#include <algorithm>
+#ifdef THREADED
+#include <pthread.h>
+#endif
+#include <Moby/sorted_pair>
 #include <Moby/Base.h>
 #include <Moby/Types.h>
 #include <Moby/Event.h>
+#include <Moby/SolverStats.h>
 
 namespace Moby {
 
+class SparseLDL;
+
 /// Defines the mechanism for handling impact events 
 class ImpactEventHandler
 {
@@ -114,29 +123,215 @@ class ImpactEventHandler
   public:
     ImpactEventHandler();
     void process_events(const std::vector<Event>& events, Real tol = NEAR_ZERO);
-
-    /// If set to true, uses the interior-point solver (default is false)
+    void process_events(const std::vector<Event>& events, Real tol, double deadline);
+
+    /// If set to true, uses the sparse interior-point solver for QP impact problems (default is false)
+    /**
+     * The interior-point solver is not used for problems with explicit
+     * joint constraint equations; Lemke's algorithm is used if the 
+     * interior-point solver fails to converge.
+     */
     bool use_ip_solver;
 
-    /// The maximum number of iterations to use for the interior-point solver 
+    /// The maximum number of iterations to use for the interior-point solver (default 100)
     unsigned ip_max_iterations;
 
     /// The tolerance for to the interior-point solver (default 1e-6)
     Real ip_eps;
 
+    /// If set to true, uses the iterative (projected Gauss-Seidel) solver (default is false)
+    /**
+     * The iterative solver is not used for events involving articulated
+     * bodies that use the advanced joint friction model.
+     */
+    bool use_iterative_solver;
+
+    /// The maximum number of sweeps to use for the iterative solver (default 100)
+    unsigned iter_max_iterations;
+
+    /// The tolerance for the iterative solver (default 1e-6)
+    /**
+     * The iterative solver terminates when no impulse changes by more than
+     * this amount over a sweep.
+     */
+    Real iter_eps;
+
+    /// If set to true, contacts persist across calls to process_events() and the solvers are warm-started using the contact impulses from the previous call (default is true)
+    /**
+     * A contact persists if it is between the same pair of geometries as a
+     * contact from the previous call and lies (in the frame of the first
+     * geometry) within warm_start_dist of it; the closest pairs are 
+     * matched first, and each contact from the previous call continues at
+     * most one contact.  Only contacts whose impulses were computed (not 
+     * those dropped from the reduced contact sets) are kept.  A persistent
+     * contact keeps its tangent frame, so its friction impulse is expressed
+     * in the same directions from call to call.  The iterative solver starts from the
+     * previous impulses; Lemke's algorithm (used by the QP solver) starts 
+     * from the basis indicated by the previous impulses (unless there are 
+     * explicit joint constraints).  The interior-point solver is not 
+     * warm-started, as its iterates must start well inside the feasible 
+     * region.
+     */
+    bool warm_start;
+
+    /// The maximum distance (in the frame of the first geometry of the pair) between a contact point and a contact point from the previous call to process_events() for the contacts to be considered the same (default 1e-2)
+    Real warm_start_dist;
+
+    /// The tolerance for reusing the problem data from the last call to process_events() (default NEAR_ZERO)
+    /**
+     * If a group of events is between the same geometries as the group 
+     * solved in the same position by the last call, only the cross-event 
+     * terms for events whose contact points and frames, or whose super 
+     * bodies' generalized coordinates, have moved by more than this amount
+     * are recomputed.  Events involving articulated or deformable bodies are
+     * always recomputed.  A negative value disables reuse.
+     */
+    Real problem_data_reuse_tol;
+
     /// The velocity tolerance above which another iteration of the solver is run after applying Poisson restitution
     Real poisson_eps;
 
+    /// The maximum number of threads used to solve independent groups of events
+    /**
+     * Groups are only solved concurrently when Moby is built to be threadsafe
+     * (otherwise the solvers share static work variables); the default is the
+     * number of online processors in a threadsafe build and 1 otherwise.
+     */
+    unsigned max_threads;
+
+    /// The wall-clock time (in seconds) that each call to process_events() may spend computing impulses (default is infinity)
+    /**
+     * Once the budget is exhausted, the solvers return the best impulses 
+     * found so far rather than converging: the iterative solver stops after
+     * its current sweep; the interior-point solver and Lemke's algorithm
+     * stop, and the problem is solved using the iterative solver instead 
+     * (every problem that does not use the advanced joint friction model 
+     * is solved with at least one sweep); and the extra solves that follow
+     * the application of Poisson restitution are skipped.  
+     */
+    Real time_budget;
+
+    /// Set by process_events() to indicate whether any solve was stopped early or skipped because the time budget was exhausted
+    bool budget_exceeded;
+
+    /// The number of solves that the last call to process_events() stopped early because the time budget was exhausted
+    unsigned num_truncated_solves;
+
+    /// The number of solves that the last call to process_events() skipped because the time budget was exhausted
+    unsigned num_skipped_solves;
+
+    /// If nonempty, each impact QP solved by Lemke's algorithm or the interior-point solver is appended to this file (see ProblemCapture)
+    /**
+     * The QPs are captured in the form minimize 0.5*z'*H*z + c'*z subject to
+     * A*z >= b, z >= 0, along with the solution, the time taken by the 
+     * solver, and (for the interior-point solver) the number of iterations.
+     */
+    std::string capture_filename;
+
   private:
+    /// Key identifying a contact across calls to process_events()
+    /**
+     * A contact is identified by its pair of geometries and by its position
+     * in the frame of the first geometry of the pair, quantized to a grid
+     * with spacing warm_start_dist.
+     */
+    struct ContactKey
+    {
+      ContactKey(const sorted_pair<CollisionGeometryPtr>& g) : geoms(g) { }
+
+      bool operator<(const ContactKey& k) const
+      {
+        if (geoms < k.geoms) return true;
+        if (k.geoms < geoms) return false;
+        return std::lexicographical_compare(cell, cell+3, k.cell, k.cell+3);
+      }
+
+      /// the pair of geometries
+      sorted_pair<CollisionGeometryPtr> geoms;
+
+      /// the grid cell containing the contact point
+      int cell[3];
+    };
+
+    /// Data for a contact saved for use by later calls to process_events()
+    /**
+     * All vectors are expressed in the frame of the first geometry of the
+     * pair, so that they follow the geometry between calls.
+     */
+    struct CachedContact
+    {
+      /// the contact point
+      Vector3 point;
+
+      /// the first contact tangent
+      Vector3 tan1;
+
+      /// the contact impulse (applied to the first geometry of the pair)
+      Vector3 impulse;
+    };
+
+    /// Queue of connected event groups shared by the threads that solve them
+    struct GroupQueue
+    {
+      /// the event handler
+      const ImpactEventHandler* handler;
+
+      /// the problem data for each group
+      std::vector<EventProblemData>* problem_data;
+
+      /// the groups of connected events
+      std::vector<std::list<Event*>*> groups;
+
+      /// the reduced sets of events for each group
+      std::vector<std::list<Event*> > reduced;
+
+      /// the index of the next group to be solved
+      unsigned next;
+
+      /// message of the first exception thrown while solving a group (if any)
+      std::string error;
+
+      /// the solver statistics collector of the thread that filled the queue
+      SolverStats* stats_collector;
+
+      #ifdef THREADED
+      /// lock for next and error
+      pthread_mutex_t mutex;
+      #endif
+    };
+
+    static void* solve_groups(void* arg);
     static DynamicBodyPtr get_super_body(SingleBodyPtr sb);
     static bool use_qp_solver(const EventProblemData& epd);
-    void apply_model(const std::vector<Event>& events, Real tol) const;
-    void apply_model_to_connected_events(const std::list<Event*>& events) const;
+    void apply_model(const std::vector<Event>& events, Real tol);
+    void apply_model_to_group(std::list<Event*>& group, std::list<Event*>& reduced, EventProblemData& epd) const;
+    void apply_model_to_connected_events(const std::list<Event*>& events, EventProblemData& epd) const;
     static void compute_problem_data(EventProblemData& epd);
+    bool update_problem_data(const std::vector<Event*>& contacts, const std::vector<Event*>& limits, const std::vector<Event*>& constraints, EventProblemData& epd) const;
+    static void determine_super_bodies(const EventProblemData& epd, std::vector<DynamicBodyPtr>& super_bodies);
+    static void init_problem_matrices(EventProblemData& epd);
+    static void save_problem_state(EventProblemData& epd);
+    static void save_contact_state(const Event& e, EventProblemData::ContactState& c);
+    static bool contact_moved(const Event& e, const EventProblemData::ContactState& c, Real tol);
+    static void determine_event_blocks(EventProblemData& epd);
     static void solve_lcp(EventProblemData& epd, VectorN& z);
-    static void solve_qp(EventProblemData& epd, Real eps);
+    bool solve_qp(EventProblemData& epd, Real eps) const;
     static void solve_nqp(EventProblemData& epd, Real eps);
-    static void solve_qp_work(EventProblemData& epd, VectorN& z);
+    void solve_iterative(EventProblemData& epd, Real eps) const;
+    bool solve_iterative_work(const EventProblemData& epd, VectorN& x) const;
+    static Real calc_contact_row_dot(const EventProblemData& q, const MatrixN& G, unsigned i, unsigned dir, const VectorN& x, unsigned BETA_C_IDX, unsigned ALPHA_L_IDX);
+    void get_warm_start_impulses(EventProblemData& epd) const;
+    void save_contact_cache(const std::vector<std::list<Event*> >& solved);
+    void match_cached_contacts(const std::list<std::list<Event*> >& groups);
+    const CachedContact* find_cached_contact(const Event& e) const;
+    void determine_contact_tangents(Event& e) const;
+    void get_contact_cell(const Vector3& p, int cell[3]) const;
+    bool solve_qp_work(EventProblemData& epd, VectorN& z) const;
+    bool solve_qp_work_ip(EventProblemData& epd, VectorN& z) const;
+    static Real get_qp_hessian_entry(const EventProblemData& epd, unsigned u, unsigned v);
+    static void solve_qp_ip_direction(const SparseLDL& ldl, const VectorN& y, const VectorN& s, const VectorN& lambda, const VectorN& mu, const VectorN& rd, const VectorN& rp, const VectorN& ryu, const VectorN& rsl, VectorN& rhs, VectorN& dy, VectorN& ds, VectorN& dlambda, VectorN& dmu);
+    static Real calc_max_step(const VectorN& x, const VectorN& dx);
+    static void get_lcp_warm_start(const EventProblemData& epd, unsigned n, VectorN& z);
     static void solve_nqp_work(EventProblemData& epd, VectorN& z);
     static void set_generalized_velocities(const EventProblemData& epd);
     static void partition_events(const std::list<Event*>& events, std::vector<Event*>& contacts, std::vector<Event*>& limits);
@@ -145,12 +340,29 @@ class ImpactEventHandler
     static void contact_select(const std::vector<int>& alpha_c_indices, const std::vector<int>& beta_nbeta_c_indices, const VectorN& x, VectorN& alpha_c, VectorN& beta_c);
     static void contact_select(const std::vector<int>& alpha_c_indices, const std::vector<int>& beta_nbeta_c_indices, const MatrixN& m, MatrixN& alpha_c_rows, MatrixN& beta_c_rows);
     static Real sqr(Real x) { return x*x; }
+    static void calc_joint_friction_impulse(const ImpactOptData& opt_data, unsigned AIDX, const MatrixN& R, const VectorN& w, VectorN& f, MatrixN& dX);
+    static void calc_joint_friction_lambda(const ImpactOptData& opt_data, unsigned i, const MatrixN& R, const VectorN& w, const VectorN& f, const MatrixN& dX, VectorN& lambda, MatrixN& Jlambda, VectorN& u, unsigned& FIDX, unsigned& LOOP_IDX);
+    static void add_row_outer_prod(const MatrixN& R, unsigned row, Real scal, MatrixN& H);
     static void sqp_hess(const VectorN& x, Real objscal, const VectorN& lambda, const VectorN& nu, MatrixN& H, void* data);
     static void sqp_grad0(const VectorN& x, VectorN& g, void* data);
     static void sqp_cJac(const VectorN& x, MatrixN& J, void* data);
     static Real sqp_f0(const VectorN& x, void* data);
     static void sqp_fx(const VectorN& x, VectorN& fc, void* data);
     static void set_optimization_data(EventProblemData& q, ImpactOptData& iopt);
+    static bool deadline_passed(const EventProblemData& epd);
+    static bool lemke_tcheck(void* data);
+
+    /// Contacts solved by the previous call to process_events(), for warm starting the solvers and reusing contact tangents (a cell may hold several contacts)
+    std::multimap<ContactKey, CachedContact> _contact_cache;
+
+    /// The cached contact matched to each contact event of the current call to process_events() (see match_cached_contacts())
+    std::map<const Event*, const CachedContact*> _cache_matches;
+
+    /// Problem data for each group of events solved by the last call to process_events()
+    std::vector<EventProblemData> _problem_data;
+
+    /// The time (see WallClock) at which the time budget of the current call to process_events() is exhausted
+    double _deadline;
 }; // end class
 } // end namespace
 
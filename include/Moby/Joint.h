@@ -242,9 +242,13 @@ class Joint : public Visualizable
     /// Gets the starting coordinate index for this joint
     unsigned get_coord_index() const { return _coord_idx; }
 
+    /// Gets the joint position offsets (the joint induces the transform for q + q_tare)
+    const VectorN& get_q_tare() const { return _q_tare; }
+
   protected:
     void calc_s_bar_from_si();
     void determine_q_tare();
+    void invalidate_parameters();
 
     /// Computes the constraint Jacobian for this joint with respect to the given body in Rodrigues parameters
     /**
@@ -0,0 +1,90 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifndef _MOBY_LINEAR_ADF_H_
+#define _MOBY_LINEAR_ADF_H_
+
+#include <limits>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <Moby/Types.h>
+#include <Moby/Vector3.h>
+
+namespace Moby {
+
+class Polyhedron;
+
+/// An adaptively-sampled distance field stored as a flat array of cells
+/**
+ * The cells of the octree are stored contiguously in breadth-first order, and
+ * the eight children of an internal cell are stored consecutively, so a cell
+ * refers to its children using a single index and no pointers are used.
+ * Looking up the signed distance at a point requires a descent of O(depth)
+ * cells followed by trilinear interpolation of the leaf's corner distances;
+ * the coarse levels of the tree are stored at the front of the array, where
+ * they tend to remain cache resident.  The layout is also directly
+ * serializable (see save_to_file() and load_from_file()).
+ *
+ * The field is built one level at a time; the distance function is evaluated
+ * over all cells of a level in parallel (if OpenMP is available), so the
+ * distance function must be safe to call concurrently.
+ *
+ * Corners (and children) of a cell are indexed using bits: bit 0 is set for
+ * the upper x bound, bit 1 for the upper y bound, and bit 2 for the upper z
+ * bound.
+ */
+class LinearADF
+{
+  public:
+    /// A cell of the ADF
+    struct Cell
+    {
+      Vector3 lo;          // the lower bounds of the cell
+      Vector3 hi;          // the upper bounds of the cell
+      Real distances[8];   // the signed distances at the corners of the cell
+      unsigned child;      // index of the first child (0 if a leaf)
+    };
+
+    LinearADF();
+    static boost::shared_ptr<LinearADF> build_ADF(Polyhedron& poly, unsigned max_recursion, Real epsilon, Real max_pos_dist = -1.0, Real max_neg_dist = std::numeric_limits<Real>::max());
+    static boost::shared_ptr<LinearADF> build_ADF(const Vector3& lo, const Vector3& hi, Real (*dfn)(const Vector3&, void*), unsigned max_recursion, Real epsilon, Real max_pos_dist = -1.0, Real max_neg_dist = std::numeric_limits<Real>::max(), void* data = NULL);
+    Real calc_signed_distance(const Vector3& point) const;
+    Vector3 determine_normal(const Vector3& point) const;
+    bool contains(const Vector3& point) const;
+    void get_bounds(Vector3& lo, Vector3& hi) const;
+    unsigned find_leaf(const Vector3& point) const;
+    void save_to_file(const std::string& filename) const;
+    static boost::shared_ptr<LinearADF> load_from_file(const std::string& filename);
+
+    /// Gets the cells of the ADF (the root is the first cell)
+    const std::vector<Cell>& get_cells() const { return _cells; }
+
+    /// Gets the number of cells in the ADF
+    unsigned num_cells() const { return _cells.size(); }
+
+    /// Gets the depth of the ADF (the root is at depth 0)
+    unsigned get_depth() const { return _depth; }
+
+  private:
+    static const unsigned BOX_VERTICES = 8;
+    static const unsigned OCT_CHILDREN = 8;
+    static const unsigned LATTICE_POINTS = 27;
+    static Real trimesh_distance_function(const Vector3& pt, void* data);
+    static Real tri_linear_interp(const Real q[8], Real u, Real v, Real w);
+    static Vector3 get_lattice_point(const Cell& cell, unsigned i, unsigned j, unsigned k);
+
+    /// The cells of the ADF, in breadth-first order
+    std::vector<Cell> _cells;
+
+    /// The depth of the ADF
+    unsigned _depth;
+}; // end class
+
+} // end namespace
+
+#endif
+
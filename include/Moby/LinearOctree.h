@@ -0,0 +1,94 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifndef _MOBY_LINEAR_OCTREE_H_
+#define _MOBY_LINEAR_OCTREE_H_
+
+#include <vector>
+#include <Moby/Types.h>
+#include <Moby/Vector3.h>
+
+namespace Moby {
+
+/// A pointerless (linear) octree for occupancy queries
+/**
+ * Only the occupied cells at the finest level of the octree are stored; each
+ * is identified by its Morton code (the interleaved bits of its integer x, y,
+ * and z coordinates), and the codes are kept sorted.  Interior nodes of the
+ * octree are implicit: the occupied cells beneath a node at level l are
+ * exactly those whose codes share the node's 3l-bit prefix, and so they form
+ * a contiguous range of the sorted array.  Points are best inserted in
+ * batches, which are encoded and sorted in parallel when OpenMP is available.
+ *
+ * Unlike Octree, the resolution of the linear octree is fixed when the bounds
+ * are set; the finest cells are the smallest cells that are no smaller than
+ * the minimum resolution (up to a depth of MAX_DEPTH).
+ */
+class LinearOctree
+{
+  public:
+    /// The type used for Morton codes
+    typedef unsigned long long MortonCode;
+
+    /// The maximum depth of the octree (3*MAX_DEPTH bits must fit in a MortonCode)
+    static const unsigned MAX_DEPTH = 21;
+
+    LinearOctree();
+    LinearOctree(Real minres, const Vector3& lo_bounds, const Vector3& hi_bounds);
+    void insert(const Vector3& point);
+    unsigned insert(const std::vector<Vector3>& points);
+    bool clear_cell(const Vector3& point);
+    bool is_cell_occupied(const Vector3& point) const;
+    bool is_occupied(const Vector3& lo_bounds, const Vector3& hi_bounds) const;
+    void set_bounds(Real minres, const Vector3& lo_bounds, const Vector3& hi_bounds);
+    void get_cell_bounds(MortonCode code, Vector3& lo_bounds, Vector3& hi_bounds) const;
+    bool get_code(const Vector3& point, MortonCode& code) const;
+    void reset();
+    static MortonCode encode(unsigned x, unsigned y, unsigned z);
+    static void decode(MortonCode code, unsigned& x, unsigned& y, unsigned& z);
+
+    /// Gets the bounds of this octree
+    void get_bounds(Vector3& lo_bounds, Vector3& hi_bounds) const { lo_bounds = _bounds_lo; hi_bounds = _bounds_hi; }
+
+    /// Gets the depth of the octree (the level of the finest cells)
+    unsigned get_depth() const { return _depth; }
+
+    /// Gets the (sorted) Morton codes of the occupied cells
+    const std::vector<MortonCode>& get_cells() const { return _cells; }
+
+    /// Gets the number of points in each occupied cell (parallel to get_cells())
+    const std::vector<unsigned>& get_cell_counts() const { return _counts; }
+
+    /// Gets the number of points in the octree
+    unsigned get_num_points() const { return _num_points; }
+
+  private:
+    bool is_occupied(unsigned level, MortonCode prefix, std::vector<MortonCode>::const_iterator begin, std::vector<MortonCode>::const_iterator end, const unsigned qlo[3], const unsigned qhi[3]) const;
+    static void sort_codes(std::vector<MortonCode>& codes);
+
+    /// The bounds of the octree
+    Vector3 _bounds_lo, _bounds_hi;
+
+    /// The side lengths of cells at the finest level
+    Vector3 _cell_size;
+
+    /// The depth of the octree
+    unsigned _depth;
+
+    /// The sorted Morton codes of the occupied cells at the finest level
+    std::vector<MortonCode> _cells;
+
+    /// The number of points in each occupied cell
+    std::vector<unsigned> _counts;
+
+    /// The total number of points in the octree
+    unsigned _num_points;
+}; // end class
+
+} // end namespace
+
+#endif
+
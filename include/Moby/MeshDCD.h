@@ -11,6 +11,7 @@
 #include <set>
 #include <map>
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 #include <Moby/sorted_pair>
 #include <Moby/Log.h>
 #include <Moby/CollisionDetection.h>
@@ -24,6 +25,7 @@ class RigidBody;
 class ArticulatedBody;
 class CollisionGeometry;  
 class DStruct;
+class LinearADF;
 
 /// Implements the ContactFinder abstract class to perform exact contact finding using vertices against triangles 
 class MeshDCD : public CollisionDetection
@@ -54,6 +56,15 @@ class MeshDCD : public CollisionDetection
     /// The intersection tolerance
     Real isect_tolerance;
 
+    /// Determines whether vertices are tested against distance fields of rigid geometries (rather than BV trees)
+    bool use_adf;
+
+    /// The maximum depth of distance fields built when use_adf is set
+    unsigned adf_max_recursion;
+
+    /// The interpolation tolerance of distance fields built when use_adf is set
+    Real adf_tolerance;
+
     Real intersect_rects(const Vector3& normal, const Vector3 r1[4], const Vector3 r2[4], Vector3& isect1, Vector3& isect2);
     Real calc_first_isect(const Triangle& t, const LineSeg3& s1, const LineSeg3& s2, Vector3& p1, Vector3& p2); 
   private:
@@ -74,6 +85,9 @@ class MeshDCD : public CollisionDetection
     static Real calc_param(const LineSeg3& seg, const Vector3& p);
     bool is_collision(CollisionGeometryPtr a, CollisionGeometryPtr b);
     bool is_collision(CollisionGeometryPtr cg);
+    bool is_collision_adf(CollisionGeometryPtr a, CollisionGeometryPtr b);
+    boost::shared_ptr<LinearADF> get_ADF(CollisionGeometryPtr cg);
+    void remove_expired_ADFs();
     static DynamicBodyPtr get_super_body(CollisionGeometryPtr a);
     static unsigned find_body(const std::vector<std::pair<DynamicBodyPtr, VectorN> >& q, DynamicBodyPtr body);
 
@@ -83,6 +97,14 @@ class MeshDCD : public CollisionDetection
     /// Indicates when bounds vectors need to be rebuilt
     bool _rebuild_bounds_vecs;
 
+    /// Distance fields for the meshes of rigid geometries (built when use_adf is set)
+    /**
+     * Meshes are held weakly, so a mesh that is replaced or destroyed is 
+     * never matched again and its distance field is released by
+     * remove_expired_ADFs().
+     */
+    std::map<boost::weak_ptr<const IndexedTriArray>, boost::shared_ptr<LinearADF> > _adfs;
+
 }; // end class
 
 // include inline functions
@@ -7,12 +7,15 @@
 #ifndef _MOBY_OPT_H
 #define _MOBY_OPT_H
 
+#include <string>
 #include <Moby/Constants.h>
 #include <Moby/MatrixN.h>
 #include <Moby/VectorN.h>
 
 namespace Moby {
 
+class SolverStats;
+
 class WorkingSet
 {
   public:
@@ -385,8 +388,8 @@ class Optimization
     static bool make_feasible_qp(const MatrixN& A, const VectorN& b, const MatrixN& M, const VectorN& q, VectorN& x, Real tol = NEAR_ZERO);
     static bool lp_simplex(const LPParams& lpparams, VectorN& x);
     static void lcp_enum(const MatrixN& M, const VectorN& q, std::vector<VectorN>& z);
-    static bool lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Real piv_tol = -1.0, Real zero_tol = -1.0);
-    static bool lcp_lemke_regularized(const MatrixN& M, const VectorN& q, VectorN& z, int min_exp = -20, unsigned step_exp = 4, int max_exp = 20, Real piv_tol = -1.0, Real zero_tol = -1.0);
+    static bool lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Real piv_tol = -1.0, Real zero_tol = -1.0, bool (*tcheck)(void*) = NULL, void* tcheck_data = NULL);
+    static bool lcp_lemke_regularized(const MatrixN& M, const VectorN& q, VectorN& z, int min_exp = -20, unsigned step_exp = 4, int max_exp = 20, Real piv_tol = -1.0, Real zero_tol = -1.0, bool (*tcheck)(void*) = NULL, void* tcheck_data = NULL);
     static bool lcp_convex_ip(const MatrixN& M, const VectorN& q, VectorN& z, Real tol=NEAR_ZERO, Real eps=NEAR_ZERO, Real eps_feas=NEAR_ZERO, unsigned max_iterations = std::numeric_limits<unsigned>::max());
     static bool lcp_iter_PD(const MatrixN& M, const VectorN& q, VectorN& z, Real tol = NEAR_ZERO, const unsigned iter = std::numeric_limits<unsigned>::max());
     static bool lcp_iter_symm(const MatrixN& M, const VectorN& q, VectorN& z, Real tol = NEAR_ZERO, const unsigned iter = std::numeric_limits<unsigned>::max());
@@ -398,7 +401,25 @@ class Optimization
     static bool optimize_convex_BFGS(OptParams& cparams, VectorN& x);
     static bool make_feasible_convex_BFGS(OptParams& cparams, VectorN& x);
 
+    /// If nonempty, each LCP solved by lcp_lemke_regularized() is appended to this file (see ProblemCapture)
+    static std::string capture_filename;
+
+    /// If <b>true</b>, lcp_lemke() solves problems on which pivoting fails in working precision again in higher precision (default is <b>true</b>)
+    /**
+     * Only the pivoting is done in higher precision (LongReal and, if Moby 
+     * is built with MPREAL_LCP, mpfr::mpreal); the solution is recovered 
+     * from the complementary basis found using iterative refinement in 
+     * working precision.  lcp_lemke_regularized() escalates at most once, 
+     * after all of its regularized attempts have failed.  This has no effect
+     * when Moby is built with ARBITRARY_PRECISION.
+     */
+    static bool lemke_mixed_precision;
+
   private:
+    static bool lcp_lemke_work(const MatrixN& M, const VectorN& q, VectorN& z, Real piv_tol, Real zero_tol, bool (*tcheck)(void*), void* tcheck_data, unsigned& npivots);
+    static bool lcp_lemke_working(const MatrixN& M, const VectorN& q, VectorN& z, Real piv_tol, Real zero_tol, bool (*tcheck)(void*), void* tcheck_data, SolverStats& stats);
+    static bool lcp_lemke_escalate(const MatrixN& M, const VectorN& q, VectorN& z, Real zero_tol, bool (*tcheck)(void*), void* tcheck_data, SolverStats& stats);
+    static bool lcp_lemke_regularized_work(const MatrixN& M, const VectorN& q, VectorN& z, int min_exp, unsigned step_exp, int max_exp, Real piv_tol, Real zero_tol, bool (*tcheck)(void*), void* tcheck_data, bool& regularized, int& exp);
     static void condition_and_factor_PD(MatrixN& H);
     static void condition_hessian(MatrixN& H);
     static bool tcheck_cvx_opt_BFGS(const VectorN& x, void* data);
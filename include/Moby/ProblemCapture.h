@@ -0,0 +1,92 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifndef _MOBY_PROBLEM_CAPTURE_H_
+#define _MOBY_PROBLEM_CAPTURE_H_
+
+#include <iostream>
+#include <string>
+#include <Moby/Types.h>
+#include <Moby/MatrixN.h>
+#include <Moby/VectorN.h>
+
+namespace Moby {
+
+/// Writes solved LCPs and QPs to (and reads them from) compact binary files, so that they can be replayed offline
+/**
+ * A capture file is a sequence of records, each of which is:
+ * <ul>
+ * <li>the four characters "MBYP" and a format version (32-bit unsigned)</li>
+ * <li>the problem type (32-bit unsigned; 0 for an LCP, 1 for a QP)</li>
+ * <li>the length of the solver name (32-bit unsigned) and its characters</li>
+ * <li>whether the solver succeeded (8-bit unsigned), the time it took in
+ *     seconds (double), and the number of iterations it took (32-bit
+ *     unsigned; zero if the solver does not report it)</li>
+ * <li>M, q, A, b, and z, where each matrix is its number of rows and
+ *     columns (32-bit unsigned) followed by its elements in column-major
+ *     order (doubles), and each vector is its size followed by its elements
+ * </ul>
+ * Values are stored in the native byte order.  Records are only appended to
+ * a file, so a corpus of problems can be built over several runs.
+ */
+class ProblemCapture
+{
+  public:
+    enum ProblemType { eLCP = 0, eQP = 1 };
+
+    /// A captured problem and its solution
+    struct Problem
+    {
+      Problem() { type = eLCP; solved = false; time = (Real) 0.0; iterations = 0; }
+
+      /// The type of problem
+      ProblemType type;
+
+      /// The name of the solver that solved the problem
+      std::string solver;
+
+      /// Whether the solver succeeded
+      bool solved;
+
+      /// The (wall-clock) time taken by the solver, in seconds
+      Real time;
+
+      /// The number of iterations taken by the solver (zero if not reported)
+      unsigned iterations;
+
+      /// The LCP matrix (LCP: w = M*z + q, w >= 0, z >= 0, z'w = 0) or the QP Hessian (QP: minimize 0.5*z'*M*z + q'*z subject to A*z >= b, z >= 0)
+      MatrixN M;
+
+      /// The LCP vector or the linear term of the QP objective
+      VectorN q;
+
+      /// The QP inequality constraint matrix (empty for LCPs)
+      MatrixN A;
+
+      /// The QP inequality constraint vector (empty for LCPs)
+      VectorN b;
+
+      /// The solution found by the solver
+      VectorN z;
+    };
+
+    static void append(const std::string& fname, const Problem& p);
+    static void write(std::ostream& out, const Problem& p);
+    static bool read(std::istream& in, Problem& p);
+
+  private:
+    static void write_unsigned(std::ostream& out, unsigned x);
+    static void write_matrix(std::ostream& out, const MatrixN& m);
+    static void write_vector(std::ostream& out, const VectorN& v);
+    static bool read_unsigned(std::istream& in, unsigned& x);
+    static bool read_matrix(std::istream& in, MatrixN& m);
+    static bool read_vector(std::istream& in, VectorN& v);
+}; // end class
+
+} // end namespace
+
+#endif
+
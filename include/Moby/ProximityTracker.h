@@ -0,0 +1,113 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifndef _MOBY_PROXIMITY_TRACKER_H_
+#define _MOBY_PROXIMITY_TRACKER_H_
+
+#include <map>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <Moby/Types.h>
+#include <Moby/Vector3.h>
+#include <Moby/Matrix4.h>
+
+namespace Moby {
+
+class CollisionDetection;
+class IndexedTriArray;
+
+/// Incrementally tracks distances between registered pairs of geometries
+/**
+ * Unlike CollisionDetection::calc_distances(), which recomputes distances
+ * between every pair of geometries on each call, the tracker only recomputes
+ * distances for registered pairs whose relative transform has changed since
+ * the last update.  Pairs whose bounding spheres are separated by more than
+ * max_distance are culled without narrow phase testing, and the closest
+ * triangles found during the last update seed the search for the new closest
+ * points.  Results are stored in a flat array indexed by the ID returned
+ * when the pair was registered.
+ */
+class ProximityTracker
+{
+  public:
+
+    /// Proximity data for a registered pair of geometries
+    struct PairData
+    {
+      CollisionGeometryPtr geom1;  // the first geometry
+      CollisionGeometryPtr geom2;  // the second geometry
+      Real dist;                   // distance between the geometries (infinite if culled)
+      Vector3 cp1;                 // closest point on geom1 (geom1's frame)
+      Vector3 cp2;                 // closest point on geom2 (geom2's frame)
+      bool culled;                 // whether the pair was culled on the last update
+      bool valid;                  // whether the data has been computed
+      unsigned tri1;               // closest triangle on geom1 from last update
+      unsigned tri2;               // closest triangle on geom2 from last update
+      Matrix4 g1Tg2;               // relative transform at the last update
+    };
+
+    ProximityTracker();
+    unsigned add_pair(CollisionGeometryPtr g1, CollisionGeometryPtr g2);
+    void add_pairs(const CollisionDetection& coldet);
+    void clear();
+    void invalidate();
+    Real update();
+
+    /// Gets the number of registered pairs
+    unsigned num_pairs() const { return _pairs.size(); }
+
+    /// Gets the proximity data for the pair with the given ID
+    const PairData& get_pair(unsigned id) const { return _pairs[id]; }
+
+    /// Gets the proximity data for all pairs (indexed by pair ID)
+    const std::vector<PairData>& get_pairs() const { return _pairs; }
+
+    /// Gets the number of pairs whose distances were recomputed on the last update
+    unsigned get_num_updated() const { return _num_updated; }
+
+    /// Pairs whose bounding spheres are farther apart than this distance are culled (default is infinity)
+    Real max_distance;
+
+    /// Pairs with relative transforms that change less than this value are not updated (default is NEAR_ZERO)
+    Real motion_tolerance;
+
+  private:
+
+    /// Bounding data for the mesh of a single geometry
+    struct GeomData
+    {
+      CollisionGeometryPtr geom;                    // the geometry
+      boost::shared_ptr<const IndexedTriArray> mesh; // mesh used to compute the data
+      Vector3 center;                               // bounding sphere center (geometry frame)
+      Real radius;                                  // bounding sphere radius
+      std::vector<Vector3> tri_centers;             // triangle bounding sphere centers
+      std::vector<Real> tri_radii;                  // triangle bounding sphere radii
+    };
+
+    unsigned get_geom_index(CollisionGeometryPtr g);
+    static void update_geom_data(GeomData& gdata);
+    static Real calc_sq_dist(const GeomData& a, const GeomData& b, const Matrix4& aTb, unsigned& tri_a, unsigned& tri_b, Vector3& cpa, Vector3& cpb);
+
+    /// The registered pairs (indexed by pair ID)
+    std::vector<PairData> _pairs;
+
+    /// Indices of the two geometries of each registered pair into _geoms
+    std::vector<std::pair<unsigned, unsigned> > _pair_geoms;
+
+    /// The bounding data for all geometries in registered pairs
+    std::vector<GeomData> _geoms;
+
+    /// Mapping from geometries to indices into _geoms
+    std::map<CollisionGeometryPtr, unsigned> _geom_map;
+
+    /// The number of pairs recomputed on the last update
+    unsigned _num_updated;
+}; // end class
+
+} // end namespace
+
+#endif
+
@@ -176,7 +176,7 @@ class RCArticulatedBody : public ArticulatedBody
     virtual VectorN& solve_generalized_inertia(DynamicBody::GeneralizedCoordinateType gctype, const VectorN& v, VectorN& result);
     virtual MatrixN& solve_generalized_inertia(DynamicBody::GeneralizedCoordinateType gctype, const MatrixN& m, MatrixN& result);
     MatrixN& solve_generalized_inertia_transpose(DynamicBody::GeneralizedCoordinateType gctype, const MatrixN& m, MatrixN& result);
-    void determine_contact_jacobians(const EventProblemData& q, const VectorN& v, const MatrixN& M, MatrixN& Jc, MatrixN& Dc);
+    void determine_contact_jacobians(const EventProblemData& q, const MatrixN& M, MatrixN& Jc, MatrixN& Dc);
     static bool supports(JointPtr joint, RigidBodyPtr link);
     void determine_generalized_forces(VectorN& gf) const;
     void determine_generalized_accelerations(VectorN& xdd) const;
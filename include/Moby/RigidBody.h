@@ -147,6 +147,7 @@ class RigidBody : public SingleBody
     virtual Vector3 calc_point_vel(const Vector3& p) const;
     virtual void update_velocity(const EventProblemData& q);
     virtual void update_event_data(EventProblemData& q);
+    void update_event_velocities(EventProblemData& q);
     RigidBodyPtr get_child_link(unsigned i) const;
     bool is_base() const;
     bool is_ground() const;
@@ -294,8 +295,10 @@ class RigidBody : public SingleBody
   private:  
     void invalidate_position();
     void invalidate_velocity();
+    void invalidate_parameters();
     void synchronize();
     static bool valid_transform(const MatrixN& T, Real tol);
+    unsigned determine_event_contacts(const EventProblemData& q, std::vector<unsigned>& contacts, std::vector<unsigned>& positions, std::vector<bool>& negated);
 
     /// Mass of the rigid body
     Real _mass;
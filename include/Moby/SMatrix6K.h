@@ -0,0 +1,101 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifndef _SMATRIX6K_H
+#define _SMATRIX6K_H
+
+#include <cmath>
+#include <Moby/SVector6.h>
+#include <Moby/SMatrix6N.h>
+#include <Moby/SpatialABInertia.h>
+
+namespace Moby {
+
+/// A fixed-size K-dimensional vector (K is generally the number of degrees of freedom of a joint)
+template <unsigned K>
+class VectorK
+{
+  public:
+    VectorK() {}
+    unsigned size() const { return K; }
+    VectorK& set_zero();
+    VectorK& set(const VectorN& v);
+    VectorN& get(VectorN& v) const;
+    VectorK& operator+=(const VectorK& v);
+    VectorK& operator-=(const VectorK& v);
+    VectorK& negate();
+    Real& operator[](unsigned i) { assert(i < K); return _data[i]; }
+    Real operator[](unsigned i) const { assert(i < K); return _data[i]; }
+    Real* data() { return _data; }
+    const Real* data() const { return _data; }
+
+  private:
+    Real _data[K];
+}; // end class
+
+/// A fixed-size KxK matrix (K is generally the number of degrees of freedom of a joint)
+/**
+ * The underlying data is stored in column-major order.
+ */
+template <unsigned K>
+class MatrixK
+{
+  public:
+    MatrixK() {}
+    MatrixK& set(const MatrixN& m);
+    MatrixN& get(MatrixN& m) const;
+    bool factor_chol();
+    VectorK<K>& solve_chol_fast(VectorK<K>& x) const;
+    Real& operator()(unsigned i, unsigned j) { assert(i < K && j < K); return _data[j*K+i]; }
+    Real operator()(unsigned i, unsigned j) const { assert(i < K && j < K); return _data[j*K+i]; }
+    Real* data() { return _data; }
+    const Real* data() const { return _data; }
+
+  private:
+    Real _data[K*K];
+}; // end class
+
+/// A fixed-size 6xK spatial algebra matrix (K is generally the number of degrees of freedom of a joint)
+/**
+ * The underlying data is stored in column-major order, like SMatrix6N, so
+ * each column is a contiguous spatial vector.  Unlike SMatrix6N, the data is
+ * not allocated on the heap and all loop bounds are compile-time constants,
+ * which allows the compiler to unroll (and vectorize) the products.
+ * SMatrix6N remains the type used at API boundaries (e.g.,
+ * Joint::get_spatial_axes()); set() and get() convert between the two.
+ * As with SMatrix6N, the transpose operations use the spatial transpose.
+ */
+template <unsigned K>
+class SMatrix6K
+{
+  public:
+    SMatrix6K() {}
+    unsigned rows() const { return 6; }
+    unsigned columns() const { return K; }
+    SMatrix6K& set(const SMatrix6N& m);
+    SMatrix6N& get(SMatrix6N& m) const;
+    SVector6 get_column(unsigned i) const { assert(i < K); return SVector6(_data+i*6); }
+    SVector6 mult(const VectorK<K>& x) const;
+    VectorK<K>& transpose_mult(const SVector6& v, VectorK<K>& result) const;
+    MatrixK<K>& transpose_mult(const SMatrix6K& m, MatrixK<K>& result) const;
+    static SMatrix6K& mult(const SpatialABInertia& I, const SMatrix6K& m, SMatrix6K& result);
+    static SpatialABInertia mult_transpose(const SMatrix6K& m1, const SMatrix6K& m2);
+    Real& operator()(unsigned i, unsigned j) { assert(i < 6 && j < K); return _data[j*6+i]; }
+    Real operator()(unsigned i, unsigned j) const { assert(i < 6 && j < K); return _data[j*6+i]; }
+    Real* data() { return _data; }
+    const Real* data() const { return _data; }
+
+  private:
+    Real _data[6*K];
+}; // end class
+
+// include inline functions
+#include "SMatrix6K.inl"
+
+} // end namespace
+
+#endif
+
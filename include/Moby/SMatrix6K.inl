@@ -0,0 +1,282 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+/// Sets this vector to zero
+template <unsigned K>
+VectorK<K>& VectorK<K>::set_zero()
+{
+  for (unsigned i=0; i< K; i++)
+    _data[i] = (Real) 0.0;
+  return *this;
+}
+
+/// Copies a VectorN (of size K) to this vector
+template <unsigned K>
+VectorK<K>& VectorK<K>::set(const VectorN& v)
+{
+  assert(v.size() == K);
+  const Real* vdata = v.data();
+  for (unsigned i=0; i< K; i++)
+    _data[i] = vdata[i];
+  return *this;
+}
+
+/// Copies this vector to a VectorN
+template <unsigned K>
+VectorN& VectorK<K>::get(VectorN& v) const
+{
+  v.resize(K);
+  Real* vdata = v.data();
+  for (unsigned i=0; i< K; i++)
+    vdata[i] = _data[i];
+  return v;
+}
+
+/// Adds v to this vector in place
+template <unsigned K>
+VectorK<K>& VectorK<K>::operator+=(const VectorK<K>& v)
+{
+  for (unsigned i=0; i< K; i++)
+    _data[i] += v._data[i];
+  return *this;
+}
+
+/// Subtracts v from this vector in place
+template <unsigned K>
+VectorK<K>& VectorK<K>::operator-=(const VectorK<K>& v)
+{
+  for (unsigned i=0; i< K; i++)
+    _data[i] -= v._data[i];
+  return *this;
+}
+
+/// Negates this vector in place
+template <unsigned K>
+VectorK<K>& VectorK<K>::negate()
+{
+  for (unsigned i=0; i< K; i++)
+    _data[i] = -_data[i];
+  return *this;
+}
+
+/// Copies a KxK MatrixN to this matrix
+template <unsigned K>
+MatrixK<K>& MatrixK<K>::set(const MatrixN& m)
+{
+  assert(m.rows() == K && m.columns() == K);
+  const Real* mdata = m.data();
+  for (unsigned i=0; i< K*K; i++)
+    _data[i] = mdata[i];
+  return *this;
+}
+
+/// Copies this matrix to a MatrixN
+template <unsigned K>
+MatrixN& MatrixK<K>::get(MatrixN& m) const
+{
+  m.resize(K, K);
+  Real* mdata = m.data();
+  for (unsigned i=0; i< K*K; i++)
+    mdata[i] = _data[i];
+  return m;
+}
+
+/// Performs the Cholesky factorization of this (symmetric) matrix in place
+/**
+ * The factorization is stored in the same form as LinAlg::factor_chol(): the
+ * upper triangle holds U (where this = U'*U) and the lower triangle is zero.
+ * \return <b>false</b> if the matrix is not positive definite
+ */
+template <unsigned K>
+bool MatrixK<K>::factor_chol()
+{
+  MatrixK<K>& A = *this;
+
+  for (unsigned j=0; j< K; j++)
+  {
+    // compute the diagonal element
+    Real d = A(j,j);
+    for (unsigned k=0; k< j; k++)
+      d -= A(k,j)*A(k,j);
+    if (d <= (Real) 0.0)
+      return false;
+    A(j,j) = std::sqrt(d);
+
+    // compute the remainder of row j
+    for (unsigned i=j+1; i< K; i++)
+    {
+      Real x = A(j,i);
+      for (unsigned k=0; k< j; k++)
+        x -= A(k,j)*A(k,i);
+      A(j,i) = x/A(j,j);
+    }
+  }
+
+  // make the matrix upper triangular
+  for (unsigned j=0; j< K; j++)
+    for (unsigned i=j+1; i< K; i++)
+      A(i,j) = (Real) 0.0;
+
+  return true;
+}
+
+/// Solves a system of linear equations in place using the Cholesky factorization computed by factor_chol()
+template <unsigned K>
+VectorK<K>& MatrixK<K>::solve_chol_fast(VectorK<K>& x) const
+{
+  const MatrixK<K>& U = *this;
+
+  // solve U'*y = x
+  for (unsigned i=0; i< K; i++)
+  {
+    Real y = x[i];
+    for (unsigned k=0; k< i; k++)
+      y -= U(k,i)*x[k];
+    x[i] = y/U(i,i);
+  }
+
+  // solve U*x = y
+  for (unsigned i=K; i-- > 0; )
+  {
+    Real y = x[i];
+    for (unsigned k=i+1; k< K; k++)
+      y -= U(i,k)*x[k];
+    x[i] = y/U(i,i);
+  }
+
+  return x;
+}
+
+/// Copies a 6xK SMatrix6N to this matrix
+template <unsigned K>
+SMatrix6K<K>& SMatrix6K<K>::set(const SMatrix6N& m)
+{
+  assert(m.rows() == 6 && m.columns() == K);
+  const Real* mdata = m.data();
+  for (unsigned i=0; i< 6*K; i++)
+    _data[i] = mdata[i];
+  return *this;
+}
+
+/// Copies this matrix to a SMatrix6N
+template <unsigned K>
+SMatrix6N& SMatrix6K<K>::get(SMatrix6N& m) const
+{
+  m.resize(6, K);
+  Real* mdata = m.data();
+  for (unsigned i=0; i< 6*K; i++)
+    mdata[i] = _data[i];
+  return m;
+}
+
+/// Multiplies this matrix by a K-dimensional vector
+template <unsigned K>
+SVector6 SMatrix6K<K>::mult(const VectorK<K>& x) const
+{
+  SVector6 result = SVector6::zero();
+  for (unsigned j=0; j< K; j++)
+  {
+    const Real* col = _data + j*6;
+    for (unsigned i=0; i< 6; i++)
+      result[i] += col[i]*x[j];
+  }
+
+  return result;
+}
+
+/// Multiplies the (spatial) transpose of this matrix by a spatial vector
+template <unsigned K>
+VectorK<K>& SMatrix6K<K>::transpose_mult(const SVector6& v, VectorK<K>& result) const
+{
+  const Real* vdata = v.data();
+  for (unsigned j=0; j< K; j++)
+  {
+    const Real* col = _data + j*6;
+    result[j] = col[0]*vdata[3] + col[1]*vdata[4] + col[2]*vdata[5] +
+                col[3]*vdata[0] + col[4]*vdata[1] + col[5]*vdata[2];
+  }
+
+  return result;
+}
+
+/// Multiplies the (spatial) transpose of this matrix by a 6xK spatial matrix
+template <unsigned K>
+MatrixK<K>& SMatrix6K<K>::transpose_mult(const SMatrix6K<K>& m, MatrixK<K>& result) const
+{
+  for (unsigned j=0; j< K; j++)
+  {
+    const Real* mcol = m._data + j*6;
+    for (unsigned i=0; i< K; i++)
+    {
+      const Real* col = _data + i*6;
+      result(i,j) = col[0]*mcol[3] + col[1]*mcol[4] + col[2]*mcol[5] +
+                    col[3]*mcol[0] + col[4]*mcol[1] + col[5]*mcol[2];
+    }
+  }
+
+  return result;
+}
+
+/// Multiplies a spatial articulated body inertia by a 6xK spatial matrix
+template <unsigned K>
+SMatrix6K<K>& SMatrix6K<K>::mult(const SpatialABInertia& I, const SMatrix6K<K>& m, SMatrix6K<K>& result)
+{
+  const Matrix3& M = I.M;
+  const Matrix3& H = I.H;
+  const Matrix3& J = I.J;
+
+  // carry out the multiplication one column at a time; the inertia has the
+  // form [H' M; J H]
+  for (unsigned j=0; j< K; j++)
+  {
+    const Real* top = m._data + j*6;
+    const Real* bot = top + 3;
+    Real* rtop = result._data + j*6;
+    Real* rbot = rtop + 3;
+    for (unsigned i=0; i< 3; i++)
+    {
+      rtop[i] = H(0,i)*top[0] + H(1,i)*top[1] + H(2,i)*top[2] +
+                M(i,0)*bot[0] + M(i,1)*bot[1] + M(i,2)*bot[2];
+      rbot[i] = J(i,0)*top[0] + J(i,1)*top[1] + J(i,2)*top[2] +
+                H(i,0)*bot[0] + H(i,1)*bot[1] + H(i,2)*bot[2];
+    }
+  }
+
+  return result;
+}
+
+/// Multiplies a 6xK spatial matrix by the (spatial) transpose of another and returns the result as a spatial articulated body inertia
+/**
+ * \note only the M, H, and J blocks of the 6x6 product are computed, so the
+ *       product must be symmetric in the spatial sense (as is, e.g.,
+ *       I*s*inv(s'*I*s)*s'*I for a spatial inertia I)
+ */
+template <unsigned K>
+SpatialABInertia SMatrix6K<K>::mult_transpose(const SMatrix6K<K>& m1, const SMatrix6K<K>& m2)
+{
+  SpatialABInertia result;
+  Matrix3& M = result.M;
+  Matrix3& H = result.H;
+  Matrix3& J = result.J;
+
+  for (unsigned k=0; k< K; k++)
+  {
+    const Real* top1 = m1._data + k*6;
+    const Real* bot1 = top1 + 3;
+    const Real* top2 = m2._data + k*6;
+    const Real* bot2 = top2 + 3;
+    for (unsigned c=0; c< 3; c++)
+      for (unsigned r=0; r< 3; r++)
+      {
+        M(r,c) += top1[r]*top2[c];
+        H(r,c) += bot1[r]*top2[c];
+        J(r,c) += bot1[r]*bot2[c];
+      }
+  }
+
+  return result;
+}
+
@@ -60,6 +60,7 @@ class Simulator : public virtual Base
     /**
      * \note if a dynamic body is articulated, only the articulated body is
      *       returned, not the links
+     * \note the i'th body has index i (see DynamicBody::get_index())
      */
     const std::vector<DynamicBodyPtr>& get_dynamic_bodies() const { return _bodies; }
 
@@ -84,6 +85,9 @@ class Simulator : public virtual Base
 
     /// The set of bodies in the simulation
     std::vector<DynamicBodyPtr> _bodies;
+
+    void index_bodies();
+    static void unindex_body(DynamicBodyPtr body);
   
     template <class ForwardIterator>
     Real integrate(Real step_size, ForwardIterator begin, ForwardIterator end);
@@ -0,0 +1,121 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifndef _MOBY_SOLVER_STATS_H_
+#define _MOBY_SOLVER_STATS_H_
+
+#include <iostream>
+
+namespace Moby {
+
+/// Statistics gathered from the numerical solvers
+/**
+ * Each call to an instrumented solver (Lemke's algorithm, regularized
+ * Lemke's algorithm, SQP, and the SVD-based least squares solvers) fills in
+ * a SolverStats for that call alone and passes it to record(), which adds
+ * it to the collector installed for the calling thread (see 
+ * SolverStatsScope), if any, and passes it to the (optional) callback. 
+ * EventDrivenSimulator::step() installs a collector to obtain per-step
+ * statistics.  Unlike the LOG_OPT output, the statistics are gathered in 
+ * release (NDEBUG) builds too.
+ */
+class SolverStats
+{
+  public:
+    SolverStats() { reset(); }
+    void reset();
+    SolverStats& operator+=(const SolverStats& s);
+    static void record(const SolverStats& s);
+    static SolverStats* get_collector();
+
+    /// Function called with the statistics of every instrumented solver call (default is NULL)
+    /**
+     * \note in threaded builds, this function may be called from several
+     *       threads at once
+     */
+    static void (*callback)(const SolverStats& s);
+
+    /// The number of calls to lcp_lemke()
+    unsigned n_lemke_calls;
+
+    /// The number of calls to lcp_lemke() that failed to find a solution
+    unsigned n_lemke_failures;
+
+    /// The total number of pivots taken by lcp_lemke()
+    unsigned n_lemke_pivots;
+
+    /// The largest number of pivots taken by a single call to lcp_lemke()
+    unsigned max_lemke_pivots;
+
+    /// The number of calls to lcp_lemke() (or lcp_lemke_regularized()) that were solved again in higher precision after pivoting failed
+    unsigned n_lemke_escalations;
+
+    /// The number of calls to lcp_lemke() (or lcp_lemke_regularized()) that were solved only in higher precision
+    unsigned n_lemke_escalations_solved;
+
+    /// The number of calls to lcp_lemke_regularized()
+    unsigned n_lemke_regularized_calls;
+
+    /// The number of calls to lcp_lemke_regularized() that failed to find a solution
+    unsigned n_lemke_regularized_failures;
+
+    /// The number of calls to lcp_lemke_regularized() that succeeded only after regularization
+    unsigned n_regularized_solutions;
+
+    /// The largest exponent of the regularization factor (10^exp) with which lcp_lemke_regularized() found a solution
+    /**
+     * Meaningful only if n_regularized_solutions > 0; a large value
+     * indicates a (nearly) degenerate problem, as from redundant contacts.
+     */
+    int max_regularization_exp;
+
+    /// The number of calls to sqp()
+    unsigned n_sqp_calls;
+
+    /// The number of calls to sqp() that terminated abnormally (e.g., incompatible constraints or a singular subproblem)
+    unsigned n_sqp_failures;
+
+    /// The total number of iterations taken by sqp()
+    unsigned n_sqp_iterations;
+
+    /// The largest number of iterations taken by a single call to sqp()
+    unsigned max_sqp_iterations;
+
+    /// The number of linear systems solved using the SVD (LinAlg::solve_LS_fast()), generally as a fallback for a failed factorization
+    unsigned n_svd_solves;
+
+    /// The number of times that the primary SVD algorithm failed and the divide-and-conquer SVD was used instead
+    unsigned n_svd_fallbacks;
+}; // end class
+
+/// Installs a collector for the solver statistics recorded by the calling thread, for the lifetime of this object
+/**
+ * The collector that was previously installed for the thread is restored on
+ * destruction, so scopes may be nested.  A collector may be installed in 
+ * several threads at once (e.g., in worker threads that solve parts of a
+ * problem for the thread that installed it); record() serializes access to
+ * it.
+ */
+class SolverStatsScope
+{
+  public:
+    SolverStatsScope(SolverStats* collector);
+    ~SolverStatsScope();
+
+  private:
+    SolverStatsScope(const SolverStatsScope&);
+    SolverStatsScope& operator=(const SolverStatsScope&);
+
+    /// The collector that was installed when this scope was entered
+    SolverStats* _prev;
+}; // end class
+
+std::ostream& operator<<(std::ostream& out, const SolverStats& s);
+
+} // end namespace
+
+#endif
+
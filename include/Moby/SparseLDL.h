@@ -0,0 +1,75 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifndef _MOBY_SPARSE_LDL_H_
+#define _MOBY_SPARSE_LDL_H_
+
+#include <vector>
+#include <Moby/Types.h>
+#include <Moby/VectorN.h>
+
+namespace Moby {
+
+/// Sparse LDL' factorization of symmetric (possibly indefinite) matrices
+/**
+ * The factorization is split into a symbolic phase (analyze()), which
+ * computes a fill-reducing (minimum degree) ordering, the elimination tree,
+ * and the nonzero pattern of L, and a numeric phase (factor()), which may be
+ * called repeatedly for matrices with the same nonzero pattern (e.g., the
+ * KKT matrices of successive interior-point iterations).  No pivoting is
+ * done during the numeric phase, so the factorization is intended for
+ * positive definite and quasidefinite matrices (for which any symmetric
+ * ordering is stable).
+ *
+ * Matrices are given in compressed column form with both the upper and lower
+ * triangles stored: the row indices of the nonzeros in column j are
+ * Ai[Ap[j]..Ap[j+1]-1] (duplicate entries are summed).
+ */
+class SparseLDL
+{
+  public:
+    SparseLDL();
+    void analyze(unsigned n, const std::vector<unsigned>& Ap, const std::vector<unsigned>& Ai);
+    bool factor(const std::vector<unsigned>& Ap, const std::vector<unsigned>& Ai, const std::vector<Real>& Ax);
+    VectorN& solve(VectorN& xb) const;
+
+    /// Gets the size of the analyzed matrix
+    unsigned size() const { return _P.size(); }
+
+    /// Gets the number of nonzeros in the (strictly lower triangular) factor L
+    unsigned nnz() const { return _Li.size(); }
+
+  private:
+    static void calc_min_degree_ordering(unsigned n, const std::vector<unsigned>& Ap, const std::vector<unsigned>& Ai, std::vector<unsigned>& P);
+
+    /// The permutation (row/column k of the permuted matrix is row/column _P[k] of the original)
+    std::vector<unsigned> _P;
+
+    /// The inverse permutation
+    std::vector<unsigned> _Pinv;
+
+    /// The elimination tree
+    std::vector<unsigned> _parent;
+
+    /// Column pointers, row indices, and values of L (unit diagonal not stored)
+    std::vector<unsigned> _Lp, _Li;
+    std::vector<Real> _Lx;
+
+    /// The diagonal matrix D
+    std::vector<Real> _D;
+
+    /// Work arrays for the numeric factorization
+    std::vector<Real> _Y;
+    std::vector<unsigned> _pattern, _flag, _lnz;
+
+    /// Work vector for solves
+    mutable std::vector<Real> _x;
+}; // end class
+
+} // end namespace
+
+#endif
+
@@ -13,6 +13,7 @@
 #include <cmath>
 #include <list>
 #include <string>
+#include <boost/weak_ptr.hpp>
 #include <Moby/Types.h>
 #include <Moby/Primitive.h>
 
@@ -57,9 +58,6 @@ class TriangleMeshPrimitive : public Primitive
     /// Determines whether we convexify the mesh for inertial calculations
     bool _convexify_inertia;
 
-    /// The root bounding volume around the primitive; can differ based on whether the geometry is deformable
-    BVPtr _root;
-    
     /// The underlying mesh
     /**
      * \note the mesh changes when the primitive's transform changes
@@ -78,35 +76,51 @@ class TriangleMeshPrimitive : public Primitive
         unsigned tri_idx;             // the index of this triangle
     };
 
-    struct TriangleMeshPrimitiveState
+    /// Bounding volume hierarchy and data derived from the mesh
+    /**
+     * \note this data is never modified once built, so that it may be shared
+     *       among all instances of a mesh 
+     */
+    struct BVHData
     {
-      boost::shared_ptr<void> pstate;  // state information for the primitive object
-      BVPtr rootBVH;     // root of the bounding volume hierarchy
+      /// The root bounding volume around the primitive; can differ based on whether the geometry is deformable
+      BVPtr root;
+
+      /// Mapping from BVs to triangles contained within
       std::map<BVPtr, std::list<unsigned> > mesh_tris;
+
+      /// Vertices used by get_vertices() [and referenced by mesh_vertices]
+      boost::shared_ptr<std::vector<Vector3> > vertices;
+
+      /// Mapping from BVs to vertex indices contained within
       std::map<BVPtr, std::list<unsigned> > mesh_vertices;
+
+      /// Mapping from BV leafs to thick triangles
       std::map<BVPtr, std::list<boost::shared_ptr<AThickTri> > > tris;
     };
 
-    void construct_mesh_vertices(boost::shared_ptr<const IndexedTriArray> mesh);
+    struct TriangleMeshPrimitiveState
+    {
+      boost::shared_ptr<void> pstate;  // state information for the primitive object
+      boost::shared_ptr<const BVHData> bvh;  // the bounding volume hierarchy
+    };
+
+    void construct_mesh_vertices(boost::shared_ptr<const IndexedTriArray> mesh, BVHData& bvh) const;
     void build_BB_tree();
-    void split_tris(const Vector3& point, const Vector3& normal, const IndexedTriArray& orig_mesh, const std::list<unsigned>& ofacets, std::list<unsigned>& pfacets, std::list<unsigned>& nfacets);
-    bool split(boost::shared_ptr<const IndexedTriArray> mesh, BVPtr source, BVPtr& tgt1, BVPtr& tgt2, const Vector3& axis);
+    void split_tris(const Vector3& point, const Vector3& normal, const IndexedTriArray& orig_mesh, const std::list<unsigned>& ofacets, std::list<unsigned>& pfacets, std::list<unsigned>& nfacets) const;
+    bool split(boost::shared_ptr<const IndexedTriArray> mesh, BVHData& bvh, BVPtr source, BVPtr& tgt1, BVPtr& tgt2, const Vector3& axis) const;
     static bool is_degen_point_on_tri(boost::shared_ptr<AThickTri> tri, const Vector3& p);
 
     template <class InputIterator, class OutputIterator>
     static OutputIterator get_vertices(const IndexedTriArray& tris, InputIterator fselect_begin, InputIterator fselect_end, OutputIterator output);
 
-    /// Mapping from BVs to triangles contained within
-    std::map<BVPtr, std::list<unsigned> > _mesh_tris;
-
-    /// Vertices used by get_vertices() [and referenced by _mesh_vertices]
-    boost::shared_ptr<std::vector<Vector3> > _vertices;
+    static std::string get_instance_key(const std::string& filename, bool center, const Matrix4& T, Real itol, Real esl);
 
-    /// Mapping from BVs to vertex indices contained within
-    std::map<BVPtr, std::list<unsigned> > _mesh_vertices;
+    /// The bounding volume hierarchy (possibly shared with other instances of the mesh)
+    boost::shared_ptr<const BVHData> _bvh;
 
-    /// Mapping from BV leafs to thick triangles
-    std::map<BVPtr, std::list<boost::shared_ptr<AThickTri> > > _tris;
+    /// Mapping from mesh instance keys to meshes and hierarchies already loaded
+    static std::map<std::string, std::pair<boost::weak_ptr<const IndexedTriArray>, boost::weak_ptr<const BVHData> > > _instances;
 
     /// List of triangles covered by a bounding volume
     std::pair<boost::shared_ptr<const IndexedTriArray>, std::list<unsigned> > _smesh;
@@ -0,0 +1,78 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifndef _MOBY_UNION_FIND_H_
+#define _MOBY_UNION_FIND_H_
+
+#include <vector>
+#include <algorithm>
+
+namespace Moby {
+
+/// Disjoint sets of the integers 0..n-1 (union-find with path halving and union by size)
+/**
+ * Any sequence of m operations on n elements takes O(m alpha(n)) time,
+ * where alpha is the inverse Ackermann function.  The storage is two
+ * arrays, which are reused across calls to reset().
+ */
+class UnionFind
+{
+  public:
+    UnionFind() { }
+    UnionFind(unsigned n) { reset(n); }
+
+    /// Makes each of the integers 0..n-1 its own set
+    void reset(unsigned n)
+    {
+      _parent.resize(n);
+      _size.resize(n);
+      for (unsigned i=0; i< n; i++)
+      {
+        _parent[i] = i;
+        _size[i] = 1;
+      }
+    }
+
+    /// Gets the number of elements
+    unsigned size() const { return _parent.size(); }
+
+    /// Gets the representative of the set containing i
+    unsigned find(unsigned i)
+    {
+      while (_parent[i] != i)
+      {
+        _parent[i] = _parent[_parent[i]];
+        i = _parent[i];
+      }
+      return i;
+    }
+
+    /// Merges the sets containing i and j; returns the representative of the merged set
+    unsigned join(unsigned i, unsigned j)
+    {
+      i = find(i);
+      j = find(j);
+      if (i == j)
+        return i;
+      if (_size[i] < _size[j])
+        std::swap(i, j);
+      _parent[j] = i;
+      _size[i] += _size[j];
+      return i;
+    }
+
+    /// Determines whether i and j are in the same set
+    bool same(unsigned i, unsigned j) { return find(i) == find(j); }
+
+  private:
+    std::vector<unsigned> _parent;
+    std::vector<unsigned> _size;
+}; // end class
+
+} // end namespace
+
+#endif
+
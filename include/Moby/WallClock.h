@@ -0,0 +1,39 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifndef _MOBY_WALL_CLOCK_H_
+#define _MOBY_WALL_CLOCK_H_
+
+#include <time.h>
+#include <limits>
+
+namespace Moby {
+
+/// Reads a monotonic wall clock, for solver time budgets and timing
+/**
+ * Times are always doubles (even when Real is float): a float cannot resolve
+ * differences of a few milliseconds once the clock reads more than a few
+ * hours.  The clock is not affected by changes to the system time.
+ */
+class WallClock
+{
+  public:
+    /// Gets the current time (in seconds, measured from an arbitrary fixed point)
+    static double now()
+    {
+      timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+    }
+
+    /// Value used for a deadline that never passes
+    static double never() { return std::numeric_limits<double>::max(); }
+}; // end class
+
+} // end namespace
+
+#endif
+
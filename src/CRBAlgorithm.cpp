@@ -13,6 +13,7 @@
 #include <Moby/RigidBody.h>
 #include <Moby/Joint.h>
 #include <Moby/NumericalException.h>
+#include <Moby/SMatrix6K.h>
 #include <Moby/CRBAlgorithm.h>
 
 using namespace Moby;
@@ -27,14 +28,26 @@ CRBAlgorithm::CRBAlgorithm()
 {
   _position_data_valid = false;
   _velocity_data_valid = false;
+  _sparse_factorization = false;
 }
 
 /// Computes the parent array for sparse Cholesky factorization
+/**
+ * lambda[i] is the generalized coordinate that immediately precedes i on the
+ * path to the base (or UINT_MAX if there is no such coordinate); the
+ * generalized inertia matrix M has nonzero entries M(i,j) only where one of i
+ * and j is an ancestor of the other.  The six base coordinates of a floating
+ * base are treated as a chain that all other coordinates descend from.
+ */
 void CRBAlgorithm::setup_parent_array()
 {
-  // get the number of generalized coordinates
+  const unsigned SPATIAL_DIM = 6;
+  const unsigned NONE = std::numeric_limits<unsigned>::max();
+
+  // get the number of generalized coordinates (i.e., the size of M)
   RCArticulatedBodyPtr body(_body);
-  const unsigned N = body->num_generalized_coordinates(DynamicBody::eAxisAngle);
+  const bool FLOATING = body->is_floating_base();
+  const unsigned N = ((FLOATING) ? SPATIAL_DIM : 0) + body->num_joint_dof_implicit();
 
   // get implicit joints
   const vector<JointPtr>& ijoints = body->get_implicit_joints();
@@ -44,7 +57,12 @@ void CRBAlgorithm::setup_parent_array()
 
   // set all values of lambda to inf initially
   for (unsigned i=0; i< N; i++)
-    _lambda[i] = std::numeric_limits<unsigned>::max();
+    _lambda[i] = NONE;
+
+  // the base coordinates (if any) form a chain
+  if (FLOATING)
+    for (unsigned i=1; i< SPATIAL_DIM; i++)
+      _lambda[i] = i-1;
   
   // loop over all implicit joints
   for (unsigned i=0; i< ijoints.size(); i++)
@@ -52,12 +70,15 @@ void CRBAlgorithm::setup_parent_array()
     // get the index of this joint
     unsigned idx = ijoints[i]->get_coord_index();
 
-    // get the parent joint and its index
+    // get the parent joint and its index (the last base coordinate for
+    // joints attached to a floating base)
     RigidBodyPtr inboard = ijoints[i]->get_inboard_link();
     JointPtr parent = inboard->get_inner_joint_implicit();
-    if (!parent)
-      continue;
-    unsigned pidx = parent->get_coord_index();
+    unsigned pidx = NONE;
+    if (parent)
+      pidx = parent->get_coord_index() + parent->num_dof() - 1;
+    else if (FLOATING)
+      pidx = SPATIAL_DIM - 1;
 
     // now set the elements of lambda
     for (unsigned j=0; j< ijoints[i]->num_dof(); j++)
@@ -67,35 +88,56 @@ void CRBAlgorithm::setup_parent_array()
       idx++;
     }
   }
+
+  // the factorization requires that every coordinate be numbered after its
+  // parent (which is not the case if the joints are not given in topological
+  // order); if this does not hold, the dense factorization is used instead
+  _sparse_factorization = true;
+  for (unsigned i=0; i< N; i++)
+    if (_lambda[i] != NONE && _lambda[i] >= i)
+    {
+      FILE_LOG(LOG_DYNAMICS) << "CRBAlgorithm::setup_parent_array() - coordinates not numbered topologically; using dense factorization" << endl;
+      _sparse_factorization = false;
+      break;
+    }
 }
 
 /// Factorizes (Cholesky) the generalized inertia matrix, exploiting sparsity
+/**
+ * Computes the factorization M = L'*L using the parent array ([Featherstone,
+ * 2008], Table 6.3); the work required is proportional to the sum of the
+ * squared depths of the coordinates rather than to the cube of the number of
+ * coordinates.  L is stored in the lower triangle of M; only the entries L(i,j)
+ * for which j is an ancestor of i (or i itself) are computed, and the
+ * remaining entries of M are left untouched.
+ * \return <b>false</b> if M is not positive definite
+ */
 bool CRBAlgorithm::factorize_cholesky(MatrixN& M)
 {
+  const unsigned NONE = std::numeric_limits<unsigned>::max();
+
   // get the number of degrees of freedom
   const unsigned n = M.rows();
+  assert(_lambda.size() == n);
 
   // loop
   for (unsigned kk=n; kk> 0; kk--)
   {
     unsigned k = kk - 1;
-    if (M(k,k) < (Real) 0.0)
-    {
-      assert(false);
+    if (M(k,k) <= (Real) 0.0)
       return false;
-    }
     M(k,k) = std::sqrt(M(k,k));
     unsigned i = _lambda[k];
-    while (i != std::numeric_limits<unsigned>::max())
+    while (i != NONE)
     {
       M(k,i) /= M(k,k);
       i = _lambda[i];
     }
     i = _lambda[k];
-    while (i != std::numeric_limits<unsigned>::max())
+    while (i != NONE)
     {
       unsigned j=i;
-      while (j != std::numeric_limits<unsigned>::max())
+      while (j != NONE)
       {
         M(i,j) -= M(k,i)*M(k,j);
         j = _lambda[j];
@@ -107,6 +149,36 @@ bool CRBAlgorithm::factorize_cholesky(MatrixN& M)
   return true;
 }
 
+/// Solves M*x = b in place using the factorization computed by factorize_cholesky()
+/**
+ * \param x the right hand side b on entry (of length M.rows()); the solution
+ *        on return
+ * \see [Featherstone, 2008], Table 6.4
+ */
+void CRBAlgorithm::solve_cholesky_sparse(Real* x) const
+{
+  const unsigned NONE = std::numeric_limits<unsigned>::max();
+  const MatrixN& L = this->_fM;
+  const unsigned n = L.rows();
+
+  // solve L'*y = b
+  for (unsigned ii=n; ii> 0; ii--)
+  {
+    unsigned i = ii - 1;
+    x[i] /= L(i,i);
+    for (unsigned j=_lambda[i]; j != NONE; j = _lambda[j])
+      x[j] -= L(i,j)*x[i];
+  }
+
+  // solve L*x = y
+  for (unsigned i=0; i< n; i++)
+  {
+    for (unsigned j=_lambda[i]; j != NONE; j = _lambda[j])
+      x[i] -= L(i,j)*x[j];
+    x[i] /= L(i,i);
+  }
+}
+
 /// Calculates the generalized inertia of this body
 void CRBAlgorithm::calc_generalized_inertia(RCArticulatedBodyPtr body, ReferenceFrameType rftype)
 {
@@ -202,10 +274,75 @@ void CRBAlgorithm::calc_generalized_inertia(DynamicBody::GeneralizedCoordinateTy
   }
 }
 
+/// Sets a block s'*f of the joint space inertia matrix (and its transpose) using fixed-size arithmetic 
+/**
+ * \param s the spatial axes of joint i (K columns)
+ * \param f the composite inertia forces of the outboard link of joint j
+ * \param X if non-NULL, the transform from the outboard link of joint j to
+ *        the outboard link of joint i
+ * \param iidx the starting coordinate index of joint i 
+ * \param jidx the starting coordinate index of joint j 
+ */
+template <unsigned K>
+static void set_H_block_fixed(const SMatrix6N& s, const SMatrix6N& f, const SpatialTransform* X, unsigned iidx, unsigned jidx, MatrixN& H)
+{
+  SMatrix6K<K> sK;
+  VectorK<K> x;
+
+  // compute the block one column at a time
+  sK.set(s);
+  for (unsigned k=0; k< f.columns(); k++)
+  {
+    SVector6 fk = f.get_column(k);
+    if (X)
+      fk = X->transform(fk);
+    sK.transpose_mult(fk, x);
+    for (unsigned r=0; r< K; r++)
+      H(iidx+r, jidx+k) = H(jidx+k, iidx+r) = x[r];
+  }
+}
+
+/// Sets a block s'*f of the joint space inertia matrix (and its transpose) 
+/**
+ * Joints with one to three degrees of freedom use the fixed-size kernels;
+ * other joints use SMatrix6N arithmetic.
+ * \see set_H_block_fixed()
+ */
+static void set_H_block(const SMatrix6N& s, const SMatrix6N& f, const SpatialTransform* X, unsigned iidx, unsigned jidx, MatrixN& H)
+{
+  SAFESTATIC SMatrix6N Xf;
+  SAFESTATIC MatrixN sub;
+
+  switch (s.columns())
+  {
+    case 1:
+      set_H_block_fixed<1>(s, f, X, iidx, jidx, H);
+      return;
+
+    case 2:
+      set_H_block_fixed<2>(s, f, X, iidx, jidx, H);
+      return;
+
+    case 3:
+      set_H_block_fixed<3>(s, f, X, iidx, jidx, H);
+      return;
+  }
+
+  // compute the block 
+  if (X)
+    s.transpose_mult(X->transform(f, Xf), sub);
+  else
+    s.transpose_mult(f, sub);
+
+  // set the appropriate parts of H
+  H.set_sub_mat(iidx, jidx, sub);
+  if (iidx != jidx)
+    H.set_sub_mat(jidx, iidx, sub, true);
+}
+
 /// Computes *just* the joint space inertia matrix
 void CRBAlgorithm::calc_joint_space_inertia(RCArticulatedBodyPtr body, ReferenceFrameType rftype, MatrixN& H, vector<SpatialRBInertia>& Ic) const
 {
-  SAFESTATIC MatrixN tmp, sub;
   SAFESTATIC vector<SMatrix6N> forces;
   SAFESTATIC vector<vector<bool> > supports;
   queue<RigidBodyPtr> link_queue;
@@ -389,10 +526,7 @@ void CRBAlgorithm::calc_joint_space_inertia(RCArticulatedBodyPtr body, Reference
     const SMatrix6N& si = ijoints[i]->get_spatial_axes(rftype);
 
     // compute the H term for i,i
-    si.transpose_mult(forces[oiidx], sub);
-
-    // set the appropriate part of H
-    H.set_sub_mat(iidx,iidx,sub);
+    set_H_block(si, forces[oiidx], NULL, iidx, iidx, H);
 
     // determine what will be the new value for m
     for (unsigned j=i+1; j< ijoints.size(); j++)
@@ -410,16 +544,12 @@ void CRBAlgorithm::calc_joint_space_inertia(RCArticulatedBodyPtr body, Reference
 
       // compute the appropriate submatrix of H
       if (rftype == eGlobal)
-        si.transpose_mult(forces[ojidx], sub);
+        set_H_block(si, forces[ojidx], NULL, iidx, jidx, H);
       else
       {
         SpatialTransform X_i_j(outboardj->get_transform(), outboardi->get_transform());
-        si.transpose_mult(X_i_j.transform(forces[ojidx]), sub);
+        set_H_block(si, forces[ojidx], &X_i_j, iidx, jidx, H);
       }
-
-      // set the appropriate parts of H
-      H.set_sub_mat(iidx,jidx,sub);
-      H.set_sub_mat(jidx,iidx,sub, true);
     }
   }
 
@@ -720,10 +850,13 @@ void CRBAlgorithm::precalc(RCArticulatedBodyPtr body, ReferenceFrameType rftype)
     MatrixN& fM = this->_fM;
     MatrixN& M = this->_M;
     fM.copy_from(M);
-    if (_rank_deficient = !LinAlg::factor_chol(fM))
+    if (_sparse_factorization)
+      _rank_deficient = !factorize_cholesky(fM);
+    else
+      _rank_deficient = !LinAlg::factor_chol(fM);
+    if (_rank_deficient)
     {
       fM.copy_from(M);
-//    if (_rank_deficient = !factorize_cholesky(fM))
       try
       {
         LinAlg::pseudo_inverse(fM, LinAlg::svd1);
@@ -801,7 +934,10 @@ VectorN& CRBAlgorithm::M_solve_noprecalc(const VectorN& v, VectorN& result) cons
   {
     // matrix is not rank deficient, use Cholesky factorization
     result.copy_from(v);
-    LinAlg::solve_chol_fast(fJ, result);
+    if (_sparse_factorization)
+      solve_cholesky_sparse(result.data());
+    else
+      LinAlg::solve_chol_fast(fJ, result);
   }
 
   return result;
@@ -823,7 +959,13 @@ MatrixN& CRBAlgorithm::M_solve_noprecalc(const MatrixN& m, MatrixN& result) cons
   {
     // matrix is not rank deficient, use Cholesky factorization
     result.copy_from(m);
-    LinAlg::solve_chol_fast(fJ, result);
+    if (_sparse_factorization)
+    {
+      for (unsigned j=0; j< result.columns(); j++)
+        solve_cholesky_sparse(result.data() + j*result.rows());
+    }
+    else
+      LinAlg::solve_chol_fast(fJ, result);
   }
 
   return result;
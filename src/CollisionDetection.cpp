@@ -8,7 +8,11 @@
 #include <stack>
 #include <list>
 #include <set>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <Moby/AAngle.h>
+#include <Moby/AABB.h>
 #include <Moby/Constants.h>
 #include <Moby/CompGeom.h>
 #include <Moby/CollisionGeometry.h>
@@ -493,6 +497,228 @@ Real CollisionDetection::calc_distances()
   return min_dist;
 }
 
+/// A node of the hierarchy over geometry bounds used by cast_rays()
+struct BoundsNode
+{
+  AABB aabb;             // the bounds of all geometries below the node
+  unsigned begin, end;   // the range of geometry indices (leaves only)
+  unsigned left, right;  // the children (internal nodes only)
+};
+
+/// Orders geometry indices by the center of their bounds along one axis
+class BoundsCenterLess
+{
+  public:
+    BoundsCenterLess(const vector<AABB>& bounds, unsigned axis) : _bounds(bounds), _axis(axis) { }
+    bool operator()(unsigned i, unsigned j) const { return _bounds[i].minp[_axis] + _bounds[i].maxp[_axis] < _bounds[j].minp[_axis] + _bounds[j].maxp[_axis]; }
+
+  private:
+    const vector<AABB>& _bounds;
+    unsigned _axis;
+};
+
+/// Builds a hierarchy over the bounds of geometries idx[begin..end-1] (splitting at the median along the longest axis), returning the index of its root
+static unsigned build_bounds_tree(const vector<AABB>& bounds, vector<unsigned>& idx, unsigned begin, unsigned end, vector<BoundsNode>& nodes)
+{
+  const unsigned LEAF_SIZE = 4;
+
+  // create the node and compute its bounds
+  const unsigned n = nodes.size();
+  nodes.push_back(BoundsNode());
+  AABB aabb;
+  aabb.minp = bounds[idx[begin]].minp;
+  aabb.maxp = bounds[idx[begin]].maxp;
+  for (unsigned i=begin+1; i< end; i++)
+    for (unsigned j=0; j< 3; j++)
+    {
+      aabb.minp[j] = std::min(aabb.minp[j], bounds[idx[i]].minp[j]);
+      aabb.maxp[j] = std::max(aabb.maxp[j], bounds[idx[i]].maxp[j]);
+    }
+  nodes[n].aabb.minp = aabb.minp;
+  nodes[n].aabb.maxp = aabb.maxp;
+
+  // make a leaf if there are few geometries
+  if (end - begin <= LEAF_SIZE)
+  {
+    nodes[n].begin = begin;
+    nodes[n].end = end;
+    nodes[n].left = nodes[n].right = 0;
+    return n;
+  }
+
+  // split at the median along the longest axis
+  const Vector3 len = aabb.maxp - aabb.minp;
+  const unsigned axis = (len[0] > len[1]) ? ((len[0] > len[2]) ? 0 : 2) : ((len[1] > len[2]) ? 1 : 2);
+  const unsigned mid = (begin + end)/2;
+  std::nth_element(idx.begin()+begin, idx.begin()+mid, idx.begin()+end, BoundsCenterLess(bounds, axis));
+
+  // build the children (NOTE: nodes may be reallocated)
+  const unsigned left = build_bounds_tree(bounds, idx, begin, mid, nodes);
+  const unsigned right = build_bounds_tree(bounds, idx, mid, end, nodes);
+  nodes[n].begin = nodes[n].end = 0;
+  nodes[n].left = left;
+  nodes[n].right = right;
+  return n;
+}
+
+/// Casts a batch of rays against all enabled geometries, determining the nearest hit for each ray
+/**
+ * \param rays the rays to cast; each ray is given as a line segment from the
+ *        ray origin to the point at the maximum range of the ray (global 
+ *        frame)
+ * \param hits the nearest hit for each ray, on return; the geometry of the
+ *        hit is NULL (and the distance infinite) if the ray hits nothing
+ * \return the number of rays that hit a geometry
+ * \note geometries are culled using a hierarchy over their axis-aligned 
+ *       bounds (global frame), built once per call, before the bounding 
+ *       volume hierarchy of each candidate is tested; the hierarchy is 
+ *       traversed nearest child first, and subtrees entered beyond the 
+ *       nearest hit found so far are skipped.  Rays are processed in parallel
+ *       if OpenMP is enabled.
+ */
+unsigned CollisionDetection::cast_rays(const vector<LineSeg3>& rays, vector<RayHit>& hits)
+{
+  const Real INF = std::numeric_limits<Real>::max();
+
+  FILE_LOG(LOG_COLDET) << "CollisionDetection::cast_rays() entered" << std::endl;
+
+  // setup the broad phase data; NOTE: this is done serially, b/c bounding
+  // volume hierarchies may be built on demand
+  vector<CollisionGeometryPtr> geoms;
+  vector<BVPtr> roots;
+  vector<AABB> bounds;
+  vector<Matrix4> inv_transforms;
+  BOOST_FOREACH(CollisionGeometryPtr cg, _geoms)
+  {
+    // skip disabled geometries and geometries without primitives
+    if (!is_enabled(cg) || !cg->get_geometry())
+      continue;
+
+    // get the root bounding volume and its bounds in the global frame 
+    BVPtr bv = cg->get_geometry()->get_BVH_root();
+    const Matrix4& T = cg->get_transform();
+    AABB aabb;
+    aabb.minp = bv->get_lower_bounds(T);
+    aabb.maxp = bv->get_upper_bounds(T);
+
+    // store the data
+    geoms.push_back(cg);
+    roots.push_back(bv);
+    bounds.push_back(aabb);
+    inv_transforms.push_back(Matrix4::inverse_transform(T));
+  }
+
+  // build the hierarchy over the bounds
+  vector<unsigned> idx(bounds.size());
+  vector<BoundsNode> nodes;
+  for (unsigned i=0; i< idx.size(); i++)
+    idx[i] = i;
+  if (!bounds.empty())
+    build_bounds_tree(bounds, idx, 0, bounds.size(), nodes);
+
+  // setup the hits
+  hits.resize(rays.size());
+
+  // cast all rays
+  unsigned nhits = 0;
+  #pragma omp parallel reduction(+:nhits)
+  {
+    // nodes to visit (entry parameter and node index) for a single ray
+    vector<pair<Real, unsigned> > stack;
+
+    #pragma omp for
+    for (int i=0; i< (int) rays.size(); i++)
+    {
+      const LineSeg3& ray = rays[i];
+      RayHit& hit = hits[i];
+      hit.geom = CollisionGeometryPtr();
+      hit.dist = INF;
+
+      // start at the root, if the ray intersects it
+      Real tbest = INF;
+      Real tmin = (Real) 0.0;
+      Vector3 q;
+      stack.clear();
+      if (!nodes.empty() && AABB::intersects(nodes.front().aabb, ray, tmin, (Real) 1.0, q))
+        stack.push_back(make_pair(tmin, (unsigned) 0));
+
+      while (!stack.empty())
+      {
+        // no geometry below the node can be hit earlier
+        const pair<Real, unsigned> top = stack.back();
+        stack.pop_back();
+        if (top.first > tbest)
+          continue;
+        const BoundsNode& node = nodes[top.second];
+
+        // internal node: visit the children, nearest first
+        if (node.begin == node.end)
+        {
+          Real tl = (Real) 0.0, tr = (Real) 0.0;
+          const Real TMAX = std::min(tbest, (Real) 1.0);
+          const bool HIT_L = AABB::intersects(nodes[node.left].aabb, ray, tl, TMAX, q);
+          const bool HIT_R = AABB::intersects(nodes[node.right].aabb, ray, tr, TMAX, q);
+          if (HIT_L && HIT_R)
+          {
+            if (tl < tr)
+            {
+              stack.push_back(make_pair(tr, node.right));
+              stack.push_back(make_pair(tl, node.left));
+            }
+            else
+            {
+              stack.push_back(make_pair(tl, node.left));
+              stack.push_back(make_pair(tr, node.right));
+            }
+          }
+          else if (HIT_L)
+            stack.push_back(make_pair(tl, node.left));
+          else if (HIT_R)
+            stack.push_back(make_pair(tr, node.right));
+          continue;
+        }
+
+        // leaf: test the geometries whose bounds intersect the ray
+        for (unsigned k=node.begin; k< node.end; k++)
+        {
+          const unsigned j = idx[k];
+          Real tj = (Real) 0.0;
+          if (!AABB::intersects(bounds[j], ray, tj, std::min(tbest, (Real) 1.0), q) || tj > tbest)
+            continue;
+
+          // convert the ray to the geometry frame 
+          LineSeg3 seg(inv_transforms[j].mult_point(ray.first), inv_transforms[j].mult_point(ray.second));
+
+          // intersect the ray against the primitive
+          Real t;
+          Vector3 isect, normal;
+          if (!geoms[j]->get_geometry()->intersect_seg(roots[j], seg, t, isect, normal) || t >= tbest)
+            continue;
+
+          // store the hit in the global frame 
+          const Matrix4& T = geoms[j]->get_transform();
+          tbest = t;
+          hit.geom = geoms[j];
+          hit.point = T.mult_point(isect);
+          hit.normal = T.mult_vector(normal);
+        }
+      }
+
+      // compute the distance of the hit
+      if (hit.geom)
+      {
+        hit.dist = tbest * (ray.second - ray.first).norm();
+        nhits++;
+      }
+    }
+  }
+
+  FILE_LOG(LOG_COLDET) << "  " << nhits << " of " << rays.size() << " rays hit a geometry" << std::endl;
+  FILE_LOG(LOG_COLDET) << "CollisionDetection::cast_rays() exited" << std::endl;
+
+  return nhits;
+}
+
 /// Calculates the closest points (and squared distance) between geometries a and b
 /**
  * \param a the first collision geometry
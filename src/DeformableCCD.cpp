@@ -411,7 +411,7 @@ void DeformableCCD::check_geoms(Real dt, CollisionGeometryPtr a, CollisionGeomet
   const Real TOI_TOLERANCE = std::numeric_limits<Real>::epsilon();
 
   // sort the vector of contacts
-  std::sort(local_contacts.begin(), local_contacts.end());
+  Event::sort_events(local_contacts);
 
   // see what points to insert into the vector of contacts 
   // we return all contacts if using an event-driven method to deal with Zeno
@@ -5,6 +5,7 @@
  ****************************************************************************/
 
 #include <cmath>
+#include <limits>
 #include <algorithm>
 #include <vector>
 #include <queue>
@@ -28,6 +29,7 @@
 #include <Moby/CollisionGeometry.h>
 #include <Moby/Log.h>
 #include <Moby/AAngle.h>
+#include <Moby/UnionFind.h>
 #include <Moby/Event.h>
 
 using namespace Moby;
@@ -85,6 +87,68 @@ Event& Event::operator=(const Event& e)
   return *this;
 }
 
+/// Exchanges the data of this event with another, without copying any vectors or reference-counted pointers
+void Event::swap(Event& e)
+{
+  std::swap(t_true, e.t_true);
+  std::swap(t, e.t);
+  std::swap(event_type, e.event_type);
+  std::swap(limit_epsilon, e.limit_epsilon);
+  std::swap(limit_dof, e.limit_dof);
+  std::swap(limit_upper, e.limit_upper);
+  std::swap(limit_impulse, e.limit_impulse);
+  limit_joint.swap(e.limit_joint);
+  contact_normal.swap(e.contact_normal);
+  contact_geom1.swap(e.contact_geom1);
+  contact_geom2.swap(e.contact_geom2);
+  contact_point.swap(e.contact_point);
+  contact_impulse.swap(e.contact_impulse);
+  std::swap(contact_mu_coulomb, e.contact_mu_coulomb);
+  std::swap(contact_mu_viscous, e.contact_mu_viscous);
+  std::swap(contact_epsilon, e.contact_epsilon);
+  std::swap(contact_NK, e.contact_NK);
+  contact_tan1.swap(e.contact_tan1);
+  contact_tan2.swap(e.contact_tan2);
+  constraint_nimpulse.swap(e.constraint_nimpulse);
+  constraint_fimpulse.swap(e.constraint_fimpulse);
+  constraint_joint.swap(e.constraint_joint);
+}
+
+/// Sorts events by time without copying them
+/**
+ * The times of the events are sorted as compact (time, index) records and
+ * the events are then permuted in place using swap(), so that no event is
+ * copied.  Events that occur at the same time keep their relative order.
+ * \param events the events to sort
+ */
+void Event::sort_events(vector<Event>& events)
+{
+  vector<std::pair<Real, unsigned> > order(events.size());
+  vector<unsigned> pos(events.size());
+
+  // sort the (time, index) records
+  for (unsigned i=0; i< events.size(); i++)
+    order[i] = std::make_pair(events[i].t, i);
+  std::stable_sort(order.begin(), order.end(), compare_event_order);
+
+  // permute the events in place: event order[i].second belongs at i; pos 
+  // gives the current location of each event and at gives the event
+  // currently at each location
+  for (unsigned i=0; i< events.size(); i++)
+    pos[i] = i;
+  vector<unsigned> at(pos);
+  for (unsigned i=0; i< events.size(); i++)
+  {
+    const unsigned j = pos[order[i].second];
+    if (j == i)
+      continue;
+    events[i].swap(events[j]);
+    std::swap(at[i], at[j]);
+    pos[at[i]] = i;
+    pos[at[j]] = j;
+  }
+}
+
 /// Sets the contact parameters for this event
 void Event::set_contact_parameters(const ContactParameters& cparams)
 {
@@ -269,193 +333,130 @@ osg::Node* Event::to_visualization_data() const
  */
 void Event::determine_connected_events(const vector<Event>& events, list<list<Event*> >& groups)
 {
+  const unsigned UINF = std::numeric_limits<unsigned>::max();
+  vector<SingleBodyPtr> nodes;
+  vector<DynamicBodyPtr> unindexed;
+  vector<unsigned> node_idx, ab_idx, group_idx;
+  vector<list<Event*>*> group_ptrs;
+
   FILE_LOG(LOG_CONTACT) << "Event::determine_connected_contacts() entered" << std::endl;
 
   // clear the groups
   groups.clear();
 
-  // copy the list of events -- only ones with geometry
-  list<Event*> events_copy;
-  BOOST_FOREACH(const Event& e, events)
-    if (e.event_type != Event::eNone)
-      events_copy.push_back((Event*) &e);
-  
-  // The way that we'll determine the event islands is to treat each rigid
+  // The way that we'll determine the event islands is to treat each single
   // body present in the events as a node in a graph; nodes will be connected
   // to other nodes if (a) they are both present in event or (b) they are
   // part of the same articulated body.  Nodes will not be created for disabled
-  // bodies.
-  set<SingleBodyPtr> nodes;
-  multimap<SingleBodyPtr, SingleBodyPtr> edges;
-  typedef multimap<SingleBodyPtr, SingleBodyPtr>::const_iterator EdgeIter;
-
-  // get all single bodies present in the events
-  for (list<Event*>::const_iterator i = events_copy.begin(); i != events_copy.end(); i++)
+  // bodies.  Nodes are identified using the dense body indices assigned by
+  // the simulator, and connected using union-find (joining each link to its
+  // articulated body connects the links).
+
+  // get the (two) nodes of each event
+  nodes.resize(events.size()*2);
+  unsigned NINDEXED = 0;
+  for (unsigned i=0; i< events.size(); i++)
   {
-    if ((*i)->event_type == Event::eContact)
+    const Event& e = events[i];
+    if (e.event_type == Event::eContact)
     {
-      SingleBodyPtr sb1((*i)->contact_geom1->get_single_body());
-      SingleBodyPtr sb2((*i)->contact_geom2->get_single_body());
+      SingleBodyPtr sb1(e.contact_geom1->get_single_body());
+      SingleBodyPtr sb2(e.contact_geom2->get_single_body());
       if (sb1->is_enabled())
-        nodes.insert(sb1);
+        nodes[i*2] = sb1;
       if (sb2->is_enabled())
-        nodes.insert(sb2);
-      if (sb1->is_enabled() && sb2->is_enabled())
-      {
-        edges.insert(std::make_pair(sb1, sb2));
-        edges.insert(std::make_pair(sb2, sb1));
-      }
+        nodes[i*2+1] = sb2;
     }
-    else if ((*i)->event_type == Event::eLimit)
+    else if (e.event_type == Event::eLimit)
     {
-      RigidBodyPtr inboard = (*i)->limit_joint->get_inboard_link();
-      RigidBodyPtr outboard = (*i)->limit_joint->get_outboard_link();
-      nodes.insert(inboard);
-      nodes.insert(outboard);
+      nodes[i*2] = e.limit_joint->get_inboard_link();
+      nodes[i*2+1] = e.limit_joint->get_outboard_link();
     }
-    else if ((*i)->event_type == Event::eConstraint)
+    else if (e.event_type == Event::eConstraint)
     {
-      RigidBodyPtr inboard = (*i)->constraint_joint->get_inboard_link();
-      RigidBodyPtr outboard = (*i)->constraint_joint->get_outboard_link();
-      nodes.insert(inboard);
-      nodes.insert(outboard);
+      nodes[i*2] = e.constraint_joint->get_inboard_link();
+      nodes[i*2+1] = e.constraint_joint->get_outboard_link();
     }
-    else 
-      assert(false);
-  }
-
-  FILE_LOG(LOG_CONTACT) << " -- single bodies in events:" << std::endl;
-  if (LOGGING(LOG_CONTACT))
-    for (set<SingleBodyPtr>::const_iterator i = nodes.begin(); i != nodes.end(); i++)
-      FILE_LOG(LOG_CONTACT) << "    " << (*i)->id << std::endl;
-  FILE_LOG(LOG_CONTACT) << std::endl;
-
-  // add connections between articulated rigid bodies -- NOTE: don't process
-  // articulated bodies twice!
-  set<ArticulatedBodyPtr> ab_processed;
-  BOOST_FOREACH(SingleBodyPtr sb, nodes)
-  {
-    // if the body is not part of an articulated body, skip it
-    ArticulatedBodyPtr abody = sb->get_articulated_body();
-    if (!abody)
-      continue;
-
-    // see whether it has already been processed
-    if (ab_processed.find(abody) != ab_processed.end())
-      continue;
-
-    // indicate that the articulated body will now have been processed
-    ab_processed.insert(abody);
-
-    // get all links in the articulated body
-    const vector<RigidBodyPtr>& links = abody->get_links();
+    else
+      assert(e.event_type == Event::eNone);
 
-    // add edges between all pairs for which there are links
-    vector<RigidBodyPtr>::const_iterator j, k;
-    for (j = links.begin(); j != links.end(); j++)
+    // determine the number of indices in use
+    for (unsigned j=i*2; j< i*2+2; j++)
     {
-      // no sense iterating over all other links if link pointed to by j is
-      // not a node
-      if (nodes.find(*j) == nodes.end())
+      if (!nodes[j])
         continue;
-
-      // iterate over all other nodes
-      k = j;
-      for (k++; k != links.end(); k++)
-        if (nodes.find(*k) != nodes.end())
-        {
-          edges.insert(std::make_pair(*j, *k));
-          edges.insert(std::make_pair(*k, *j));
-        }
-    }      
+      if (nodes[j]->get_index() != UINF)
+        NINDEXED = std::max(NINDEXED, nodes[j]->get_index()+1);
+      ArticulatedBodyPtr abody = nodes[j]->get_articulated_body();
+      if (abody && abody->get_index() != UINF)
+        NINDEXED = std::max(NINDEXED, abody->get_index()+1);
+    }
   }
 
-  // Now, we'll remove nodes from the set until there are no more nodes.
-  // For each removed node, we'll get add all events that contain the single 
-  // body to the group; all neighboring nodes will then be processed.
-  while (!nodes.empty())
+  // get the indices of the nodes and of their articulated bodies
+  node_idx.resize(nodes.size());
+  ab_idx.resize(nodes.size());
+  for (unsigned i=0; i< nodes.size(); i++)
   {
-    // get the node from the front
-    SingleBodyPtr node = *nodes.begin();
-
-    // add a list to the contact groups
-    groups.push_back(list<Event*>());
-    FILE_LOG(LOG_CONTACT) << " -- events in group: " << std::endl;
+    node_idx[i] = ab_idx[i] = UINF;
+    if (!nodes[i])
+      continue;
+    node_idx[i] = get_island_index(nodes[i], NINDEXED, unindexed);
+    ArticulatedBodyPtr abody = nodes[i]->get_articulated_body();
+    if (abody)
+      ab_idx[i] = get_island_index(abody, NINDEXED, unindexed);
+  }
 
-    // create a node queue, with this node added
-    std::queue<SingleBodyPtr> node_q;
-    node_q.push(node);
+  // connect the nodes
+  UnionFind islands(NINDEXED + unindexed.size());
+  for (unsigned i=0; i< events.size(); i++)
+    if (node_idx[i*2] != UINF && node_idx[i*2+1] != UINF)
+      islands.join(node_idx[i*2], node_idx[i*2+1]);
+  for (unsigned i=0; i< nodes.size(); i++)
+    if (ab_idx[i] != UINF)
+      islands.join(node_idx[i], ab_idx[i]);
+
+  // add each event to the group of its island
+  group_idx.assign(islands.size(), UINF);
+  for (unsigned i=0; i< events.size(); i++)
+  {
+    // get a node of the event; events without nodes are not grouped
+    const unsigned node = (node_idx[i*2] != UINF) ? node_idx[i*2] : node_idx[i*2+1];
+    if (node == UINF)
+      continue;
 
-    // loop until the queue is empty
-    while (!node_q.empty())
+    // get the group, creating it if necessary
+    const unsigned island = islands.find(node);
+    if (group_idx[island] == UINF)
     {
-      // get the node off of the front of the node queue
-      node = node_q.front();
-      node_q.pop();
-
-      // erase the node from the set of nodes
-      nodes.erase(node);
-
-      // add all neighbors of the node that have not been processed already 
-      // to the node queue
-      std::pair<EdgeIter, EdgeIter> neighbors = edges.equal_range(node);
-      for (EdgeIter i = neighbors.first; i != neighbors.second; i++)
-        if (nodes.find(i->second) != nodes.end())
-          node_q.push(i->second);
-
-      // loop through all remaining events
-      for (list<Event*>::iterator i = events_copy.begin(); i != events_copy.end(); )
-      {
-        if ((*i)->event_type == Event::eContact)
-        {
-          SingleBodyPtr sb1((*i)->contact_geom1->get_single_body());
-          SingleBodyPtr sb2((*i)->contact_geom2->get_single_body());
-
-          // see whether one of the bodies is equal to the node
-          if (sb1 == node || sb2 == node)
-          {
-            groups.back().push_back(*i);
-            i = events_copy.erase(i);
-            continue;
-          }
-          else
-            i++;
-        }
-        else if ((*i)->event_type == Event::eLimit)
-        {
-          RigidBodyPtr inboard = (*i)->limit_joint->get_inboard_link();
-          RigidBodyPtr outboard = (*i)->limit_joint->get_outboard_link();
-          if (inboard == node || outboard == node)
-          {
-            groups.back().push_back(*i);
-            i = events_copy.erase(i);
-            continue;
-          }
-          else
-            i++;
-        }
-        else if ((*i)->event_type == Event::eConstraint)
-        {
-          RigidBodyPtr inboard = (*i)->constraint_joint->get_inboard_link();
-          RigidBodyPtr outboard = (*i)->constraint_joint->get_outboard_link();
-          if (inboard == node || outboard == node)
-          {
-            groups.back().push_back(*i);
-            i = events_copy.erase(i);
-            continue;
-          }
-          else
-            i++;
-        }
-        else
-          assert(false);
-      }
+      group_idx[island] = group_ptrs.size();
+      groups.push_back(list<Event*>());
+      group_ptrs.push_back(&groups.back());
     }
+    group_ptrs[group_idx[island]]->push_back((Event*) &events[i]);
   }
 
+  FILE_LOG(LOG_CONTACT) << " -- " << groups.size() << " groups of connected events" << std::endl;
   FILE_LOG(LOG_CONTACT) << "Event::determine_connected_events() exited" << std::endl;
 }
 
+/// Gets the index of a body for determining connected events
+/**
+ * Bodies in a simulator use their dense indices (which are less than 
+ * NINDEXED); other bodies are assigned indices NINDEXED, NINDEXED+1, ... in
+ * the order they are encountered.
+ */
+unsigned Event::get_island_index(DynamicBodyPtr body, unsigned NINDEXED, vector<DynamicBodyPtr>& unindexed)
+{
+  if (body->get_index() < NINDEXED)
+    return body->get_index();
+  vector<DynamicBodyPtr>::const_iterator i = std::find(unindexed.begin(), unindexed.end(), body);
+  if (i != unindexed.end())
+    return NINDEXED + (i - unindexed.begin());
+  unindexed.push_back(body);
+  return NINDEXED + unindexed.size() - 1;
+}
+
 /// Modified Gaussian elimination with partial pivoting -- computes half-rank at the same time
 unsigned Event::gauss_elim(MatrixN& A, vector<unsigned>& piv)
 {
@@ -704,6 +705,215 @@ void Event::compute_contact_jacobians(const Event& e, MatrixN& Jc, MatrixN& Dc,
   }
 }
 
+/// Reduces coplanar contact manifolds between pairs of geometries to at most four contacts
+/**
+ * Contacts between two geometries that share a normal and lie in a common
+ * plane (e.g., face-face contact between polyhedra or meshes) support the
+ * geometries only through the convex hull of the contact points.  For each
+ * such manifold, contacts interior to the 2D convex hull are removed and,
+ * if the hull has more than four vertices, the four vertices that span the
+ * quadrilateral of maximum area are retained.  Contacts that are not part of
+ * a coplanar manifold are left untouched.
+ */
+void Event::reduce_contact_manifolds(list<Event*>& group)
+{
+  const unsigned MAX_MANIFOLD_CONTACTS = 4;
+  const Real TOL = std::sqrt(NEAR_ZERO);
+
+  // bucket the contact events by pair of geometries
+  map<sorted_pair<CollisionGeometryPtr>, vector<Event*> > manifolds;
+  for (list<Event*>::const_iterator i = group.begin(); i != group.end(); i++)
+    if ((*i)->event_type == Event::eContact)
+    {
+      sorted_pair<CollisionGeometryPtr> geoms((*i)->contact_geom1, (*i)->contact_geom2);
+      manifolds[geoms].push_back(*i);
+    }
+
+  // reduce each manifold
+  vector<Event*> removed;
+  vector<Vector3> points;
+  vector<Vector2> points_2D, hull;
+  vector<unsigned> keep;
+  for (map<sorted_pair<CollisionGeometryPtr>, vector<Event*> >::const_iterator i = manifolds.begin(); i != manifolds.end(); i++)
+  {
+    const vector<Event*>& contacts = i->second;
+    const unsigned NC = contacts.size();
+    if (NC <= MAX_MANIFOLD_CONTACTS)
+      continue;
+
+    // get the normal of the manifold, pointing outward from the first geometry
+    // of the pair
+    const CollisionGeometryPtr& g1 = i->first.first;
+    Vector3 normal = contacts.front()->contact_normal;
+    if (contacts.front()->contact_geom1 != g1)
+      normal = -normal;
+
+    // verify that all contact normals are (nearly) identical and that the
+    // contact points lie in a common plane
+    const Vector3& p0 = contacts.front()->contact_point;
+    Real extent = (Real) 0.0;
+    for (unsigned j=1; j< NC; j++)
+      extent = std::max(extent, (contacts[j]->contact_point - p0).norm());
+    bool coplanar = true;
+    for (unsigned j=1; j< NC && coplanar; j++)
+    {
+      const Event& e = *contacts[j];
+      Real ndot = e.contact_normal.dot(normal);
+      if (e.contact_geom1 != g1)
+        ndot = -ndot;
+      if (ndot < (Real) 1.0 - TOL)
+        coplanar = false;
+      else if (std::fabs(normal.dot(e.contact_point - p0)) > TOL * std::max((Real) 1.0, extent))
+        coplanar = false;
+    }
+    if (!coplanar)
+      continue;
+
+    // project the contact points to 2D
+    points.resize(NC);
+    for (unsigned j=0; j< NC; j++)
+      points[j] = contacts[j]->contact_point;
+    Matrix3 R = CompGeom::calc_3D_to_2D_matrix(normal);
+    points_2D.resize(NC);
+    CompGeom::to_2D(points.begin(), points.end(), points_2D.begin(), R);
+
+    // compute the 2D convex hull; if the points are collinear, no hull is
+    // computed and the extreme points of the segment are kept instead
+    hull.resize(NC);
+    hull.erase(CompGeom::calc_convex_hull_2D(points_2D.begin(), points_2D.end(), hull.begin()), hull.end());
+    keep.clear();
+    if (hull.size() < 3)
+    {
+      unsigned a = 0, b = 0;
+      for (unsigned j=1; j< NC; j++)
+        if ((points_2D[j] - points_2D[0]).norm_sq() > (points_2D[a] - points_2D[0]).norm_sq())
+          a = j;
+      for (unsigned j=0; j< NC; j++)
+        if ((points_2D[j] - points_2D[a]).norm_sq() > (points_2D[b] - points_2D[a]).norm_sq())
+          b = j;
+      keep.push_back(a);
+      if (b != a)
+        keep.push_back(b);
+    }
+    else
+    {
+      // select the hull vertices to keep
+      unsigned quad[MAX_MANIFOLD_CONTACTS];
+      const unsigned NKEEP = select_max_area_quad(hull, quad);
+
+      // map the hull vertices back to the contact points
+      for (unsigned k=0; k< NKEEP; k++)
+      {
+        const Vector2& v = hull[quad[k]];
+        unsigned closest = 0;
+        Real closest_dist = (points_2D[0] - v).norm_sq();
+        for (unsigned j=1; j< NC; j++)
+        {
+          Real dist = (points_2D[j] - v).norm_sq();
+          if (dist < closest_dist)
+          {
+            closest = j;
+            closest_dist = dist;
+          }
+        }
+        keep.push_back(closest);
+      }
+    }
+
+    // mark the remaining contacts for removal
+    std::sort(keep.begin(), keep.end());
+    for (unsigned j=0; j< NC; j++)
+      if (!std::binary_search(keep.begin(), keep.end(), j))
+        removed.push_back(contacts[j]);
+
+    FILE_LOG(LOG_CONTACT) << "Event::reduce_contact_manifolds() - reduced " << NC << " coplanar contacts between " << i->first.first->id << " and " << i->first.second->id << " to " << keep.size() << std::endl;
+  }
+
+  // remove the contacts from the group
+  if (removed.empty())
+    return;
+  std::sort(removed.begin(), removed.end());
+  for (list<Event*>::iterator i = group.begin(); i != group.end(); )
+    if (std::binary_search(removed.begin(), removed.end(), *i))
+      i = group.erase(i);
+    else
+      i++;
+}
+
+/// Computes twice the (unsigned) area of a triangle in 2D
+static Real calc_triangle_area(const Vector2& a, const Vector2& b, const Vector2& c)
+{
+  return std::fabs((b[0] - a[0])*(c[1] - a[1]) - (c[0] - a[0])*(b[1] - a[1]));
+}
+
+/// Selects (at most) four vertices of a convex polygon that span a quadrilateral of maximum area
+/**
+ * \param hull the vertices of the convex polygon, in order
+ * \param quad the indices of the selected vertices, on return
+ * \return the number of selected vertices
+ * \note for a fixed diagonal (a,c), the vertices b and d that maximize the
+ *       area lie on opposite sides of the diagonal and can be chosen
+ *       independently, so the search takes O(n^3) time
+ */
+unsigned Event::select_max_area_quad(const vector<Vector2>& hull, unsigned quad[4])
+{
+  const unsigned N = hull.size();
+  if (N <= 4)
+  {
+    for (unsigned i=0; i< N; i++)
+      quad[i] = i;
+    return N;
+  }
+
+  Real best_area = (Real) -1.0;
+  for (unsigned a=0; a< N; a++)
+    for (unsigned c=a+2; c< N; c++)
+    {
+      // the diagonal must have vertices on both sides
+      if (a == 0 && c == N-1)
+        continue;
+
+      // find the vertex between a and c farthest from the diagonal 
+      Real best_abc = (Real) -1.0;
+      unsigned b = a+1;
+      for (unsigned k=a+1; k< c; k++)
+      {
+        Real area = calc_triangle_area(hull[a], hull[k], hull[c]);
+        if (area > best_abc)
+        {
+          best_abc = area;
+          b = k;
+        }
+      }
+
+      // find the vertex between c and a (wrapping around) farthest from the
+      // diagonal
+      Real best_cda = (Real) -1.0;
+      unsigned d = (c+1) % N;
+      for (unsigned k=(c+1) % N; k != a; k = (k+1) % N)
+      {
+        Real area = calc_triangle_area(hull[c], hull[k], hull[a]);
+        if (area > best_cda)
+        {
+          best_cda = area;
+          d = k;
+        }
+      }
+
+      // update the best quadrilateral
+      if (best_abc + best_cda > best_area)
+      {
+        best_area = best_abc + best_cda;
+        quad[0] = a;
+        quad[1] = b;
+        quad[2] = c;
+        quad[3] = d;
+      }
+    }
+
+  return 4;
+}
+
 /**
  * Complexity of computing a minimal set:
  * N = # of contacts, NGC = # of generalized coordinates
@@ -724,6 +934,10 @@ void Event::determine_minimal_set(list<Event*>& group)
   FILE_LOG(LOG_CONTACT) << "Event::determine_minimal_set() entered" << std::endl;
   FILE_LOG(LOG_CONTACT) << " -- initial number of events: " << group.size() << std::endl;
 
+  // reduce coplanar contact manifolds first; this is cheap and removes most
+  // of the redundant contacts before the (expensive) rank tests below
+  reduce_contact_manifolds(group);
+
   // get the number of contact events and total number of events
   list<Event*>::iterator start = group.begin();
   unsigned NC = 0, NE = 0;
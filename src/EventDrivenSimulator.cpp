@@ -12,7 +12,9 @@
 #include <Moby/CollisionGeometry.h>
 #include <Moby/CollisionDetection.h>
 #include <Moby/ContactParameters.h>
+#include <Moby/Optimization.h>
 #include <Moby/VariableStepIntegrator.h>
+#include <Moby/WallClock.h>
 #include <Moby/EventDrivenSimulator.h>
 
 #ifdef USE_OSG
@@ -40,6 +42,10 @@ using boost::dynamic_pointer_cast;
 EventDrivenSimulator::EventDrivenSimulator()
 {
   max_Zeno_step = std::numeric_limits<Real>::max();
+  step_time_budget = std::numeric_limits<Real>::max();
+  step_budget_exceeded = false;
+  num_budget_exceeded_steps = 0;
+  _step_deadline = WallClock::never();
   event_callback_fn = NULL;
   event_post_impulse_callback_fn = NULL;
   post_mini_step_callback_fn = NULL;
@@ -136,7 +142,7 @@ shared_ptr<ContactParameters> EventDrivenSimulator::get_contact_parameters(Colli
 }
 
 /// Draws a ray directed from a contact point along the contact normal
-void EventDrivenSimulator::visualize_contact( Event& event ) {
+void EventDrivenSimulator::visualize_contact( const Event& event ) {
 
   #ifdef USE_OSG
 
@@ -280,8 +286,8 @@ void EventDrivenSimulator::handle_events()
 {
   // if the setting is enabled, draw all contact events
   if( render_contact_points ) {
-    for ( std::vector<Event>::iterator it = _events.begin(); it < _events.end(); it++ ) {
-      Event event = *it;
+    for ( std::vector<Event>::const_iterator it = _events.begin(); it < _events.end(); it++ ) {
+      const Event& event = *it;
       if( event.event_type != Event::eContact ) continue;
       visualize_contact( event );
     }
@@ -295,8 +301,11 @@ void EventDrivenSimulator::handle_events()
   for (unsigned i=0; i< _events.size(); i++)
     preprocess_event(_events[i]);
 
-  // compute impulses here...
-  _impact_event_handler.process_events(_events);
+  // compute impulses here, within the time remaining in the step (if the 
+  // step has a time budget)
+  _impact_event_handler.process_events(_events, NEAR_ZERO, _step_deadline);
+  if (_impact_event_handler.budget_exceeded)
+    step_budget_exceeded = true;
 
   // call the post-impulse application callback, if any 
   if (event_post_impulse_callback_fn)
@@ -393,15 +402,14 @@ bool EventDrivenSimulator::will_impact(Event& e, const vector<pair<VectorN, Vect
   SAFESTATIC VectorN qx, qy;
 
   // get the bodies of the event
-  vector<DynamicBodyPtr> bodies;
-  e.get_super_bodies(std::back_inserter(bodies));
-  std::sort(bodies.begin(), bodies.end());
+  vector<bool> treated(_bodies.size(), false);
+  mark_treated_bodies(e, treated);
 
   // set the velocities of the bodies involved in the event
   for (unsigned i=0; i< _bodies.size(); i++)
   {
     // if the body is not involved in the event, skip it
-    if (!std::binary_search(bodies.begin(), bodies.end(), _bodies[i]))
+    if (!treated[i])
       continue;
 
     // set the velocity of the body
@@ -418,7 +426,7 @@ bool EventDrivenSimulator::will_impact(Event& e, const vector<pair<VectorN, Vect
   for (unsigned i=0; i< _bodies.size(); i++)
   {
     // if the body is not involved in the event, skip it
-    if (!std::binary_search(bodies.begin(), bodies.end(), _bodies[i]))
+    if (!treated[i])
       continue;
 
     // set the (interpolated) velocity of the body
@@ -469,53 +477,80 @@ Real EventDrivenSimulator::step(Real step_size)
   // setup the amount remaining to step
   Real dt = step_size;
 
+  // setup the deadline for the step
+  step_budget_exceeded = false;
+  if (step_time_budget < INF)
+    _step_deadline = WallClock::now() + (double) step_time_budget;
+  else
+    _step_deadline = WallClock::never();
+
+  // start gathering solver statistics for the step
+  step_solver_stats.reset();
+
   // clear one-step visualization data
   #ifdef USE_OSG
   _transient_vdata->removeChildren(0, _transient_vdata->getNumChildren());
   #endif
   FILE_LOG(LOG_SIMULATOR) << "+stepping simulation from time: " << this->current_time << std::endl;
 
-  // methods below assume that coords/velocities of the bodies may be modified,
-  // so we need to take precautions to save/restore them as necessary
-  while (dt > (Real) 0.0)
+  // step, collecting the statistics of the solver calls made by this thread
+  // (and by the threads that it starts) for the step
   {
-    // get the current generalized coordinates and velocities
-    get_coords_and_velocities(q0);
-
-    // integrate the systems forward by dt
-    integrate(dt);
-
-    // save the current generalized coordinates and velocities
-    get_coords_and_velocities(q1);
-
-    // look for events in [0, dt], advance all bodies to the time of event,
-    // and handle the event(s)
-    bool Zeno = false;
-    Real t = find_and_handle_events(dt, q0, q1, Zeno);
-    if (t > dt)
-      break; // no event.. finish up
-    else if (Zeno) 
+    SolverStatsScope stats_scope(&step_solver_stats);
+
+    // methods below assume that coords/velocities of the bodies may be modified,
+    // so we need to take precautions to save/restore them as necessary
+    while (dt > (Real) 0.0)
     {
-      // move to time of designated Zeno point
-      Real h = std::min(max_Zeno_step, dt);
-      handle_Zeno_point(h, q0, q1);
-      t += h;
-      if (t > dt)    // don't want to accidentally step clock too far
-        t = dt;
-    }
+      // get the current generalized coordinates and velocities
+      get_coords_and_velocities(q0);
+
+      // integrate the systems forward by dt
+      integrate(dt);
+
+      // save the current generalized coordinates and velocities
+      get_coords_and_velocities(q1);
+
+      // look for events in [0, dt], advance all bodies to the time of event,
+      // and handle the event(s)
+      bool Zeno = false;
+      Real t = find_and_handle_events(dt, q0, q1, Zeno);
+      if (t > dt)
+        break; // no event.. finish up
+      else if (Zeno) 
+      {
+        // move to time of designated Zeno point
+        Real h = std::min(max_Zeno_step, dt);
+        handle_Zeno_point(h, q0, q1);
+        t += h;
+        if (t > dt)    // don't want to accidentally step clock too far
+          t = dt;
+      }
 
-    // events have been handled already; reduce dt and keep integrating
-    dt -= t;
-    current_time += t;
+      // events have been handled already; reduce dt and keep integrating
+      dt -= t;
+      current_time += t;
 
-    // call the mini-callback
-    if (post_mini_step_callback_fn)
-      post_mini_step_callback_fn(this);
+      // call the mini-callback
+      if (post_mini_step_callback_fn)
+        post_mini_step_callback_fn(this);
+    }
   }
 
   // update the current time
   current_time += dt;
 
+  // accumulate the solver statistics for the step
+  total_solver_stats += step_solver_stats;
+  FILE_LOG(LOG_SIMULATOR) << " -- solver statistics for step: " << std::endl << step_solver_stats;
+
+  // record whether the time budget was exhausted
+  if (step_budget_exceeded)
+  {
+    FILE_LOG(LOG_SIMULATOR) << " -- time budget for event handling exhausted during step" << std::endl;
+    num_budget_exceeded_steps++;
+  }
+
   // call the callback 
   if (post_step_callback_fn)
     post_step_callback_fn(this);
@@ -544,13 +579,9 @@ void EventDrivenSimulator::handle_Zeno_point(Real dt, const vector<pair<VectorN,
   FILE_LOG(LOG_SIMULATOR) << "Zeno point detected! handling it..." << endl;
 
   // determine treated bodies for all events
-  vector<DynamicBodyPtr> treated_bodies;
+  vector<bool> treated(_bodies.size(), false);
   for (unsigned i=0; i< _events.size(); i++)
-    _events[i].get_super_bodies(std::back_inserter(treated_bodies));
-
-  // remove duplicates
-  std::sort(treated_bodies.begin(), treated_bodies.end());
-  treated_bodies.erase(std::unique(treated_bodies.begin(), treated_bodies.end()), treated_bodies.end());
+    mark_treated_bodies(_events[i], treated);
 
   // for each body in the simulator
   for (unsigned i=0; i< _bodies.size(); i++)
@@ -558,7 +589,7 @@ void EventDrivenSimulator::handle_Zeno_point(Real dt, const vector<pair<VectorN,
     // each Zeno body will already have the proper velocity; use that to 
     // update q1; non-Zeno bodies will be updated to their already determined
     // q1
-    if (std::binary_search(treated_bodies.begin(), treated_bodies.end(), _bodies[i]))
+    if (treated[i])
     {
       // get the body's current velocity (it was just treated) and use that to
       // update q1
@@ -570,20 +601,52 @@ void EventDrivenSimulator::handle_Zeno_point(Real dt, const vector<pair<VectorN,
   }
 }
 
-/// Determines (super) bodies treated in events
-void EventDrivenSimulator::determine_treated_bodies(list<list<Event*> >& groups, vector<DynamicBodyPtr>& bodies)
+/// Moves events from one vector to the end of another without copying them
+/**
+ * \param source the events to move; the vector is cleared on return
+ * \param dest the vector to which the events are appended
+ */
+void EventDrivenSimulator::move_events(vector<Event>& source, vector<Event>& dest)
 {
-  // clear the vector of bodies
-  bodies.clear();
+  if (dest.empty())
+    dest.swap(source);
+  else
+  {
+    const unsigned N = dest.size();
+    dest.resize(N + source.size());
+    for (unsigned i=0; i< source.size(); i++)
+      dest[N+i].swap(source[i]);
+  }
+  source.clear();
+}
+
+/// Marks the (super) bodies treated in an event
+/**
+ * \param e the event
+ * \param treated flags for the bodies in the simulator (indexed as in 
+ *        _bodies); the flags for the super bodies of e are set on return
+ */
+void EventDrivenSimulator::mark_treated_bodies(const Event& e, vector<bool>& treated) const
+{
+  SAFESTATIC vector<DynamicBodyPtr> bodies;
 
   // get the super bodies
-  BOOST_FOREACH(list<Event*>& l, groups)
-    BOOST_FOREACH(Event* e, l)
-      e->get_super_bodies(std::back_inserter(bodies));
+  bodies.clear();
+  e.get_super_bodies(std::back_inserter(bodies));
 
-  // sort the vector of bodies and remove duplicates
-  std::sort(bodies.begin(), bodies.end());
-  bodies.erase(std::unique(bodies.begin(), bodies.end()), bodies.end());
+  // mark them using their indices 
+  for (unsigned i=0; i< bodies.size(); i++)
+  {
+    const unsigned idx = bodies[i]->get_index();
+    if (idx < _bodies.size() && _bodies[idx] == bodies[i])
+      treated[idx] = true;
+    else
+    {
+      vector<DynamicBodyPtr>::const_iterator j = std::find(_bodies.begin(), _bodies.end(), bodies[i]);
+      if (j != _bodies.end())
+        treated[j - _bodies.begin()] = true;
+    }
+  }
 }
 
 /// Finds and handles first impacting event(s) in [0,dt]; returns time t in [0,dt] of first impacting event(s) and advances bodies' dynamics to time t
@@ -647,16 +710,16 @@ Real EventDrivenSimulator::find_and_handle_events(Real dt, const vector<pair<Vec
     cd->is_contact(dt, x0, x1, cd_events);
 
     // add to events
-    _events.insert(_events.end(), cd_events.begin(), cd_events.end());
+    move_events(cd_events, _events);
   }
 
   // check each articulated body for a joint limit event
   limit_events.clear();
   find_limit_events(q0, q1, dt, limit_events);
-  _events.insert(_events.end(), limit_events.begin(), limit_events.end());
+  move_events(limit_events, _events);
 
   // sort the set of events
-  std::sort(_events.begin(), _events.end()); 
+  Event::sort_events(_events);
 
   // set the "real" time for the events
   for (unsigned i=0; i< _events.size(); i++)
@@ -693,17 +756,13 @@ Real EventDrivenSimulator::find_and_handle_events(Real dt, const vector<pair<Vec
   if (Zeno)
   {
     // determine bodies in the events
-    vector<DynamicBodyPtr> treated_bodies;
+    vector<bool> treated(_bodies.size(), false);
     for (unsigned i=0; i< _events.size(); i++)
-      _events[i].get_super_bodies(std::back_inserter(treated_bodies));
-
-    // remove duplicates
-    std::sort(treated_bodies.begin(), treated_bodies.end());
-    treated_bodies.erase(std::unique(treated_bodies.begin(), treated_bodies.end()), treated_bodies.end());
+      mark_treated_bodies(_events[i], treated);
  
     // set velocities for bodies in events  
     for (unsigned i=0; i< _bodies.size(); i++)
-      if (std::binary_search(treated_bodies.begin(), treated_bodies.end(), _bodies[i]))
+      if (treated[i])
         _bodies[i]->set_generalized_velocity(DynamicBody::eRodrigues, q1[i].second);
   }
 
@@ -883,6 +942,51 @@ void EventDrivenSimulator::load_from_xml(XMLTreeConstPtr node, map<std::string,
   if (maxZeno_attrib)
     max_Zeno_step = maxZeno_attrib->get_real_value();
 
+  // get the impact solver options
+  const XMLAttrib* iter_attrib = node->get_attrib("use-iterative-impact-solver");
+  if (iter_attrib)
+    _impact_event_handler.use_iterative_solver = iter_attrib->get_bool_value();
+  const XMLAttrib* iter_max_attrib = node->get_attrib("iterative-impact-solver-max-iterations");
+  if (iter_max_attrib)
+    _impact_event_handler.iter_max_iterations = iter_max_attrib->get_unsigned_value();
+  const XMLAttrib* iter_eps_attrib = node->get_attrib("iterative-impact-solver-tolerance");
+  if (iter_eps_attrib)
+    _impact_event_handler.iter_eps = iter_eps_attrib->get_real_value();
+  const XMLAttrib* ip_attrib = node->get_attrib("use-ip-impact-solver");
+  if (ip_attrib)
+    _impact_event_handler.use_ip_solver = ip_attrib->get_bool_value();
+  const XMLAttrib* ip_max_attrib = node->get_attrib("ip-impact-solver-max-iterations");
+  if (ip_max_attrib)
+    _impact_event_handler.ip_max_iterations = ip_max_attrib->get_unsigned_value();
+  const XMLAttrib* ip_eps_attrib = node->get_attrib("ip-impact-solver-tolerance");
+  if (ip_eps_attrib)
+    _impact_event_handler.ip_eps = ip_eps_attrib->get_real_value();
+  const XMLAttrib* warm_attrib = node->get_attrib("impact-solver-warm-start");
+  if (warm_attrib)
+    _impact_event_handler.warm_start = warm_attrib->get_bool_value();
+  const XMLAttrib* warm_dist_attrib = node->get_attrib("impact-solver-warm-start-distance");
+  if (warm_dist_attrib)
+    _impact_event_handler.warm_start_dist = warm_dist_attrib->get_real_value();
+  const XMLAttrib* reuse_attrib = node->get_attrib("impact-solver-reuse-tolerance");
+  if (reuse_attrib)
+    _impact_event_handler.problem_data_reuse_tol = reuse_attrib->get_real_value();
+  const XMLAttrib* budget_attrib = node->get_attrib("impact-solver-time-budget");
+  if (budget_attrib)
+    _impact_event_handler.time_budget = budget_attrib->get_real_value();
+
+  // get the step time budget
+  const XMLAttrib* step_budget_attrib = node->get_attrib("step-time-budget");
+  if (step_budget_attrib)
+    step_time_budget = step_budget_attrib->get_real_value();
+
+  // get the files to which solved problems are captured
+  const XMLAttrib* impact_capture_attrib = node->get_attrib("impact-solver-capture-file");
+  if (impact_capture_attrib)
+    _impact_event_handler.capture_filename = impact_capture_attrib->get_string_value();
+  const XMLAttrib* lcp_capture_attrib = node->get_attrib("lcp-capture-file");
+  if (lcp_capture_attrib)
+    Optimization::capture_filename = lcp_capture_attrib->get_string_value();
+
   // get the collision detector, if specified
   const XMLAttrib* coldet_attrib = node->get_attrib("collision-detector-id");
   if (coldet_attrib)
@@ -965,6 +1069,27 @@ void EventDrivenSimulator::save_to_xml(XMLTreePtr node, list<BaseConstPtr>& shar
   // save the maximum Zeno step 
   node->attribs.insert(XMLAttrib("max-Zeno-step", max_Zeno_step));
 
+  // save the impact solver options
+  node->attribs.insert(XMLAttrib("use-iterative-impact-solver", _impact_event_handler.use_iterative_solver));
+  node->attribs.insert(XMLAttrib("iterative-impact-solver-max-iterations", _impact_event_handler.iter_max_iterations));
+  node->attribs.insert(XMLAttrib("iterative-impact-solver-tolerance", _impact_event_handler.iter_eps));
+  node->attribs.insert(XMLAttrib("use-ip-impact-solver", _impact_event_handler.use_ip_solver));
+  node->attribs.insert(XMLAttrib("ip-impact-solver-max-iterations", _impact_event_handler.ip_max_iterations));
+  node->attribs.insert(XMLAttrib("ip-impact-solver-tolerance", _impact_event_handler.ip_eps));
+  node->attribs.insert(XMLAttrib("impact-solver-warm-start", _impact_event_handler.warm_start));
+  node->attribs.insert(XMLAttrib("impact-solver-warm-start-distance", _impact_event_handler.warm_start_dist));
+  node->attribs.insert(XMLAttrib("impact-solver-reuse-tolerance", _impact_event_handler.problem_data_reuse_tol));
+  node->attribs.insert(XMLAttrib("impact-solver-time-budget", _impact_event_handler.time_budget));
+
+  // save the step time budget
+  node->attribs.insert(XMLAttrib("step-time-budget", step_time_budget));
+
+  // save the files to which solved problems are captured, if any
+  if (!_impact_event_handler.capture_filename.empty())
+    node->attribs.insert(XMLAttrib("impact-solver-capture-file", _impact_event_handler.capture_filename));
+  if (!Optimization::capture_filename.empty())
+    node->attribs.insert(XMLAttrib("lcp-capture-file", Optimization::capture_filename));
+
   // save the IDs of the collision detectors, if any 
   BOOST_FOREACH(shared_ptr<CollisionDetection> c, collision_detectors)
   {
@@ -0,0 +1,132 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#include <algorithm>
+#include <Moby/EventProblemData.h>
+
+using std::vector;
+using namespace Moby;
+
+/// Gets the index of a contact event in the list of contact events of a super body (or the size of the list, if the contact event does not involve the super body)
+static unsigned find_contact(const vector<unsigned>& contacts, unsigned i)
+{
+  vector<unsigned>::const_iterator j = std::lower_bound(contacts.begin(), contacts.end(), i);
+  return (j != contacts.end() && *j == i) ? j - contacts.begin() : contacts.size();
+}
+
+/// Sizes and zeros the contact blocks (one per super body)
+void EventProblemData::init_contact_blocks()
+{
+  contact_blocks.resize(super_bodies.size());
+  for (unsigned s=0; s< contact_blocks.size(); s++)
+  {
+    const unsigned NC = super_body_contacts[s].size();
+    contact_blocks[s].Jc_iM_JcT.set_zero(NC, NC);
+    contact_blocks[s].Jc_iM_DcT.set_zero(NC, NC*2);
+    contact_blocks[s].Dc_iM_DcT.set_zero(NC*2, NC*2);
+  }
+}
+
+/// Gets the entry of Jc*inv(M)*Jc' for contacts i and j
+Real EventProblemData::get_Jc_iM_JcT(unsigned i, unsigned j) const
+{
+  Real value = (Real) 0.0;
+  for (unsigned m=0; m< contact_block_entries[i].size(); m++)
+  {
+    const unsigned s = contact_block_entries[i][m].first;
+    const unsigned b = find_contact(super_body_contacts[s], j);
+    if (b < super_body_contacts[s].size())
+      value += contact_blocks[s].Jc_iM_JcT(contact_block_entries[i][m].second, b);
+  }
+
+  return value;
+}
+
+/// Gets the entry of Jc*inv(M)*Dc' for contact i and tangent direction l
+Real EventProblemData::get_Jc_iM_DcT(unsigned i, unsigned l) const
+{
+  Real value = (Real) 0.0;
+  for (unsigned m=0; m< contact_block_entries[i].size(); m++)
+  {
+    const unsigned s = contact_block_entries[i][m].first;
+    const unsigned b = find_contact(super_body_contacts[s], l/2);
+    if (b < super_body_contacts[s].size())
+      value += contact_blocks[s].Jc_iM_DcT(contact_block_entries[i][m].second, b*2 + l%2);
+  }
+
+  return value;
+}
+
+/// Gets the entry of Dc*inv(M)*Dc' for tangent directions k and l
+Real EventProblemData::get_Dc_iM_DcT(unsigned k, unsigned l) const
+{
+  const unsigned i = k/2;
+  Real value = (Real) 0.0;
+  for (unsigned m=0; m< contact_block_entries[i].size(); m++)
+  {
+    const unsigned s = contact_block_entries[i][m].first;
+    const unsigned b = find_contact(super_body_contacts[s], l/2);
+    if (b < super_body_contacts[s].size())
+      value += contact_blocks[s].Dc_iM_DcT(contact_block_entries[i][m].second*2 + k%2, b*2 + l%2);
+  }
+
+  return value;
+}
+
+/// Adds the velocity changes due to contact impulses to the contact velocities
+/**
+ * Computes Jc_v += Jc*inv(M)*Jc'*alpha_c + Jc*inv(M)*Dc'*beta_c and
+ * Dc_v += Dc*inv(M)*Jc'*alpha_c + Dc*inv(M)*Dc'*beta_c, using only the
+ * contact blocks.
+ */
+void EventProblemData::add_contact_velocity_changes(const VectorN& alpha_c, const VectorN& beta_c, VectorN& Jc_v, VectorN& Dc_v) const
+{
+  for (unsigned s=0; s< contact_blocks.size(); s++)
+  {
+    const vector<unsigned>& contacts = super_body_contacts[s];
+    const ContactBlock& block = contact_blocks[s];
+    for (unsigned b=0; b< contacts.size(); b++)
+    {
+      const unsigned j = contacts[b];
+      const Real AJ = alpha_c[j];
+      const Real BJ[2] = { beta_c[j*2], beta_c[j*2+1] };
+      for (unsigned a=0; a< contacts.size(); a++)
+      {
+        const unsigned i = contacts[a];
+        Jc_v[i] += block.Jc_iM_JcT(a,b)*AJ + block.Jc_iM_DcT(a,b*2)*BJ[0] + block.Jc_iM_DcT(a,b*2+1)*BJ[1];
+        for (unsigned t=0; t< 2; t++)
+          Dc_v[i*2+t] += block.Jc_iM_DcT(b,a*2+t)*AJ + block.Dc_iM_DcT(a*2+t,b*2)*BJ[0] + block.Dc_iM_DcT(a*2+t,b*2+1)*BJ[1];
+      }
+    }
+  }
+}
+
+/// Assembles the dense contact-contact cross-event terms from the contact blocks
+void EventProblemData::get_contact_terms(MatrixN& Jc_iM_JcT, MatrixN& Jc_iM_DcT, MatrixN& Dc_iM_DcT) const
+{
+  const unsigned NC = contact_events.size();
+  Jc_iM_JcT.set_zero(NC, NC);
+  Jc_iM_DcT.set_zero(NC, NC*2);
+  Dc_iM_DcT.set_zero(NC*2, NC*2);
+  for (unsigned s=0; s< contact_blocks.size(); s++)
+  {
+    const vector<unsigned>& contacts = super_body_contacts[s];
+    const ContactBlock& block = contact_blocks[s];
+    for (unsigned b=0; b< contacts.size(); b++)
+      for (unsigned a=0; a< contacts.size(); a++)
+      {
+        const unsigned i = contacts[a], j = contacts[b];
+        Jc_iM_JcT(i,j) += block.Jc_iM_JcT(a,b);
+        Jc_iM_DcT(i,j*2) += block.Jc_iM_DcT(a,b*2);
+        Jc_iM_DcT(i,j*2+1) += block.Jc_iM_DcT(a,b*2+1);
+        Dc_iM_DcT(i*2,j*2) += block.Dc_iM_DcT(a*2,b*2);
+        Dc_iM_DcT(i*2,j*2+1) += block.Dc_iM_DcT(a*2,b*2+1);
+        Dc_iM_DcT(i*2+1,j*2) += block.Dc_iM_DcT(a*2+1,b*2);
+        Dc_iM_DcT(i*2+1,j*2+1) += block.Dc_iM_DcT(a*2+1,b*2+1);
+      }
+  }
+}
+
@@ -18,6 +18,7 @@
 #include <Moby/Joint.h>
 #include <Moby/NumericalException.h>
 #include <Moby/FSABAlgorithm.h>
+#include <Moby/SMatrix6K.h>
 #include <Moby/FastThreadable.h>
 
 using namespace Moby;
@@ -672,11 +673,109 @@ void FSABAlgorithm::calc_spatial_coriolis_vectors(RCArticulatedBodyPtr body, Ref
   }
 }
 
+/// Computes I*s, the factorization of s'*I*s, and the articulated body inertia propagated to the parent using fixed-size arithmetic
+/**
+ * \param I the articulated body inertia of the link
+ * \param s the spatial axes of the link's inner joint (K columns)
+ * \param Is_out on return, contains I*s
+ * \param sIs_out on return, contains the Cholesky factorization of s'*I*s
+ * \param uI on return, contains I - I*s*inv(s'*I*s)*s'*I
+ * \return <b>false</b> if s'*I*s is not positive definite (nothing is
+ *         stored in that case)
+ */
+template <unsigned K>
+static bool calc_spatial_inertia_fixed(const SpatialABInertia& I, const SMatrix6N& s, SMatrix6N& Is_out, MatrixN& sIs_out, SpatialABInertia& uI)
+{
+  SMatrix6K<K> sK, Is, IsinvsIs;
+  MatrixK<K> sIs;
+  VectorK<K> x;
+
+  // compute Is and sIs
+  sK.set(s);
+  SMatrix6K<K>::mult(I, sK, Is);
+  sK.transpose_mult(Is, sIs);
+
+  // factorize sIs
+  if (!sIs.factor_chol())
+    return false;
+
+  // store Is and the factorization
+  Is.get(Is_out);
+  sIs.get(sIs_out);
+
+  // compute Is*inv(sIs) one row at a time (sIs is symmetric)
+  for (unsigned i=0; i< 6; i++)
+  {
+    for (unsigned j=0; j< K; j++)
+      x[j] = Is(i,j);
+    sIs.solve_chol_fast(x);
+    for (unsigned j=0; j< K; j++)
+      IsinvsIs(i,j) = x[j];
+  }
+
+  // compute the inertia to propagate to the parent
+  uI = I - SMatrix6K<K>::mult_transpose(IsinvsIs, Is);
+  return true;
+}
+
+/// Computes the qm subexpression and the zero acceleration propagated to the parent using fixed-size arithmetic
+/**
+ * \param Q the (scaled) joint force plus the feedforward force
+ * \param mu_out on return, contains Q - Is'*c - s'*Z
+ * \return Z + I*c + Is*inv(sIs)*mu
+ */
+template <unsigned K>
+static SVector6 calc_spatial_zero_acceleration_fixed(const SpatialABInertia& I, const SMatrix6N& s, const SMatrix6N& Is_in, const MatrixN& sIs_in, const SVector6& c, const SVector6& Z, const VectorN& Q, VectorN& mu_out)
+{
+  SMatrix6K<K> sK, Is;
+  MatrixK<K> sIs;
+  VectorK<K> mu, tmp;
+
+  // compute the qm subexpression
+  sK.set(s);
+  Is.set(Is_in);
+  mu.set(Q);
+  mu -= Is.transpose_mult(c, tmp);
+  mu -= sK.transpose_mult(Z, tmp);
+  mu.get(mu_out);
+
+  // compute the zero acceleration to propagate to the parent 
+  sIs.set(sIs_in);
+  sIs.solve_chol_fast(mu);
+  return Z + (I*c) + Is.mult(mu);
+}
+
+/// Computes joint accelerations and the spatial acceleration of a link (less the s_dot*qd term) using fixed-size arithmetic
+/**
+ * \param aim1 the parent link acceleration (in the link's frame)
+ * \param qdd on return, contains the joint accelerations
+ * \return aim1 + c + s*qdd
+ */
+template <unsigned K>
+static SVector6 calc_spatial_acceleration_fixed(const SMatrix6N& s, const SMatrix6N& Is_in, const MatrixN& sIs_in, const VectorN& mu, const SVector6& aim1, const SVector6& c, VectorN& qdd)
+{
+  SMatrix6K<K> sK, Is;
+  MatrixK<K> sIs;
+  VectorK<K> x, tmp;
+
+  // compute the joint accelerations
+  Is.set(Is_in);
+  x.set(mu);
+  x -= Is.transpose_mult(aim1, tmp);
+  sIs.set(sIs_in);
+  sIs.solve_chol_fast(x);
+  x.get(qdd);
+
+  // compute the link acceleration
+  sK.set(s);
+  return aim1 + c + sK.mult(x);
+}
+
 /// Computes articulated body zero acceleration forces used for computing forward dynamics
 void FSABAlgorithm::calc_spatial_zero_accelerations(RCArticulatedBodyPtr body, ReferenceFrameType rftype)
 {
-  VectorN Q, sIsmu, tmp, tmp2;
-  queue<RigidBodyPtr> link_queue;
+  SAFESTATIC FastThreadable<VectorN> Q, sIsmu, tmp, tmp2;
+  SAFESTATIC FastThreadable<std::priority_queue<unsigned> > link_pqueue_x;
 
   FILE_LOG(LOG_DYNAMICS) << "calc_spatial_zero_accelerations() entered" << endl;
 
@@ -737,7 +836,9 @@ void FSABAlgorithm::calc_spatial_zero_accelerations(RCArticulatedBodyPtr body, R
     body->_processed[i] = false; 
 
   // doing a recursion backward from the end-effectors; add all leaf links to the link_queue
-  std::priority_queue<unsigned> link_pqueue;
+  std::priority_queue<unsigned>& link_pqueue = link_pqueue_x();
+  while (!link_pqueue.empty())
+    link_pqueue.pop();
   for (unsigned i=0; i< links.size(); i++)
     if (!links[i]->is_base() && links[i]->num_child_links() == 0)
       link_pqueue.push(i);
@@ -776,16 +877,36 @@ void FSABAlgorithm::calc_spatial_zero_accelerations(RCArticulatedBodyPtr body, R
     const SVector6& c = _c[idx];
     const SVector6& Z = _Z[idx];
     
-    // compute the qm subexpression
-    joint->get_scaled_force(Q);
-    Q += joint->ff;
-    _mu[idx].copy_from(Q);
-    _mu[idx] -= _Is[idx].transpose_mult(_c[idx], tmp);
-    _mu[idx] -= s.transpose_mult(Z, tmp2);
-
     // get Is
     const SMatrix6N& Is = _Is[idx];
 
+    // compute the qm subexpression and the zero acceleration to propagate to
+    // the parent; the fixed-size kernels are used when sIs is factorized 
+    joint->get_scaled_force(Q());
+    Q() += joint->ff;
+    SVector6 uZ;
+    switch (_rank_deficient[idx] ? 0 : s.columns())
+    {
+      case 1:
+        uZ = calc_spatial_zero_acceleration_fixed<1>(I, s, Is, _sIs[idx], c, Z, Q(), _mu[idx]);
+        break;
+
+      case 2:
+        uZ = calc_spatial_zero_acceleration_fixed<2>(I, s, Is, _sIs[idx], c, Z, Q(), _mu[idx]);
+        break;
+
+      case 3:
+        uZ = calc_spatial_zero_acceleration_fixed<3>(I, s, Is, _sIs[idx], c, Z, Q(), _mu[idx]);
+        break;
+
+      default:
+        _mu[idx].copy_from(Q());
+        _mu[idx] -= Is.transpose_mult(c, tmp());
+        _mu[idx] -= s.transpose_mult(Z, tmp2());
+        solve_sIs(idx, _mu[idx], sIsmu());
+        uZ = Z + (I*c) + Is.mult(sIsmu());
+    }
+
     // get the qm subexpression
     const VectorN& mu = _mu[idx];
   
@@ -802,10 +923,6 @@ void FSABAlgorithm::calc_spatial_zero_accelerations(RCArticulatedBodyPtr body, R
     if (!body->is_floating_base() && parent->is_base())
       continue;
  
-    // compute a couple of necessary matrices
-    solve_sIs(idx, mu, sIsmu);
-    SVector6 uZ = Z + (I*c) + Is.mult(sIsmu);
-
     // get the parent current zero acceleration and inertia
     SVector6& Zim1 = _Z[pidx];
 
@@ -842,8 +959,9 @@ void FSABAlgorithm::calc_spatial_zero_accelerations(RCArticulatedBodyPtr body, R
 /// Computes articulated body inertias used for computing forward dynamics
 void FSABAlgorithm::calc_spatial_inertias(RCArticulatedBodyPtr body, ReferenceFrameType rftype)
 {
-  SMatrix6N tmp;
-  MatrixN sIss;
+  SAFESTATIC FastThreadable<SMatrix6N> tmp;
+  SAFESTATIC FastThreadable<MatrixN> sIss;
+  SAFESTATIC FastThreadable<std::priority_queue<unsigned> > link_pqueue_x;
 
   FILE_LOG(LOG_DYNAMICS) << "calc_spatial_zero_accelerations() entered" << endl;
 
@@ -886,7 +1004,9 @@ void FSABAlgorithm::calc_spatial_inertias(RCArticulatedBodyPtr body, ReferenceFr
     body->_processed[i] = false;
  
   // doing a recursion backward from the end-effectors; add all leaf links to the link_queue
-  std::priority_queue<unsigned> link_pqueue;
+  std::priority_queue<unsigned>& link_pqueue = link_pqueue_x();
+  while (!link_pqueue.empty())
+    link_pqueue.pop();
   for (unsigned i=0; i< links.size(); i++)
     if (!links[i]->is_base() && links[i]->num_child_links() == 0)
       link_pqueue.push(i);
@@ -925,31 +1045,57 @@ FILE_LOG(LOG_DYNAMICS) << "added link " << parent->id << " to queue for processi
 
     // get I
     const SpatialABInertia& I = _I[idx];
-    
-    // compute Is
-    I.mult(s, _Is[idx]);
-
-    // compute sIs
-    s.transpose_mult(_Is[idx], _sIs[idx]);
 
     // get whether s is rank deficient
     _rank_deficient[idx] = joint->is_singular_config();
 
-    // if the joint is not rank deficient, compute a Cholesky factorization 
-    // of sIs
-    if (!_rank_deficient[idx])
-      LinAlg::factor_chol(_sIs[idx]);
-    else
+    // compute Is, the Cholesky factorization of sIs, and the inertia to
+    // propagate to the parent using the fixed-size kernels, if possible
+    SpatialABInertia uI;
+    bool fixed = false;
+    switch (_rank_deficient[idx] ? 0 : s.columns())
     {
-      try
-      {
-        LinAlg::pseudo_inverse(_sIs[idx], LinAlg::svd1);
-      }
-      catch (NumericalException e)
+      case 1:
+        fixed = calc_spatial_inertia_fixed<1>(I, s, _Is[idx], _sIs[idx], uI);
+        break;
+
+      case 2:
+        fixed = calc_spatial_inertia_fixed<2>(I, s, _Is[idx], _sIs[idx], uI);
+        break;
+
+      case 3:
+        fixed = calc_spatial_inertia_fixed<3>(I, s, _Is[idx], _sIs[idx], uI);
+        break;
+    }
+
+    if (!fixed)
+    {
+      // compute Is
+      I.mult(s, _Is[idx]);
+
+      // compute sIs
+      s.transpose_mult(_Is[idx], _sIs[idx]);
+
+      // if the joint is not rank deficient, compute a Cholesky factorization 
+      // of sIs
+      if (!_rank_deficient[idx])
+        LinAlg::factor_chol(_sIs[idx]);
+      else
       {
-        s.transpose_mult(_Is[idx], _sIs[idx]);
-        LinAlg::pseudo_inverse(_sIs[idx], LinAlg::svd2);
+        try
+        {
+          LinAlg::pseudo_inverse(_sIs[idx], LinAlg::svd1);
+        }
+        catch (NumericalException e)
+        {
+          s.transpose_mult(_Is[idx], _sIs[idx]);
+          LinAlg::pseudo_inverse(_sIs[idx], LinAlg::svd2);
+        }
       }
+
+      // compute the inertia to propagate to the parent
+      transpose_solve_sIs(idx, s, sIss());
+      uI = I - SpatialABInertia::mult(_Is[idx].mult(sIss(), tmp()), I);
     }
 
     // get Is
@@ -965,10 +1111,6 @@ FILE_LOG(LOG_DYNAMICS) << "added link " << parent->id << " to queue for processi
     if (!body->is_floating_base() && parent->is_base())
       continue;
  
-    // compute a couple of necessary matrices
-    transpose_solve_sIs(idx, s, sIss);
-    SpatialABInertia uI = I - SpatialABInertia::mult(Is.mult(sIss, tmp), I);
-
     // get the parent current zero acceleration and inertia
     SpatialABInertia& Iim1 = _I[pidx];
 
@@ -998,9 +1140,8 @@ FILE_LOG(LOG_DYNAMICS) << "added link " << parent->id << " to queue for processi
 /// Computes joint and spatial link accelerations 
 void FSABAlgorithm::calc_spatial_accelerations(RCArticulatedBodyPtr body, ReferenceFrameType rftype)
 {
-  queue<RigidBodyPtr> link_queue;
-  VectorN result;
-  SVector6 tmp, tmp2;
+  SAFESTATIC FastThreadable<vector<unsigned> > link_queue_x;
+  SAFESTATIC FastThreadable<VectorN> result;
 
   // get the links
   const vector<RigidBodyPtr>& links = body->get_links();
@@ -1031,16 +1172,18 @@ void FSABAlgorithm::calc_spatial_accelerations(RCArticulatedBodyPtr body, Refere
   // compute joint accelerations
   // *****************************************************************
 
-  // add all children of the base to the link queue
+  // add all children of the base to the link queue (the queue is a vector
+  // of link indices, so that its storage persists between calls)
+  vector<unsigned>& link_queue = link_queue_x();
+  link_queue.clear();
   push_children(base, link_queue);
 
   // process all links for forward recursion
-  while (!link_queue.empty())
+  for (unsigned k=0; k< link_queue.size(); k++)
   {
     // get the link off of the front of the queue 
-    RigidBodyPtr link = link_queue.front();
-    link_queue.pop();
-    unsigned idx = link->get_index();
+    unsigned idx = link_queue[k];
+    RigidBodyPtr link = links[idx];
 
     // push all children of the link onto the queue
     push_children(link, link_queue);
@@ -1068,14 +1211,29 @@ void FSABAlgorithm::calc_spatial_accelerations(RCArticulatedBodyPtr body, Refere
     const VectorN& mu = _mu[idx];    
     const SVector6& c = _c[idx];
 
-    // compute joint i acceleration
-    Is.transpose_mult(aim1, result);
-    result.negate();
-    result += mu;
-    solve_sIs(idx, result, joint->qdd);
-    
-    // compute link i spatial acceleration
-    _a[idx] = aim1 + c + s_dot.mult(joint->qd) + s.mult(joint->qdd);
+    // compute joint i acceleration and link i spatial acceleration
+    switch (_rank_deficient[idx] ? 0 : s.columns())
+    {
+      case 1:
+        _a[idx] = calc_spatial_acceleration_fixed<1>(s, Is, _sIs[idx], mu, aim1, c, joint->qdd);
+        break;
+
+      case 2:
+        _a[idx] = calc_spatial_acceleration_fixed<2>(s, Is, _sIs[idx], mu, aim1, c, joint->qdd);
+        break;
+
+      case 3:
+        _a[idx] = calc_spatial_acceleration_fixed<3>(s, Is, _sIs[idx], mu, aim1, c, joint->qdd);
+        break;
+
+      default:
+        Is.transpose_mult(aim1, result());
+        result().negate();
+        result() += mu;
+        solve_sIs(idx, result(), joint->qdd);
+        _a[idx] = aim1 + c + s.mult(joint->qdd);
+    }
+    _a[idx] += s_dot.mult(joint->qd);
     link->set_spatial_accel(_a[idx], rftype);
 
     FILE_LOG(LOG_DYNAMICS) << endl << endl << "  *** Forward recursion processing link " << link->id << endl;  
@@ -1198,6 +1356,17 @@ void FSABAlgorithm::push_children(RigidBodyPtr link, queue<RigidBodyPtr>& q)
   }
 }
 
+/// Pushes the indices of all children of the given link onto the back of the given vector 
+void FSABAlgorithm::push_children(RigidBodyPtr link, vector<unsigned>& q)
+{
+  const list<RigidBody::OuterJointData>& ojd_list = link->get_outer_joints_data();
+  BOOST_FOREACH(const RigidBody::OuterJointData& ojd, ojd_list)
+  {
+    RigidBodyPtr child(ojd.child);
+    q.push_back(child->get_index());
+  }
+}
+
 /// Computes necessary vectors to apply impulses to an articulated body
 /**
  * Featherstone Algorithm taken from Mirtich's thesis (p. 113).  Note that Mirtich's numbering is a little funny;
@@ -287,9 +287,15 @@ bool GeneralizedCCD::is_contact(Real dt, const vector<pair<DynamicBodyPtr, Vecto
     check_geoms(dt, a, b, aTb, bTa, a_vel, b_vel, events[i]);
   } 
 
-  // integrate all contacts into a single structure 
+  // integrate all contacts into a single structure (swapping, not copying,
+  // the events)
   for (unsigned i=0; i< events.size(); i++)
-    contacts.insert(contacts.end(), events[i].begin(), events[i].end());
+  {
+    const unsigned N = contacts.size();
+    contacts.resize(N + events[i].size());
+    for (unsigned j=0; j< events[i].size(); j++)
+      contacts[N+j].swap(events[i][j]);
+  }
 
   FILE_LOG(LOG_COLDET) << "contacts:" << endl;
   if (contacts.empty())
@@ -468,7 +474,7 @@ void GeneralizedCCD::check_geoms(Real dt, CollisionGeometryPtr a, CollisionGeome
   const Real TOI_TOLERANCE = std::numeric_limits<Real>::epsilon();
 
   // sort the vector of contacts
-  std::sort(local_contacts.begin(), local_contacts.end());
+  Event::sort_events(local_contacts);
 
   // see what points to insert into the global set of contacts 
   // we return all contacts if using an event-driven method to deal with Zeno
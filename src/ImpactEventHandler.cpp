@@ -10,6 +10,12 @@
 #include <set>
 #include <cmath>
 #include <numeric>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#ifdef THREADED
+#include <unistd.h>
+#endif
 #include <Moby/ArticulatedBody.h>
 #include <Moby/Constants.h>
 #include <Moby/Event.h>
@@ -20,7 +26,11 @@
 #include <Moby/Log.h>
 #include <Moby/XMLTree.h>
 #include <Moby/Optimization.h>
+#include <Moby/SparseLDL.h>
+#include <Moby/SparseMatrixN.h>
 #include <Moby/NumericalException.h>
+#include <Moby/ProblemCapture.h>
+#include <Moby/WallClock.h>
 #include <Moby/ImpactEventHandler.h>
 
 using namespace Moby;
@@ -40,11 +50,42 @@ ImpactEventHandler::ImpactEventHandler()
   ip_max_iterations = 100;
   ip_eps = 1e-6;
   use_ip_solver = false;
+  iter_max_iterations = 100;
+  iter_eps = 1e-6;
+  use_iterative_solver = false;
+  warm_start = true;
+  warm_start_dist = 1e-2;
+  problem_data_reuse_tol = NEAR_ZERO;
   poisson_eps = NEAR_ZERO;
+  time_budget = std::numeric_limits<Real>::max();
+  budget_exceeded = false;
+  num_truncated_solves = num_skipped_solves = 0;
+  _deadline = WallClock::never();
+
+  // use one thread per processor, if possible
+  #ifdef THREADED
+  long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+  max_threads = (nprocs > 0) ? (unsigned) nprocs : 1;
+  #else
+  max_threads = 1;
+  #endif
 }
 
 // Processes impacts
 void ImpactEventHandler::process_events(const vector<Event>& events, Real tol)
+{
+  process_events(events, tol, WallClock::never());
+}
+
+/// Processes impacts, computing impulses no later than the given deadline
+/**
+ * \param events the events to process
+ * \param tol the tolerance for the event model
+ * \param deadline the time (see WallClock) by which impulses must be 
+ *        computed; the earlier of this and the end of the time budget 
+ *        (see time_budget) is used
+ */
+void ImpactEventHandler::process_events(const vector<Event>& events, Real tol, double deadline)
 {
   FILE_LOG(LOG_CONTACT) << "*************************************************************";
   FILE_LOG(LOG_CONTACT) << endl;
@@ -53,13 +94,17 @@ void ImpactEventHandler::process_events(const vector<Event>& events, Real tol)
   FILE_LOG(LOG_CONTACT) << "*************************************************************";
   FILE_LOG(LOG_CONTACT) << endl;
 
-  // apply the method to all contacts
+  // setup the deadline for computing impulses
+  budget_exceeded = false;
+  num_truncated_solves = num_skipped_solves = 0;
+  _deadline = deadline;
+  if (time_budget < std::numeric_limits<Real>::max())
+    _deadline = std::min(_deadline, WallClock::now() + (double) time_budget);
+
+  // apply the method to all contacts (this also saves the contacts for 
+  // warm starting the next call)
   if (!events.empty())
-  {
-    vector<Event> nev;
-    nev.push_back(events.front());
     apply_model(events, tol);
-  }
   else
     FILE_LOG(LOG_CONTACT) << " (no events?!)" << endl;
     
@@ -71,8 +116,11 @@ void ImpactEventHandler::process_events(const vector<Event>& events, Real tol)
 /// Applies the model to a set of events 
 /**
  * \param events a set of events
+ * Groups of connected events are independent (they share no super bodies), so
+ * in a threadsafe build they are solved concurrently by up to max_threads
+ * threads.
  */
-void ImpactEventHandler::apply_model(const vector<Event>& events, Real tol) const
+void ImpactEventHandler::apply_model(const vector<Event>& events, Real tol)
 {
   // **********************************************************
   // determine sets of connected events 
@@ -82,68 +130,223 @@ void ImpactEventHandler::apply_model(const vector<Event>& events, Real tol) cons
   Event::remove_nonimpacting_groups(groups, tol);
 
   // **********************************************************
-  // do method for each connected set 
+  // prepare each connected set (serially; contact set reduction relies on
+  // code that is not re-entrant)
   // **********************************************************
+  GroupQueue queue;
+  queue.handler = this;
+  queue.problem_data = &_problem_data;
+  queue.next = 0;
+  queue.stats_collector = SolverStats::get_collector();
+  match_cached_contacts(groups);
   for (list<list<Event*> >::iterator i = groups.begin(); i != groups.end(); i++)
   {
-    // determine contact tangents
+    // determine contact tangents (persistent contacts keep their tangents)
     for (list<Event*>::iterator j = i->begin(); j != i->end(); j++)
       if ((*j)->event_type == Event::eContact)
-        (*j)->determine_contact_tangents();
-//    list<Event*>& revents = *i;
-    list<Event*> revents = *i;
+        determine_contact_tangents(**j);
 
-    FILE_LOG(LOG_CONTACT) << " -- post-event velocity (all events): " << std::endl;
+    FILE_LOG(LOG_CONTACT) << " -- pre-event velocity (all events): " << std::endl;
     for (list<Event*>::iterator j = i->begin(); j != i->end(); j++)
       FILE_LOG(LOG_CONTACT) << "    event: " << std::endl << **j;
 
     // determine a reduced set of events
-    Event::determine_minimal_set(revents);
+    queue.groups.push_back(&*i);
+    queue.reduced.push_back(*i);
+    Event::determine_minimal_set(queue.reduced.back());
+  }
+
+  // each group keeps its own problem data, so that the data of the group 
+  // solved in the same position by the last call can be reused
+  if (_problem_data.size() < queue.groups.size())
+    _problem_data.resize(queue.groups.size());
+
+  // **********************************************************
+  // do method for each connected set 
+  // **********************************************************
+  #ifdef THREADED
+  const unsigned NTHREADS = std::min(max_threads, (unsigned) queue.groups.size());
+  if (NTHREADS > 1)
+  {
+    FILE_LOG(LOG_CONTACT) << " -- solving " << queue.groups.size() << " groups using " << NTHREADS << " threads" << endl;
+
+    // start the threads
+    pthread_mutex_init(&queue.mutex, NULL);
+    vector<pthread_t> threads(NTHREADS);
+    unsigned nstarted = 0;
+    for (; nstarted < NTHREADS; nstarted++)
+      if (pthread_create(&threads[nstarted], NULL, &solve_groups, &queue) != 0)
+        break;
+
+    // if no threads could be started, solve the groups in this thread
+    if (nstarted == 0)
+      solve_groups(&queue);
+
+    // wait for the threads to finish
+    for (unsigned i=0; i< nstarted; i++)
+      pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&queue.mutex);
+
+    // report any error
+    if (!queue.error.empty())
+      throw std::runtime_error(queue.error);
+  }
+  else
+  #endif
+  {
+    // solve the groups one after another
+    for (unsigned i=0; i< queue.groups.size(); i++)
+      apply_model_to_group(*queue.groups[i], queue.reduced[i], _problem_data[i]);
+  }
+
+  // count the solves affected by the time budget
+  for (unsigned i=0; i< queue.groups.size(); i++)
+  {
+    num_truncated_solves += _problem_data[i].n_truncated_solves;
+    num_skipped_solves += _problem_data[i].n_skipped_solves;
+  }
+  budget_exceeded = (num_truncated_solves > 0 || num_skipped_solves > 0);
+  if (budget_exceeded)
+    FILE_LOG(LOG_CONTACT) << " -- time budget exhausted: " << num_truncated_solves << " solves stopped early, " << num_skipped_solves << " skipped" << endl;
+
+  // save the solved contacts for warm starting the next call
+  save_contact_cache(queue.reduced);
+}
+
+/// Determines whether the deadline for computing impulses for a problem has passed
+bool ImpactEventHandler::deadline_passed(const EventProblemData& epd)
+{
+  return epd.deadline < WallClock::never() && WallClock::now() > epd.deadline;
+}
+
+/// Termination check for Lemke's algorithm: stops it once the deadline for the problem (an EventProblemData) has passed
+bool ImpactEventHandler::lemke_tcheck(void* data)
+{
+  return deadline_passed(*(const EventProblemData*) data);
+}
+
+/// Solves groups of connected events from a queue until the queue is empty
+/**
+ * \param arg a pointer to the GroupQueue
+ * \return NULL
+ */
+void* ImpactEventHandler::solve_groups(void* arg)
+{
+  GroupQueue& queue = *(GroupQueue*) arg;
+
+  // record solver statistics where the thread that filled the queue does
+  SolverStatsScope stats_scope(queue.stats_collector);
+
+  while (true)
+  {
+    // get the next group
+    #ifdef THREADED
+    pthread_mutex_lock(&queue.mutex);
+    #endif
+    const unsigned i = queue.next++;
+    #ifdef THREADED
+    pthread_mutex_unlock(&queue.mutex);
+    #endif
+    if (i >= queue.groups.size())
+      break;
+
+    // solve the group; exceptions must not propagate out of the thread
+    try
+    {
+      queue.handler->apply_model_to_group(*queue.groups[i], queue.reduced[i], (*queue.problem_data)[i]);
+    }
+    catch (std::exception& e)
+    {
+      #ifdef THREADED
+      pthread_mutex_lock(&queue.mutex);
+      #endif
+      if (queue.error.empty())
+        queue.error = e.what();
+      #ifdef THREADED
+      pthread_mutex_unlock(&queue.mutex);
+      #endif
+    }
+  }
+
+  return NULL;
+}
+
+/// Applies the model to a single group of connected events
+/**
+ * \param group the connected events
+ * \param reduced the reduced set of events for the group; on return, the 
+ *        events whose impulses were computed last (the whole group, if it
+ *        had to be solved as well)
+ * \param epd problem data storage used for solving the group
+ */
+void ImpactEventHandler::apply_model_to_group(list<Event*>& group, list<Event*>& reduced, EventProblemData& epd) const
+{
+  // setup the deadline
+  epd.deadline = _deadline;
+  epd.n_truncated_solves = epd.n_skipped_solves = 0;
 
-    // apply model to the reduced contacts   
-    apply_model_to_connected_events(revents);
+  // apply model to the reduced contacts   
+  apply_model_to_connected_events(reduced, epd);
 
 ///*
 // check the minimum event velocity
 Real minvel = (Real) 0.0;
-for (list<Event*>::const_iterator j = i->begin(); j != i->end(); j++)
+for (list<Event*>::const_iterator j = group.begin(); j != group.end(); j++)
   minvel = std::min(minvel, (*j)->calc_event_vel());
 if (minvel < -1e-5)
 {
-  apply_model_to_connected_events(*i);
+  if (deadline_passed(epd))
+    epd.n_skipped_solves++;
+  else
+  {
+    apply_model_to_connected_events(group, epd);
+    reduced = group;
+  }
 std::cerr << "Invalid contact state detected!" << std::endl;
 //  exit(0);
 }
 //*/
-    FILE_LOG(LOG_CONTACT) << " -- post-event velocity (all events): " << std::endl;
-    for (list<Event*>::iterator j = i->begin(); j != i->end(); j++)
-      FILE_LOG(LOG_CONTACT) << "    event: " << std::endl << **j;
-  }
+  FILE_LOG(LOG_CONTACT) << " -- post-event velocity (all events): " << std::endl;
+  for (list<Event*>::iterator j = group.begin(); j != group.end(); j++)
+    FILE_LOG(LOG_CONTACT) << "    event: " << std::endl << **j;
 }
 
 /**
  * Applies method of Drumwright and Shell to a set of connected events
  * \param events a set of connected events 
+ * \param epd storage for the problem data; the data from the last problem
+ *        solved using it is reused where possible (see 
+ *        update_problem_data()), and callers solving groups concurrently
+ *        must each provide their own
  */
-void ImpactEventHandler::apply_model_to_connected_events(const list<Event*>& events) const
+void ImpactEventHandler::apply_model_to_connected_events(const list<Event*>& events, EventProblemData& epd) const
 {
   Real ke_minus = 0.0, ke_plus = 0.0;
   vector<Event> constraint_event_objects;
-  SAFESTATIC EventProblemData epd;
 
   FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::apply_model_to_connected_events() entered" << endl;
 
-  // reset problem data
-  epd.reset();
-
   // determine sets of contact and limit events
-  partition_events(events, epd.contact_events, epd.limit_events);
+  vector<Event*> contacts, limits, constraints;
+  partition_events(events, contacts, limits);
 
   // add events for constraints for articulated bodies
-  add_constraint_events(events, constraint_event_objects, epd.constraint_events);
+  add_constraint_events(events, constraint_event_objects, constraints);
+
+  // compute all event cross-terms; if the events have barely changed since
+  // the last problem solved using epd, its cross-terms are updated instead
+  if (!update_problem_data(contacts, limits, constraints, epd))
+  {
+    epd.reset();
+    epd.contact_events.swap(contacts);
+    epd.limit_events.swap(limits);
+    epd.constraint_events.swap(constraints);
+    compute_problem_data(epd);
+  }
 
-  // compute all event cross-terms
-  compute_problem_data(epd);
+  // get initial guesses for contact impulses
+  if (warm_start)
+    get_warm_start_impulses(epd);
 
   // compute energy
   if (LOGGING(LOG_CONTACT))
@@ -164,9 +367,20 @@ void ImpactEventHandler::apply_model_to_connected_events(const list<Event*>& eve
 */
   epd.kappa = (Real) -std::numeric_limits<float>::max();
 
-  // determine what type of QP solver to use
-  if (use_qp_solver(epd))
-    solve_qp(epd, poisson_eps);
+  // determine what type of solver to use (the iterative solver does not 
+  // handle the advanced joint friction model); the iterative solver can stop
+  // after any sweep, so it is also used once the time budget is exhausted
+  const bool USE_ITERATIVE = epd.N_CONSTRAINT_DOF_IMP == 0 && 
+                             epd.N_CONSTRAINT_DOF_EXP == 0;
+  if (USE_ITERATIVE && (use_iterative_solver || deadline_passed(epd)))
+    solve_iterative(epd, poisson_eps);
+  else if (use_qp_solver(epd))
+  {
+    // the QP solver fails only if the time budget is exhausted before it
+    // finds a solution
+    if (!solve_qp(epd, poisson_eps))
+      solve_iterative(epd, poisson_eps);
+  }
   else
     solve_nqp(epd, poisson_eps);
 
@@ -289,31 +503,11 @@ void ImpactEventHandler::compute_problem_data(EventProblemData& q)
 {
   const unsigned UINF = std::numeric_limits<unsigned>::max();
 
-  // determine set of "super" bodies from contact events
-  q.super_bodies.clear();
-  for (unsigned i=0; i< q.contact_events.size(); i++)
-  {
-    q.super_bodies.push_back(get_super_body(q.contact_events[i]->contact_geom1->get_single_body()));
-    q.super_bodies.push_back(get_super_body(q.contact_events[i]->contact_geom2->get_single_body()));
-  }
-
-  // determine set of "super" bodies from limit events
-  for (unsigned i=0; i< q.limit_events.size(); i++)
-  {
-    RigidBodyPtr outboard = q.limit_events[i]->limit_joint->get_outboard_link();
-    q.super_bodies.push_back(get_super_body(outboard));
-  }
-
-  // determine set of "super" bodies from constraint events
-  for (unsigned i=0; i< q.constraint_events.size(); i++)
-  {
-    RigidBodyPtr outboard = q.constraint_events[i]->constraint_joint->get_outboard_link();
-    q.super_bodies.push_back(get_super_body(outboard));
-  }
+  // determine set of "super" bodies
+  determine_super_bodies(q, q.super_bodies);
 
-  // make super bodies vector unique
-  std::sort(q.super_bodies.begin(), q.super_bodies.end());
-  q.super_bodies.erase(std::unique(q.super_bodies.begin(), q.super_bodies.end()), q.super_bodies.end());
+  // determine the block structure of the problem
+  determine_event_blocks(q);
 
   // initialize constants and set easy to set constants
   q.N_CONSTRAINTS = q.constraint_events.size();
@@ -350,13 +544,56 @@ void ImpactEventHandler::compute_problem_data(EventProblemData& q)
   q.N_LIN_CONE = q.N_CONTACTS - q.N_TRUE_CONE;
 
   // initialize the problem matrices / vectors
-  q.Jc_iM_JcT.set_zero(q.N_CONTACTS, q.N_CONTACTS);
-  q.Jc_iM_DcT.set_zero(q.N_CONTACTS, q.N_CONTACTS*2);
+  init_problem_matrices(q);
+
+  // for each super body, update the problem data
+  for (unsigned i=0; i< q.super_bodies.size(); i++)
+    q.super_bodies[i]->update_event_data(q);
+
+  // save the state from which the problem data was computed
+  save_problem_state(q);
+}
+
+/// Determines the (sorted) set of "super" bodies involved in the events of the problem data
+void ImpactEventHandler::determine_super_bodies(const EventProblemData& q, vector<DynamicBodyPtr>& super_bodies)
+{
+  // determine set of "super" bodies from contact events
+  super_bodies.clear();
+  for (unsigned i=0; i< q.contact_events.size(); i++)
+  {
+    super_bodies.push_back(get_super_body(q.contact_events[i]->contact_geom1->get_single_body()));
+    super_bodies.push_back(get_super_body(q.contact_events[i]->contact_geom2->get_single_body()));
+  }
+
+  // determine set of "super" bodies from limit events
+  for (unsigned i=0; i< q.limit_events.size(); i++)
+  {
+    RigidBodyPtr outboard = q.limit_events[i]->limit_joint->get_outboard_link();
+    super_bodies.push_back(get_super_body(outboard));
+  }
+
+  // determine set of "super" bodies from constraint events
+  for (unsigned i=0; i< q.constraint_events.size(); i++)
+  {
+    RigidBodyPtr outboard = q.constraint_events[i]->constraint_joint->get_outboard_link();
+    super_bodies.push_back(get_super_body(outboard));
+  }
+
+  // make super bodies vector unique
+  std::sort(super_bodies.begin(), super_bodies.end());
+  super_bodies.erase(std::unique(super_bodies.begin(), super_bodies.end()), super_bodies.end());
+}
+
+/// Sizes and zeros the cross-event terms other than the contact-contact terms
+/**
+ * Only articulated bodies contribute to these terms.
+ */
+static void init_event_terms(EventProblemData& q)
+{
   q.Jc_iM_JlT.set_zero(q.N_CONTACTS, q.N_LIMITS);
   q.Jc_iM_DtT.set_zero(q.N_CONTACTS, q.N_CONSTRAINT_DOF_IMP);
   q.Jc_iM_JxT.set_zero(q.N_CONTACTS, q.N_CONSTRAINT_EQNS_EXP);
   q.Jc_iM_DxT.set_zero(q.N_CONTACTS, q.N_CONSTRAINT_DOF_EXP);
-  q.Dc_iM_DcT.set_zero(q.N_CONTACTS*2, q.N_CONTACTS*2);
   q.Dc_iM_JlT.set_zero(q.N_CONTACTS*2, q.N_LIMITS);
   q.Dc_iM_DtT.set_zero(q.N_CONTACTS*2, q.N_CONSTRAINT_DOF_IMP);
   q.Dc_iM_JxT.set_zero(q.N_CONTACTS*2, q.N_CONSTRAINT_EQNS_EXP);
@@ -371,6 +608,13 @@ void ImpactEventHandler::compute_problem_data(EventProblemData& q)
   q.Jx_iM_JxT.set_zero(q.N_CONSTRAINT_EQNS_EXP, q.N_CONSTRAINT_EQNS_EXP);
   q.Jx_iM_DxT.set_zero(q.N_CONSTRAINT_EQNS_EXP, q.N_CONSTRAINT_DOF_EXP);
   q.Dx_iM_DxT.set_zero(q.N_CONSTRAINT_DOF_EXP, q.N_CONSTRAINT_DOF_EXP);
+}
+
+/// Sizes and zeros the cross-event terms, velocity vectors, and impulse vectors of the problem data
+void ImpactEventHandler::init_problem_matrices(EventProblemData& q)
+{
+  q.init_contact_blocks();
+  init_event_terms(q);
   q.Jc_v.set_zero(q.N_CONTACTS);
   q.Dc_v.set_zero(q.N_CONTACTS*2);
   q.Jl_v.set_zero(q.N_LIMITS);
@@ -382,10 +626,285 @@ void ImpactEventHandler::compute_problem_data(EventProblemData& q)
   q.beta_t.set_zero(q.N_CONSTRAINT_DOF_IMP);
   q.alpha_x.set_zero(q.N_CONSTRAINT_EQNS_EXP);
   q.beta_x.set_zero(q.N_CONSTRAINT_DOF_EXP);
+}
 
-  // for each super body, update the problem data
+/// Saves the events and super body configurations from which the problem data was computed
+void ImpactEventHandler::save_problem_state(EventProblemData& q)
+{
+  q.last_contacts.resize(q.N_CONTACTS);
+  for (unsigned i=0; i< q.N_CONTACTS; i++)
+    save_contact_state(*q.contact_events[i], q.last_contacts[i]);
+
+  q.last_limits.resize(q.N_LIMITS);
+  for (unsigned i=0; i< q.N_LIMITS; i++)
+  {
+    q.last_limits[i].joint = q.limit_events[i]->limit_joint;
+    q.last_limits[i].dof = q.limit_events[i]->limit_dof;
+    q.last_limits[i].upper = q.limit_events[i]->limit_upper;
+  }
+
+  q.last_constraints.resize(q.N_CONSTRAINTS);
+  for (unsigned i=0; i< q.N_CONSTRAINTS; i++)
+    q.last_constraints[i] = q.constraint_events[i]->constraint_joint;
+
+  q.last_gc.resize(q.super_bodies.size());
   for (unsigned i=0; i< q.super_bodies.size(); i++)
-    q.super_bodies[i]->update_event_data(q);
+    q.super_bodies[i]->get_generalized_coordinates(DynamicBody::eRodrigues, q.last_gc[i]);
+
+  q.has_last_state = true;
+}
+
+/// Saves the state of a contact event from which the problem data was computed
+void ImpactEventHandler::save_contact_state(const Event& e, EventProblemData::ContactState& c)
+{
+  c.geom1 = e.contact_geom1;
+  c.geom2 = e.contact_geom2;
+  c.NK = e.contact_NK;
+  c.point = e.contact_point;
+  c.normal = e.contact_normal;
+  c.tan1 = e.contact_tan1;
+  c.tan2 = e.contact_tan2;
+}
+
+/// Determines whether a contact event has moved from the state from which the problem data was computed
+bool ImpactEventHandler::contact_moved(const Event& e, const EventProblemData::ContactState& c, Real tol)
+{
+  return (e.contact_point - c.point).norm() > tol ||
+         (e.contact_normal - c.normal).norm() > tol ||
+         (e.contact_tan1 - c.tan1).norm() > tol ||
+         (e.contact_tan2 - c.tan2).norm() > tol;
+}
+
+/// Updates the problem data of the last problem solved using it, if the events have barely changed
+/**
+ * Between consecutive calls (e.g., the mini-steps taken at a Zeno point)
+ * the events and super bodies are often the same.  If the events are 
+ * between the same geometries (and at the same joint limits) as those of
+ * the last problem, only the contributions of the super bodies of events
+ * that have changed are recomputed, in place.  An event has changed if one of
+ * its contact point and frame vectors, or the generalized coordinates of one
+ * of its super bodies, has moved by more than problem_data_reuse_tol from
+ * the state from which its terms were last computed.  Articulated and 
+ * deformable bodies keep data from their last update for computing their 
+ * velocity updates, so their events are always recomputed.  The velocity
+ * vectors (Jc_v, Dc_v, ...) are always recomputed.
+ * \param contacts the contact events
+ * \param limits the limit events
+ * \param constraints the constraint events
+ * \param q the problem data of the last problem; on return, the problem data
+ *        for the events if the method returns <b>true</b>
+ * \return <b>false</b> if the problem data must be computed from scratch
+ */
+bool ImpactEventHandler::update_problem_data(const vector<Event*>& contacts, const vector<Event*>& limits, const vector<Event*>& constraints, EventProblemData& q) const
+{
+  if (problem_data_reuse_tol < (Real) 0.0 || !q.has_last_state)
+    return false;
+
+  // the events must be between the same geometries and at the same limits
+  if (contacts.size() != q.last_contacts.size() || 
+      limits.size() != q.last_limits.size() ||
+      constraints.size() != q.last_constraints.size())
+    return false;
+  for (unsigned i=0; i< contacts.size(); i++)
+  {
+    const EventProblemData::ContactState& c = q.last_contacts[i];
+    if (contacts[i]->contact_geom1 != c.geom1 || 
+        contacts[i]->contact_geom2 != c.geom2 ||
+        contacts[i]->contact_NK != c.NK)
+      return false;
+  }
+  for (unsigned i=0; i< limits.size(); i++)
+  {
+    const EventProblemData::LimitState& l = q.last_limits[i];
+    if (limits[i]->limit_joint != l.joint || limits[i]->limit_dof != l.dof ||
+        limits[i]->limit_upper != l.upper)
+      return false;
+  }
+  for (unsigned i=0; i< constraints.size(); i++)
+    if (constraints[i]->constraint_joint != q.last_constraints[i])
+      return false;
+
+  // install the events
+  q.contact_events = contacts;
+  q.limit_events = limits;
+  q.constraint_events = constraints;
+
+  // the events must involve the same super bodies, in the same way
+  vector<DynamicBodyPtr> super_bodies;
+  determine_super_bodies(q, super_bodies);
+  if (super_bodies != q.super_bodies)
+    return false;
+  vector<vector<unsigned> > super_body_contacts = q.super_body_contacts;
+  vector<vector<unsigned> > super_body_limits = q.super_body_limits;
+  determine_event_blocks(q);
+  if (super_body_contacts != q.super_body_contacts || 
+      super_body_limits != q.super_body_limits)
+    return false;
+
+  // determine the super bodies that have moved (articulated and deformable
+  // bodies are always treated as moved); their events have changed
+  const unsigned N_SUPERS = q.super_bodies.size();
+  vector<bool> moved(N_SUPERS, false), changed_contact(q.N_CONTACTS, false);
+  vector<bool> changed_limit(q.N_LIMITS, false);
+  VectorN gc;
+  for (unsigned i=0; i< N_SUPERS; i++)
+  {
+    if (dynamic_pointer_cast<RigidBody>(q.super_bodies[i]))
+    {
+      q.super_bodies[i]->get_generalized_coordinates(DynamicBody::eRodrigues, gc);
+      moved[i] = (gc.size() != q.last_gc[i].size() || 
+                  (gc -= q.last_gc[i]).norm_inf() > problem_data_reuse_tol);
+    }
+    else
+      moved[i] = true;
+    if (!moved[i])
+      continue;
+    for (unsigned j=0; j< q.super_body_contacts[i].size(); j++)
+      changed_contact[q.super_body_contacts[i][j]] = true;
+    for (unsigned j=0; j< q.super_body_limits[i].size(); j++)
+      changed_limit[q.super_body_limits[i][j]] = true;
+  }
+
+  // determine the contacts that have moved
+  vector<unsigned> crows, lrows;
+  for (unsigned i=0; i< q.N_CONTACTS; i++)
+    if (changed_contact[i] || contact_moved(*contacts[i], q.last_contacts[i], problem_data_reuse_tol))
+    {
+      changed_contact[i] = true;
+      crows.push_back(i);
+    }
+  for (unsigned i=0; i< q.N_LIMITS; i++)
+    if (changed_limit[i])
+      lrows.push_back(i);
+
+  // if most of the events have changed, it is cheaper to start over
+  const unsigned N_CHANGED = crows.size() + lrows.size();
+  if (N_CHANGED*2 > q.N_CONTACTS + q.N_LIMITS)
+    return false;
+
+  FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::update_problem_data() - updating " << crows.size() << " of " << q.N_CONTACTS << " contacts and " << lrows.size() << " of " << q.N_LIMITS << " limits" << endl;
+
+  // determine the super bodies involved in changed events
+  vector<bool> affected(moved);
+  for (unsigned i=0; i< N_SUPERS; i++)
+  {
+    for (unsigned j=0; j< q.super_body_contacts[i].size() && !affected[i]; j++)
+      affected[i] = changed_contact[q.super_body_contacts[i][j]];
+    for (unsigned j=0; j< q.super_body_limits[i].size() && !affected[i]; j++)
+      affected[i] = changed_limit[q.super_body_limits[i][j]];
+  }
+
+  // recompute the contributions of the affected super bodies in place: the
+  // entries for a changed event receive contributions only from its own
+  // super bodies, so zeroing the contact blocks of the affected super bodies
+  // removes all stale contributions; the remaining cross-event terms come
+  // only from articulated bodies, which are always affected
+  q.Jc_v.set_zero();
+  q.Dc_v.set_zero();
+  q.Jl_v.set_zero();
+  q.Jx_v.set_zero();
+  q.Dx_v.set_zero();
+  bool any_affected = false;
+  for (unsigned i=0; i< N_SUPERS; i++)
+    if (affected[i])
+    {
+      any_affected = true;
+      q.contact_blocks[i].Jc_iM_JcT.set_zero();
+      q.contact_blocks[i].Jc_iM_DcT.set_zero();
+      q.contact_blocks[i].Dc_iM_DcT.set_zero();
+    }
+  if (any_affected)
+  {
+    init_event_terms(q);
+    for (unsigned i=0; i< N_SUPERS; i++)
+      if (affected[i])
+        q.super_bodies[i]->update_event_data(q);
+
+    // update the saved state of the changed events
+    for (unsigned i=0; i< crows.size(); i++)
+      save_contact_state(*contacts[crows[i]], q.last_contacts[crows[i]]);
+    for (unsigned i=0; i< N_SUPERS; i++)
+      if (moved[i])
+        q.super_bodies[i]->get_generalized_coordinates(DynamicBody::eRodrigues, q.last_gc[i]);
+  }
+
+  // compute the velocity vectors for the remaining bodies (all of which are
+  // rigid, since other bodies are always treated as moved)
+  for (unsigned i=0; i< N_SUPERS; i++)
+    if (!affected[i])
+    {
+      assert(dynamic_pointer_cast<RigidBody>(q.super_bodies[i]));
+      dynamic_pointer_cast<RigidBody>(q.super_bodies[i])->update_event_velocities(q);
+    }
+
+  // reset the impulses
+  q.alpha_c.set_zero(q.N_CONTACTS);
+  q.beta_c.set_zero(q.N_CONTACTS*2);
+  q.alpha_l.set_zero(q.N_LIMITS);
+  q.beta_t.set_zero(q.N_CONSTRAINT_DOF_IMP);
+  q.alpha_x.set_zero(q.N_CONSTRAINT_EQNS_EXP);
+  q.beta_x.set_zero(q.N_CONSTRAINT_DOF_EXP);
+  q.alpha_c0.resize(0);
+  q.beta_c0.resize(0);
+
+  return true;
+}
+
+/// Determines the events that involve each super body and the blocks of the contact terms in which each contact appears
+/**
+ * Only entries of the cross-event terms between events that involve a 
+ * common super body can be nonzero; super bodies use this structure to
+ * update only those entries (see DynamicBody::update_event_data()), and the
+ * contact-contact terms are stored as one block per super body (see
+ * EventProblemData::contact_blocks).
+ */
+void ImpactEventHandler::determine_event_blocks(EventProblemData& q)
+{
+  const unsigned N_SUPERS = q.super_bodies.size();
+
+  // clear the lists of events
+  q.super_body_contacts.resize(N_SUPERS);
+  q.super_body_limits.resize(N_SUPERS);
+  for (unsigned i=0; i< N_SUPERS; i++)
+  {
+    q.super_body_contacts[i].clear();
+    q.super_body_limits[i].clear();
+  }
+
+  // determine the super bodies involved in each contact event (disabled 
+  // rigid bodies contribute nothing to the problem and are skipped) and the
+  // position of the event in the blocks of those super bodies
+  q.contact_block_entries.resize(q.contact_events.size());
+  for (unsigned i=0; i< q.contact_events.size(); i++)
+  {
+    SingleBodyPtr sb[2];
+    sb[0] = q.contact_events[i]->contact_geom1->get_single_body();
+    sb[1] = q.contact_events[i]->contact_geom2->get_single_body();
+    unsigned idx[2] = { N_SUPERS, N_SUPERS };
+    q.contact_block_entries[i].clear();
+    for (unsigned j=0; j< 2; j++)
+    {
+      if (!sb[j]->is_enabled() && !sb[j]->get_articulated_body())
+        continue;
+      idx[j] = q.get_super_body_index(get_super_body(sb[j]));
+      if (j == 1 && idx[1] == idx[0])
+        idx[1] = N_SUPERS;
+      if (idx[j] < N_SUPERS)
+      {
+        q.contact_block_entries[i].push_back(std::make_pair(idx[j], q.super_body_contacts[idx[j]].size()));
+        q.super_body_contacts[idx[j]].push_back(i);
+      }
+    }
+  }
+
+  // determine the super body involved in each limit event
+  for (unsigned i=0; i< q.limit_events.size(); i++)
+  {
+    RigidBodyPtr outboard = q.limit_events[i]->limit_joint->get_outboard_link();
+    unsigned idx = q.get_super_body_index(get_super_body(outboard));
+    if (idx < N_SUPERS)
+      q.super_body_limits[idx].push_back(i);
+  }
 }
 
 /// Sets up optimization data for nonlinear QP
@@ -590,7 +1109,11 @@ void ImpactEventHandler::set_optimization_data(EventProblemData& q, ImpactOptDat
 }
 
 /// Solves the quadratic program (potentially solves two QPs, actually)
-void ImpactEventHandler::solve_qp(EventProblemData& q, Real poisson_eps)
+/**
+ * \return <b>false</b> if the time budget was exhausted before the first QP 
+ *         was solved (the impulses in q are not updated)
+ */
+bool ImpactEventHandler::solve_qp(EventProblemData& q, Real poisson_eps) const
 {
   SAFESTATIC VectorN z, tmp, tmp2;
   const Real TOL = poisson_eps;
@@ -602,8 +1125,24 @@ void ImpactEventHandler::solve_qp(EventProblemData& q, Real poisson_eps)
   const unsigned N_CONSTRAINT_DOF_IMP = q.N_CONSTRAINT_DOF_IMP;
   const unsigned N_K_TOTAL = q.N_K_TOTAL;
 
+  // the interior-point solver may be used when there are no explicit
+  // constraint equations; Lemke's algorithm is used if it fails
+  const bool USE_IP = use_ip_solver && q.N_CONSTRAINT_EQNS_EXP == 0;
+
   // solve the QP
-  solve_qp_work(q, z);
+  if (!USE_IP || !solve_qp_work_ip(q, z))
+  {
+    if (deadline_passed(q) || !solve_qp_work(q, z))
+    {
+      FILE_LOG(LOG_CONTACT) << " -- time budget exhausted before QP was solved" << std::endl;
+      q.n_truncated_solves++;
+      return false;
+    }
+  }
+
+  // any further QPs solve for impulse increments; don't warm start them
+  q.alpha_c0.resize(0);
+  q.beta_c0.resize(0);
 
   // apply (Poisson) restitution to contacts
   for (unsigned i=0; i< N_CONTACTS; i++)
@@ -617,12 +1156,9 @@ void ImpactEventHandler::solve_qp(EventProblemData& q, Real poisson_eps)
   update_impulses(q, z);
 
   // update Jc_v, Dc_v, Jl_v, and Jx_v
-  q.Jc_v += q.Jc_iM_JcT.mult(q.alpha_c, tmp);
-  q.Jc_v += q.Jc_iM_DcT.mult(q.beta_c, tmp);
+  q.add_contact_velocity_changes(q.alpha_c, q.beta_c, q.Jc_v, q.Dc_v);
   q.Jc_v += q.Jc_iM_JlT.mult(q.alpha_l, tmp);
   q.Jc_v += q.Jc_iM_JxT.mult(q.alpha_x, tmp);
-  q.Dc_v += q.Jc_iM_DcT.transpose_mult(q.alpha_c, tmp);
-  q.Dc_v += q.Dc_iM_DcT.mult(q.beta_c, tmp);
   q.Dc_v += q.Dc_iM_JlT.mult(q.alpha_l, tmp);
   q.Dc_v += q.Dc_iM_JxT.mult(q.alpha_x, tmp);
   q.Jl_v += q.Jc_iM_JlT.transpose_mult(q.alpha_c, tmp);
@@ -642,31 +1178,44 @@ void ImpactEventHandler::solve_qp(EventProblemData& q, Real poisson_eps)
   FILE_LOG(LOG_CONTACT) << "new Jx_v: " << q.Jx_v << std::endl;
 
   // see whether another QP must be solved
+  bool resolve = false;
   if (q.Jc_v.size() > 0 && *min_element(q.Jc_v.begin(), q.Jc_v.end()) < -TOL)
   {
     FILE_LOG(LOG_CONTACT) << "minimum Jc*v: " << *min_element(q.Jc_v.begin(), q.Jc_v.end()) << std::endl;
-    FILE_LOG(LOG_CONTACT) << " -- running another QP iteration..." << std::endl;
-    solve_qp_work(q, z);
-    update_impulses(q, z);
+    resolve = true;
   }
-  else 
-    if (q.Jl_v.size() > 0 && *min_element(q.Jl_v.begin(), q.Jl_v.end()) < -TOL)
-    {
-      FILE_LOG(LOG_CONTACT) << "minimum Jl*v: " << *min_element(q.Jl_v.begin(), q.Jl_v.end()) << std::endl;
-      FILE_LOG(LOG_CONTACT) << " -- running another QP iteration..." << std::endl;
-      solve_qp_work(q, z);
-      update_impulses(q, z);
-    }
-  else
+  else if (q.Jl_v.size() > 0 && *min_element(q.Jl_v.begin(), q.Jl_v.end()) < -TOL)
+  {
+    FILE_LOG(LOG_CONTACT) << "minimum Jl*v: " << *min_element(q.Jl_v.begin(), q.Jl_v.end()) << std::endl;
+    resolve = true;
+  }
+  else if (q.Jx_v.size() > 0)
   {
     pair<Real*, Real*> mm = boost::minmax_element(q.Jx_v.begin(), q.Jx_v.end());
-    if (q.Jx_v.size() > 0 && (*mm.first < -TOL || *mm.second > TOL))
+    if (*mm.first < -TOL || *mm.second > TOL)
     {
       FILE_LOG(LOG_CONTACT) << "minimum J*v: " << *mm.first << std::endl;
       FILE_LOG(LOG_CONTACT) << "maximum J*v: " << *mm.second << std::endl;
+      resolve = true;
+    }
+  }
+
+  // solve another QP if necessary (and if there is time left); the 
+  // impulses from the first QP are kept if the time budget is exhausted 
+  if (resolve)
+  {
+    if (deadline_passed(q))
+    {
+      FILE_LOG(LOG_CONTACT) << " -- time budget exhausted; not running another QP iteration" << std::endl;
+      q.n_skipped_solves++;
+    }
+    else 
+    {
       FILE_LOG(LOG_CONTACT) << " -- running another QP iteration..." << std::endl;
-      solve_qp_work(q, z);
-      update_impulses(q, z);
+      if ((USE_IP && solve_qp_work_ip(q, z)) || solve_qp_work(q, z))
+        update_impulses(q, z);
+      else
+        q.n_truncated_solves++;
     }
   }
 
@@ -684,6 +1233,8 @@ void ImpactEventHandler::solve_qp(EventProblemData& q, Real poisson_eps)
   // save limit impulses
   for (unsigned i=0; i< N_LIMITS; i++)
     q.limit_events[i]->limit_impulse = q.alpha_l[i]; 
+
+  return true;
 }
 
 /// Solves the nonlinearly constrained quadratic program (potentially solves two nQPs, actually)
@@ -715,12 +1266,9 @@ void ImpactEventHandler::solve_nqp(EventProblemData& q, Real poisson_eps)
   update_impulses(q, z);
 
   // update Jc_v, Dc_v, Jl_v, and Jx_v
-  q.Jc_v += q.Jc_iM_JcT.mult(q.alpha_c, tmp);
-  q.Jc_v += q.Jc_iM_DcT.mult(q.beta_c, tmp);
+  q.add_contact_velocity_changes(q.alpha_c, q.beta_c, q.Jc_v, q.Dc_v);
   q.Jc_v += q.Jc_iM_JlT.mult(q.alpha_l, tmp);
   q.Jc_v += q.Jc_iM_JxT.mult(q.alpha_x, tmp);
-  q.Dc_v += q.Jc_iM_DcT.transpose_mult(q.alpha_c, tmp);
-  q.Dc_v += q.Dc_iM_DcT.mult(q.beta_c, tmp);
   q.Dc_v += q.Dc_iM_JlT.mult(q.alpha_l, tmp);
   q.Dc_v += q.Dc_iM_JxT.mult(q.alpha_x, tmp);
   q.Jl_v += q.Jc_iM_JlT.transpose_mult(q.alpha_c, tmp);
@@ -733,28 +1281,38 @@ void ImpactEventHandler::solve_nqp(EventProblemData& q, Real poisson_eps)
   q.Jx_v += q.Jx_iM_JxT.mult(q.alpha_x, tmp);
 
   // see whether another QP must be solved
+  bool resolve = false;
   if (q.Jc_v.size() > 0 && *min_element(q.Jc_v.begin(), q.Jc_v.end()) < -TOL)
   {
     FILE_LOG(LOG_CONTACT) << "minimum Jc*v: " << *min_element(q.Jc_v.begin(), q.Jc_v.end()) << std::endl;
-    FILE_LOG(LOG_CONTACT) << " -- running another QP iteration..." << std::endl;
-    solve_nqp_work(q, z);
-    update_impulses(q, z);
+    resolve = true;
   }
-  else 
-    if (q.Jl_v.size() > 0 && *min_element(q.Jl_v.begin(), q.Jl_v.end()) < -TOL)
-    {
-      FILE_LOG(LOG_CONTACT) << "minimum Jl*v: " << *min_element(q.Jl_v.begin(), q.Jl_v.end()) << std::endl;
-      FILE_LOG(LOG_CONTACT) << " -- running another QP iteration..." << std::endl;
-      solve_nqp_work(q, z);
-      update_impulses(q, z);
-    }
-  else
+  else if (q.Jl_v.size() > 0 && *min_element(q.Jl_v.begin(), q.Jl_v.end()) < -TOL)
+  {
+    FILE_LOG(LOG_CONTACT) << "minimum Jl*v: " << *min_element(q.Jl_v.begin(), q.Jl_v.end()) << std::endl;
+    resolve = true;
+  }
+  else if (q.Jx_v.size() > 0)
   {
     pair<Real*, Real*> mm = boost::minmax_element(q.Jx_v.begin(), q.Jx_v.end());
-    if (q.Jx_v.size() > 0 && (*mm.first < -TOL || *mm.second > TOL))
+    if (*mm.first < -TOL || *mm.second > TOL)
     {
       FILE_LOG(LOG_CONTACT) << "minimum J*v: " << *mm.first << std::endl;
       FILE_LOG(LOG_CONTACT) << "maximum J*v: " << *mm.second << std::endl;
+      resolve = true;
+    }
+  }
+
+  // solve another QP if necessary (and if there is time left)
+  if (resolve)
+  {
+    if (deadline_passed(q))
+    {
+      FILE_LOG(LOG_CONTACT) << " -- time budget exhausted; not running another QP iteration" << std::endl;
+      q.n_skipped_solves++;
+    }
+    else
+    {
       FILE_LOG(LOG_CONTACT) << " -- running another QP iteration..." << std::endl;
       solve_nqp_work(q, z);
       update_impulses(q, z);
@@ -777,17 +1335,523 @@ void ImpactEventHandler::solve_nqp(EventProblemData& q, Real poisson_eps)
     q.limit_events[i]->limit_impulse = q.alpha_l[i]; 
 }
 
-/// Updates impulses in q using concatenated vector of impulses z
-void ImpactEventHandler::update_impulses(EventProblemData& q, const VectorN& z)
+/// Solves for impulses using the iterative solver (potentially runs the solver twice, actually)
+/**
+ * Unlike solve_qp(), which minimizes kinetic energy, the iterative solver 
+ * solves the complementarity formulation of the impact problem (for which
+ * the kinetic energy minimizing solution is also a solution, in the absence
+ * of friction) using projected Gauss-Seidel.  Friction impulses for each
+ * contact are projected onto the friction disc (rather than onto a
+ * linearized friction cone).
+ */
+void ImpactEventHandler::solve_iterative(EventProblemData& q, Real poisson_eps) const
 {
-  SAFESTATIC VectorN tmp;
+  SAFESTATIC VectorN x, tmp;
+  const Real TOL = poisson_eps;
 
   // get the number of different types of each event
-  const unsigned UINF = std::numeric_limits<unsigned>::max();
   const unsigned N_CONTACTS = q.N_CONTACTS;
   const unsigned N_LIMITS = q.N_LIMITS;
-  const unsigned N_CONSTRAINT_EQNS = q.N_CONSTRAINT_EQNS_EXP;
-  const unsigned N_K_TOTAL = q.N_K_TOTAL;
+
+  // setup variable indices
+  const unsigned ALPHA_C_IDX = 0;
+  const unsigned BETA_C_IDX = N_CONTACTS;
+  const unsigned ALPHA_L_IDX = N_CONTACTS*2 + BETA_C_IDX;
+  const unsigned ALPHA_X_IDX = N_LIMITS + ALPHA_L_IDX;
+  const unsigned NVARS = q.N_CONSTRAINT_EQNS_EXP + ALPHA_X_IDX;
+
+  // get the initial impulses
+  x.set_zero(NVARS);
+  if (q.alpha_c0.size() == N_CONTACTS)
+  {
+    x.set_sub_vec(ALPHA_C_IDX, q.alpha_c0);
+    x.set_sub_vec(BETA_C_IDX, q.beta_c0);
+  }
+
+  // solve for the impulses
+  if (!solve_iterative_work(q, x))
+    q.n_truncated_solves++;
+
+  // apply (Poisson) restitution to contacts
+  for (unsigned i=0; i< N_CONTACTS; i++)
+    x[ALPHA_C_IDX+i] *= ((Real) 1.0 + q.contact_events[i]->contact_epsilon);
+
+  // apply (Poisson) restitution to limits
+  for (unsigned i=0; i< N_LIMITS; i++)
+    x[ALPHA_L_IDX+i] *= ((Real) 1.0 + q.limit_events[i]->limit_epsilon);
+
+  // save impulses in q
+  q.alpha_c += x.get_sub_vec(ALPHA_C_IDX, BETA_C_IDX, tmp);
+  q.beta_c += x.get_sub_vec(BETA_C_IDX, ALPHA_L_IDX, tmp);
+  q.alpha_l += x.get_sub_vec(ALPHA_L_IDX, ALPHA_X_IDX, tmp);
+  q.alpha_x += x.get_sub_vec(ALPHA_X_IDX, NVARS, tmp);
+
+  // update Jc_v, Dc_v, Jl_v, and Jx_v
+  q.add_contact_velocity_changes(q.alpha_c, q.beta_c, q.Jc_v, q.Dc_v);
+  q.Jc_v += q.Jc_iM_JlT.mult(q.alpha_l, tmp);
+  q.Jc_v += q.Jc_iM_JxT.mult(q.alpha_x, tmp);
+  q.Dc_v += q.Dc_iM_JlT.mult(q.alpha_l, tmp);
+  q.Dc_v += q.Dc_iM_JxT.mult(q.alpha_x, tmp);
+  q.Jl_v += q.Jc_iM_JlT.transpose_mult(q.alpha_c, tmp);
+  q.Jl_v += q.Dc_iM_JlT.transpose_mult(q.beta_c, tmp);
+  q.Jl_v += q.Jl_iM_JlT.mult(q.alpha_l, tmp);
+  q.Jl_v += q.Jl_iM_JxT.mult(q.alpha_x, tmp);
+  q.Jx_v += q.Jc_iM_JxT.transpose_mult(q.alpha_c, tmp);
+  q.Jx_v += q.Dc_iM_JxT.transpose_mult(q.beta_c, tmp);
+  q.Jx_v += q.Jl_iM_JxT.transpose_mult(q.alpha_l, tmp);
+  q.Jx_v += q.Jx_iM_JxT.mult(q.alpha_x, tmp);
+
+  // see whether the solver must be run again 
+  bool resolve = false;
+  if (q.Jc_v.size() > 0 && *min_element(q.Jc_v.begin(), q.Jc_v.end()) < -TOL)
+  {
+    FILE_LOG(LOG_CONTACT) << "minimum Jc*v: " << *min_element(q.Jc_v.begin(), q.Jc_v.end()) << std::endl;
+    resolve = true;
+  }
+  else if (q.Jl_v.size() > 0 && *min_element(q.Jl_v.begin(), q.Jl_v.end()) < -TOL)
+  {
+    FILE_LOG(LOG_CONTACT) << "minimum Jl*v: " << *min_element(q.Jl_v.begin(), q.Jl_v.end()) << std::endl;
+    resolve = true;
+  }
+  else if (q.Jx_v.size() > 0)
+  {
+    pair<Real*, Real*> mm = boost::minmax_element(q.Jx_v.begin(), q.Jx_v.end());
+    if (*mm.first < -TOL || *mm.second > TOL)
+    {
+      FILE_LOG(LOG_CONTACT) << "minimum J*v: " << *mm.first << std::endl;
+      FILE_LOG(LOG_CONTACT) << "maximum J*v: " << *mm.second << std::endl;
+      resolve = true;
+    }
+  }
+
+  // run the solver again (from zero) if necessary (and if there is time left)
+  if (resolve && deadline_passed(q))
+  {
+    FILE_LOG(LOG_CONTACT) << " -- time budget exhausted; not running the iterative solver again" << std::endl;
+    q.n_skipped_solves++;
+  }
+  else if (resolve)
+  {
+    FILE_LOG(LOG_CONTACT) << " -- running the iterative solver again..." << std::endl;
+    x.set_zero(NVARS);
+    if (!solve_iterative_work(q, x))
+      q.n_truncated_solves++;
+    q.alpha_c += x.get_sub_vec(ALPHA_C_IDX, BETA_C_IDX, tmp);
+    q.beta_c += x.get_sub_vec(BETA_C_IDX, ALPHA_L_IDX, tmp);
+    q.alpha_l += x.get_sub_vec(ALPHA_L_IDX, ALPHA_X_IDX, tmp);
+    q.alpha_x += x.get_sub_vec(ALPHA_X_IDX, NVARS, tmp);
+  }
+
+  // save normal contact impulses
+  for (unsigned i=0; i< N_CONTACTS; i++)
+    q.contact_events[i]->contact_impulse = q.contact_events[i]->contact_normal * q.alpha_c[i];
+
+  // save tangent contact impulses
+  for (unsigned i=0, j=0; i< N_CONTACTS; i++)
+  {
+    q.contact_events[i]->contact_impulse += q.contact_events[i]->contact_tan1 * q.beta_c[j++];
+    q.contact_events[i]->contact_impulse += q.contact_events[i]->contact_tan2 * q.beta_c[j++];
+  }
+
+  // save limit impulses
+  for (unsigned i=0; i< N_LIMITS; i++)
+    q.limit_events[i]->limit_impulse = q.alpha_l[i]; 
+}
+
+/// Runs projected Gauss-Seidel on the impact problem (does all of the work)
+/**
+ * \param q the problem data; the current velocities (Jc_v, Dc_v, Jl_v, Jx_v)
+ *        are used
+ * \param x on entry, the initial impulses [alpha_c; beta_c; alpha_l; alpha_x];
+ *        on return, the computed impulses
+ * \return <b>false</b> if the sweeps were stopped because the deadline for 
+ *         the problem passed (the impulses are those from the last sweep)
+ */
+bool ImpactEventHandler::solve_iterative_work(const EventProblemData& q, VectorN& x) const
+{
+  SAFESTATIC MatrixN G;
+  SAFESTATIC VectorN b;
+  SAFESTATIC vector<Real> visc, diag;
+
+  // get the number of different types of each event
+  const unsigned N_CONTACTS = q.N_CONTACTS;
+  const unsigned N_LIMITS = q.N_LIMITS;
+
+  // setup variable indices
+  const unsigned ALPHA_C_IDX = 0;
+  const unsigned BETA_C_IDX = N_CONTACTS;
+  const unsigned ALPHA_L_IDX = N_CONTACTS*2 + BETA_C_IDX;
+  const unsigned ALPHA_X_IDX = N_LIMITS + ALPHA_L_IDX;
+  const unsigned NVARS = q.N_CONSTRAINT_EQNS_EXP + ALPHA_X_IDX;
+  const unsigned NX = NVARS - ALPHA_L_IDX;
+  assert(x.size() == NVARS);
+
+  // setup the columns of the (symmetric) Delassus matrix for the limit and
+  // explicit constraint variables; the contact-contact terms are taken 
+  // directly from the contact blocks
+  G.resize(NVARS, NX);
+  G.set_sub_mat(ALPHA_C_IDX, 0, q.Jc_iM_JlT);
+  G.set_sub_mat(ALPHA_C_IDX, N_LIMITS, q.Jc_iM_JxT);
+  G.set_sub_mat(BETA_C_IDX, 0, q.Dc_iM_JlT);
+  G.set_sub_mat(BETA_C_IDX, N_LIMITS, q.Dc_iM_JxT);
+  G.set_sub_mat(ALPHA_L_IDX, 0, q.Jl_iM_JlT);
+  G.set_sub_mat(ALPHA_L_IDX, N_LIMITS, q.Jl_iM_JxT);
+  G.set_sub_mat(ALPHA_X_IDX, 0, q.Jl_iM_JxT, true);
+  G.set_sub_mat(ALPHA_X_IDX, N_LIMITS, q.Jx_iM_JxT);
+
+  // get the diagonal of the Delassus matrix for the contact variables
+  diag.assign(ALPHA_L_IDX, (Real) 0.0);
+  for (unsigned s=0; s< q.contact_blocks.size(); s++)
+  {
+    const vector<unsigned>& contacts = q.super_body_contacts[s];
+    const EventProblemData::ContactBlock& block = q.contact_blocks[s];
+    for (unsigned a=0; a< contacts.size(); a++)
+    {
+      const unsigned i = contacts[a];
+      diag[ALPHA_C_IDX+i] += block.Jc_iM_JcT(a,a);
+      diag[BETA_C_IDX+i*2] += block.Dc_iM_DcT(a*2,a*2);
+      diag[BETA_C_IDX+i*2+1] += block.Dc_iM_DcT(a*2+1,a*2+1);
+    }
+  }
+
+  // setup the velocity vector
+  b.resize(NVARS);
+  b.set_sub_vec(ALPHA_C_IDX, q.Jc_v);
+  b.set_sub_vec(BETA_C_IDX, q.Dc_v);
+  b.set_sub_vec(ALPHA_L_IDX, q.Jl_v);
+  b.set_sub_vec(ALPHA_X_IDX, q.Jx_v);
+
+  // compute the viscous friction terms (mu_v * tangential velocity)
+  visc.resize(N_CONTACTS);
+  for (unsigned i=0, k=0; i< N_CONTACTS; i++, k+= 2)
+    visc[i] = q.contact_events[i]->contact_mu_viscous * std::sqrt(sqr(q.Dc_v[k]) + sqr(q.Dc_v[k+1]));
+
+  // the velocity for a contact variable is computed from the contact blocks
+  // and the corresponding row of G; the Delassus matrix is symmetric, so the
+  // velocity for a limit or constraint variable is computed using column k
+  // of G (contiguous in memory)
+  const Real* Gdata = G.data();
+  unsigned iter = 0;
+  for (; iter < iter_max_iterations; iter++)
+  {
+    Real max_delta = (Real) 0.0;
+
+    // process contacts: normal impulse first, then friction impulses
+    for (unsigned i=0, k=BETA_C_IDX; i< N_CONTACTS; i++, k+= 2)
+    {
+      // update the normal impulse
+      const unsigned n = ALPHA_C_IDX+i;
+      if (diag[n] > NEAR_ZERO)
+      {
+        Real w = calc_contact_row_dot(q, G, i, 0, x, BETA_C_IDX, ALPHA_L_IDX) + b[n];
+        Real xn = std::max((Real) 0.0, x[n] - w/diag[n]);
+        max_delta = std::max(max_delta, std::fabs(xn - x[n]));
+        x[n] = xn;
+      }
+
+      // update the friction impulses
+      Real xt[2] = { x[k], x[k+1] };
+      for (unsigned j=0; j< 2; j++)
+        if (diag[k+j] > NEAR_ZERO)
+        {
+          Real w = calc_contact_row_dot(q, G, i, j+1, x, BETA_C_IDX, ALPHA_L_IDX) + b[k+j];
+          xt[j] = x[k+j] - w/diag[k+j];
+        }
+
+      // project the friction impulses onto the friction disc
+      const Real LIMIT = q.contact_events[i]->contact_mu_coulomb * x[n] + visc[i];
+      const Real NRM = std::sqrt(sqr(xt[0]) + sqr(xt[1]));
+      if (NRM > LIMIT)
+      {
+        const Real SCAL = (NRM > (Real) 0.0) ? LIMIT/NRM : (Real) 0.0;
+        xt[0] *= SCAL;
+        xt[1] *= SCAL;
+      }
+      max_delta = std::max(max_delta, std::fabs(xt[0] - x[k]));
+      max_delta = std::max(max_delta, std::fabs(xt[1] - x[k+1]));
+      x[k] = xt[0];
+      x[k+1] = xt[1];
+    }
+
+    // process limits (impulses are nonnegative) and explicit constraints
+    // (impulses are unbounded)
+    for (unsigned i=ALPHA_L_IDX, k=0; i< NVARS; i++, k++)
+    {
+      if (G(i,k) <= NEAR_ZERO)
+        continue;
+      Real w = std::inner_product(x.begin(), x.end(), Gdata+k*NVARS, b[i]);
+      Real xi = x[i] - w/G(i,k);
+      if (i < ALPHA_X_IDX)
+        xi = std::max((Real) 0.0, xi);
+      max_delta = std::max(max_delta, std::fabs(xi - x[i]));
+      x[i] = xi;
+    }
+
+    // check for convergence
+    if (max_delta < iter_eps)
+    {
+      iter++;
+      break;
+    }
+
+    // stop if the deadline has passed; every sweep leaves the impulses 
+    // within their bounds, so the last sweep's impulses are used
+    if (deadline_passed(q))
+    {
+      FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::solve_iterative_work() - time budget exhausted after " << (iter+1) << " sweeps" << std::endl;
+      FILE_LOG(LOG_CONTACT) << "  impulses: " << x << std::endl;
+      return false;
+    }
+  }
+
+  FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::solve_iterative_work() - " << iter << " sweeps" << std::endl;
+  FILE_LOG(LOG_CONTACT) << "  impulses: " << x << std::endl;
+  return true;
+}
+
+/// Computes the dot product of a row of the iterative solver's Delassus matrix for a contact variable with the impulses
+/**
+ * \param q the problem data
+ * \param G the columns of the Delassus matrix for the limit and explicit 
+ *        constraint variables
+ * \param i the index of the contact
+ * \param dir 0 for the normal variable of the contact, 1 or 2 for the
+ *        tangent variables
+ * \param x the impulses [alpha_c; beta_c; alpha_l; alpha_x]
+ * \param BETA_C_IDX the index of beta_c in x
+ * \param ALPHA_L_IDX the index of alpha_l in x
+ */
+Real ImpactEventHandler::calc_contact_row_dot(const EventProblemData& q, const MatrixN& G, unsigned i, unsigned dir, const VectorN& x, unsigned BETA_C_IDX, unsigned ALPHA_L_IDX)
+{
+  Real dot = (Real) 0.0;
+
+  // add contributions from the contacts in the blocks of the contact's 
+  // super bodies
+  for (unsigned m=0; m< q.contact_block_entries[i].size(); m++)
+  {
+    const unsigned s = q.contact_block_entries[i][m].first;
+    const unsigned a = q.contact_block_entries[i][m].second;
+    const vector<unsigned>& contacts = q.super_body_contacts[s];
+    const EventProblemData::ContactBlock& block = q.contact_blocks[s];
+    for (unsigned b=0; b< contacts.size(); b++)
+    {
+      const unsigned j = contacts[b];
+      const unsigned k = BETA_C_IDX + j*2;
+      if (dir == 0)
+        dot += block.Jc_iM_JcT(a,b)*x[j] + block.Jc_iM_DcT(a,b*2)*x[k] + block.Jc_iM_DcT(a,b*2+1)*x[k+1];
+      else
+      {
+        const unsigned t = a*2 + dir-1;
+        dot += block.Jc_iM_DcT(b,t)*x[j] + block.Dc_iM_DcT(t,b*2)*x[k] + block.Dc_iM_DcT(t,b*2+1)*x[k+1];
+      }
+    }
+  }
+
+  // add contributions from limits and explicit constraints
+  const unsigned ROW = (dir == 0) ? i : BETA_C_IDX + i*2 + dir-1;
+  for (unsigned k=0; k< G.columns(); k++)
+    dot += G(ROW,k)*x[ALPHA_L_IDX+k];
+
+  return dot;
+}
+
+/// Gets initial guesses for contact impulses from the impulses of the last call to process_events()
+/**
+ * Each persistent contact (see find_cached_contact()) takes the impulse of
+ * the contact from the last call, expressed in the contact's current frame.
+ * Other contacts get zero impulse.
+ * \param q the problem data; alpha_c0 and beta_c0 are set on return
+ */
+void ImpactEventHandler::get_warm_start_impulses(EventProblemData& q) const
+{
+  const unsigned N_CONTACTS = q.N_CONTACTS;
+
+  q.alpha_c0.set_zero(N_CONTACTS);
+  q.beta_c0.set_zero(N_CONTACTS*2);
+  for (unsigned i=0, k=0; i< N_CONTACTS; i++, k+= 2)
+  {
+    const Event& e = *q.contact_events[i];
+
+    // look for the contact from the last call
+    const CachedContact* cc = find_cached_contact(e);
+    if (!cc)
+      continue;
+
+    // get the impulse in the global frame (cached impulses are applied to 
+    // the first geometry)
+    sorted_pair<CollisionGeometryPtr> geoms(e.contact_geom1, e.contact_geom2);
+    Vector3 impulse = geoms.first->get_transform().mult_vector(cc->impulse);
+    if (e.contact_geom1 != geoms.first)
+      impulse = -impulse;
+
+    // express the impulse in the contact frame
+    q.alpha_c0[i] = std::max((Real) 0.0, e.contact_normal.dot(impulse));
+    q.beta_c0[k] = e.contact_tan1.dot(impulse);
+    q.beta_c0[k+1] = e.contact_tan2.dot(impulse);
+  }
+}
+
+/// Gets the grid cell (used for contact keys) containing a point
+void ImpactEventHandler::get_contact_cell(const Vector3& p, int cell[3]) const
+{
+  for (unsigned i=0; i< 3; i++)
+    cell[i] = (int) std::floor(p[i]/warm_start_dist);
+}
+
+/// Matches the contact events of the current call to process_events() to the contacts solved by the last call
+/**
+ * A contact event and a cached contact match if they are between the same
+ * pair of geometries and their points, expressed in the frame of the first
+ * geometry of the pair, are within warm_start_dist of one another.  The
+ * cached contacts keyed to the grid cell containing the point and to the
+ * neighboring cells are examined.  The closest pairs are matched first, and
+ * each contact event and each cached contact is matched at most once, so 
+ * that no cached impulse is used twice.
+ */
+void ImpactEventHandler::match_cached_contacts(const list<list<Event*> >& groups)
+{
+  const Real MAX_DIST_SQ = sqr(warm_start_dist);
+  typedef std::multimap<ContactKey, CachedContact>::const_iterator CacheIter;
+
+  _cache_matches.clear();
+  if (!warm_start || _contact_cache.empty() || warm_start_dist <= (Real) 0.0)
+    return;
+
+  // determine all pairs of contact events and nearby cached contacts
+  vector<pair<Real, pair<const Event*, const CachedContact*> > > candidates;
+  for (list<list<Event*> >::const_iterator i = groups.begin(); i != groups.end(); i++)
+    for (list<Event*>::const_iterator j = i->begin(); j != i->end(); j++)
+    {
+      const Event& e = **j;
+      if (e.event_type != Event::eContact)
+        continue;
+
+      // get the contact point in the frame of the first geometry 
+      ContactKey key(sorted_pair<CollisionGeometryPtr>(e.contact_geom1, e.contact_geom2));
+      Vector3 p = key.geoms.first->get_transform().inverse_mult_point(e.contact_point);
+
+      // examine the contacts in the neighboring cells
+      int cell[3];
+      get_contact_cell(p, cell);
+      for (int a=-1; a<= 1; a++)
+        for (int b=-1; b<= 1; b++)
+          for (int c=-1; c<= 1; c++)
+          {
+            key.cell[0] = cell[0]+a;
+            key.cell[1] = cell[1]+b;
+            key.cell[2] = cell[2]+c;
+            pair<CacheIter, CacheIter> range = _contact_cache.equal_range(key);
+            for (CacheIter k = range.first; k != range.second; k++)
+            {
+              Real dist_sq = (k->second.point - p).norm_sq();
+              if (dist_sq <= MAX_DIST_SQ)
+                candidates.push_back(std::make_pair(dist_sq, std::make_pair(&e, &k->second)));
+            }
+          }
+    }
+
+  // match the closest pairs first
+  std::sort(candidates.begin(), candidates.end());
+  std::set<const CachedContact*> used;
+  for (unsigned i=0; i< candidates.size(); i++)
+  {
+    const Event* e = candidates[i].second.first;
+    const CachedContact* cc = candidates[i].second.second;
+    if (_cache_matches.find(e) != _cache_matches.end() || used.find(cc) != used.end())
+      continue;
+    _cache_matches[e] = cc;
+    used.insert(cc);
+  }
+
+  FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::match_cached_contacts() - " << _cache_matches.size() << " persistent contacts" << endl;
+}
+
+/// Finds the contact from the last call to process_events() that corresponds to a contact event (see match_cached_contacts())
+/**
+ * \return a pointer to the cached contact, or NULL if the contact is new
+ */
+const ImpactEventHandler::CachedContact* ImpactEventHandler::find_cached_contact(const Event& e) const
+{
+  map<const Event*, const CachedContact*>::const_iterator i = _cache_matches.find(&e);
+  return (i == _cache_matches.end()) ? NULL : i->second;
+}
+
+/// Determines the contact tangents for a contact event
+/**
+ * A persistent contact (see find_cached_contact()) keeps the tangents it had
+ * in the last call to process_events() (projected to be orthogonal to the
+ * current contact normal), so that its friction impulses remain comparable
+ * across calls; other contacts get new tangents.
+ */
+void ImpactEventHandler::determine_contact_tangents(Event& e) const
+{
+  const CachedContact* cc = (warm_start) ? find_cached_contact(e) : NULL;
+  if (cc)
+  {
+    // get the cached tangent in the global frame
+    sorted_pair<CollisionGeometryPtr> geoms(e.contact_geom1, e.contact_geom2);
+    Vector3 tan1 = geoms.first->get_transform().mult_vector(cc->tan1);
+
+    // make it orthogonal to the contact normal
+    tan1 -= e.contact_normal * e.contact_normal.dot(tan1);
+    Real nrm = tan1.norm();
+    if (nrm > NEAR_ZERO)
+    {
+      e.contact_tan1 = tan1/nrm;
+      e.contact_tan2 = Vector3::normalize(Vector3::cross(e.contact_normal, e.contact_tan1));
+      return;
+    }
+  }
+
+  e.determine_contact_tangents();
+}
+
+/// Saves the solved contacts (and their impulses) for use by the next call to process_events()
+/**
+ * \param solved the events whose impulses were computed, for each group 
+ *        (contacts dropped from the reduced sets have no impulses and are
+ *        not saved)
+ */
+void ImpactEventHandler::save_contact_cache(const vector<list<Event*> >& solved)
+{
+  // the matches refer to the old cache
+  _cache_matches.clear();
+  _contact_cache.clear();
+  if (!warm_start || warm_start_dist <= (Real) 0.0)
+    return;
+
+  for (unsigned i=0; i< solved.size(); i++)
+    for (list<Event*>::const_iterator j = solved[i].begin(); j != solved[i].end(); j++)
+    {
+      const Event& e = **j;
+      if (e.event_type != Event::eContact)
+        continue;
+
+      // store the contact in the frame of the first geometry of the pair
+      ContactKey key(sorted_pair<CollisionGeometryPtr>(e.contact_geom1, e.contact_geom2));
+      const Matrix4& T = key.geoms.first->get_transform();
+      CachedContact cc;
+      cc.point = T.inverse_mult_point(e.contact_point);
+      cc.tan1 = T.transpose_mult_vector(e.contact_tan1);
+      cc.impulse = T.transpose_mult_vector((e.contact_geom1 == key.geoms.first) ? e.contact_impulse : -e.contact_impulse);
+      get_contact_cell(cc.point, key.cell);
+      _contact_cache.insert(std::make_pair(key, cc));
+    }
+
+  FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::save_contact_cache() - " << _contact_cache.size() << " contacts cached" << endl;
+}
+
+/// Updates impulses in q using concatenated vector of impulses z
+void ImpactEventHandler::update_impulses(EventProblemData& q, const VectorN& z)
+{
+  SAFESTATIC VectorN tmp;
+
+  // get the number of different types of each event
+  const unsigned UINF = std::numeric_limits<unsigned>::max();
+  const unsigned N_CONTACTS = q.N_CONTACTS;
+  const unsigned N_LIMITS = q.N_LIMITS;
+  const unsigned N_CONSTRAINT_EQNS = q.N_CONSTRAINT_EQNS_EXP;
+  const unsigned N_K_TOTAL = q.N_K_TOTAL;
   const unsigned ALPHA_C_IDX = 0;
   const unsigned BETA_C_IDX = N_CONTACTS;
   const unsigned NBETA_C_IDX = BETA_C_IDX + N_CONTACTS*2;
@@ -820,6 +1884,7 @@ void ImpactEventHandler::solve_nqp_work(EventProblemData& q, VectorN& z)
   const unsigned UINF = std::numeric_limits<unsigned>::max();
   SAFESTATIC MatrixN sub, t1, t2, t3, t4, A, MR, RTH;
   SAFESTATIC VectorN tmpv, y;
+  SAFESTATIC MatrixN Jc_iM_JcT, Jc_iM_DcT, Dc_iM_DcT;
 
   // get the number of different types of each event
   const unsigned N_CONTACTS = q.N_CONTACTS;
@@ -832,6 +1897,9 @@ void ImpactEventHandler::solve_nqp_work(EventProblemData& q, VectorN& z)
   const unsigned N_TRUE_CONE = q.N_TRUE_CONE;
   const unsigned N_LOOPS = q.N_LOOPS;
 
+  // assemble the (dense) contact-contact terms
+  q.get_contact_terms(Jc_iM_JcT, Jc_iM_DcT, Dc_iM_DcT);
+
   // setup variable indices
   const unsigned ALPHA_C_IDX = 0;
   const unsigned BETA_C_IDX = N_CONTACTS;
@@ -896,7 +1964,7 @@ void ImpactEventHandler::solve_nqp_work(EventProblemData& q, VectorN& z)
 
   // setup number of nonlinear inequality constraints
   const unsigned N_JF_DOF = N_CONSTRAINT_DOF_IMP + N_CONSTRAINT_DOF_EXP;
-  const unsigned NONLIN_INEQUAL = N_TRUE_CONE + N_JF_DOF + N_LOOPS;
+  const unsigned NONLIN_INEQUAL = N_TRUE_CONE + N_JF_DOF + N_LOOPS*2;
 
   // setup the optimization data
   set_optimization_data(q, opt_data);
@@ -922,13 +1990,13 @@ void ImpactEventHandler::solve_nqp_work(EventProblemData& q, VectorN& z)
   unsigned row = 0;
 
   // row (block) 1 -- Jc * iM * [Jc' Dc' Jl' Dt' Jx' Dx']
-  H.set_sub_row_block(0,&q.Jc_iM_JcT, &q.Jc_iM_DcT, &q.Jc_iM_JlT, 
+  H.set_sub_row_block(0,&Jc_iM_JcT, &Jc_iM_DcT, &q.Jc_iM_JlT, 
                         &q.Jc_iM_DtT, &q.Jc_iM_JxT, &q.Jc_iM_DxT);
   row += N_CONTACTS;
   
   // row (block) 2 -- Dc * iM * [Jc' Dc' Jl' Dt' Jx' Dx']
-  MatrixN::transpose(q.Jc_iM_DcT, t1);
-  H.set_sub_row_block(row, &t1,          &q.Dc_iM_DcT, &q.Dc_iM_JlT, 
+  MatrixN::transpose(Jc_iM_DcT, t1);
+  H.set_sub_row_block(row, &t1,          &Dc_iM_DcT, &q.Dc_iM_JlT, 
                            &q.Dc_iM_DtT, &q.Dc_iM_JxT, &q.Dc_iM_DxT);
   row += N_CONTACTS*2;
 
@@ -1068,11 +2136,11 @@ void ImpactEventHandler::solve_nqp_work(EventProblemData& q, VectorN& z)
   M.copy_from(MR);
 
   FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::solve_nqp_work() entered" << std::endl;
-  FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Jc': " << std::endl << q.Jc_iM_JcT;
-  FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Dc': " << std::endl << q.Jc_iM_DcT;
+  FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Jc': " << std::endl << Jc_iM_JcT;
+  FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Dc': " << std::endl << Jc_iM_DcT;
   FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Jl': " << std::endl << q.Jc_iM_JlT;
   FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Jx': " << std::endl << q.Jc_iM_JxT;
-  FILE_LOG(LOG_CONTACT) << "  Dc * inv(M) * Dc': " << std::endl << q.Dc_iM_DcT;
+  FILE_LOG(LOG_CONTACT) << "  Dc * inv(M) * Dc': " << std::endl << Dc_iM_DcT;
   FILE_LOG(LOG_CONTACT) << "  Dc * inv(M) * Jl': " << std::endl << q.Dc_iM_JlT;
   FILE_LOG(LOG_CONTACT) << "  Dc * inv(M) * Jx': " << std::endl << q.Dc_iM_JxT;
   FILE_LOG(LOG_CONTACT) << "  Jl * inv(M) * Jl': " << std::endl << q.Jl_iM_JlT;
@@ -1111,12 +2179,15 @@ oparams.max_iterations = 10000;
 
 /// Solves the quadratic program (does all of the work)
 /**
+ * \return <b>false</b> if Lemke's algorithm was stopped because the deadline
+ *         for the problem passed 
  * \note this is the version without joint friction forces
  */
-void ImpactEventHandler::solve_qp_work(EventProblemData& q, VectorN& z)
+bool ImpactEventHandler::solve_qp_work(EventProblemData& q, VectorN& z) const
 {
   SAFESTATIC MatrixN sub, t1, t2, t3, neg1, A, AR, R, RTH;
   SAFESTATIC MatrixN H, MM;
+  SAFESTATIC MatrixN Jc_iM_JcT, Jc_iM_DcT, Dc_iM_DcT;
   SAFESTATIC VectorN negv, c, qq, nb, tmpv, y;
 
   // get the number of different types of each event
@@ -1125,6 +2196,9 @@ void ImpactEventHandler::solve_qp_work(EventProblemData& q, VectorN& z)
   const unsigned N_CONSTRAINT_EQNS_EXP = q.N_CONSTRAINT_EQNS_EXP;
   const unsigned N_K_TOTAL = q.N_K_TOTAL;
 
+  // assemble the (dense) contact-contact terms
+  q.get_contact_terms(Jc_iM_JcT, Jc_iM_DcT, Dc_iM_DcT);
+
   // setup variable indices
   const unsigned ALPHA_C_IDX = 0;
   const unsigned BETA_C_IDX = N_CONTACTS;
@@ -1184,15 +2258,15 @@ void ImpactEventHandler::solve_qp_work(EventProblemData& q, VectorN& z)
   unsigned col = 0, row = 0;
 
   // row (block) 1 -- Jc * iM * [Jc' Dc' -Dc' Jl' Jx']
-  neg1.copy_from(q.Jc_iM_DcT).negate();
-  H.set_sub_row_block(0, &q.Jc_iM_JcT, &q.Jc_iM_DcT, &neg1, &q.Jc_iM_JlT, 
+  neg1.copy_from(Jc_iM_DcT).negate();
+  H.set_sub_row_block(0, &Jc_iM_JcT, &Jc_iM_DcT, &neg1, &q.Jc_iM_JlT, 
                       &q.Jc_iM_JxT);
   row += N_CONTACTS;
   
   // row (block) 2 -- Dc * iM * [Jc' Dc' -Dc' Jl' Jx']
-  MatrixN::transpose(q.Jc_iM_DcT, t1);
-  neg1.copy_from(q.Dc_iM_DcT).negate();
-  H.set_sub_row_block(row, &t1, &q.Dc_iM_DcT, &neg1, &q.Dc_iM_JlT, 
+  MatrixN::transpose(Jc_iM_DcT, t1);
+  neg1.copy_from(Dc_iM_DcT).negate();
+  H.set_sub_row_block(row, &t1, &Dc_iM_DcT, &neg1, &q.Dc_iM_JlT, 
                       &q.Dc_iM_JxT);
 
   // row (block 3) -- negated block 2
@@ -1293,11 +2367,11 @@ void ImpactEventHandler::solve_qp_work(EventProblemData& q, VectorN& z)
   qq.set_sub_vec(N_PRIMAL, nb);
 
   FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::solve_qp() entered" << std::endl;
-  FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Jc': " << std::endl << q.Jc_iM_JcT;
-  FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Dc': " << std::endl << q.Jc_iM_DcT;
+  FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Jc': " << std::endl << Jc_iM_JcT;
+  FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Dc': " << std::endl << Jc_iM_DcT;
   FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Jl': " << std::endl << q.Jc_iM_JlT;
   FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Jx': " << std::endl << q.Jc_iM_JxT;
-  FILE_LOG(LOG_CONTACT) << "  Dc * inv(M) * Dc': " << std::endl << q.Dc_iM_DcT;
+  FILE_LOG(LOG_CONTACT) << "  Dc * inv(M) * Dc': " << std::endl << Dc_iM_DcT;
   FILE_LOG(LOG_CONTACT) << "  Dc * inv(M) * Jl': " << std::endl << q.Dc_iM_JlT;
   FILE_LOG(LOG_CONTACT) << "  Dc * inv(M) * Jx': " << std::endl << q.Dc_iM_JxT;
   FILE_LOG(LOG_CONTACT) << "  Jl * inv(M) * Jl': " << std::endl << q.Jl_iM_JlT;
@@ -1314,9 +2388,41 @@ void ImpactEventHandler::solve_qp_work(EventProblemData& q, VectorN& z)
   FILE_LOG(LOG_CONTACT) << "LCP matrix: " << std::endl << MM; 
   FILE_LOG(LOG_CONTACT) << "LCP vector: " << qq << std::endl; 
 
-  // solve the LCP using Lemke's algorithm
-  if (!Optimization::lcp_lemke_regularized(MM, qq, tmpv))
+  // setup the initial basis for Lemke's algorithm using the impulse guesses
+  // (only possible when the QP variables are the impulses themselves)
+  tmpv.resize(0);
+  if (N_CONSTRAINT_EQNS_EXP == 0 && q.alpha_c0.size() == N_CONTACTS)
+    get_lcp_warm_start(q, N_PRIMAL + N_INEQUAL, tmpv);
+
+  // solve the LCP using Lemke's algorithm (stopping at the deadline)
+  const double T0 = (capture_filename.empty()) ? 0.0 : WallClock::now();
+  bool solved = Optimization::lcp_lemke_regularized(MM, qq, tmpv, -20, 4, 20, -1.0, -1.0, &lemke_tcheck, &q);
+
+  // capture the QP, if desired (AR was negated to setup the LCP matrix)
+  if (!capture_filename.empty())
+  {
+    ProblemCapture::Problem p;
+    p.type = ProblemCapture::eQP;
+    p.solver = "ImpactEventHandler::solve_qp_work";
+    p.solved = solved;
+    p.time = (Real) (WallClock::now() - T0);
+    p.M.copy_from(H);
+    p.q.copy_from(c);
+    p.A.copy_from(AR).negate();
+    p.b.copy_from(nb).negate();
+    tmpv.get_sub_vec(0, std::min(N_PRIMAL, tmpv.size()), p.z);
+    ProblemCapture::append(capture_filename, p);
+  }
+
+  if (!solved)
+  {
+    if (deadline_passed(q))
+    {
+      FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::solve_qp() - time budget exhausted" << std::endl;
+      return false;
+    }
     throw std::runtime_error("Unable to solve event QP!");
+  }
 
   // get the nullspace solution out
   FILE_LOG(LOG_CONTACT) << "LCP solution: " << tmpv << std::endl; 
@@ -1326,42 +2432,607 @@ void ImpactEventHandler::solve_qp_work(EventProblemData& q, VectorN& z)
 
   FILE_LOG(LOG_CONTACT) << "QP solution: " << z << std::endl; 
   FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::solve_qp() exited" << std::endl;
+  return true;
 }
 
-/// Solves the (frictionless) LCP
-void ImpactEventHandler::solve_lcp(EventProblemData& q, VectorN& z)
+/// Gets an entry of the Hessian of the QP solved by solve_qp_work() when there are no explicit constraint equations
+/**
+ * The QP variables are [alpha_c; beta_c; nbeta_c; alpha_l].
+ */
+Real ImpactEventHandler::get_qp_hessian_entry(const EventProblemData& q, unsigned u, unsigned v)
 {
-  SAFESTATIC MatrixN UL, LR, MM;
-  SAFESTATIC MatrixN UR, t2, iJx_iM_JxT;
-  SAFESTATIC VectorN alpha_c, alpha_l, alpha_x, v1, v2, qq;
+  const unsigned N_CONTACTS = q.N_CONTACTS;
+  const unsigned BETA_C_IDX = N_CONTACTS;
+  const unsigned NBETA_C_IDX = N_CONTACTS*3;
+  const unsigned ALPHA_L_IDX = N_CONTACTS*5;
+  enum { eNormal, eTangent, eLimit };
+
+  // determine the type (normal, tangent, or limit), index, and sign of the
+  // two variables
+  const unsigned vars[2] = { u, v };
+  unsigned type[2], idx[2];
+  Real sign = (Real) 1.0;
+  for (unsigned k=0; k< 2; k++)
+  {
+    const unsigned x = vars[k];
+    if (x < BETA_C_IDX)
+    {
+      type[k] = eNormal;
+      idx[k] = x;
+    }
+    else if (x < NBETA_C_IDX)
+    {
+      type[k] = eTangent;
+      idx[k] = x - BETA_C_IDX;
+    }
+    else if (x < ALPHA_L_IDX)
+    {
+      type[k] = eTangent;
+      idx[k] = x - NBETA_C_IDX;
+      sign = -sign;
+    }
+    else
+    {
+      type[k] = eLimit;
+      idx[k] = x - ALPHA_L_IDX;
+    }
+  }
+
+  // get the entry from the appropriate block
+  const unsigned i = idx[0], j = idx[1];
+  switch (type[0]*3 + type[1])
+  {
+    case eNormal*3 + eNormal:   return sign * q.get_Jc_iM_JcT(i,j);
+    case eNormal*3 + eTangent:  return sign * q.get_Jc_iM_DcT(i,j);
+    case eNormal*3 + eLimit:    return sign * q.Jc_iM_JlT(i,j);
+    case eTangent*3 + eNormal:  return sign * q.get_Jc_iM_DcT(j,i);
+    case eTangent*3 + eTangent: return sign * q.get_Dc_iM_DcT(i,j);
+    case eTangent*3 + eLimit:   return sign * q.Dc_iM_JlT(i,j);
+    case eLimit*3 + eNormal:    return sign * q.Jc_iM_JlT(j,i);
+    case eLimit*3 + eTangent:   return sign * q.Dc_iM_JlT(j,i);
+    default:                    return sign * q.Jl_iM_JlT(i,j);
+  }
+}
+
+/// Solves the QP solved by solve_qp_work() using a sparse primal-dual interior-point method
+/**
+ * This method may be used only when there are no explicit constraint 
+ * equations.  The QP is:
+ * minimize 0.5*y'*H*y + c'*y subject to A*y >= b, y >= 0
+ * where H and A are sparse: the entries of H for two events can be nonzero
+ * only if the events involve a common super body (see determine_event_blocks
+ * in EventProblemData).  The sparsity pattern of the (quasidefinite) KKT 
+ * matrix 
+ * | H + inv(Y)*M   -A'           |
+ * | -A             -inv(L)*S     |
+ * is analyzed once; the matrix is then refactored (using a sparse LDL'
+ * factorization) at each iteration of Mehrotra's predictor-corrector method.
+ * \param q the event problem data
+ * \param z the solution [alpha_c; beta_c; nbeta_c; alpha_l], on return
+ * \return <b>true</b> if the method converged within ip_max_iterations
+ *         iterations (and before the deadline for the problem)
+ */
+bool ImpactEventHandler::solve_qp_work_ip(EventProblemData& q, VectorN& z) const
+{
+  const Real STEP_FRAC = 0.995;
+  SAFESTATIC SparseLDL ldl;
+  SAFESTATIC vector<vector<unsigned> > coupled;
+  SAFESTATIC vector<unsigned> event_vars, Hp, Hi, Ap, Ai, ATp, ATi, Kp, Ki, fill;
+  SAFESTATIC vector<Real> Hx, Ax, ATx, Kx, bfric;
+  SAFESTATIC VectorN c, b, y, s, lambda, mu, rd, rp, ryu, rsl, rhs, dy, ds;
+  SAFESTATIC VectorN dlambda, dmu, dy_aff, ds_aff, dlambda_aff, dmu_aff, tmpv;
 
   // get the number of different types of each event
   const unsigned N_CONTACTS = q.N_CONTACTS;
   const unsigned N_LIMITS = q.N_LIMITS;
-  const unsigned N_CONSTRAINT_EQNS_EXP = q.N_CONSTRAINT_EQNS_EXP;
-  const unsigned N_K_TOTAL = q.N_K_TOTAL;
-  const unsigned N_LIN_CONE = q.N_LIN_CONE;
-  const unsigned N_TRUE_CONE = q.N_TRUE_CONE;
-  const unsigned N_LOOPS = q.N_LOOPS;
+  const unsigned N_EVENTS = N_CONTACTS + N_LIMITS;
+
+  // get the start time, if the QP is to be captured
+  const double T0 = (capture_filename.empty()) ? 0.0 : WallClock::now();
 
   // setup variable indices
   const unsigned ALPHA_C_IDX = 0;
   const unsigned BETA_C_IDX = N_CONTACTS;
   const unsigned NBETA_C_IDX = N_CONTACTS*3;
-  const unsigned ALPHA_L_IDX = N_LIN_CONE*2 + NBETA_C_IDX;
-  const unsigned ALPHA_X_IDX = N_LIMITS + ALPHA_L_IDX;
-  const unsigned BETA_T_IDX = q.N_CONSTRAINT_EQNS_EXP + ALPHA_X_IDX;
-  const unsigned BETA_X_IDX = q.N_CONSTRAINT_DOF_IMP + BETA_T_IDX;
-  const unsigned DELTA_IDX = BETA_X_IDX + q.N_CONSTRAINT_DOF_EXP;
-  const unsigned NVARS = N_LOOPS + DELTA_IDX; 
+  const unsigned ALPHA_L_IDX = N_CONTACTS*5;
+  const unsigned n = ALPHA_L_IDX + N_LIMITS;
+  assert(q.N_CONSTRAINT_EQNS_EXP == 0);
 
-  // setup sizes
-  UL.resize(N_CONTACTS, N_CONTACTS);
-  UR.resize(N_CONTACTS, N_LIMITS);
-  LR.resize(N_LIMITS, N_LIMITS);
+  FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::solve_qp_work_ip() entered" << std::endl;
 
-  // setup primary terms -- first upper left hand block of matrix
-  iJx_iM_JxT.copy_from(q.Jx_iM_JxT);
+  // look for trivial problem
+  z.set_zero(n);
+  if (n == 0)
+    return true;
+
+  // determine the events coupled to each event (contact i is event i, limit
+  // j is event N_CONTACTS+j) 
+  coupled.resize(N_EVENTS);
+  for (unsigned i=0; i< N_EVENTS; i++)
+  {
+    coupled[i].clear();
+    coupled[i].push_back(i);
+  }
+  for (unsigned k=0; k< q.super_bodies.size(); k++)
+  {
+    const vector<unsigned>& contacts = q.super_body_contacts[k];
+    const vector<unsigned>& limits = q.super_body_limits[k];
+    for (unsigned i=0; i< contacts.size(); i++)
+    {
+      vector<unsigned>& ci = coupled[contacts[i]];
+      ci.insert(ci.end(), contacts.begin(), contacts.end());
+      for (unsigned j=0; j< limits.size(); j++)
+        ci.push_back(N_CONTACTS + limits[j]);
+    }
+    for (unsigned i=0; i< limits.size(); i++)
+    {
+      vector<unsigned>& ci = coupled[N_CONTACTS + limits[i]];
+      ci.insert(ci.end(), contacts.begin(), contacts.end());
+      for (unsigned j=0; j< limits.size(); j++)
+        ci.push_back(N_CONTACTS + limits[j]);
+    }
+  }
+  for (unsigned i=0; i< N_EVENTS; i++)
+  {
+    std::sort(coupled[i].begin(), coupled[i].end());
+    coupled[i].erase(std::unique(coupled[i].begin(), coupled[i].end()), coupled[i].end());
+  }
+
+  // setup H (compressed row storage) using the coupling
+  Hp.resize(n+1);
+  Hi.clear();
+  Hx.clear();
+  for (unsigned u=0; u< n; u++)
+  {
+    // get the event for the variable
+    unsigned e;
+    if (u < BETA_C_IDX)
+      e = u;
+    else if (u < NBETA_C_IDX)
+      e = (u - BETA_C_IDX)/2;
+    else if (u < ALPHA_L_IDX)
+      e = (u - NBETA_C_IDX)/2;
+    else
+      e = N_CONTACTS + u - ALPHA_L_IDX;
+
+    // get the variables for all coupled events
+    event_vars.clear();
+    for (unsigned k=0; k< coupled[e].size(); k++)
+    {
+      const unsigned f = coupled[e][k];
+      if (f < N_CONTACTS)
+      {
+        event_vars.push_back(ALPHA_C_IDX + f);
+        event_vars.push_back(BETA_C_IDX + f*2);
+        event_vars.push_back(BETA_C_IDX + f*2 + 1);
+        event_vars.push_back(NBETA_C_IDX + f*2);
+        event_vars.push_back(NBETA_C_IDX + f*2 + 1);
+      }
+      else
+        event_vars.push_back(ALPHA_L_IDX + f - N_CONTACTS);
+    }
+    std::sort(event_vars.begin(), event_vars.end());
+
+    // store the row
+    Hp[u] = Hi.size();
+    for (unsigned k=0; k< event_vars.size(); k++)
+    {
+      Hi.push_back(event_vars[k]);
+      Hx.push_back(get_qp_hessian_entry(q, u, event_vars[k]));
+    }
+  }
+  Hp[n] = Hi.size();
+
+  // setup c
+  c.resize(n);
+  c.set_sub_vec(ALPHA_C_IDX, q.Jc_v);         
+  c.set_sub_vec(BETA_C_IDX, q.Dc_v);         
+  c.set_sub_vec(NBETA_C_IDX, tmpv.copy_from(q.Dc_v).negate());           
+  c.set_sub_vec(ALPHA_L_IDX, q.Jl_v);         
+
+  // setup A (compressed row storage) and b; first, the Jc*v+ >= 0 and 
+  // Jl*v+ >= 0 constraints use rows of H
+  Ap.clear();
+  Ai.clear();
+  Ax.clear();
+  for (unsigned k=0; k< N_CONTACTS + N_LIMITS; k++)
+  {
+    const unsigned u = (k < N_CONTACTS) ? ALPHA_C_IDX + k : ALPHA_L_IDX + k - N_CONTACTS;
+    Ap.push_back(Ai.size());
+    Ai.insert(Ai.end(), Hi.begin() + Hp[u], Hi.begin() + Hp[u+1]);
+    Ax.insert(Ax.end(), Hx.begin() + Hp[u], Hx.begin() + Hp[u+1]);
+  }
+  b.resize(N_CONTACTS + N_LIMITS);
+  for (unsigned i=0; i< N_CONTACTS; i++)
+    b[i] = -q.Jc_v[i];
+  for (unsigned i=0; i< N_LIMITS; i++)
+    b[N_CONTACTS+i] = -q.Jl_v[i];
+
+  // setup the contact friction constraints
+  // mu_c*cn + mu_v*cvel >= beta
+  bfric.clear();
+  for (unsigned i=0, k=0; i< N_CONTACTS; i++, k+= 2)
+  {
+    // initialize the contact velocity
+    Real vel = std::sqrt(sqr(q.Dc_v[k]) + sqr(q.Dc_v[k+1]));
+
+    // setup the Coulomb friction inequality constraints for this contact
+    const unsigned NK = q.contact_events[i]->contact_NK;
+    for (unsigned j=0; j< NK; j++)
+    {
+      Real theta = (NK > 1) ? (Real) j/(NK-1) * M_PI_2 : (Real) 0.0;
+      const Real ct = std::cos(theta);
+      const Real st = std::sin(theta);
+      const unsigned cols[5] = { ALPHA_C_IDX+i, BETA_C_IDX+k, BETA_C_IDX+k+1, NBETA_C_IDX+k, NBETA_C_IDX+k+1 };
+      const Real vals[5] = { q.contact_events[i]->contact_mu_coulomb, -ct, -st, -ct, -st };
+      Ap.push_back(Ai.size());
+      Ai.insert(Ai.end(), cols, cols+5);
+      Ax.insert(Ax.end(), vals, vals+5);
+
+      // setup the viscous friction component
+      bfric.push_back(-q.contact_events[i]->contact_mu_viscous * vel);
+    }
+  }
+
+  // setup the normal impulse constraint
+  // 1'cn <= kappa (equiv. to -1'cn >= -kappa)
+  if (q.use_kappa)
+  {
+    Ap.push_back(Ai.size());
+    for (unsigned i=0; i< N_CONTACTS; i++)
+    {
+      Ai.push_back(ALPHA_C_IDX+i);
+      Ax.push_back((Real) -1.0);
+    }
+    bfric.push_back(-q.kappa);
+  }
+  const unsigned m = Ap.size();
+  Ap.push_back(Ai.size());
+  b.resize(m, true);
+  std::copy(bfric.begin(), bfric.end(), b.begin() + N_CONTACTS + N_LIMITS);
+
+  // setup A' (compressed row storage)
+  ATp.assign(n+1, 0);
+  for (unsigned p=0; p< Ai.size(); p++)
+    ATp[Ai[p]+1]++;
+  for (unsigned j=0; j< n; j++)
+    ATp[j+1] += ATp[j];
+  ATi.resize(Ai.size());
+  ATx.resize(Ai.size());
+  fill.assign(ATp.begin(), ATp.end()-1);
+  for (unsigned r=0; r< m; r++)
+    for (unsigned p=Ap[r]; p< Ap[r+1]; p++)
+    {
+      const unsigned dest = fill[Ai[p]]++;
+      ATi[dest] = r;
+      ATx[dest] = Ax[p];
+    }
+
+  // setup the pattern of the KKT matrix (compressed column storage, both
+  // triangles) and analyze it
+  Kp.resize(n+m+1);
+  Ki.clear();
+  for (unsigned j=0; j< n; j++)
+  {
+    Kp[j] = Ki.size();
+    Ki.insert(Ki.end(), Hi.begin() + Hp[j], Hi.begin() + Hp[j+1]);
+    for (unsigned p=ATp[j]; p< ATp[j+1]; p++)
+      Ki.push_back(n + ATi[p]);
+  }
+  for (unsigned r=0; r< m; r++)
+  {
+    Kp[n+r] = Ki.size();
+    Ki.insert(Ki.end(), Ai.begin() + Ap[r], Ai.begin() + Ap[r+1]);
+    Ki.push_back(n+r);
+  }
+  Kp[n+m] = Ki.size();
+  Kx.resize(Ki.size());
+  ldl.analyze(n+m, Kp, Ki);
+
+  // setup sparse matrices for multiplication
+  boost::shared_array<unsigned> Hp_s(new unsigned[Hp.size()]), Hi_s(new unsigned[Hi.size()]);
+  boost::shared_array<Real> Hx_s(new Real[Hx.size()]);
+  std::copy(Hp.begin(), Hp.end(), Hp_s.get());
+  std::copy(Hi.begin(), Hi.end(), Hi_s.get());
+  std::copy(Hx.begin(), Hx.end(), Hx_s.get());
+  SparseMatrixN H(n, n, Hp_s, Hi_s, Hx_s);
+  boost::shared_array<unsigned> Ap_s(new unsigned[Ap.size()]), Ai_s(new unsigned[Ai.size()]);
+  boost::shared_array<Real> Ax_s(new Real[Ax.size()]);
+  std::copy(Ap.begin(), Ap.end(), Ap_s.get());
+  std::copy(Ai.begin(), Ai.end(), Ai_s.get());
+  std::copy(Ax.begin(), Ax.end(), Ax_s.get());
+  SparseMatrixN A(m, n, Ap_s, Ai_s, Ax_s);
+
+  // compute scaling for the convergence criteria
+  const Real C_SCAL = (Real) 1.0 + (n > 0 ? c.norm_inf() : (Real) 0.0);
+  const Real B_SCAL = (Real) 1.0 + (m > 0 ? b.norm_inf() : (Real) 0.0);
+
+  // setup the initial point
+  y.set_one(n);
+  mu.set_one(n);
+  s.set_one(m);
+  lambda.set_one(m);
+
+  // do the iterations
+  bool converged = false;
+  unsigned iter = 0;
+  for (; iter < ip_max_iterations; iter++)
+  {
+    // compute the residuals: rd = H*y + c - A'*lambda - mu, rp = A*y - s - b
+    H.mult(y, rd) += c;
+    rd -= A.transpose_mult(lambda, tmpv);
+    rd -= mu;
+    A.mult(y, rp) -= s;
+    rp -= b;
+
+    // compute the duality measure
+    const Real GAP = (s.dot(lambda) + y.dot(mu))/(n+m);
+    const Real RD = rd.norm_inf();
+    const Real RP = (m > 0) ? rp.norm_inf() : (Real) 0.0;
+    FILE_LOG(LOG_CONTACT) << "  iteration " << iter << ": dual residual: " << RD << " primal residual: " << RP << " gap: " << GAP << std::endl;
+
+    // check for convergence or divergence
+    if (RD <= ip_eps*C_SCAL && RP <= ip_eps*B_SCAL && GAP <= ip_eps)
+    {
+      converged = true;
+      break;
+    }
+    if (!(GAP < std::numeric_limits<Real>::max()) || std::isnan(RD) || std::isnan(RP))
+      break;
+
+    // stop if the deadline has passed (the iterates are generally infeasible,
+    // so they are not used)
+    if (deadline_passed(q))
+    {
+      FILE_LOG(LOG_CONTACT) << "  time budget exhausted" << std::endl;
+      break;
+    }
+
+    // set the values of the KKT matrix
+    for (unsigned j=0, p=0; j< n; j++)
+    {
+      for (unsigned k=Hp[j]; k< Hp[j+1]; k++, p++)
+        Kx[p] = (Hi[k] == j) ? Hx[k] + mu[j]/y[j] : Hx[k];
+      for (unsigned k=ATp[j]; k< ATp[j+1]; k++, p++)
+        Kx[p] = -ATx[k];
+    }
+    for (unsigned r=0, p=Kp[n]; r< m; r++)
+    {
+      for (unsigned k=Ap[r]; k< Ap[r+1]; k++, p++)
+        Kx[p] = -Ax[k];
+      Kx[p++] = -s[r]/lambda[r];
+    }
+
+    // factorize the KKT matrix
+    if (!ldl.factor(Kp, Ki, Kx))
+      break;
+
+    // compute the affine scaling (predictor) direction
+    ryu.resize(n);
+    rsl.resize(m);
+    for (unsigned i=0; i< n; i++)
+      ryu[i] = y[i]*mu[i];
+    for (unsigned i=0; i< m; i++)
+      rsl[i] = s[i]*lambda[i];
+    solve_qp_ip_direction(ldl, y, s, lambda, mu, rd, rp, ryu, rsl, rhs, dy_aff, ds_aff, dlambda_aff, dmu_aff);
+
+    // compute the step lengths for the affine scaling direction
+    const Real ALPHA_P_AFF = std::min((Real) 1.0, std::min(calc_max_step(y, dy_aff), calc_max_step(s, ds_aff)));
+    const Real ALPHA_D_AFF = std::min((Real) 1.0, std::min(calc_max_step(mu, dmu_aff), calc_max_step(lambda, dlambda_aff)));
+
+    // compute the centering parameter
+    Real gap_aff = (Real) 0.0;
+    for (unsigned i=0; i< n; i++)
+      gap_aff += (y[i] + ALPHA_P_AFF*dy_aff[i])*(mu[i] + ALPHA_D_AFF*dmu_aff[i]);
+    for (unsigned i=0; i< m; i++)
+      gap_aff += (s[i] + ALPHA_P_AFF*ds_aff[i])*(lambda[i] + ALPHA_D_AFF*dlambda_aff[i]);
+    gap_aff /= (n+m);
+    const Real SIGMA = std::pow(gap_aff/GAP, (Real) 3.0);
+
+    // compute the combined (corrector) direction
+    for (unsigned i=0; i< n; i++)
+      ryu[i] += dy_aff[i]*dmu_aff[i] - SIGMA*GAP;
+    for (unsigned i=0; i< m; i++)
+      rsl[i] += ds_aff[i]*dlambda_aff[i] - SIGMA*GAP;
+    solve_qp_ip_direction(ldl, y, s, lambda, mu, rd, rp, ryu, rsl, rhs, dy, ds, dlambda, dmu);
+
+    // compute the step lengths 
+    const Real ALPHA_P = std::min((Real) 1.0, STEP_FRAC*std::min(calc_max_step(y, dy), calc_max_step(s, ds)));
+    const Real ALPHA_D = std::min((Real) 1.0, STEP_FRAC*std::min(calc_max_step(mu, dmu), calc_max_step(lambda, dlambda)));
+
+    // update the iterates
+    y += (dy *= ALPHA_P);
+    s += (ds *= ALPHA_P);
+    mu += (dmu *= ALPHA_D);
+    lambda += (dlambda *= ALPHA_D);
+  }
+
+  FILE_LOG(LOG_CONTACT) << "  interior-point method " << ((converged) ? "converged" : "did not converge") << " after " << iter << " iterations; " << Hi.size() << " nonzeros in H, " << ldl.nnz() << " nonzeros in L" << std::endl;
+
+  // capture the QP, if desired (H and A are stored densely)
+  if (!capture_filename.empty())
+  {
+    ProblemCapture::Problem p;
+    p.type = ProblemCapture::eQP;
+    p.solver = "ImpactEventHandler::solve_qp_work_ip";
+    p.solved = converged;
+    p.time = (Real) (WallClock::now() - T0);
+    p.iterations = iter;
+    p.M.set_zero(n, n);
+    for (unsigned i=0; i< n; i++)
+      for (unsigned k=Hp[i]; k< Hp[i+1]; k++)
+        p.M(i, Hi[k]) = Hx[k];
+    p.q.copy_from(c);
+    p.A.set_zero(m, n);
+    for (unsigned r=0; r< m; r++)
+      for (unsigned k=Ap[r]; k< Ap[r+1]; k++)
+        p.A(r, Ai[k]) += Ax[k];
+    p.b.copy_from(b);
+    p.z.copy_from(y);
+    ProblemCapture::append(capture_filename, p);
+  }
+
+  // store the solution
+  if (converged)
+  {
+    z.copy_from(y);
+    FILE_LOG(LOG_CONTACT) << "QP solution: " << z << std::endl; 
+  }
+  FILE_LOG(LOG_CONTACT) << "ImpactEventHandler::solve_qp_work_ip() exited" << std::endl;
+
+  return converged;
+}
+
+/// Computes a search direction for the interior-point method used by solve_qp_work_ip()
+/**
+ * Given the factorized KKT matrix, solves the Newton system for the 
+ * residuals rd, rp, ryu (complementarity of y and mu), and rsl 
+ * (complementarity of s and lambda).
+ */
+void ImpactEventHandler::solve_qp_ip_direction(const SparseLDL& ldl, const VectorN& y, const VectorN& s, const VectorN& lambda, const VectorN& mu, const VectorN& rd, const VectorN& rp, const VectorN& ryu, const VectorN& rsl, VectorN& rhs, VectorN& dy, VectorN& ds, VectorN& dlambda, VectorN& dmu)
+{
+  const unsigned n = y.size();
+  const unsigned m = s.size();
+
+  // setup the right hand side: [-rd - inv(Y)*ryu; rp + inv(L)*rsl]
+  rhs.resize(n+m);
+  for (unsigned i=0; i< n; i++)
+    rhs[i] = -rd[i] - ryu[i]/y[i];
+  for (unsigned i=0; i< m; i++)
+    rhs[n+i] = rp[i] + rsl[i]/lambda[i];
+
+  // solve for dy and dlambda
+  ldl.solve(rhs);
+  rhs.get_sub_vec(0, n, dy);
+  rhs.get_sub_vec(n, n+m, dlambda);
+
+  // recover dmu and ds
+  dmu.resize(n);
+  for (unsigned i=0; i< n; i++)
+    dmu[i] = (-ryu[i] - mu[i]*dy[i])/y[i];
+  ds.resize(m);
+  for (unsigned i=0; i< m; i++)
+    ds[i] = (-rsl[i] - s[i]*dlambda[i])/lambda[i];
+}
+
+/// Computes the largest step that keeps x + alpha*dx nonnegative
+Real ImpactEventHandler::calc_max_step(const VectorN& x, const VectorN& dx)
+{
+  Real alpha = std::numeric_limits<Real>::max();
+  for (unsigned i=0; i< x.size(); i++)
+    if (dx[i] < (Real) 0.0)
+      alpha = std::min(alpha, -x[i]/dx[i]);
+  return alpha;
+}
+
+/// Sets up the initial basis guess for Lemke's algorithm (used by solve_qp_work()) from the guessed contact impulses
+/**
+ * The LCP variables are the QP variables [alpha_c; beta_c; nbeta_c; alpha_l]
+ * followed by the multipliers for the QP constraints; Lemke's algorithm
+ * takes the positive components of the guess to be basic.  Besides the
+ * guessed impulses themselves, the Coulomb friction constraint nearest the
+ * guessed friction impulse is taken to be active for contacts whose guessed
+ * friction impulse lies on the boundary of the friction cone (i.e., for
+ * sliding contacts).
+ * \param q the problem data (alpha_c0 and beta_c0 must be set)
+ * \param n the number of LCP variables
+ * \param z the initial guess on return
+ */
+void ImpactEventHandler::get_lcp_warm_start(const EventProblemData& q, unsigned n, VectorN& z)
+{
+  // amount of the friction cone boundary that a friction impulse must reach
+  // for the contact to be considered to be sliding
+  const Real SLIDING_FRAC = (Real) 0.99;
+
+  // get the number of different types of each event
+  const unsigned N_CONTACTS = q.N_CONTACTS;
+  const unsigned N_LIMITS = q.N_LIMITS;
+
+  // setup variable indices
+  const unsigned ALPHA_C_IDX = 0;
+  const unsigned BETA_C_IDX = N_CONTACTS;
+  const unsigned NBETA_C_IDX = N_CONTACTS*2 + BETA_C_IDX;
+  const unsigned ALPHA_L_IDX = N_CONTACTS*2 + NBETA_C_IDX;
+  const unsigned N_PRIMAL = N_LIMITS + ALPHA_L_IDX;
+  const unsigned FRICTION_IDX = N_PRIMAL + N_CONTACTS + N_LIMITS;
+
+  z.set_zero(n);
+  for (unsigned i=0, k=0, r=FRICTION_IDX; i< N_CONTACTS; i++, k+= 2)
+  {
+    const Event& e = *q.contact_events[i];
+    const unsigned NK = e.contact_NK;
+
+    // set the impulses
+    const Real alpha = q.alpha_c0[i];
+    z[ALPHA_C_IDX+i] = alpha;
+    z[BETA_C_IDX+k] = std::max((Real) 0.0, q.beta_c0[k]);
+    z[BETA_C_IDX+k+1] = std::max((Real) 0.0, q.beta_c0[k+1]);
+    z[NBETA_C_IDX+k] = std::max((Real) 0.0, -q.beta_c0[k]);
+    z[NBETA_C_IDX+k+1] = std::max((Real) 0.0, -q.beta_c0[k+1]);
+
+    // find the friction constraint nearest to the friction impulse 
+    const Real b1 = std::fabs(q.beta_c0[k]);
+    const Real b2 = std::fabs(q.beta_c0[k+1]);
+    Real fmax = (Real) 0.0;
+    unsigned jmax = 0;
+    for (unsigned j=0; j< NK; j++)
+    {
+      Real theta = (Real) j/(NK-1) * M_PI_2;
+      Real f = std::cos(theta)*b1 + std::sin(theta)*b2;
+      if (f > fmax)
+      {
+        fmax = f;
+        jmax = j;
+      }
+    }
+
+    // see whether the contact is sliding
+    const Real vel = std::sqrt(sqr(q.Dc_v[k]) + sqr(q.Dc_v[k+1]));
+    const Real LIMIT = e.contact_mu_coulomb * alpha + e.contact_mu_viscous * vel;
+    if (alpha > (Real) 0.0 && fmax > (Real) 0.0 && fmax >= SLIDING_FRAC * LIMIT)
+      z[r+jmax] = (Real) 1.0;
+    r += NK;
+  }
+}
+
+/// Solves the (frictionless) LCP
+void ImpactEventHandler::solve_lcp(EventProblemData& q, VectorN& z)
+{
+  SAFESTATIC MatrixN UL, LR, MM;
+  SAFESTATIC MatrixN UR, t2, iJx_iM_JxT;
+  SAFESTATIC MatrixN Jc_iM_JcT, Jc_iM_DcT, Dc_iM_DcT;
+  SAFESTATIC VectorN alpha_c, alpha_l, alpha_x, v1, v2, qq;
+
+  // get the number of different types of each event
+  const unsigned N_CONTACTS = q.N_CONTACTS;
+  const unsigned N_LIMITS = q.N_LIMITS;
+  const unsigned N_CONSTRAINT_EQNS_EXP = q.N_CONSTRAINT_EQNS_EXP;
+  const unsigned N_K_TOTAL = q.N_K_TOTAL;
+  const unsigned N_LIN_CONE = q.N_LIN_CONE;
+  const unsigned N_TRUE_CONE = q.N_TRUE_CONE;
+  const unsigned N_LOOPS = q.N_LOOPS;
+
+  // assemble the (dense) contact-contact terms
+  q.get_contact_terms(Jc_iM_JcT, Jc_iM_DcT, Dc_iM_DcT);
+
+  // setup variable indices
+  const unsigned ALPHA_C_IDX = 0;
+  const unsigned BETA_C_IDX = N_CONTACTS;
+  const unsigned NBETA_C_IDX = N_CONTACTS*3;
+  const unsigned ALPHA_L_IDX = N_LIN_CONE*2 + NBETA_C_IDX;
+  const unsigned ALPHA_X_IDX = N_LIMITS + ALPHA_L_IDX;
+  const unsigned BETA_T_IDX = q.N_CONSTRAINT_EQNS_EXP + ALPHA_X_IDX;
+  const unsigned BETA_X_IDX = q.N_CONSTRAINT_DOF_IMP + BETA_T_IDX;
+  const unsigned DELTA_IDX = BETA_X_IDX + q.N_CONSTRAINT_DOF_EXP;
+  const unsigned NVARS = N_LOOPS + DELTA_IDX; 
+
+  // setup sizes
+  UL.resize(N_CONTACTS, N_CONTACTS);
+  UR.resize(N_CONTACTS, N_LIMITS);
+  LR.resize(N_LIMITS, N_LIMITS);
+
+  // setup primary terms -- first upper left hand block of matrix
+  iJx_iM_JxT.copy_from(q.Jx_iM_JxT);
   try
   {
     LinAlg::pseudo_inverse(iJx_iM_JxT, LinAlg::svd1);
@@ -1380,7 +3051,7 @@ void ImpactEventHandler::solve_lcp(EventProblemData& q, VectorN& z)
   t2.mult_transpose(q.Jl_iM_JxT, LR);
 
   // subtract secondary terms
-  UL -= q.Jc_iM_JcT;
+  UL -= Jc_iM_JcT;
   UR -= q.Jc_iM_JlT;
   LR -= q.Jl_iM_JlT;
 
@@ -1408,7 +3079,7 @@ void ImpactEventHandler::solve_lcp(EventProblemData& q, VectorN& z)
   qq.negate();
 
   FILE_LOG(LOG_CONTACT) << "ImpulseEventHandler::solve_lcp() entered" << std::endl;
-  FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Jc': " << std::endl << q.Jc_iM_JcT;
+  FILE_LOG(LOG_CONTACT) << "  Jc * inv(M) * Jc': " << std::endl << Jc_iM_JcT;
   FILE_LOG(LOG_CONTACT) << "  Jc * v: " << q.Jc_v << std::endl;
   FILE_LOG(LOG_CONTACT) << "  Jl * v: " << q.Jl_v << std::endl;
   FILE_LOG(LOG_CONTACT) << "  LCP matrix: " << std::endl << MM;
@@ -1465,12 +3136,174 @@ DynamicBodyPtr ImpactEventHandler::get_super_body(SingleBodyPtr sb)
     return sb;
 }
 
-/// The Hessian
+/// Computes the generalized impulse on an articulated body from the joint friction problem variables and its derivative
+/**
+ * \param opt_data the optimization data
+ * \param AIDX the index of the articulated body in the super bodies vector
+ * \param R the nullspace matrix (w = R*x + z)
+ * \param w the problem variables 
+ * \param f the generalized impulse on the body, on return
+ * \param dX the derivative of f with respect to x, on return
+ */
+void ImpactEventHandler::calc_joint_friction_impulse(const ImpactOptData& opt_data, unsigned AIDX, const MatrixN& R, const VectorN& w, VectorN& f, MatrixN& dX)
+{
+  SAFESTATIC VectorN tmpv, tmpv2, fx;
+  SAFESTATIC MatrixN tmpM, tmpM2, dXx;
+
+  // get the body
+  const EventProblemData& epd = *opt_data.epd;
+  ArticulatedBodyPtr abody = dynamic_pointer_cast<ArticulatedBody>(epd.super_bodies[AIDX]);    
+
+  // get indices for this body
+  const vector<int>& alpha_c_indices = opt_data.alpha_c_indices[AIDX];
+  const vector<int>& beta_nbeta_c_indices = opt_data.beta_nbeta_c_indices[AIDX];
+  const vector<unsigned>& alpha_l_indices = opt_data.alpha_l_indices[AIDX];
+  const vector<unsigned>& beta_t_indices = opt_data.beta_t_indices[AIDX];
+  const vector<unsigned>& beta_x_indices = opt_data.beta_x_indices[AIDX];
+
+  // compute the impulse: Jc'*alpha_c + Dc'*beta_c + Jl'*alpha_l + beta_t + 
+  //                      Dx'*beta_x
+  contact_select(alpha_c_indices, beta_nbeta_c_indices, w, tmpv, tmpv2);
+  abody->transpose_Jc_mult(tmpv, f);
+  f += abody->transpose_Dc_mult(tmpv2, fx);
+  w.select(alpha_l_indices.begin(), alpha_l_indices.end(), tmpv);
+  f += abody->transpose_Jl_mult(tmpv, fx);
+  f += w.select(beta_t_indices.begin(), beta_t_indices.end(), fx);
+  w.select(beta_x_indices.begin(), beta_x_indices.end(), tmpv);
+  f += abody->transpose_Dx_mult(tmpv, fx);
+
+  // the derivative uses the corresponding rows of R
+  contact_select(alpha_c_indices, beta_nbeta_c_indices, R, tmpM, tmpM2);
+  abody->transpose_Jc_mult(tmpM, dX);
+  dX += abody->transpose_Dc_mult(tmpM2, dXx);
+  R.select_rows(alpha_l_indices.begin(), alpha_l_indices.end(), tmpM);
+  dX += abody->transpose_Jl_mult(tmpM, dXx);
+  dX += R.select_rows(beta_t_indices.begin(), beta_t_indices.end(), dXx);
+  R.select_rows(beta_x_indices.begin(), beta_x_indices.end(), tmpM);
+  dX += abody->transpose_Dx_mult(tmpM, dXx);
+}
+
+/// Computes the joint friction "lambda" vector for a joint friction constraint and its derivative
+/**
+ * The joint friction constraint is w[FIDX]^2 - mu^2*||lambda||^2 - visc >= 0,
+ * where lambda = (Z + delta*Zd + (1-delta)*Z1d)*f if the joint is part of a 
+ * loop (with delta = w[LOOP_IDX]) and lambda = Z*f otherwise.
+ * \param i the index of the joint friction constraint
+ * \param R the nullspace matrix (w = R*x + z)
+ * \param w the problem variables 
+ * \param f the generalized impulse on the articulated body
+ * \param dX the derivative of f with respect to x
+ * \param lambda the lambda vector, on return
+ * \param Jlambda the derivative of lambda with respect to x, on return
+ * \param u the vector dX'*(Zd - Z1d)'*lambda, on return (if the joint is part
+ *        of a loop; u will be empty otherwise)
+ * \param FIDX the index of the joint frictional force in w, on return
+ * \param LOOP_IDX the index of delta in w, on return (UINT_MAX if the joint is
+ *        not part of a loop)
+ */
+void ImpactEventHandler::calc_joint_friction_lambda(const ImpactOptData& opt_data, unsigned i, const MatrixN& R, const VectorN& w, const VectorN& f, const MatrixN& dX, VectorN& lambda, MatrixN& Jlambda, VectorN& u, unsigned& FIDX, unsigned& LOOP_IDX)
+{
+  const unsigned UINF = std::numeric_limits<unsigned>::max();
+  SAFESTATIC MatrixN L, tmpM;
+  SAFESTATIC VectorN dZf, tmpv;
+
+  // get the event problem data
+  const EventProblemData& epd = *opt_data.epd;
+
+  // setup necessary indices
+  const unsigned ALPHA_X_IDX = epd.N_CONTACTS*3 + epd.N_LIN_CONE*2 + epd.N_LIMITS;
+  const unsigned BETA_T_IDX = ALPHA_X_IDX + epd.N_CONSTRAINT_EQNS_EXP;
+  const unsigned BETA_X_IDX = BETA_T_IDX + epd.N_CONSTRAINT_DOF_IMP;
+  const unsigned DELTA_IDX = BETA_X_IDX + epd.N_CONSTRAINT_DOF_EXP;
+
+  // get the body index and body
+  const unsigned AIDX = opt_data.body_indices[i];
+  ArticulatedBodyPtr abody = dynamic_pointer_cast<ArticulatedBody>(epd.super_bodies[AIDX]);    
+
+  // get the relative joint friction index for this articulated body and the
+  // index of the joint in the articulated body
+  const unsigned RIDX = i - opt_data.joint_friction_start[AIDX];
+  const unsigned JIDX = opt_data.true_indices[AIDX][RIDX];
+
+  // get the joint frictional force in w
+  FIDX = (RIDX < abody->num_joint_dof_implicit()) ? BETA_T_IDX + opt_data.implicit_start[AIDX] : BETA_X_IDX + opt_data.explicit_start[AIDX];
+
+  // get the three Z's
+  const MatrixN& Zd = opt_data.Zd[AIDX][JIDX];
+  const MatrixN& Z1d = opt_data.Z1d[AIDX][JIDX];
+  const MatrixN& Z = opt_data.Z[AIDX][JIDX];
+
+  // two cases: joint is part of a loop or not
+  const vector<unsigned>& loop_indices = opt_data.loop_indices[AIDX];
+  if (loop_indices[JIDX] != UINF)
+  {
+    LOOP_IDX = DELTA_IDX + opt_data.delta_start[AIDX] + loop_indices[JIDX];
+    const Real DELTA = w[LOOP_IDX];
+
+    // setup L = Z + delta*Zd + (1-delta)*Z1d
+    L.copy_from(Zd) *= DELTA;
+    L += (tmpM.copy_from(Z1d) *= ((Real) 1.0 - DELTA));
+    L += Z;
+
+    // compute lambda = L*f and dlambda/dx = L*dX + (Zd - Z1d)*f*Rd 
+    L.mult(f, lambda);
+    L.mult(dX, Jlambda);
+    Zd.mult(f, dZf);
+    dZf -= Z1d.mult(f, tmpv);
+    for (unsigned k=0; k< Jlambda.columns(); k++)
+    {
+      const Real RDK = R(LOOP_IDX, k);
+      if (RDK == (Real) 0.0)
+        continue;
+      for (unsigned r=0; r< Jlambda.rows(); r++)
+        Jlambda(r,k) += dZf[r]*RDK;
+    }
+
+    // compute u
+    Zd.transpose_mult(lambda, dZf);
+    dZf -= Z1d.transpose_mult(lambda, tmpv);
+    dX.transpose_mult(dZf, u);
+  }
+  else
+  {
+    LOOP_IDX = UINF;
+    Z.mult(f, lambda);
+    Z.mult(dX, Jlambda);
+    u.resize(0);
+  }
+}
+
+/// Adds scal * r*r' to H, where r is a row of R; only nonzero components of r are processed
+void ImpactEventHandler::add_row_outer_prod(const MatrixN& R, unsigned row, Real scal, MatrixN& H)
+{
+  SAFESTATIC vector<unsigned> nz;
+
+  // get the nonzero components of the row
+  nz.clear();
+  for (unsigned j=0; j< R.columns(); j++)
+    if (R(row,j) != (Real) 0.0)
+      nz.push_back(j);
+
+  // update H
+  for (unsigned k=0; k< nz.size(); k++)
+  {
+    const Real RK = R(row,nz[k]) * scal;
+    for (unsigned j=0; j< nz.size(); j++)
+      H(nz[j],nz[k]) += R(row,nz[j]) * RK;
+  }
+}
+
+/// The Hessian of the Lagrangian
+/**
+ * The objective is quadratic and the friction cone and joint friction 
+ * constraints are quadratic in the impulses, so the Hessian is computed in
+ * closed form.  Only constraints with nonzero multipliers contribute.
+ */
 void ImpactEventHandler::sqp_hess(const VectorN& x, Real objscal, const VectorN& hlambda, const VectorN& nu, MatrixN& H, void* data)
 {
-  SAFESTATIC VectorN Gx, w, tmpv, ff, lambda;
-  SAFESTATIC MatrixN t1, t2;
-  const Real INFEAS_TOL = 1e-8;
+  const unsigned UINF = std::numeric_limits<unsigned>::max();
+  SAFESTATIC VectorN w, f, lambda, u;
+  SAFESTATIC MatrixN dX, Jlambda, t1;
 
   // get the optimization data
   const ImpactOptData& opt_data = *(const ImpactOptData*) data;
@@ -1480,96 +3313,96 @@ void ImpactEventHandler::sqp_hess(const VectorN& x, Real objscal, const VectorN&
 
   // setup constants
   const unsigned N_CONTACTS = epd.N_CONTACTS;
-  const unsigned N_LIMITS = epd.N_LIMITS;
   const unsigned N_TRUE_CONE = epd.N_TRUE_CONE;
-  const unsigned N_LIN_CONE = epd.N_LIN_CONE;
   const unsigned N_LOOPS = epd.N_LOOPS;
-  const unsigned N_CONSTRAINT_EQNS_EXP = epd.N_CONSTRAINT_EQNS_EXP; 
-  const unsigned N_CONSTRAINT_DOF_IMP = epd.N_CONSTRAINT_DOF_IMP;
-  const unsigned N_CONSTRAINT_DOF_EXP = epd.N_CONSTRAINT_DOF_EXP;
-  const unsigned N_JOINT_DOF = N_CONSTRAINT_DOF_EXP + N_CONSTRAINT_DOF_IMP;
+  const unsigned N_JOINT_DOF = epd.N_CONSTRAINT_DOF_EXP + epd.N_CONSTRAINT_DOF_IMP;
   const unsigned ALPHA_C_IDX = 0;
   const unsigned BETA_C_IDX = ALPHA_C_IDX + N_CONTACTS;
-  const unsigned NBETA_C_IDX = BETA_C_IDX + N_CONTACTS*2;
-  const unsigned ALPHA_L_IDX = NBETA_C_IDX + N_LIN_CONE*2;
-  const unsigned ALPHA_X_IDX = ALPHA_L_IDX + N_LIMITS;
-  const unsigned BETA_T_IDX = ALPHA_X_IDX + N_CONSTRAINT_EQNS_EXP;
-  const unsigned BETA_X_IDX = BETA_T_IDX + N_CONSTRAINT_DOF_IMP;
-  const unsigned DELTA_IDX = BETA_X_IDX + N_CONSTRAINT_DOF_EXP;
 
   // get necessary data
   const VectorN& z = opt_data.z;
   const MatrixN& R = opt_data.R;
   const MatrixN& G = opt_data.H;
-  const VectorN& c = opt_data.c;
 
   // objective function is quadratic
   H.copy_from(G) *= objscal;
 
-  // setup the constraint index
-  unsigned index = 0;
-
-  // add in constraints for true friction cone
+  // add in constraints for true friction cone: the Hessian of 
+  // ||beta_c||^2 - mu*alpha_c^2 is 2*(Rx'*Rx + Ry'*Ry - mu*Ra'*Ra) 
   for (unsigned i=0; i< N_TRUE_CONE; i++)
   {
+    // skip inactive constraints
+    const Real HL = hlambda[i];
+    if (HL == (Real) 0.0)
+      continue;
+
     // get the contact event index
     const unsigned CIDX = opt_data.cone_contacts[i];
     const unsigned BETA_CX = BETA_C_IDX + CIDX*2;
     const unsigned BETA_CY = BETA_CX + 1;
     const unsigned ALPHA_C = ALPHA_C_IDX + CIDX;
 
-    // compute contact friction
-    R.get_row(BETA_CX, tmpv);
-    (*VectorN::outer_prod(tmpv, tmpv, &t2));
-    R.get_row(BETA_CY, tmpv);
-    (*VectorN::outer_prod(tmpv, tmpv, &t1));
-    t2 += t1;
-    t2 *= (Real) 2.0;
-    R.get_row(ALPHA_C, tmpv);
-    (*VectorN::outer_prod(tmpv, tmpv, &t1)) *= (Real) (2.0 * opt_data.c_mu_c[CIDX]);
-    t2 -= t1;
-
-    // add in t2 to hessian
-    t2 *= hlambda[index++];
-    H += t2;
+    // add in contact friction terms
+    add_row_outer_prod(R, BETA_CX, HL * (Real) 2.0, H);
+    add_row_outer_prod(R, BETA_CY, HL * (Real) 2.0, H);
+    add_row_outer_prod(R, ALPHA_C, -HL * (Real) 2.0 * opt_data.c_mu_c[i], H);
   }
 
-/*
-    // setup numerical Hessian
-    unsigned n = x.size();
-    const Real h = NEAR_ZERO;
-    const Real INV_H2 = 1.0 / (h*2);
-    VectorN xx = x;
-    VectorN v1, v2;
-    H.resize(n);
-    for (unsigned i=0; i< n; i++)
+  // delta constraints are linear; add in joint friction constraints
+  const unsigned JF_START = N_TRUE_CONE + N_LOOPS*2;
+  if (N_JOINT_DOF > 0)
+    R.mult(x, w) += z;
+  for (unsigned i=0, last_aidx = UINF; i< N_JOINT_DOF; i++)
+  {
+    // skip inactive constraints
+    const Real HL = hlambda[JF_START+i];
+    if (HL == (Real) 0.0)
+      continue;
+
+    // the generalized impulse is computed once per articulated body
+    const unsigned AIDX = opt_data.body_indices[i];
+    if (AIDX != last_aidx)
     {
-      xx[i] += h;
-      sqp_grad(xx, m, v1, data);
-      xx[i] -= 2*h;
-      sqp_grad(xx, m, v2, data);
-      xx[i] += h;
-      v1 -= v2;
-      v1 *= INV_H2;
-      H.set_column(i, v1);
+      calc_joint_friction_impulse(opt_data, AIDX, R, w, f, dX);
+      last_aidx = AIDX;
     }
-    // average values of the Hessian
-    for (unsigned i=0; i< n; i++)
-      for (unsigned j=i+1; j< n; j++)
-        H(i,j) = H(j,i) = 0.5*(H(i,j) + H(j,i));
-    return true;
-*/
+
+    // compute lambda and its derivative
+    unsigned FIDX, LOOP_IDX;
+    calc_joint_friction_lambda(opt_data, i, R, w, f, dX, lambda, Jlambda, u, FIDX, LOOP_IDX);
+
+    // add in Hessian of w[FIDX]^2
+    add_row_outer_prod(R, FIDX, HL * (Real) 2.0, H);
+
+    // add in Hessian of -mu^2*||lambda||^2 
+    const Real SCAL = -HL * (Real) 2.0 * opt_data.j_mu_c[i];
+    Jlambda.transpose_mult(Jlambda, t1) *= SCAL;
+    H += t1;
+
+    // lambda is bilinear in delta and f for joints in loops
+    if (LOOP_IDX != UINF)
+    {
+      for (unsigned k=0; k< H.columns(); k++)
+      {
+        const Real RDK = R(LOOP_IDX,k) * SCAL;
+        const Real UK = u[k] * SCAL;
+        for (unsigned j=0; j< H.rows(); j++)
+          H(j,k) += R(LOOP_IDX,j)*UK + u[j]*RDK;
+      }
+    }
+  }
 }
 
-/// The gradient
+/// The Jacobian of the nonlinear constraints
+/**
+ * Gradients are computed in closed form; terms for articulated bodies are
+ * computed once per body, rather than once per joint friction constraint. 
+ */
 void ImpactEventHandler::sqp_cJac(const VectorN& x, MatrixN& J, void* data)
 {
-  SAFESTATIC VectorN Gx, tmpv, tmpv2, ff, fff, w, wdelta, walphac, wbetac, walphal;
-  SAFESTATIC VectorN wbetat, wbetax, zalphac, zbetac, zalphal, zbetat, zbetax;
-  SAFESTATIC VectorN Zf, Zdf, Z1df, grad;
-  SAFESTATIC MatrixN dX, Rd, tmpM, tmpM2, JcTRalphac, DcTRbetac, JlTRalphal;
-  SAFESTATIC MatrixN Rbetat, DxTRbetax;
-  const Real INFEAS_TOL = 1e-8;
+  const unsigned UINF = std::numeric_limits<unsigned>::max();
+  SAFESTATIC VectorN w, f, lambda, u, grad;
+  SAFESTATIC MatrixN dX, Jlambda;
 
   // get the optimization data
   const ImpactOptData& opt_data = *(const ImpactOptData*) data;
@@ -1599,11 +3432,10 @@ void ImpactEventHandler::sqp_cJac(const VectorN& x, MatrixN& J, void* data)
   // get necessary data
   const VectorN& z = opt_data.z;
   const MatrixN& R = opt_data.R;
-  const MatrixN& G = opt_data.H;
-  const VectorN& c = opt_data.c;
+  const unsigned N = x.size();
 
   // resize J
-  J.resize(N_TRUE_CONE + N_LOOPS*2 + N_JOINT_DOF, x.size());
+  J.resize(N_TRUE_CONE + N_LOOPS*2 + N_JOINT_DOF, N);
 
   // setup constraint index
   unsigned index = 0;
@@ -1620,13 +3452,13 @@ void ImpactEventHandler::sqp_cJac(const VectorN& x, MatrixN& J, void* data)
     const unsigned BETA_CY = BETA_CX + 1;
     const unsigned ALPHA_C = ALPHA_C_IDX + CIDX;
 
-    // compute contact friction
-    R.get_row(BETA_CX, grad) *= ((Real) 2.0 * w[BETA_CX]);
-    R.get_row(BETA_CY, tmpv) *= ((Real) 2.0 * w[BETA_CY]);
-    grad += tmpv;
-    R.get_row(ALPHA_C, tmpv) *= ((Real) 2.0 * w[ALPHA_C] * opt_data.c_mu_c[CIDX]);
-    grad -= tmpv;
-    J.set_row(index++, grad); 
+    // compute contact friction: 2*(wx*Rx + wy*Ry - mu*wa*Ra) 
+    const Real WX = (Real) 2.0 * w[BETA_CX];
+    const Real WY = (Real) 2.0 * w[BETA_CY];
+    const Real WA = (Real) 2.0 * w[ALPHA_C] * opt_data.c_mu_c[i];
+    for (unsigned j=0; j< N; j++)
+      J(index,j) = WX*R(BETA_CX,j) + WY*R(BETA_CY,j) - WA*R(ALPHA_C,j);
+    index++;
   }
 
   // compute gradients for delta >= 0 constraints
@@ -1648,215 +3480,32 @@ void ImpactEventHandler::sqp_cJac(const VectorN& x, MatrixN& J, void* data)
   }
 
   // compute gradients for joint friction constraints
-  for (unsigned i=0; i< N_JOINT_DOF; i++)
+  for (unsigned i=0, last_aidx = UINF; i< N_JOINT_DOF; i++)
   {
     // original equation is mu_c ||si'*F*(fext + ff + D'*betax)|| >= ||ff||
     //                   or mu_c ||si'*F*(fext + ff + D'*betax)|| >= ||beta_x||
 
-    // get the body index and body
+    // the generalized impulse is computed once per articulated body
     const unsigned AIDX = opt_data.body_indices[i];
-    ArticulatedBodyPtr abody = dynamic_pointer_cast<ArticulatedBody>(epd.super_bodies[AIDX]);    
-
-    // get indices for this body
-    const vector<int>& alpha_c_indices = opt_data.alpha_c_indices[AIDX];
-    const vector<int>& beta_nbeta_c_indices = opt_data.beta_nbeta_c_indices[AIDX];
-    const vector<unsigned>& alpha_l_indices = opt_data.alpha_l_indices[AIDX];
-    const vector<unsigned>& beta_t_indices = opt_data.beta_t_indices[AIDX];
-    const vector<unsigned>& beta_x_indices = opt_data.beta_x_indices[AIDX];
-
-    // get the relative joint friction index for this articulated body
-    const unsigned RIDX = i - opt_data.joint_friction_start[AIDX];
-
-    // get the index of the joint in the articulated body
-    const unsigned JIDX = opt_data.true_indices[AIDX][RIDX];
-
-    // get the number of implicit DOFs for this body, so we can determine
-    // whether the relative index is implicit or explicit
-    const unsigned N_ABODY_IMPLICIT = abody->num_joint_dof_implicit();
-
-    // get the joint frictional force in w
-    const unsigned FIDX = (RIDX < N_ABODY_IMPLICIT) ? BETA_T_IDX + opt_data.implicit_start[AIDX] : BETA_X_IDX + opt_data.explicit_start[AIDX];
-
-    // get the three Z's
-    const MatrixN& Zd = opt_data.Zd[AIDX][JIDX];
-    const MatrixN& Z1d = opt_data.Z1d[AIDX][JIDX];
-    const MatrixN& Z = opt_data.Z[AIDX][JIDX];
-
-    // get squared Coulomb joint friction coefficient
-    const Real MUCSQ = opt_data.j_mu_c[i];
-
-    // get components of R corresponding to alpha_c, beta_c, nbeta_c,
-    // alpha_l, beta_t, beta_x, and delta for this body and
-    // multiply components of R by corresponding Jacobian
-    contact_select(alpha_c_indices, beta_nbeta_c_indices, R, tmpM, tmpM2);
-    abody->transpose_Jc_mult(tmpM, JcTRalphac);
-    abody->transpose_Dc_mult(tmpM2, DcTRbetac);
-    R.select_rows(alpha_l_indices.begin(), alpha_l_indices.end(), tmpM);
-    abody->transpose_Jl_mult(tmpM, JlTRalphal);
-    R.select_rows(beta_x_indices.begin(), beta_x_indices.end(), tmpM);
-    abody->transpose_Dx_mult(tmpM, DxTRbetax);
-
-    // get components of z and multiply by the proper Jacobians
-    contact_select(alpha_c_indices, beta_nbeta_c_indices, z, tmpv, tmpv2);
-    abody->transpose_Jc_mult(tmpv, zalphac);
-    abody->transpose_Dc_mult(tmpv2, zbetac);
-    z.select(alpha_l_indices.begin(), alpha_l_indices.end(), tmpv);
-    abody->transpose_Jl_mult(tmpv, zalphal);
-    z.select(beta_t_indices.begin(), beta_t_indices.end(), zbetat);
-    z.select(beta_x_indices.begin(), beta_x_indices.end(), tmpv);
-    abody->transpose_Dx_mult(tmpv, zbetax);
-
-    // setup impulse 
-    JcTRalphac.mult(x, walphac) += zalphac;
-    DcTRbetac.mult(x, wbetac) += zbetac;      
-    Rbetat.mult(x, wbetat) += zbetat;
-    DxTRbetax.mult(x, wbetax) += zbetax;
-    fff.copy_from(walphac);
-    fff += wbetac;
-    fff += walphal;
-    fff += wbetat;
-    fff += wbetax;
-
-    // compute gradient of impulse 
-    dX.copy_from(JcTRalphac) += DcTRbetac;
-    dX += JlTRalphal;
-    dX += Rbetat;
-    dX += DxTRbetax;
-
-    // get loop indices for this articulated body
-    const vector<unsigned>& loop_indices = opt_data.loop_indices[AIDX];
-
-    // two cases: joint is part of a loop or not
-    if (loop_indices[JIDX] != std::numeric_limits<unsigned>::max())
-    {
-      // setup delta stuff
-      const unsigned DELTA_START = DELTA_IDX + opt_data.delta_start[AIDX];
-      const unsigned LOOP_IDX = DELTA_START+loop_indices[JIDX];
-      R.get_sub_mat(LOOP_IDX, LOOP_IDX+1, 0, R.columns(), Rd);
-      const Real ZDELTA = opt_data.z[LOOP_IDX];
-      Rd.mult(x, wdelta);
-      const Real DELTA = wdelta[0] + ZDELTA;
-
-      // compute first component of gradient (dX' * Z' * Z * f)
-      Z.mult(fff, Zf);
-      Z.transpose_mult(Zf, tmpv);
-      dX.transpose_mult(tmpv, grad);
-
-      // compute second component of gradient (Rd' * f * Z' * Zd * f)
-      Zd.mult(fff, Zdf);
-      Z.transpose_mult(Zdf, tmpv);
-      Rd.get_row(0, tmpv2);
-      tmpv2 *= (fff.dot(tmpv));
-      grad += tmpv2;    
-
-      // compute third component of gradient (d * dX' * Z' * Zd * f)
-      dX.transpose_mult(tmpv, tmpv2);
-      tmpv2 *= DELTA;
-      grad += tmpv2;
-
-      // compute fourth component of gradient (d * dX' * Zd' * Z * f)
-      Z.mult(fff, Zf);
-      Zd.transpose_mult(Zf, tmpv);
-      dX.transpose_mult(tmpv, tmpv2) *= DELTA;
-      grad += tmpv2;
-
-      // compute fifth component of gradient (-Rd' * f' * Z' * Z1d * f)
-      Z1d.mult(fff, Z1df);
-      Z.transpose_mult(Z1df, tmpv);
-      Rd.get_row(0, tmpv2);
-      tmpv2 *= (-fff.dot(tmpv));
-      grad += tmpv2;
-
-      // compute six and seventh components of gradient 
-      // ((1-d) * dX' * [(Z' * Z1d * f) + (Z1d' * Z * f)]
-      Z1d.transpose_mult(Zf, tmpv);
-      Z.transpose_mult(Z1df, tmpv2);
-      tmpv += tmpv2;
-      dX.transpose_mult(tmpv, tmpv2) *= ((Real) 1.0 - DELTA);
-      grad += tmpv2;
-
-      // compute eight component of gradient (d * Rd' * f' * Zd' * Zd * f)
-      Zd.transpose_mult(Zdf, tmpv);
-      Rd.get_row(0, tmpv2);
-      tmpv2 *= (fff.dot(tmpv) * DELTA);
-      grad += tmpv2;
-
-      // compute ninth component of gradient (d^2 * dX' * Zd' * Zd * f)
-      dX.transpose_mult(tmpv, tmpv2);
-      tmpv2 *= (DELTA * DELTA);
-      grad += tmpv2;
-
-      // compute 10th and 11th components of gradient 
-      // (-d * Rd' * f' * Zd' * Z1d * f) and ((1-d) * Rd' * f' * Zd' * Z1d * f)
-      Zd.transpose_mult(Z1df, tmpv);
-      Rd.get_row(0, tmpv2);
-      tmpv2 *= (fff.dot(tmpv) * (1 - DELTA*2));
-      grad += tmpv2;
-
-      // compute 12th and 13th components of gradient
-      // ((1-d) * dX * R' * Zd' * Z1d * f) and ((1-d) * d * dX' * Z1d' * Zd * f)
-      Zd.transpose_mult(Z1df, tmpv);
-      Z1d.transpose_mult(Zdf, tmpv2);
-      tmpv += tmpv2;
-      dX.transpose_mult(tmpv, tmpv2);
-      tmpv2 *= (DELTA - DELTA*DELTA); 
-      grad += tmpv2;
-
-      // compute 14th component of gradient (-(1-d) * Rd' * f' * Z1d' * Z1d * f)
-      Z1d.transpose_mult(Z1df, tmpv);
-      Rd.get_row(0, tmpv2);
-      tmpv2 *= (fff.dot(tmpv) * (DELTA - (Real) 1.0));
-      grad += tmpv2;
-
-      // compute 15th component of gradient ((1-d)^2 * dX' * Z1d' * Z1d * f)
-      dX.transpose_mult(tmpv, tmpv2);
-      tmpv2 *= ((Real) 1.0 - (Real) 2.0*DELTA + DELTA*DELTA);
-      grad += tmpv2;
-
-      // scale gradient
-      grad *= (-MUCSQ);
-
-      // add in gradient due to applied frictional force
-      R.get_row(FIDX, ff);
-      ff *= (ff.dot(x) + z[FIDX]);
-      grad += ff;
-    }
-    else
+    if (AIDX != last_aidx)
     {
-      // compute gradient
-      Z.mult(fff, Zf);
-      Z.transpose_mult(Zf, tmpv);
-      dX.transpose_mult(tmpv, grad) *= (-MUCSQ);
-
-      // add in gradient due to applied frictional force
-      R.get_row(FIDX, ff);
-      ff *= (ff.dot(x) + z[FIDX]);
-      grad += ff;
+      calc_joint_friction_impulse(opt_data, AIDX, R, w, f, dX);
+      last_aidx = AIDX;
     }
 
+    // compute lambda and its derivative
+    unsigned FIDX, LOOP_IDX;
+    calc_joint_friction_lambda(opt_data, i, R, w, f, dX, lambda, Jlambda, u, FIDX, LOOP_IDX);
+
+    // gradient is 2*w[FIDX]*R[FIDX] - 2*mu^2*Jlambda'*lambda
+    Jlambda.transpose_mult(lambda, grad) *= ((Real) -2.0 * opt_data.j_mu_c[i]);
+    const Real WF = (Real) 2.0 * w[FIDX];
+    for (unsigned j=0; j< N; j++)
+      grad[j] += WF*R(FIDX,j);
+
     // set appropriate row of the Jacobian
     J.set_row(index++, grad);
   }
-/*
-    // setup numerical gradient 
-    unsigned n = x.size();
-    const Real h = NEAR_ZERO;
-    const Real INV_H2 = 1.0 / (h*2);
-    VectorN xx = x;
-    grad.resize(n);
-    for (unsigned i=0; i< n; i++)
-    {
-      xx[i] += h;
-      Real v1 = sqp_fx(xx, m, data);
-      xx[i] -= 2*h;
-      Real v2 = sqp_fx(xx, m, data);
-      xx[i] += h;
-      v1 -= v2;
-      v1 *= INV_H2;
-      grad[i] = v1;
-    }
-    return;
-*/
 }
 
 /// The gradient
@@ -1952,7 +3601,7 @@ void ImpactEventHandler::sqp_fx(const VectorN& x, VectorN& fc, void* data)
     const unsigned ALPHA_C = ALPHA_C_IDX + CIDX;
 
     // compute contact friction
-    fc[index++] = sqr(w[BETA_CX]) + sqr(w[BETA_CY]) - opt_data.c_mu_c[CIDX]*sqr(w[ALPHA_C]) - opt_data.c_visc[CIDX] - INFEAS_TOL;
+    fc[index++] = sqr(w[BETA_CX]) + sqr(w[BETA_CY]) - opt_data.c_mu_c[i]*sqr(w[ALPHA_C]) - opt_data.c_visc[i] - INFEAS_TOL;
   }
 
   // delta >= 0 constraint
@@ -111,6 +111,17 @@ void Joint::determine_q_tare()
 
   // reset q
   q.copy_from(q_save);
+
+  // the joint offsets have changed
+  invalidate_parameters();
+}
+
+/// Informs the articulated body that the axes or offsets of this joint changed
+void Joint::invalidate_parameters()
+{
+  ArticulatedBodyPtr abody = get_articulated_body();
+  if (abody)
+    abody->invalidate_parameters();
 }
 
 /// (Relatively slow) method for determining the joint velocity from current link velocities
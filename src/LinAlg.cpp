@@ -20,6 +20,7 @@
 #include <Moby/NumericalException.h>
 #include <Moby/SingularException.h>
 #include <Moby/Log.h>
+#include <Moby/SolverStats.h>
 #include <Moby/LinAlg.h>
 
 using namespace Moby;
@@ -1859,6 +1860,9 @@ void LinAlg::svd(MatrixN& A, MatrixN& U, VectorN& S, MatrixN& V)
   }
   catch (NumericalException e)
   {
+    SolverStats stats;
+    stats.n_svd_fallbacks = 1;
+    SolverStats::record(stats);
     svd2(A_backup(), U, S, V); 
   }
 }
@@ -2509,6 +2513,19 @@ VectorN& LinAlg::solve_LS(const SparseMatrixN& A, const VectorN& b, VectorN& x,
 
   return x;
 }
+
+/// Records the solver statistics for a least squares solve using the SVD
+/**
+ * solve_LS_fast2() is only used once solve_LS_fast1() has failed, so using
+ * svd2() is counted as a fallback.
+ */
+static void record_svd_solve(void (*svd)(MatrixN&, MatrixN&, VectorN&, MatrixN&))
+{
+  SolverStats stats;
+  stats.n_svd_solves = 1;
+  stats.n_svd_fallbacks = (svd == &LinAlg::svd2) ? 1 : 0;
+  SolverStats::record(stats);
+}
  
 /// Most robust system of linear equations solver (solves Ax = b)
 /**
@@ -2554,6 +2571,7 @@ VectorN& LinAlg::solve_LS_fast(MatrixN& A, VectorN& xb, void (*svd)(MatrixN&, Ma
   VectorN& Sx = S();
   VectorN& workvx = workv();
   svd(A, Ux, Sx, Vx);
+  record_svd_solve(svd);
   
   // determine new tolerance based on first std::singular value if necessary
   if (tol < 0.0)
@@ -2647,6 +2665,7 @@ MatrixN& LinAlg::solve_LS_fast(MatrixN& A, MatrixN& XB, void (*svd)(MatrixN&, Ma
   VectorN& Sx = S();
   MatrixN& workMx = workM();
   svd(A, Ux, Sx, Vx);
+  record_svd_solve(svd);
   
   // determine new tolerance based on first std::singular value if necessary
   if (tol < 0.0)
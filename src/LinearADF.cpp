@@ -0,0 +1,464 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <Moby/Constants.h>
+#include <Moby/Log.h>
+#include <Moby/Polyhedron.h>
+#include <Moby/LinearADF.h>
+
+using namespace Moby;
+using boost::shared_ptr;
+using std::vector;
+
+// identifier written at the start of serialized ADFs
+static const char LINEAR_ADF_MAGIC[8] = { 'M', 'O', 'B', 'Y', 'L', 'A', 'D', 'F' };
+
+/// Constructs an empty ADF
+LinearADF::LinearADF()
+{
+  _depth = 0;
+}
+
+/// Distance function for a triangle mesh
+Real LinearADF::trimesh_distance_function(const Vector3& pt, void* data)
+{
+  // get the Polyhedron
+  Polyhedron& poly = *(Polyhedron*) data;
+
+  // compute the distance
+  return poly.calc_signed_distance(pt);
+}
+
+/// Builds an ADF from a polyhedron
+shared_ptr<LinearADF> LinearADF::build_ADF(Polyhedron& poly, unsigned max_recursion, Real epsilon, Real max_pos_dist, Real max_neg_dist)
+{
+  // determine the bounding box for the triangle mesh
+  std::pair<Vector3, Vector3> bb = poly.get_bounding_box_corners();
+
+  // the polyhedron computes its convexity lazily; compute it now, before the
+  // distance function is called from multiple threads
+  poly.is_convex();
+
+  // build the ADF
+  return build_ADF(bb.first, bb.second, &trimesh_distance_function, max_recursion, epsilon, max_pos_dist, max_neg_dist, (void*) &poly);
+}
+
+/// Builds an ADF using a bounding box and distance function
+/**
+ * \param lo the lower bounds
+ * \param hi the upper bounds
+ * \param dfn the distance function (must be safe to call concurrently)
+ * \param max_recursion the maximum depth of the ADF octree
+ * \param epsilon the tolerance below which subdivision stops
+ * \param max_pos_dist the maximum positive (external) distance to build the
+ *         ADF; if max_pos_dist is negative, then the maximum positive distance
+ *         is computed to be 1% of the diagonal of the bounding box
+ * \param max_neg_dist the maximum negative (internal) distance to build the
+ *         ADF; default value is infinity
+ * \return a shared pointer to the constructed ADF
+ * \note subdivision uses the same criteria as ADF::build_ADF(): a cell is
+ *       subdivided unless it lies entirely deeper than max_neg_dist inside
+ *       the surface or trilinear interpolation reproduces the distance
+ *       function to within epsilon at the centers of the cell, its faces,
+ *       and its edges
+ */
+shared_ptr<LinearADF> LinearADF::build_ADF(const Vector3& lo, const Vector3& hi, Real (*dfn)(const Vector3&, void*), unsigned max_recursion, Real epsilon, Real max_pos_dist, Real max_neg_dist, void* data)
+{
+  const Real COMPUTED_EXTRA = 0.01;
+
+  // if the maximum positive distance is negative, compute the maximum positive
+  // distance
+  if (max_pos_dist < 0.0)
+    max_pos_dist = (hi - lo).norm() * COMPUTED_EXTRA;
+
+  // we'll make each dimension of the box slightly bigger to better represent
+  // the iso-surface
+  const Real INV_SQRT_3 = 1.0/std::sqrt(3.0);
+  Vector3 enlarge = Vector3(1.0, 1.0, 1.0)*INV_SQRT_3*max_pos_dist;
+
+  // create the ADF and its root cell
+  shared_ptr<LinearADF> adf(new LinearADF);
+  vector<Cell>& cells = adf->_cells;
+  Cell root;
+  root.lo = lo - enlarge;
+  root.hi = hi + enlarge;
+  root.child = 0;
+  for (unsigned b=0; b< BOX_VERTICES; b++)
+    root.distances[b] = dfn(get_lattice_point(root, (b & 1)*2, ((b >> 1) & 1)*2, ((b >> 2) & 1)*2), data);
+  cells.push_back(root);
+
+  FILE_LOG(LOG_ADF) << "LinearADF::build_ADF() - root bounds: " << root.lo << " / " << root.hi << std::endl;
+
+  // process the ADF one level at a time
+  vector<unsigned> level_cells(1, 0), next_cells;
+  vector<Real> lattice;
+  vector<unsigned char> split;
+  for (unsigned level=0; level < max_recursion && !level_cells.empty(); level++)
+  {
+    const int N = (int) level_cells.size();
+
+    // the distances over the 3x3x3 lattice of each cell are computed when
+    // checking the cell against the tolerance; the lattice points are the
+    // corners of the cell's children
+    lattice.resize(N*LATTICE_POINTS);
+    split.assign(N, 0);
+
+    // determine which cells to subdivide
+    #pragma omp parallel for
+    for (int m=0; m< N; m++)
+    {
+      const Cell& cell = cells[level_cells[m]];
+      Real* q = &lattice[m*LATTICE_POINTS];
+
+      // if cell is completely inside, do not subdivide it
+      bool completely_inside = true;
+      for (unsigned b=0; b< BOX_VERTICES; b++)
+        if (cell.distances[b] > -max_neg_dist)
+        {
+          completely_inside = false;
+          break;
+        }
+      if (completely_inside)
+        continue;
+
+      // evaluate the distance function over the lattice
+      for (unsigned k=0; k< 3; k++)
+        for (unsigned j=0; j< 3; j++)
+          for (unsigned i=0; i< 3; i++)
+          {
+            Real& qijk = q[i + j*3 + k*9];
+
+            // corners are already known
+            if (i != 1 && j != 1 && k != 1)
+            {
+              qijk = cell.distances[i/2 + (j/2)*2 + (k/2)*4];
+              continue;
+            }
+
+            // compute the true distance and compare it to the interpolated one
+            qijk = dfn(get_lattice_point(cell, i, j, k), data);
+            Real calc_dist = tri_linear_interp(cell.distances, i*0.5, j*0.5, k*0.5);
+            if (std::fabs(calc_dist - qijk) > epsilon)
+              split[m] = 1;
+          }
+    }
+
+    // allocate the children of the subdivided cells (children are stored
+    // consecutively, after all cells of this level)
+    next_cells.clear();
+    for (int m=0; m< N; m++)
+    {
+      if (!split[m])
+        continue;
+
+      const unsigned parent = level_cells[m];
+      cells[parent].child = cells.size();
+      for (unsigned c=0; c< OCT_CHILDREN; c++)
+      {
+        const unsigned ox = c & 1, oy = (c >> 1) & 1, oz = (c >> 2) & 1;
+        Cell child;
+        child.lo = get_lattice_point(cells[parent], ox, oy, oz);
+        child.hi = get_lattice_point(cells[parent], ox+1, oy+1, oz+1);
+        child.child = 0;
+        next_cells.push_back(cells.size());
+        cells.push_back(child);
+      }
+    }
+
+    // set the distances of the children from the lattice
+    #pragma omp parallel for
+    for (int m=0; m< N; m++)
+    {
+      if (!split[m])
+        continue;
+
+      const Real* q = &lattice[m*LATTICE_POINTS];
+      const unsigned first = cells[level_cells[m]].child;
+      for (unsigned c=0; c< OCT_CHILDREN; c++)
+      {
+        const unsigned ox = c & 1, oy = (c >> 1) & 1, oz = (c >> 2) & 1;
+        Cell& child = cells[first + c];
+        for (unsigned b=0; b< BOX_VERTICES; b++)
+          child.distances[b] = q[(ox + (b & 1)) + (oy + ((b >> 1) & 1))*3 + (oz + ((b >> 2) & 1))*9];
+      }
+    }
+
+    FILE_LOG(LOG_ADF) << "LinearADF::build_ADF() - subdivided " << next_cells.size()/OCT_CHILDREN << " of " << N << " cells at level " << level << std::endl;
+
+    // prepare to process the next level
+    if (!next_cells.empty())
+      adf->_depth = level+1;
+    level_cells.swap(next_cells);
+  }
+
+  FILE_LOG(LOG_ADF) << "LinearADF::build_ADF() - built ADF with " << cells.size() << " cells and depth " << adf->_depth << std::endl;
+
+  return adf;
+}
+
+/// Gets a point on the 3x3x3 lattice over a cell
+/**
+ * \param i the x index of the point (0 = lower bound, 1 = midpoint, 2 = upper bound)
+ * \param j the y index of the point
+ * \param k the z index of the point
+ */
+Vector3 LinearADF::get_lattice_point(const Cell& cell, unsigned i, unsigned j, unsigned k)
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  return Vector3(cell.lo[X] + (cell.hi[X] - cell.lo[X])*(i*0.5),
+                 cell.lo[Y] + (cell.hi[Y] - cell.lo[Y])*(j*0.5),
+                 cell.lo[Z] + (cell.hi[Z] - cell.lo[Z])*(k*0.5));
+}
+
+/// Performs trilinear interpolation of corner values
+/**
+ * \param q the values at the corners of the cell (indexed by bits)
+ * \param u the normalized x coordinate within the cell [0,1]
+ * \param v the normalized y coordinate within the cell [0,1]
+ * \param w the normalized z coordinate within the cell [0,1]
+ */
+Real LinearADF::tri_linear_interp(const Real q[8], Real u, Real v, Real w)
+{
+  // interpolate along x
+  Real q00 = q[0] + (q[1] - q[0])*u;
+  Real q10 = q[2] + (q[3] - q[2])*u;
+  Real q01 = q[4] + (q[5] - q[4])*u;
+  Real q11 = q[6] + (q[7] - q[6])*u;
+
+  // interpolate along y
+  Real q0 = q00 + (q10 - q00)*v;
+  Real q1 = q01 + (q11 - q01)*v;
+
+  // interpolate along z
+  return q0 + (q1 - q0)*w;
+}
+
+/// Gets the bounds of the ADF
+void LinearADF::get_bounds(Vector3& lo, Vector3& hi) const
+{
+  assert(!_cells.empty());
+  lo = _cells.front().lo;
+  hi = _cells.front().hi;
+}
+
+/// Determines whether the given point is within the ADF's bounding box
+bool LinearADF::contains(const Vector3& point) const
+{
+  const unsigned THREE_D = 3;
+
+  if (_cells.empty())
+    return false;
+
+  const Cell& root = _cells.front();
+  for (unsigned i=0; i< THREE_D; i++)
+    if (point[i] < root.lo[i] || point[i] > root.hi[i])
+      return false;
+
+  return true;
+}
+
+/// Gets the index of the leaf cell containing a point
+/**
+ * \note the point is assumed to lie within the bounds of the ADF
+ */
+unsigned LinearADF::find_leaf(const Vector3& point) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  assert(!_cells.empty());
+
+  unsigned idx = 0;
+  while (_cells[idx].child)
+  {
+    const Cell& cell = _cells[idx];
+    unsigned c = 0;
+    if (point[X] >= (cell.lo[X] + cell.hi[X])*0.5)
+      c |= 1;
+    if (point[Y] >= (cell.lo[Y] + cell.hi[Y])*0.5)
+      c |= 2;
+    if (point[Z] >= (cell.lo[Z] + cell.hi[Z])*0.5)
+      c |= 4;
+    idx = cell.child + c;
+  }
+
+  return idx;
+}
+
+/// Computes the signed distance at a point using trilinear interpolation
+/**
+ * \note for points outside of the bounds of the ADF, the distance is
+ *       approximated as the distance at the closest point on the bounds plus
+ *       the distance to that point
+ */
+Real LinearADF::calc_signed_distance(const Vector3& point) const
+{
+  const unsigned X = 0, Y = 1, Z = 2, THREE_D = 3;
+
+  assert(!_cells.empty());
+
+  // clamp the point to the bounds of the ADF
+  const Cell& root = _cells.front();
+  Vector3 p = point;
+  for (unsigned i=0; i< THREE_D; i++)
+    p[i] = std::min(std::max(p[i], root.lo[i]), root.hi[i]);
+
+  // find the leaf and interpolate
+  const Cell& leaf = _cells[find_leaf(p)];
+  Real u = (p[X] - leaf.lo[X])/(leaf.hi[X] - leaf.lo[X]);
+  Real v = (p[Y] - leaf.lo[Y])/(leaf.hi[Y] - leaf.lo[Y]);
+  Real w = (p[Z] - leaf.lo[Z])/(leaf.hi[Z] - leaf.lo[Z]);
+  return tri_linear_interp(leaf.distances, u, v, w) + (point - p).norm();
+}
+
+/// Determines the (unit) normal to the iso-surface at a point using the gradient of the interpolated distance
+Vector3 LinearADF::determine_normal(const Vector3& point) const
+{
+  const unsigned X = 0, Y = 1, Z = 2, THREE_D = 3;
+
+  assert(!_cells.empty());
+
+  // clamp the point to the bounds of the ADF
+  const Cell& root = _cells.front();
+  Vector3 p = point;
+  for (unsigned i=0; i< THREE_D; i++)
+    p[i] = std::min(std::max(p[i], root.lo[i]), root.hi[i]);
+
+  // get the leaf and normalized coordinates
+  const Cell& leaf = _cells[find_leaf(p)];
+  const Vector3 len = leaf.hi - leaf.lo;
+  Real u = (p[X] - leaf.lo[X])/len[X];
+  Real v = (p[Y] - leaf.lo[Y])/len[Y];
+  Real w = (p[Z] - leaf.lo[Z])/len[Z];
+  const Real* q = leaf.distances;
+
+  // compute the gradient of the trilinear interpolant
+  Vector3 grad = ZEROS_3;
+  for (unsigned b=0; b< BOX_VERTICES; b++)
+  {
+    const Real wx = (b & 1) ? u : 1.0 - u;
+    const Real wy = (b & 2) ? v : 1.0 - v;
+    const Real wz = (b & 4) ? w : 1.0 - w;
+    const Real sx = (b & 1) ? 1.0 : -1.0;
+    const Real sy = (b & 2) ? 1.0 : -1.0;
+    const Real sz = (b & 4) ? 1.0 : -1.0;
+    grad[X] += q[b]*sx*wy*wz;
+    grad[Y] += q[b]*wx*sy*wz;
+    grad[Z] += q[b]*wx*wy*sz;
+  }
+  grad[X] /= len[X];
+  grad[Y] /= len[Y];
+  grad[Z] /= len[Z];
+
+  // normalize the gradient
+  Real nrm = grad.norm();
+  return (nrm < NEAR_ZERO) ? ZEROS_3 : grad/nrm;
+}
+
+/// Saves this ADF to a binary file
+/**
+ * The file consists of an identifier, the number of cells, the depth, and
+ * the cells in breadth-first order; each cell is written as its bounds and
+ * corner distances (as double precision values) followed by the index of its
+ * first child.
+ */
+void LinearADF::save_to_file(const std::string& filename) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+  const unsigned CELL_VALUES = 6 + BOX_VERTICES;
+
+  // open the file
+  std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+  if (out.fail())
+    throw std::runtime_error("LinearADF::save_to_file() - unable to open file for writing");
+
+  // write the header
+  unsigned ncells = _cells.size();
+  out.write(LINEAR_ADF_MAGIC, sizeof(LINEAR_ADF_MAGIC));
+  out.write((const char*) &ncells, sizeof(unsigned));
+  out.write((const char*) &_depth, sizeof(unsigned));
+
+  // write the cells
+  for (unsigned i=0; i< ncells; i++)
+  {
+    const Cell& cell = _cells[i];
+    double values[CELL_VALUES];
+    values[0] = (double) cell.lo[X];
+    values[1] = (double) cell.lo[Y];
+    values[2] = (double) cell.lo[Z];
+    values[3] = (double) cell.hi[X];
+    values[4] = (double) cell.hi[Y];
+    values[5] = (double) cell.hi[Z];
+    for (unsigned j=0; j< BOX_VERTICES; j++)
+      values[6+j] = (double) cell.distances[j];
+    out.write((const char*) values, sizeof(values));
+    out.write((const char*) &cell.child, sizeof(unsigned));
+  }
+
+  // close the file
+  out.close();
+
+  FILE_LOG(LOG_ADF) << ncells << " cells written" << std::endl;
+}
+
+/// Reads an ADF from a binary file written by save_to_file()
+shared_ptr<LinearADF> LinearADF::load_from_file(const std::string& filename)
+{
+  const unsigned CELL_VALUES = 6 + BOX_VERTICES;
+
+  // open the file
+  std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+  if (in.fail())
+    throw std::runtime_error("LinearADF::load_from_file() - unable to open file for reading");
+
+  // read and verify the header
+  char magic[sizeof(LINEAR_ADF_MAGIC)];
+  unsigned ncells, depth;
+  in.read(magic, sizeof(magic));
+  in.read((char*) &ncells, sizeof(unsigned));
+  in.read((char*) &depth, sizeof(unsigned));
+  if (in.fail() || std::memcmp(magic, LINEAR_ADF_MAGIC, sizeof(magic)) != 0)
+    throw std::runtime_error("LinearADF::load_from_file() - file is not a linear ADF");
+
+  // read the cells
+  shared_ptr<LinearADF> adf(new LinearADF);
+  adf->_depth = depth;
+  adf->_cells.resize(ncells);
+  for (unsigned i=0; i< ncells; i++)
+  {
+    Cell& cell = adf->_cells[i];
+    double values[CELL_VALUES];
+    in.read((char*) values, sizeof(values));
+    in.read((char*) &cell.child, sizeof(unsigned));
+    cell.lo = Vector3(values[0], values[1], values[2]);
+    cell.hi = Vector3(values[3], values[4], values[5]);
+    for (unsigned j=0; j< BOX_VERTICES; j++)
+      cell.distances[j] = values[6+j];
+
+    // verify that the child index is sensible
+    if (cell.child != 0 && (cell.child <= i || cell.child + OCT_CHILDREN > ncells))
+      throw std::runtime_error("LinearADF::load_from_file() - invalid cell data");
+  }
+
+  // verify that the entire file was read
+  if (in.fail())
+    throw std::runtime_error("LinearADF::load_from_file() - unexpected end of file");
+
+  // close the file
+  in.close();
+
+  FILE_LOG(LOG_ADF) << ncells << " cells read" << std::endl;
+
+  return adf;
+}
+
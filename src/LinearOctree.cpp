@@ -0,0 +1,407 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <algorithm>
+#include <limits>
+#include <Moby/Constants.h>
+#include <Moby/LinearOctree.h>
+
+using namespace Moby;
+using std::vector;
+
+/// Constructs a linear octree with empty bounds
+/**
+ * set_bounds() must be called before points are inserted.
+ */
+LinearOctree::LinearOctree()
+{
+  set_bounds((Real) 0.0, ZEROS_3, ZEROS_3);
+}
+
+/// Constructs a linear octree with the specified minimum resolution and bounds
+LinearOctree::LinearOctree(Real minres, const Vector3& lo_bounds, const Vector3& hi_bounds)
+{
+  set_bounds(minres, lo_bounds, hi_bounds);
+}
+
+/// (Re)sets the minimum resolution and bounds of the octree
+/**
+ * \note all points are removed from the octree
+ */
+void LinearOctree::set_bounds(Real minres, const Vector3& lo_bounds, const Vector3& hi_bounds)
+{
+  const unsigned THREE_D = 3;
+
+  // set the bounds
+  _bounds_lo = lo_bounds;
+  _bounds_hi = hi_bounds;
+
+  // get the largest side length
+  Real sidelen = (Real) 0.0;
+  for (unsigned i=0; i< THREE_D; i++)
+    sidelen = std::max(sidelen, _bounds_hi[i] - _bounds_lo[i]);
+
+  // determine the depth of the octree; this matches the subdivision criterion
+  // of Octree (cells are subdivided only if the subcells are no smaller than
+  // the minimum resolution)
+  if (minres <= (Real) 0.0)
+    _depth = MAX_DEPTH;
+  else
+  {
+    _depth = 0;
+    for (Real half = sidelen*0.5; _depth < MAX_DEPTH && half >= minres; half *= 0.5)
+      _depth++;
+  }
+
+  // compute the cell size
+  _cell_size = (_bounds_hi - _bounds_lo)/(Real) (1 << _depth);
+
+  // remove all points
+  reset();
+}
+
+/// Removes all points from the octree
+void LinearOctree::reset()
+{
+  _cells.clear();
+  _counts.clear();
+  _num_points = 0;
+}
+
+/// Interleaves the bits of three 21-bit integer coordinates into a Morton code
+LinearOctree::MortonCode LinearOctree::encode(unsigned x, unsigned y, unsigned z)
+{
+  MortonCode c[3] = { x, y, z };
+
+  // spread the bits of each coordinate so that they lie two bits apart
+  for (unsigned i=0; i< 3; i++)
+  {
+    c[i] &= 0x1fffffULL;
+    c[i] = (c[i] | c[i] << 32) & 0x1f00000000ffffULL;
+    c[i] = (c[i] | c[i] << 16) & 0x1f0000ff0000ffULL;
+    c[i] = (c[i] | c[i] << 8) & 0x100f00f00f00f00fULL;
+    c[i] = (c[i] | c[i] << 4) & 0x10c30c30c30c30c3ULL;
+    c[i] = (c[i] | c[i] << 2) & 0x1249249249249249ULL;
+  }
+
+  return c[0] | (c[1] << 1) | (c[2] << 2);
+}
+
+/// Extracts the integer coordinates from a Morton code
+void LinearOctree::decode(MortonCode code, unsigned& x, unsigned& y, unsigned& z)
+{
+  MortonCode c[3] = { code, code >> 1, code >> 2 };
+
+  // compact every third bit of the code
+  for (unsigned i=0; i< 3; i++)
+  {
+    c[i] &= 0x1249249249249249ULL;
+    c[i] = (c[i] ^ (c[i] >> 2)) & 0x10c30c30c30c30c3ULL;
+    c[i] = (c[i] ^ (c[i] >> 4)) & 0x100f00f00f00f00fULL;
+    c[i] = (c[i] ^ (c[i] >> 8)) & 0x1f0000ff0000ffULL;
+    c[i] = (c[i] ^ (c[i] >> 16)) & 0x1f00000000ffffULL;
+    c[i] = (c[i] ^ (c[i] >> 32)) & 0x1fffffULL;
+  }
+
+  x = (unsigned) c[0];
+  y = (unsigned) c[1];
+  z = (unsigned) c[2];
+}
+
+/// Gets the Morton code of the finest cell containing a point
+/**
+ * \return <b>false</b> if the point lies outside of the bounds of the octree
+ */
+bool LinearOctree::get_code(const Vector3& point, MortonCode& code) const
+{
+  const unsigned THREE_D = 3;
+  const unsigned NCELLS = 1 << _depth;
+  unsigned idx[THREE_D];
+
+  for (unsigned i=0; i< THREE_D; i++)
+  {
+    // check that the point is within the bounds
+    if (point[i] < _bounds_lo[i] || point[i] > _bounds_hi[i])
+      return false;
+
+    // compute the integer coordinate (points on the upper bound belong to the
+    // last cell)
+    if (_cell_size[i] > (Real) 0.0)
+      idx[i] = std::min((unsigned) ((point[i] - _bounds_lo[i])/_cell_size[i]), NCELLS-1);
+    else
+      idx[i] = 0;
+  }
+
+  code = encode(idx[0], idx[1], idx[2]);
+  return true;
+}
+
+/// Gets the bounds of the finest cell with the given Morton code
+void LinearOctree::get_cell_bounds(MortonCode code, Vector3& lo_bounds, Vector3& hi_bounds) const
+{
+  unsigned x, y, z;
+  decode(code, x, y, z);
+  lo_bounds = _bounds_lo + Vector3(_cell_size[0]*x, _cell_size[1]*y, _cell_size[2]*z);
+  hi_bounds = lo_bounds + _cell_size;
+}
+
+/// Inserts a single point into the octree
+/**
+ * \note inserting points one at a time requires time linear in the number of
+ *       occupied cells per insertion; use the batch version of insert()
+ *       for large numbers of points
+ */
+void LinearOctree::insert(const Vector3& point)
+{
+  // get the code for the point
+  MortonCode code;
+  if (!get_code(point, code))
+    return;
+
+  // find the cell
+  vector<MortonCode>::iterator i = std::lower_bound(_cells.begin(), _cells.end(), code);
+  if (i != _cells.end() && *i == code)
+    _counts[i - _cells.begin()]++;
+  else
+  {
+    _counts.insert(_counts.begin() + (i - _cells.begin()), 1);
+    _cells.insert(i, code);
+  }
+
+  _num_points++;
+}
+
+/// Inserts a batch of points into the octree
+/**
+ * The Morton codes of the points are computed and sorted in parallel (if
+ * OpenMP is available) and then merged with the occupied cells.
+ * \return the number of points inserted (points outside of the bounds of the
+ *         octree are not inserted)
+ */
+unsigned LinearOctree::insert(const vector<Vector3>& points)
+{
+  const MortonCode INVALID = std::numeric_limits<MortonCode>::max();
+  const int N = (int) points.size();
+
+  // compute the codes of all points
+  vector<MortonCode> codes(N);
+  #pragma omp parallel for
+  for (int i=0; i< N; i++)
+    if (!get_code(points[i], codes[i]))
+      codes[i] = INVALID;
+
+  // sort the codes; points outside of the bounds are sorted to the end
+  sort_codes(codes);
+  while (!codes.empty() && codes.back() == INVALID)
+    codes.pop_back();
+
+  // merge the sorted codes with the occupied cells
+  vector<MortonCode> cells;
+  vector<unsigned> counts;
+  cells.reserve(_cells.size() + codes.size());
+  counts.reserve(_cells.size() + codes.size());
+  unsigned i = 0, j = 0;
+  while (i < _cells.size() || j < codes.size())
+  {
+    // pick the smaller code
+    MortonCode code;
+    if (j == codes.size() || (i < _cells.size() && _cells[i] <= codes[j]))
+      code = _cells[i];
+    else
+      code = codes[j];
+
+    // accumulate the count for the code
+    unsigned count = 0;
+    if (i < _cells.size() && _cells[i] == code)
+      count += _counts[i++];
+    for (; j < codes.size() && codes[j] == code; j++)
+      count++;
+
+    cells.push_back(code);
+    counts.push_back(count);
+  }
+
+  // store the new cells
+  _cells.swap(cells);
+  _counts.swap(counts);
+  _num_points += codes.size();
+
+  return codes.size();
+}
+
+/// Sorts Morton codes, sorting chunks of the codes in parallel (if possible) and then merging them
+void LinearOctree::sort_codes(vector<MortonCode>& codes)
+{
+  #ifdef _OPENMP
+  const unsigned MIN_CHUNK = 4096;
+  const int NCHUNKS = std::min(omp_get_max_threads(), (int) (codes.size()/MIN_CHUNK));
+  if (NCHUNKS > 1)
+  {
+    // setup the chunk boundaries
+    vector<unsigned> bounds(NCHUNKS+1);
+    for (int k=0; k<= NCHUNKS; k++)
+      bounds[k] = (unsigned) ((codes.size() * (unsigned long long) k)/NCHUNKS);
+
+    // sort the chunks
+    #pragma omp parallel for
+    for (int k=0; k< NCHUNKS; k++)
+      std::sort(codes.begin() + bounds[k], codes.begin() + bounds[k+1]);
+
+    // merge adjacent runs until all codes are sorted
+    for (int width=1; width < NCHUNKS; width *= 2)
+    {
+      #pragma omp parallel for
+      for (int k=0; k< NCHUNKS; k += width*2)
+      {
+        const int mid = k + width;
+        const int end = std::min(k + width*2, NCHUNKS);
+        if (mid < end)
+          std::inplace_merge(codes.begin() + bounds[k], codes.begin() + bounds[mid], codes.begin() + bounds[end]);
+      }
+    }
+
+    return;
+  }
+  #endif
+
+  std::sort(codes.begin(), codes.end());
+}
+
+/// Removes a point from the cell containing the given point
+/**
+ * \return <b>true</b> if the cell was occupied (and a point was removed),
+ *         and <b>false</b> otherwise
+ */
+bool LinearOctree::clear_cell(const Vector3& point)
+{
+  // get the code for the point
+  MortonCode code;
+  if (!get_code(point, code))
+    return false;
+
+  // find the cell
+  vector<MortonCode>::iterator i = std::lower_bound(_cells.begin(), _cells.end(), code);
+  if (i == _cells.end() || *i != code)
+    return false;
+
+  // remove a point from the cell; remove the cell if it is no longer occupied
+  const unsigned idx = i - _cells.begin();
+  if (--_counts[idx] == 0)
+  {
+    _cells.erase(i);
+    _counts.erase(_counts.begin() + idx);
+  }
+  _num_points--;
+
+  return true;
+}
+
+/// Determines whether the finest cell containing a point is occupied
+bool LinearOctree::is_cell_occupied(const Vector3& point) const
+{
+  MortonCode code;
+  if (!get_code(point, code))
+    return false;
+
+  return std::binary_search(_cells.begin(), _cells.end(), code);
+}
+
+/// Determines whether any occupied cell intersects a rectangular region of space
+bool LinearOctree::is_occupied(const Vector3& lo_bounds, const Vector3& hi_bounds) const
+{
+  const unsigned THREE_D = 3;
+
+  // verify that regions are correct
+  #ifndef NDEBUG
+  for (unsigned i=0; i< THREE_D; i++)
+    assert(lo_bounds[i] <= hi_bounds[i]);
+  #endif
+
+  // if no points, return false
+  if (_cells.empty())
+    return false;
+
+  // clip the query to the bounds of the octree
+  Vector3 lo, hi;
+  for (unsigned i=0; i< THREE_D; i++)
+  {
+    if (lo_bounds[i] > _bounds_hi[i] || hi_bounds[i] < _bounds_lo[i])
+      return false;
+    lo[i] = std::max(lo_bounds[i], _bounds_lo[i]);
+    hi[i] = std::min(hi_bounds[i], _bounds_hi[i]);
+  }
+
+  // convert the query to (inclusive) ranges of integer cell coordinates
+  MortonCode lo_code, hi_code;
+  get_code(lo, lo_code);
+  get_code(hi, hi_code);
+  unsigned qlo[THREE_D], qhi[THREE_D];
+  decode(lo_code, qlo[0], qlo[1], qlo[2]);
+  decode(hi_code, qhi[0], qhi[1], qhi[2]);
+
+  // descend from the root
+  return is_occupied(0, 0, _cells.begin(), _cells.end(), qlo, qhi);
+}
+
+/// Determines whether any occupied cell below an (implicit) octree node lies within a range of cells
+/**
+ * \param level the level of the node (the root is at level 0)
+ * \param prefix the Morton code of the node at its level
+ * \param begin the first occupied cell below the node
+ * \param end one past the last occupied cell below the node
+ * \param qlo the lower integer coordinates of the query (finest level)
+ * \param qhi the upper integer coordinates of the query (finest level)
+ */
+bool LinearOctree::is_occupied(unsigned level, MortonCode prefix, vector<MortonCode>::const_iterator begin, vector<MortonCode>::const_iterator end, const unsigned qlo[3], const unsigned qhi[3]) const
+{
+  const unsigned THREE_D = 3, OCT_CHILDREN = 8;
+
+  // if there are no occupied cells below this node, quit
+  if (begin == end)
+    return false;
+
+  // get the range of finest cells covered by this node
+  const unsigned SHIFT = _depth - level;
+  unsigned nlo[THREE_D];
+  decode(prefix, nlo[0], nlo[1], nlo[2]);
+
+  // determine whether the node is outside of or fully inside the query
+  bool inside = true;
+  for (unsigned i=0; i< THREE_D; i++)
+  {
+    const unsigned lo = nlo[i] << SHIFT;
+    const unsigned hi = lo + (1 << SHIFT) - 1;
+    if (lo > qhi[i] || hi < qlo[i])
+      return false;
+    if (lo < qlo[i] || hi > qhi[i])
+      inside = false;
+  }
+
+  // if the node is fully inside the query, one of its cells is occupied
+  if (inside)
+    return true;
+
+  // otherwise, process the children
+  const unsigned CHILD_SHIFT = (SHIFT - 1)*THREE_D;
+  for (unsigned i=0; i< OCT_CHILDREN; i++)
+  {
+    // get the range of occupied cells below the child
+    MortonCode child = (prefix << THREE_D) | i;
+    vector<MortonCode>::const_iterator cbegin = std::lower_bound(begin, end, child << CHILD_SHIFT);
+    vector<MortonCode>::const_iterator cend = std::lower_bound(cbegin, end, (child + 1) << CHILD_SHIFT);
+
+    // recurse
+    if (is_occupied(level+1, child, cbegin, cend, qlo, qhi))
+      return true;
+    begin = cend;
+  }
+
+  return false;
+}
+
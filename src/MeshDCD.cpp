@@ -25,6 +25,7 @@
 #include <Moby/Integrator.h>
 #include <Moby/OBB.h>
 #include <Moby/NumericalException.h>
+#include <Moby/LinearADF.h>
 #include <Moby/MeshDCD.h>
 
 // To delete
@@ -35,6 +36,7 @@ using namespace Moby;
 using boost::dynamic_pointer_cast;
 using boost::static_pointer_cast;
 using boost::shared_ptr;
+using boost::weak_ptr;
 using boost::tuple;
 using boost::make_tuple;
 using std::cerr;
@@ -56,6 +58,9 @@ MeshDCD::MeshDCD()
 {
   eps_tolerance = 1e-4;
   isect_tolerance = 1e-4;
+  use_adf = false;
+  adf_max_recursion = 6;
+  adf_tolerance = 1e-3;
   _rebuild_bounds_vecs = true;
   return_all_contacts = true;
 }
@@ -87,12 +92,14 @@ void MeshDCD::add_articulated_body(ArticulatedBodyPtr abody, bool disable_adjace
 void MeshDCD::remove_collision_geometry(CollisionGeometryPtr cg)
 {
   CollisionDetection::remove_collision_geometry(cg);
+  remove_expired_ADFs();
   _rebuild_bounds_vecs = true;
 }
 
 void MeshDCD::remove_all_collision_geometries()
 {
   CollisionDetection::remove_all_collision_geometries();
+  _adfs.clear();
   _rebuild_bounds_vecs = true;
 }
 
@@ -620,6 +627,12 @@ void MeshDCD::determine_contacts_deformable_rigid(CollisionGeometryPtr a, Collis
 
   // get the transform from and into b's frame
   const Matrix4& wTb = b->get_transform();
+  Matrix4 bTw = Matrix4::inverse_transform(wTb);
+
+  // get the distance field for b, if distance fields are in use
+  shared_ptr<LinearADF> adf_b;
+  if (use_adf)
+    adf_b = get_ADF(b);
 
   // get the meshes from a and b
   const IndexedTriArray& mesh_a = *a->get_geometry()->get_mesh();
@@ -640,6 +653,18 @@ void MeshDCD::determine_contacts_deformable_rigid(CollisionGeometryPtr a, Collis
 
     FILE_LOG(LOG_COLDET) << " -- testing vertex " << v << " with relative velocity: " << vdot << endl;
 
+    // if the vertex cannot reach the surface of b during the time step, skip
+    // testing it against the triangles of b
+    if (adf_b)
+    {
+      Real dist = adf_b->calc_signed_distance(bTw.mult_point(v));
+      if (dist > vdot.norm()*dt + adf_tolerance + isect_tolerance)
+      {
+        FILE_LOG(LOG_COLDET) << "  ++ vertex is " << dist << " from surface; skipping" << endl;
+        continue;
+      }
+    }
+
     // loop over all triangles in mesh b
     for (unsigned j=0; j< mesh_b.num_tris(); j++)
     {
@@ -1535,6 +1560,12 @@ bool MeshDCD::is_collision(CollisionGeometryPtr cg)
 /// Determines whether two geometries are in collision
 bool MeshDCD::is_collision(CollisionGeometryPtr a, CollisionGeometryPtr b)
 {
+  // if distance fields are in use and either geometry belongs to a rigid
+  // body, test vertices against the distance field(s)
+  if (use_adf && (dynamic_pointer_cast<RigidBody>(a->get_single_body()) || 
+                  dynamic_pointer_cast<RigidBody>(b->get_single_body())))
+    return is_collision_adf(a, b);
+
   // get the first primitive 
   PrimitivePtr a_primitive = a->get_geometry();
 
@@ -1556,6 +1587,80 @@ bool MeshDCD::is_collision(CollisionGeometryPtr a, CollisionGeometryPtr b)
   return intersect_BV_trees(bva, bvb, aTw * wTb, a, b);
 }
 
+/// Determines whether two geometries are in collision using distance fields
+/**
+ * The vertices of each geometry are tested against the distance field of the
+ * other geometry, if the latter belongs to a rigid body (meshes of deformable
+ * bodies change as the bodies deform, so no distance fields are built for
+ * them).  Only vertices are tested, so edge/edge intersections are not
+ * detected, and the result is subject to the interpolation error of the
+ * distance fields (see adf_tolerance).
+ */
+bool MeshDCD::is_collision_adf(CollisionGeometryPtr a, CollisionGeometryPtr b)
+{
+  CollisionGeometryPtr geoms[2] = { a, b };
+
+  for (unsigned i=0; i< 2; i++)
+  {
+    // vertices of x are tested against the distance field of y
+    CollisionGeometryPtr x = geoms[i], y = geoms[1-i];
+    if (!dynamic_pointer_cast<RigidBody>(y->get_single_body()))
+      continue;
+
+    // get the distance field for y
+    shared_ptr<LinearADF> adf = get_ADF(y);
+
+    // get the transform from x's frame to y's frame (vertices of deformable
+    // bodies are in the global frame)
+    Matrix4 yTx = Matrix4::inverse_transform(y->get_transform());
+    if (dynamic_pointer_cast<RigidBody>(x->get_single_body()))
+      yTx = yTx * x->get_transform();
+
+    // test all vertices of x
+    const vector<Vector3>& verts = x->get_geometry()->get_mesh()->get_vertices();
+    for (unsigned j=0; j< verts.size(); j++)
+      if (adf->calc_signed_distance(yTx.mult_point(verts[j])) < (Real) 0.0)
+        return true;
+  }
+
+  return false;
+}
+
+/// Gets the distance field for the mesh of a geometry, building it if necessary
+shared_ptr<LinearADF> MeshDCD::get_ADF(CollisionGeometryPtr cg)
+{
+  // look for the distance field for the mesh
+  shared_ptr<const IndexedTriArray> mesh = cg->get_geometry()->get_mesh();
+  map<weak_ptr<const IndexedTriArray>, shared_ptr<LinearADF> >::const_iterator i = _adfs.find(mesh);
+  if (i != _adfs.end())
+    return i->second;
+
+  // release the distance fields of meshes that no longer exist
+  remove_expired_ADFs();
+
+  // build the distance field
+  Polyhedron poly(*mesh);
+  shared_ptr<LinearADF> adf = LinearADF::build_ADF(poly, adf_max_recursion, adf_tolerance);
+  _adfs[mesh] = adf;
+
+  FILE_LOG(LOG_COLDET) << "MeshDCD::get_ADF() - built distance field with " << adf->num_cells() << " cells for " << cg->id << endl;
+
+  return adf;
+}
+
+/// Removes the distance fields of meshes that have been destroyed (e.g., replaced in their geometries)
+void MeshDCD::remove_expired_ADFs()
+{
+  map<weak_ptr<const IndexedTriArray>, shared_ptr<LinearADF> >::iterator i = _adfs.begin();
+  while (i != _adfs.end())
+  {
+    if (i->first.expired())
+      _adfs.erase(i++);
+    else
+      i++;
+  }
+}
+
 /// Implements Base::load_from_xml()
 void MeshDCD::load_from_xml(XMLTreeConstPtr node, map<std::string, BasePtr>& id_map)
 {
@@ -1571,6 +1676,21 @@ void MeshDCD::load_from_xml(XMLTreeConstPtr node, map<std::string, BasePtr>& id_
   const XMLAttrib* nu_attr = node->get_attrib("eps-tolerance");
   if (nu_attr)
     this->eps_tolerance = nu_attr->get_real_value();
+
+  // get whether to use distance fields, if specified
+  const XMLAttrib* adf_attr = node->get_attrib("use-adf");
+  if (adf_attr)
+    this->use_adf = adf_attr->get_bool_value();
+
+  // get the maximum depth of distance fields, if specified
+  const XMLAttrib* adf_rec_attr = node->get_attrib("adf-max-recursion");
+  if (adf_rec_attr)
+    this->adf_max_recursion = adf_rec_attr->get_unsigned_value();
+
+  // get the distance field tolerance, if specified
+  const XMLAttrib* adf_tol_attr = node->get_attrib("adf-tolerance");
+  if (adf_tol_attr)
+    this->adf_tolerance = adf_tol_attr->get_real_value();
 }
 
 /// Implements Base::save_to_xml()
@@ -1588,6 +1708,11 @@ void MeshDCD::save_to_xml(XMLTreePtr node, list<BaseConstPtr>& shared_objects) c
 
   // save the nu tolerance
   node->attribs.insert(XMLAttrib("eps-tolerance", eps_tolerance));
+
+  // save the distance field settings
+  node->attribs.insert(XMLAttrib("use-adf", use_adf));
+  node->attribs.insert(XMLAttrib("adf-max-recursion", adf_max_recursion));
+  node->attribs.insert(XMLAttrib("adf-tolerance", adf_tolerance));
 }
 
 
@@ -33,10 +33,16 @@ extern "C"
 #include <Moby/SingularException.h>
 #include <Moby/NonsquareMatrixException.h>
 #include <Moby/NumericalException.h>
+#include <Moby/ProblemCapture.h>
+#include <Moby/WallClock.h>
+#include <Moby/SolverStats.h>
 #include <Moby/Optimization.h>
 #ifdef USE_PATH
 #include <Moby/PathLCPSolver.h>
 #endif
+#ifdef USE_MPREAL_LCP
+#include <Moby/mpreal.h>
+#endif
 
 using namespace Moby;
 using boost::shared_ptr;
@@ -84,6 +90,9 @@ struct FeasibilityData
   void (*hess)(const VectorN&, Real objscal, const VectorN& lambda, const VectorN& nu, MatrixN&, void*);
 };
 
+std::string Optimization::capture_filename;
+bool Optimization::lemke_mixed_precision = true;
+
 /// The signum function
 static Real sign(Real x)
 {
@@ -224,7 +233,13 @@ restart:
     switch (MODE)
     {
       case 2:  
+      {
+        SolverStats stats;
+        stats.n_sqp_calls = stats.n_sqp_failures = 1;
+        stats.n_sqp_iterations = stats.max_sqp_iterations = ITER;
+        SolverStats::record(stats);
         throw std::runtime_error("Optimization::sqp()- too many runtime constraints");
+      }
 
       case 3:  
         FILE_LOG(LOG_OPT) << "Optimization::sqp()- too many least squares iterations" << endl;
@@ -265,6 +280,13 @@ restart:
     JW.resize(L_JW);
     goto restart;
   }
+
+  // record the statistics
+  SolverStats stats;
+  stats.n_sqp_calls = 1;
+  stats.n_sqp_failures = (MODE > 1) ? 1 : 0;
+  stats.n_sqp_iterations = stats.max_sqp_iterations = ITER;
+  SolverStats::record(stats);
 }
 
 /// Evaluates all equality constraints (nonlinear and linear)
@@ -1568,8 +1590,10 @@ bool Optimization::make_feasible_convex(OptParams& cparams, VectorN& x, void (*s
   fdata.m = m;
   fdata.f0 = cparams.f0;
   fdata.fx = cparams.fx;
+  fdata.gx = cparams.gx;
   fdata.grad0 = cparams.grad0;
   fdata.cJac_f = cparams.cJac_f;
+  fdata.cJac_g = cparams.cJac_g;
   fdata.hess = cparams.hess;
   fdata.data = cparams.data;
 
@@ -4531,10 +4555,69 @@ void Optimization::qp_to_lcp2(const MatrixN& G, const VectorN& c, const MatrixN&
 }
 
 /// Regularized wrapper around Lemke's algorithm
-bool Optimization::lcp_lemke_regularized(const MatrixN& M, const VectorN& q, VectorN& z, int min_exp, unsigned step_exp, int max_exp, Real piv_tol, Real zero_tol)
+/**
+ * \param z a vector "close" to the solution on input (optional; see
+ *        lcp_lemke()); contains the solution on output.  Each attempt with 
+ *        a larger regularization factor starts from the final basis of the 
+ *        previous attempt.
+ * \param tcheck pointer to a function that is called (with tcheck_data) 
+ *        before each pivot and before each attempt and returns <b>true</b>
+ *        if the algorithm should stop without a solution (optional)
+ * \note the problem is appended to capture_filename, if it is set
+ * \note the regularization used is recorded (see SolverStats)
+ * \note the attempts are made in working precision only; if all of them
+ *       fail and lemke_mixed_precision is set, the unregularized problem is
+ *       solved once more in higher precision (see lcp_lemke())
+ */
+bool Optimization::lcp_lemke_regularized(const MatrixN& M, const VectorN& q, VectorN& z, int min_exp, unsigned step_exp, int max_exp, Real piv_tol, Real zero_tol, bool (*tcheck)(void*), void* tcheck_data)
+{
+  // solve the problem, timing the solver if the problem is to be captured
+  bool regularized = false;
+  int exp = 0;
+  const double T0 = (capture_filename.empty()) ? 0.0 : WallClock::now();
+  bool result = lcp_lemke_regularized_work(M, q, z, min_exp, step_exp, max_exp, piv_tol, zero_tol, tcheck, tcheck_data, regularized, exp);
+
+  // record the statistics
+  SolverStats stats;
+  stats.n_lemke_regularized_calls = 1;
+  stats.n_lemke_regularized_failures = (result) ? 0 : 1;
+  if (regularized)
+  {
+    stats.n_regularized_solutions = 1;
+    stats.max_regularization_exp = exp;
+  }
+  SolverStats::record(stats);
+
+  // look for the usual case
+  if (capture_filename.empty())
+    return result;
+
+  // capture the problem
+  ProblemCapture::Problem p;
+  p.type = ProblemCapture::eLCP;
+  p.solver = "lcp_lemke_regularized";
+  p.solved = result;
+  p.time = (Real) (WallClock::now() - T0);
+  p.M.copy_from(M);
+  p.q.copy_from(q);
+  p.z.copy_from(z);
+  ProblemCapture::append(capture_filename, p);
+
+  return result;
+}
+
+/// Does the work for lcp_lemke_regularized()
+/**
+ * \param regularized on return, <b>true</b> if a solution was found only 
+ *        after regularizing M
+ * \param exp on return, the exponent of the regularization factor (10^exp) 
+ *        with which the solution was found (if regularized is <b>true</b>)
+ */
+bool Optimization::lcp_lemke_regularized_work(const MatrixN& M, const VectorN& q, VectorN& z, int min_exp, unsigned step_exp, int max_exp, Real piv_tol, Real zero_tol, bool (*tcheck)(void*), void* tcheck_data, bool& regularized, int& exp)
 {
   FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke_regularized() entered" << endl;
   SAFESTATIC FastThreadable<VectorN> w_x, qq_x, qe_x;
+  regularized = false;
   SAFESTATIC FastThreadable<MatrixN> MM_x, Me_x;
   VectorN& w = w_x();
   VectorN& qq = qq_x();
@@ -4564,7 +4647,9 @@ bool Optimization::lcp_lemke_regularized(const MatrixN& M, const VectorN& q, Vec
   const Real ZERO_TOL = (zero_tol > (Real) 0.0) ? zero_tol : q.size() * std::numeric_limits<Real>::epsilon();
 
   // try non-regularized version first
-  bool result = lcp_lemke(MM, qq, z, piv_tol, zero_tol);
+  SolverStats stats;
+  bool result = lcp_lemke_working(MM, qq, z, piv_tol, zero_tol, tcheck, tcheck_data, stats);
+  SolverStats::record(stats);
   if (result)
   {
     // verify that solution truly is a solution -- check z
@@ -4591,6 +4676,14 @@ bool Optimization::lcp_lemke_regularized(const MatrixN& M, const VectorN& q, Vec
   int rf = min_exp;
   while (rf < max_exp)
   {
+    // check whether we must terminate now
+    if (tcheck && (*tcheck)(tcheck_data))
+    {
+      FILE_LOG(LOG_OPT) << "  user specified termination" << endl;
+      FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke_regularized() exited" << endl;
+      return false;
+    }
+
     // setup regularization factor
     Real lambda = std::pow((Real) 10.0, (Real) rf);
 
@@ -4602,8 +4695,11 @@ bool Optimization::lcp_lemke_regularized(const MatrixN& M, const VectorN& q, Vec
     // recopy q
     qq.copy_from(qe);
 
-    // try to solve the LCP
-    if ((result = lcp_lemke(MM, qq, z, piv_tol, zero_tol)))
+    // try to solve the LCP (z holds the final basis of the last attempt)
+    stats.reset();
+    result = lcp_lemke_working(MM, qq, z, piv_tol, zero_tol, tcheck, tcheck_data, stats);
+    SolverStats::record(stats);
+    if (result)
     {
       // verify that solution truly is a solution -- check z
       if (*std::min_element(z.begin(), z.end()) > -ZERO_TOL)
@@ -4623,6 +4719,8 @@ bool Optimization::lcp_lemke_regularized(const MatrixN& M, const VectorN& q, Vec
           {
             FILE_LOG(LOG_OPT) << "  solved with regularization factor: " << lambda << endl;
             FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke_regularized() exited" << endl;
+            regularized = true;
+            exp = rf;
 
             return true;
           }
@@ -4634,6 +4732,20 @@ bool Optimization::lcp_lemke_regularized(const MatrixN& M, const VectorN& q, Vec
     rf += step_exp;
   }
 
+  // as a last resort, solve the unregularized problem in higher precision
+  if (lemke_mixed_precision && !(tcheck && (*tcheck)(tcheck_data)))
+  {
+    stats.reset();
+    result = lcp_lemke_escalate(Me, qe, z, zero_tol, tcheck, tcheck_data, stats);
+    SolverStats::record(stats);
+    if (result)
+    {
+      FILE_LOG(LOG_OPT) << "  solved with no regularization in higher precision" << endl;
+      FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke_regularized() exited" << endl;
+      return true;
+    }
+  }
+
   FILE_LOG(LOG_OPT) << "  unable to solve given any regularization!" << endl;
   FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke_regularized() exited" << endl;
 
@@ -4641,12 +4753,446 @@ bool Optimization::lcp_lemke_regularized(const MatrixN& M, const VectorN& q, Vec
   return false;
 }
 
+/// Maintains a factorization of the basis matrix for Lemke's algorithm
+/**
+ * Each pivot of Lemke's algorithm replaces a single column of the basis, so
+ * rather than refactoring the basis on every pivot, the LU factorization of 
+ * an earlier basis is kept along with the column replacements made since
+ * (in product form, as "eta" vectors).  If B0 is the factored basis, the 
+ * current basis is B0*E1*...*Ek, where Ei is the identity matrix with column
+ * p_i replaced by the solution d_i of the basis system for the entering 
+ * column; d_i is computed by Lemke's algorithm anyway, so updates are nearly
+ * free. Solving then costs one LU solve plus O(k*n) operations. The basis
+ * is refactored after MAX_ETAS replacements or if a replacement is poorly
+ * conditioned.
+ */
+class LemkeBasis
+{
+  public:
+    LemkeBasis() { invalidate(); }
+
+    /// Forces the basis to be refactored on the next solve
+    void invalidate() { _factored = false; _neta = 0; }
+
+    void solve(const MatrixN& B, VectorN& xb);
+    void replace_column(unsigned p, const VectorN& d);
+
+  private:
+    static const unsigned MAX_ETAS = 50;
+
+    bool _factored;       // whether _LU holds a valid factorization
+    unsigned _neta;       // number of column replacements since factoring
+    MatrixN _LU;          // LU factorization of the basis
+    std::vector<int> _IPIV;
+    std::vector<VectorN> _etas;        // eta vectors
+    std::vector<unsigned> _eta_idx;    // replaced column for each eta vector
+    MatrixN _A;           // work matrix
+    VectorN _b;           // work vector
+};
+
+/// Solves B*x = b, where B is the current basis
+/**
+ * \param B the current basis (used only if the basis must be refactored)
+ * \param xb the vector b on entry, the vector x on return
+ */
+void LemkeBasis::solve(const MatrixN& B, VectorN& xb)
+{
+  // refactor the basis, if necessary
+  if (!_factored)
+  {
+    _LU.copy_from(B);
+    _factored = LinAlg::factor_LU(_LU, _IPIV);
+    _neta = 0;
+  }
+
+  // if the basis is singular, use the slower SVD pseudo-inverse
+  if (!_factored)
+  {
+    _b.copy_from(xb);
+    try
+    {
+      _A.copy_from(B);
+      LinAlg::solve_LS_fast1(_A, xb);
+    }
+    catch (NumericalException e)
+    {
+      _A.copy_from(B);
+      xb.copy_from(_b);
+      LinAlg::solve_LS_fast2(_A, xb);
+    }
+    return;
+  }
+
+  // solve using the factored basis
+  LinAlg::solve_LU_fast(_LU, false, _IPIV, xb);
+
+  // apply the inverses of the eta matrices, oldest first
+  for (unsigned i=0; i< _neta; i++)
+  {
+    const VectorN& eta = _etas[i];
+    const unsigned p = _eta_idx[i];
+    const Real xp = xb[p] / eta[p];
+    for (unsigned j=0; j< xb.size(); j++)
+      xb[j] -= eta[j] * xp;
+    xb[p] = xp;
+  }
+}
+
+/// Records the replacement of a column of the basis
+/**
+ * \param p the index of the replaced column
+ * \param d the solution of B*d = a, where B is the basis before the 
+ *        replacement and a is the new column
+ */
+void LemkeBasis::replace_column(unsigned p, const VectorN& d)
+{
+  // nothing to update if the basis will be refactored anyway
+  if (!_factored)
+    return;
+
+  // refactor if there are too many updates or if the update is poor 
+  if (_neta == MAX_ETAS || std::fabs(d[p]) < std::sqrt(std::numeric_limits<Real>::epsilon()) * d.norm_inf())
+  {
+    invalidate();
+    return;
+  }
+
+  // store the eta vector
+  if (_etas.size() == _neta)
+  {
+    _etas.push_back(d);
+    _eta_idx.push_back(p);
+  }
+  else
+  {
+    _etas[_neta].copy_from(d);
+    _eta_idx[_neta] = p;
+  }
+  _neta++;
+}
+
+/// Gets the values of the z variables in the current basis of Lemke's algorithm (nonbasic z variables are zero)
+static void get_basic_z(const vector<unsigned>& bas, const VectorN& x, unsigned n, VectorN& z)
+{
+  z.set_zero(n);
+  for (unsigned i=0; i< bas.size(); i++)
+    if (bas[i] < n)
+      z[bas[i]] = x[i];
+}
+
+#ifndef BUILD_ARBITRARY_PRECISION
+/// Converts a Real to the extended precision type
+static LongReal to_long_real(Real x) { return (LongReal) x; }
+
+#ifdef USE_MPREAL_LCP
+/// The number of bits of precision used when Lemke's algorithm is escalated to arbitrary precision
+static const unsigned LEMKE_MP_BITS = 256;
+
+/// Converts a Real to arbitrary precision
+static mpfr::mpreal to_mpreal(Real x) { return mpfr::mpreal((double) x, LEMKE_MP_BITS); }
+#endif
+
+/// Lemke's algorithm on a dense tableau, using the scalar type T
+/**
+ * This is used to find a complementary basis when lcp_lemke() fails in 
+ * working precision.  The tableau [I -M -e | q] is pivoted in place, so 
+ * each pivot takes O(n^2) operations on T (no factorizations are needed).
+ * \param convert function for converting a Real to T
+ * \param eps the machine epsilon of T
+ * \param z_basic on return, z_basic[i] is <b>true</b> if z_i is basic in the
+ *        complementary basis found
+ * \param z on return, the solution (in working precision)
+ * \param tcheck pointer to a function that is called (with tcheck_data)
+ *        before each pivot and returns <b>true</b> if the algorithm should
+ *        stop without a solution (optional)
+ * \return <b>true</b> if a complementary basis was found
+ */
+template <class T>
+static bool lemke_tableau(const MatrixN& M, const VectorN& q, T (*convert)(Real), T eps, vector<bool>& z_basic, VectorN& z, bool (*tcheck)(void*), void* tcheck_data)
+{
+  const unsigned n = q.size();
+  const unsigned NCOLS = 2*n+2, Z0 = 2*n, RHS = 2*n+1;
+  const unsigned MAXITER = std::min((unsigned) 1000, 50*n);
+  const T ZERO = convert((Real) 0.0), ONE = convert((Real) 1.0);
+
+  // setup the tableau (row major)
+  vector<T> tab(n*NCOLS, ZERO);
+  for (unsigned i=0; i< n; i++)
+  {
+    T* row = &tab[i*NCOLS];
+    row[i] = ONE;
+    for (unsigned j=0; j< n; j++)
+      row[n+j] = -convert(M(i,j));
+    row[Z0] = -ONE;
+    row[RHS] = convert(q[i]);
+  }
+
+  // initially, all w variables are basic
+  vector<unsigned> bas(n);
+  for (unsigned i=0; i< n; i++)
+    bas[i] = i;
+
+  // the artificial variable enters; the most negative q leaves 
+  unsigned r = 0;
+  for (unsigned i=1; i< n; i++)
+    if (tab[i*NCOLS+RHS] < tab[r*NCOLS+RHS])
+      r = i;
+  unsigned entering = Z0;
+
+  for (unsigned iter=0; iter <= MAXITER; iter++)
+  {
+    // see whether we have run out of time
+    if (tcheck && (*tcheck)(tcheck_data))
+      return false;
+
+    // pivot on (r, entering)
+    T* prow = &tab[r*NCOLS];
+    const T PIV = prow[entering];
+    for (unsigned j=0; j< NCOLS; j++)
+      prow[j] /= PIV;
+    for (unsigned i=0; i< n; i++)
+    {
+      if (i == r)
+        continue;
+      T* row = &tab[i*NCOLS];
+      const T F = row[entering];
+      if (F == ZERO)
+        continue;
+      for (unsigned j=0; j< NCOLS; j++)
+        row[j] -= F*prow[j];
+    }
+    const unsigned leaving = bas[r];
+    bas[r] = entering;
+
+    // if the artificial variable left, the basis is complementary
+    if (leaving == Z0)
+    {
+      z_basic.assign(n, false);
+      z.set_zero(n);
+      for (unsigned i=0; i< n; i++)
+        if (bas[i] >= n && bas[i] < Z0)
+        {
+          z_basic[bas[i]-n] = true;
+          z[bas[i]-n] = (Real) tab[i*NCOLS+RHS];
+        }
+      return true;
+    }
+
+    // the complement of the leaving variable enters
+    entering = (leaving < n) ? leaving + n : leaving - n;
+
+    // determine the pivot tolerance for the entering column
+    T colmax = ONE;
+    for (unsigned i=0; i< n; i++)
+    {
+      const T A = tab[i*NCOLS+entering];
+      if (A > colmax)
+        colmax = A;
+      else if (-A > colmax)
+        colmax = -A;
+    }
+    const T PIV_TOL = eps*convert((Real) n)*colmax;
+
+    // do the minimum ratio test (ties go to the artificial variable, then 
+    // the lowest row)
+    bool found = false;
+    T min_ratio = ZERO;
+    for (unsigned i=0; i< n; i++)
+    {
+      const T A = tab[i*NCOLS+entering];
+      if (!(A > PIV_TOL))
+        continue;
+      const T RATIO = tab[i*NCOLS+RHS]/A;
+      if (!found || RATIO < min_ratio || (RATIO == min_ratio && bas[i] == Z0))
+      {
+        found = true;
+        min_ratio = RATIO;
+        r = i;
+      }
+    }
+
+    // check for ray termination
+    if (!found)
+      return false;
+  }
+
+  // too many iterations
+  return false;
+}
+
+/// Computes the solution of an LCP given a complementary basis, using iterative refinement
+/**
+ * The basic z variables solve M_bb z_b = -q_b.  This system is factored in
+ * working precision, and the residual of each iterate is computed in 
+ * extended precision, so that the solution is accurate to working precision
+ * unless M_bb is very badly conditioned.
+ * \param z the solution from the extended precision tableau on input; the 
+ *        refined solution on output
+ */
+static void lemke_refine(const MatrixN& M, const VectorN& q, const vector<bool>& z_basic, VectorN& z)
+{
+  const unsigned MAX_REFINE_ITER = 3;
+  const unsigned n = q.size();
+
+  // get the basic variables
+  vector<unsigned> b;
+  for (unsigned i=0; i< n; i++)
+    if (z_basic[i])
+      b.push_back(i);
+  if (b.empty())
+    return;
+
+  // factor M_bb
+  MatrixN Mbb;
+  M.select_square(b.begin(), b.end(), Mbb);
+  vector<int> pivots;
+  if (!LinAlg::factor_LU(Mbb, pivots))
+    return;
+
+  // refine
+  VectorN r(b.size());
+  for (unsigned iter=0; iter< MAX_REFINE_ITER; iter++)
+  {
+    // compute the residual -q_b - M_bb z_b in extended precision
+    Real rnorm = (Real) 0.0, znorm = (Real) 0.0;
+    for (unsigned i=0; i< b.size(); i++)
+    {
+      LongReal ri = -(LongReal) q[b[i]];
+      for (unsigned j=0; j< b.size(); j++)
+        ri -= (LongReal) M(b[i],b[j]) * (LongReal) z[b[j]];
+      r[i] = (Real) ri;
+      rnorm = std::max(rnorm, std::fabs(r[i]));
+      znorm = std::max(znorm, std::fabs(z[b[i]]));
+    }
+
+    // see whether the solution is as accurate as it can be
+    if (rnorm <= std::numeric_limits<Real>::epsilon() * znorm)
+      break;
+
+    // update z_b
+    LinAlg::solve_LU_fast(Mbb, false, pivots, r);
+    for (unsigned i=0; i< b.size(); i++)
+      z[b[i]] += r[i];
+  }
+}
+
+/// Determines whether z solves an LCP to within the given tolerance (scaled by the magnitude of z)
+static bool lemke_check(const MatrixN& M, const VectorN& q, const VectorN& z, Real zero_tol)
+{
+  VectorN w;
+  M.mult(z, w) += q;
+  const Real TOL = zero_tol * std::max((Real) 1.0, z.norm_inf());
+  for (unsigned i=0; i< z.size(); i++)
+    if (z[i] < -TOL || w[i] < -TOL || std::min(z[i], w[i]) > TOL)
+      return false;
+  return true;
+}
+#endif
+
 /// Lemke's algorithm for solving linear complementarity problems
 /**
- * \param z a vector "close" to the solution on input (optional); contains
- *        the solution on output
+ * \param z a vector "close" to the solution on input (optional); the z
+ *        variables that are positive in this vector form the initial basis.
+ *        Contains the solution on output; if no solution is found, contains
+ *        the values of the z variables in the final basis (which can be used
+ *        to start another attempt).
+ * \param tcheck pointer to a function that is called (with tcheck_data) 
+ *        before each pivot and returns <b>true</b> if the algorithm should
+ *        stop without a solution (optional)
+ * \note the number of pivots is recorded (see SolverStats)
+ * \note if no pivot passes the pivot tolerance (or the iteration limit is
+ *       reached) and lemke_mixed_precision is set, the problem is solved 
+ *       again using Lemke's algorithm in extended precision (and then, if
+ *       Moby is built with MPREAL_LCP, in arbitrary precision); the 
+ *       solution is then recovered in working precision by iterative 
+ *       refinement; tcheck is also called before each higher precision pivot
  */
-bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Real piv_tol, Real zero_tol)
+bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Real piv_tol, Real zero_tol, bool (*tcheck)(void*), void* tcheck_data)
+{
+  // solve the problem in working precision
+  SolverStats stats;
+  bool result = lcp_lemke_working(M, q, z, piv_tol, zero_tol, tcheck, tcheck_data, stats);
+
+  // escalate the precision if pivoting failed (and not b/c of tcheck)
+  if (!result && lemke_mixed_precision && !(tcheck && (*tcheck)(tcheck_data)))
+    result = lcp_lemke_escalate(M, q, z, zero_tol, tcheck, tcheck_data, stats);
+
+  SolverStats::record(stats);
+
+  return result;
+}
+
+/// Solves an LCP using Lemke's algorithm in working precision only (see lcp_lemke())
+/**
+ * \param stats on return, the statistics of the solve (not yet recorded)
+ */
+bool Optimization::lcp_lemke_working(const MatrixN& M, const VectorN& q, VectorN& z, Real piv_tol, Real zero_tol, bool (*tcheck)(void*), void* tcheck_data, SolverStats& stats)
+{
+  // solve the problem, counting the pivots
+  unsigned npivots = 0;
+  bool result = lcp_lemke_work(M, q, z, piv_tol, zero_tol, tcheck, tcheck_data, npivots);
+
+  // set the statistics
+  stats.n_lemke_calls = 1;
+  stats.n_lemke_failures = (result) ? 0 : 1;
+  stats.n_lemke_pivots = stats.max_lemke_pivots = npivots;
+
+  return result;
+}
+
+/// Solves an LCP on which pivoting failed in working precision again in higher precision (see lemke_mixed_precision)
+/**
+ * The tableau is started cold (z is not used as a starting basis).
+ * \param z contains the solution on return, if one is found (and is 
+ *        unchanged otherwise)
+ * \param stats the statistics of the failed solve; updated on return
+ */
+bool Optimization::lcp_lemke_escalate(const MatrixN& M, const VectorN& q, VectorN& z, Real zero_tol, bool (*tcheck)(void*), void* tcheck_data, SolverStats& stats)
+{
+  #ifdef BUILD_ARBITRARY_PRECISION
+  return false;
+  #else
+  SAFESTATIC FastThreadable<VectorN> z_x;
+  bool result = false;
+
+  FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke() - escalating to extended precision" << endl;
+  stats.n_lemke_escalations = 1;
+  const Real ZERO_TOL = (zero_tol > (Real) 0.0) ? zero_tol : std::numeric_limits<Real>::epsilon() * M.norm_inf() * q.size();
+  vector<bool> z_basic;
+  VectorN& zx = z_x();
+  if (lemke_tableau<LongReal>(M, q, &to_long_real, std::numeric_limits<LongReal>::epsilon(), z_basic, zx, tcheck, tcheck_data))
+  {
+    lemke_refine(M, q, z_basic, zx);
+    result = lemke_check(M, q, zx, ZERO_TOL);
+  }
+  #ifdef USE_MPREAL_LCP
+  if (!result && !(tcheck && (*tcheck)(tcheck_data)))
+  {
+    FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke() - escalating to arbitrary precision" << endl;
+    if (lemke_tableau<mpfr::mpreal>(M, q, &to_mpreal, mpfr::mpreal(std::ldexp(1.0, 1 - (int) LEMKE_MP_BITS), LEMKE_MP_BITS), z_basic, zx, tcheck, tcheck_data))
+    {
+      lemke_refine(M, q, z_basic, zx);
+      result = lemke_check(M, q, zx, ZERO_TOL);
+    }
+  }
+  #endif
+  if (result)
+  {
+    FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke() - solved using higher precision" << endl;
+    z.copy_from(zx);
+    stats.n_lemke_failures = 0;
+    stats.n_lemke_escalations_solved = 1;
+  }
+
+  return result;
+  #endif
+}
+
+/// Does the work for lcp_lemke()
+/**
+ * \param npivots on return, the number of pivots taken
+ */
+bool Optimization::lcp_lemke_work(const MatrixN& M, const VectorN& q, VectorN& z, Real piv_tol, Real zero_tol, bool (*tcheck)(void*), void* tcheck_data, unsigned& npivots)
 {
   const unsigned n = q.size();
   const unsigned MAXITER = std::min((unsigned) 1000, 50*n);
@@ -4660,8 +5206,9 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
 
   // setup work variables
   SAFESTATIC FastThreadable<VectorN> Be_x, U_x, z0_x, x_x, d_x, xj_x, dj_x, w_x, result_x;
-  SAFESTATIC FastThreadable<MatrixN> B_x, A_x, t1_x, t2_x;
+  SAFESTATIC FastThreadable<MatrixN> B_x, t1_x, t2_x;
   SAFESTATIC FastThreadable<vector<unsigned> > all_x, tlist_x, bas_x, nonbas_x, j_x; 
+  SAFESTATIC FastThreadable<LemkeBasis> basis_x;
 
   // get references to all variables
   VectorN& Be = Be_x();
@@ -4674,7 +5221,6 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
   VectorN& w = w_x();
   VectorN& result = result_x();
   MatrixN& B = B_x();
-  MatrixN& A = A_x();
   MatrixN& t1 = t1_x();
   MatrixN& t2 = t2_x();
   vector<unsigned>& all = all_x();
@@ -4682,6 +5228,7 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
   vector<unsigned>& bas = bas_x();
   vector<unsigned>& nonbas = nonbas_x();
   vector<unsigned>& j = j_x();
+  LemkeBasis& basis = basis_x();
 
   // clear all vectors
   all.clear();
@@ -4756,27 +5303,9 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
   }
 
   // solve B*x = -q
-  try
-  {
-    A.copy_from(B);
-    x.copy_from(q);
-    LinAlg::solve_fast(A, x);
-  }
-  catch (SingularException e)
-  {
-    try
-    {
-      // use slower SVD pseudo-inverse
-      A.copy_from(B);
-      x.copy_from(q);
-      LinAlg::solve_LS_fast1(A, x);
-    }
-    catch (NumericalException e)
-    {
-      A.copy_from(B);
-      LinAlg::solve_LS_fast2(A, x);
-    }
-  }
+  basis.invalidate();
+  x.copy_from(q);
+  basis.solve(B, x);
   x.negate();
 
   // check whether initial basis provides a solution
@@ -4816,6 +5345,7 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
 
   // pivot in the artificial variable
   *iiter = t;    // replace w var with z0 in basic indices
+  npivots++;
   U.resize(n);
   for (unsigned i=0; i< n; i++)
     U[i] = (x[i] < 0.0) ? 1.0 : 0.0;
@@ -4824,11 +5354,25 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
   x += U*tval;
   x[lvindex] = tval;
   B.set_column(lvindex, Be);
+
+  // update the basis factorization (B\Be = -U)
+  d.copy_from(U).negate();
+  basis.replace_column(lvindex, d);
   FILE_LOG(LOG_OPT) << "  new q: " << x << endl;
 
   // main iterations begin here
   for (unsigned iter=0; iter < MAXITER; iter++)
   {
+    // check whether we must terminate now
+    if (tcheck && leaving != t && (*tcheck)(tcheck_data))
+    {
+      FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke() - user specified termination" << endl;
+      FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke() exited" << endl;
+
+      get_basic_z(bas, x, n, z);
+      return false;
+    }
+
     // check whether done; if not, get new entering variable
     if (leaving == t)
     {
@@ -4865,26 +5409,7 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
       M.get_column(entering, Be);
     }
     d.copy_from(Be);
-    try
-    {
-      A.copy_from(B);
-      LinAlg::solve_fast(A, d);
-    }
-    catch (SingularException e)
-    {
-      try
-      {
-        // use slower SVD pseudo-inverse
-        A.copy_from(B);
-        d.copy_from(Be);
-        LinAlg::solve_LS_fast1(A, d);
-      }
-      catch (NumericalException e)
-      {
-        A.copy_from(B);
-        LinAlg::solve_LS_fast2(A, d);
-      }
-    }
+    basis.solve(B, d);
 
     // use a new pivot tolerance if necessary
     const Real PIV_TOL = (piv_tol > (Real) 0.0) ? piv_tol : std::numeric_limits<Real>::epsilon() * n * std::max((Real) 1.0, Be.norm_inf());
@@ -4900,7 +5425,7 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
       FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke() - no new pivots (ray termination)" << endl;
       FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke() exited" << endl;
 
-      z.resize(n, true);
+      get_basic_z(bas, x, n, z);
       return false;
     }
 
@@ -4934,7 +5459,7 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
     {
       FILE_LOG(LOG_OPT) << "zero tolerance too low?" << std::endl;
       FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke() exited" << std::endl;
-      z.resize(n, true);
+      get_basic_z(bas, x, n, z);
       return false;
     }
 
@@ -4963,12 +5488,14 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
     leaving = *iiter;
 
     // ** perform pivot
+    basis.replace_column(lvindex, d);
     Real ratio = x[lvindex]/d[lvindex];
     d*= ratio;
     x -= d;
     x[lvindex] = ratio;
     B.set_column(lvindex, Be);
     *iiter = entering;
+    npivots++;
 
     FILE_LOG(LOG_OPT) << "pivoting " << var(leaving,n) << " and " << var(entering,n) << endl;
   }
@@ -4977,7 +5504,7 @@ bool Optimization::lcp_lemke(const MatrixN& M, const VectorN& q, VectorN& z, Rea
   FILE_LOG(LOG_OPT) << "Optimization::lcp_lemke() exited" << std::endl;
 
   // max iterations exceeded
-  z.resize(n, true);
+  get_basic_z(bas, x, n, z);
   
   return false;
 }
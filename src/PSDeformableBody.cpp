@@ -247,6 +247,16 @@ void PSDeformableBody::update_velocity(const EventProblemData& q)
   }
 }
 
+/// Adds the tangent velocity changes of the given contacts (in Dc_v) to a row of a contact block
+static void add_tangent_row(const vector<unsigned>& contacts, const VectorN& Dc_v, unsigned row, MatrixN& Dc_iM_DcT)
+{
+  for (unsigned b=0; b< contacts.size(); b++)
+  {
+    Dc_iM_DcT(row, b*2) += Dc_v[contacts[b]*2];
+    Dc_iM_DcT(row, b*2+1) += Dc_v[contacts[b]*2+1];
+  }
+}
+
 /// Adds contributions to the event matrices
 void PSDeformableBody::update_event_data(EventProblemData& q) 
 {
@@ -258,12 +268,14 @@ void PSDeformableBody::update_event_data(EventProblemData& q)
   get_generalized_coordinates(DynamicBody::eAxisAngle, gc);
   get_generalized_velocity(DynamicBody::eAxisAngle, gv);
 
-  // setup matrices
-  MatrixN Jc_iM_JcT, Jc_iM_DcT, Dc_iM_DcT;
-  Jc_iM_JcT.set_zero(q.Jc_iM_JcT.rows(), q.Jc_iM_JcT.columns());
-  Jc_iM_DcT.set_zero(q.Jc_iM_DcT.rows(), q.Jc_iM_DcT.columns());
-  Dc_iM_DcT.set_zero(q.Dc_iM_DcT.rows(), q.Dc_iM_DcT.columns());
-  
+  // get the contact events involving this body; the velocity changes are
+  // stored in the contact block of this body
+  const unsigned SB = q.get_super_body_index(get_this());
+  if (SB == q.super_bodies.size())
+    return;
+  const vector<unsigned>& contacts = q.super_body_contacts[SB];
+  EventProblemData::ContactBlock& block = q.contact_blocks[SB];
+
   // determine Jc_v and Dc_v
   VectorN Jc_v, Dc_v;
   determine_Jc_v(q.contact_events, Jc_v);
@@ -277,13 +289,10 @@ void PSDeformableBody::update_event_data(EventProblemData& q)
   VectorN Jc_v_new, Dc_v_new, Jc_v_last, Dc_v_last;
   Jc_v_last.copy_from(Jc_v);
   Dc_v_last.copy_from(Dc_v);
-  for (unsigned i=0; i< q.N_CONTACTS; i++)
+  for (unsigned a=0; a< contacts.size(); a++)
   {
-    // if neither of the bodies in the contact is this, keep looping...
-    SingleBodyPtr sb1 = q.contact_events[i]->contact_geom1->get_single_body();
+    const unsigned i = contacts[a];
     SingleBodyPtr sb2 = q.contact_events[i]->contact_geom2->get_single_body();
-    if (sb1.get() != this && sb2.get() != this)
-      continue;
     
     // get the normal
     Vector3 n = q.contact_events[i]->contact_normal;
@@ -302,8 +311,13 @@ void PSDeformableBody::update_event_data(EventProblemData& q)
     Dc_v_last.negate();
 
     // update two of the matrices
-    Jc_iM_JcT.set_row(i, Jc_v_last);
-    Jc_iM_DcT.set_row(i, Dc_v_last);
+    for (unsigned b=0; b< contacts.size(); b++)
+    {
+      const unsigned j = contacts[b];
+      block.Jc_iM_JcT(a, b) += Jc_v_last[j];
+      block.Jc_iM_DcT(a, b*2) += Dc_v_last[j*2];
+      block.Jc_iM_DcT(a, b*2+1) += Dc_v_last[j*2+1];
+    }
 
     // set Jc_v_last and Dc_dv_last
     Jc_v_last.copy_from(Jc_v_new);
@@ -311,16 +325,10 @@ void PSDeformableBody::update_event_data(EventProblemData& q)
   }
 
   // now do the same, but for tangent directions only
-  for (unsigned i=0, k=0; i< q.N_CONTACTS; i++)
+  for (unsigned a=0; a< contacts.size(); a++)
   {
-    // if neither of the bodies in the contact is this, keep looping...
-    SingleBodyPtr sb1 = q.contact_events[i]->contact_geom1->get_single_body();
+    const unsigned i = contacts[a];
     SingleBodyPtr sb2 = q.contact_events[i]->contact_geom2->get_single_body();
-    if (sb1.get() != this && sb2.get() != this)
-    {
-      k += 2;
-      continue;
-    }
 
     // evaluate both tangent directions
     Vector3 d1 = q.contact_events[i]->contact_tan1;
@@ -340,7 +348,7 @@ void PSDeformableBody::update_event_data(EventProblemData& q)
     Dc_v_last.negate();
 
     // update the matrix 
-    Dc_iM_DcT.set_row(k++, Dc_v_last);
+    add_tangent_row(contacts, Dc_v_last, a*2, block.Dc_iM_DcT);
     Dc_v_last.copy_from(Dc_v_new); 
 
     // apply the impulse in the second tangent direction
@@ -352,15 +360,10 @@ void PSDeformableBody::update_event_data(EventProblemData& q)
     Dc_v_last.negate();
 
     // update the matrix 
-    Dc_iM_DcT.set_row(k++, Dc_v_last);
+    add_tangent_row(contacts, Dc_v_last, a*2+1, block.Dc_iM_DcT);
     Dc_v_last.copy_from(Dc_v_new); 
   }
 
-  // update q's matrices
-  q.Jc_iM_JcT += Jc_iM_JcT;
-  q.Jc_iM_DcT += Jc_iM_DcT;
-  q.Dc_iM_DcT += Dc_iM_DcT;
-
   // restore body state
   set_generalized_coordinates(DynamicBody::eAxisAngle, gc);
   set_generalized_velocity(DynamicBody::eAxisAngle, gv);
@@ -119,6 +119,9 @@ void PrismaticJoint::set_axis_local(const Vector3& axis)
   _v2 = inner->get_transform().mult_vector(naxis);
   _v2 = outer->get_transform().transpose_mult_vector(_v2);
   Vector3::determine_orthonormal_basis(_u, _ui, _uj);
+
+  // the joint axis has changed
+  invalidate_parameters();
 }        
 
 /// Sets the global axis for this joint
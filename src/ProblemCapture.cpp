@@ -0,0 +1,188 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#ifdef THREADED
+#include <pthread.h>
+#endif
+#include <Moby/Constants.h>
+#include <Moby/Log.h>
+#include <Moby/ProblemCapture.h>
+
+using std::vector;
+using namespace Moby;
+
+static const char MAGIC[4] = { 'M', 'B', 'Y', 'P' };
+static const unsigned VERSION = 1;
+
+#ifdef THREADED
+/// Lock that serializes appends to capture files
+static pthread_mutex_t append_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/// Appends a problem to a capture file
+/**
+ * \param fname the name of the file (created if it does not exist)
+ * \param p the problem
+ */
+void ProblemCapture::append(const std::string& fname, const Problem& p)
+{
+  #ifdef THREADED
+  pthread_mutex_lock(&append_mutex);
+  #endif
+  std::ofstream out(fname.c_str(), std::ios::out | std::ios::app | std::ios::binary);
+  if (out.fail())
+  {
+    FILE_LOG(LOG_OPT) << "ProblemCapture::append() - unable to open " << fname << std::endl;
+  }
+  else
+  {
+    write(out, p);
+    out.close();
+  }
+  #ifdef THREADED
+  pthread_mutex_unlock(&append_mutex);
+  #endif
+}
+
+/// Writes a problem to a stream
+void ProblemCapture::write(std::ostream& out, const Problem& p)
+{
+  // write the header
+  out.write(MAGIC, sizeof(MAGIC));
+  write_unsigned(out, VERSION);
+  write_unsigned(out, (unsigned) p.type);
+
+  // write the solver data
+  write_unsigned(out, p.solver.size());
+  out.write(p.solver.data(), p.solver.size());
+  const unsigned char SOLVED = (p.solved) ? 1 : 0;
+  out.write((const char*) &SOLVED, sizeof(SOLVED));
+  const double TIME = (double) p.time;
+  out.write((const char*) &TIME, sizeof(TIME));
+  write_unsigned(out, p.iterations);
+
+  // write the problem and the solution
+  write_matrix(out, p.M);
+  write_vector(out, p.q);
+  write_matrix(out, p.A);
+  write_vector(out, p.b);
+  write_vector(out, p.z);
+}
+
+/// Reads a problem from a stream
+/**
+ * \return <b>false</b> if the end of the stream was reached
+ * \throws std::runtime_error if the stream does not contain a valid record
+ */
+bool ProblemCapture::read(std::istream& in, Problem& p)
+{
+  // read the header
+  char magic[4];
+  in.read(magic, sizeof(magic));
+  if (in.gcount() == 0 && in.eof())
+    return false;
+  unsigned version, type;
+  if (in.gcount() != sizeof(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+    throw std::runtime_error("ProblemCapture::read() - invalid record");
+  if (!read_unsigned(in, version) || version != VERSION)
+    throw std::runtime_error("ProblemCapture::read() - unsupported format version");
+  if (!read_unsigned(in, type) || type > (unsigned) eQP)
+    throw std::runtime_error("ProblemCapture::read() - invalid problem type");
+  p.type = (ProblemType) type;
+
+  // read the solver data
+  unsigned len;
+  unsigned char solved;
+  double time;
+  if (!read_unsigned(in, len))
+    throw std::runtime_error("ProblemCapture::read() - truncated record");
+  vector<char> name(len);
+  if (len > 0)
+    in.read(&name.front(), len);
+  in.read((char*) &solved, sizeof(solved));
+  in.read((char*) &time, sizeof(time));
+  if (in.fail() || !read_unsigned(in, p.iterations))
+    throw std::runtime_error("ProblemCapture::read() - truncated record");
+  p.solver.assign(name.begin(), name.end());
+  p.solved = (solved != 0);
+  p.time = (Real) time;
+
+  // read the problem and the solution
+  if (!read_matrix(in, p.M) || !read_vector(in, p.q) ||
+      !read_matrix(in, p.A) || !read_vector(in, p.b) || !read_vector(in, p.z))
+    throw std::runtime_error("ProblemCapture::read() - truncated record");
+
+  return true;
+}
+
+/// Writes an unsigned integer to a stream
+void ProblemCapture::write_unsigned(std::ostream& out, unsigned x)
+{
+  out.write((const char*) &x, sizeof(x));
+}
+
+/// Writes a matrix to a stream (elements are written as doubles in column-major order)
+void ProblemCapture::write_matrix(std::ostream& out, const MatrixN& m)
+{
+  write_unsigned(out, m.rows());
+  write_unsigned(out, m.columns());
+  vector<double> x(m.data(), m.data() + m.rows()*m.columns());
+  if (!x.empty())
+    out.write((const char*) &x.front(), x.size()*sizeof(double));
+}
+
+/// Writes a vector to a stream (elements are written as doubles)
+void ProblemCapture::write_vector(std::ostream& out, const VectorN& v)
+{
+  write_unsigned(out, v.size());
+  vector<double> x(v.begin(), v.end());
+  if (!x.empty())
+    out.write((const char*) &x.front(), x.size()*sizeof(double));
+}
+
+/// Reads an unsigned integer from a stream
+bool ProblemCapture::read_unsigned(std::istream& in, unsigned& x)
+{
+  in.read((char*) &x, sizeof(x));
+  return !in.fail();
+}
+
+/// Reads a matrix from a stream
+bool ProblemCapture::read_matrix(std::istream& in, MatrixN& m)
+{
+  unsigned rows, columns;
+  if (!read_unsigned(in, rows) || !read_unsigned(in, columns))
+    return false;
+  vector<double> x(rows*columns);
+  if (!x.empty())
+    in.read((char*) &x.front(), x.size()*sizeof(double));
+  if (in.fail())
+    return false;
+  m.resize(rows, columns);
+  std::copy(x.begin(), x.end(), m.data());
+  return true;
+}
+
+/// Reads a vector from a stream
+bool ProblemCapture::read_vector(std::istream& in, VectorN& v)
+{
+  unsigned n;
+  if (!read_unsigned(in, n))
+    return false;
+  vector<double> x(n);
+  if (!x.empty())
+    in.read((char*) &x.front(), x.size()*sizeof(double));
+  if (in.fail())
+    return false;
+  v.resize(n);
+  std::copy(x.begin(), x.end(), v.begin());
+  return true;
+}
+
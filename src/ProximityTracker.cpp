@@ -0,0 +1,306 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <Moby/Constants.h>
+#include <Moby/Log.h>
+#include <Moby/Triangle.h>
+#include <Moby/IndexedTriArray.h>
+#include <Moby/CollisionGeometry.h>
+#include <Moby/CollisionDetection.h>
+#include <Moby/ProximityTracker.h>
+
+using namespace Moby;
+using boost::shared_ptr;
+using std::vector;
+using std::map;
+using std::set;
+using std::pair;
+using std::make_pair;
+
+/// Constructs a proximity tracker with no registered pairs
+ProximityTracker::ProximityTracker()
+{
+  max_distance = std::numeric_limits<Real>::max();
+  motion_tolerance = NEAR_ZERO;
+  _num_updated = 0;
+}
+
+/// Removes all registered pairs
+void ProximityTracker::clear()
+{
+  _pairs.clear();
+  _pair_geoms.clear();
+  _geoms.clear();
+  _geom_map.clear();
+  _num_updated = 0;
+}
+
+/// Forces distances for all registered pairs to be recomputed on the next update
+/**
+ * Calling this method is necessary if the geometry of a primitive changes
+ * without its mesh being replaced.
+ */
+void ProximityTracker::invalidate()
+{
+  for (unsigned i=0; i< _pairs.size(); i++)
+    _pairs[i].valid = false;
+  for (unsigned i=0; i< _geoms.size(); i++)
+    _geoms[i].mesh = shared_ptr<const IndexedTriArray>();
+}
+
+/// Registers a pair of geometries for distance tracking
+/**
+ * \return the ID of the pair, which indexes the pair's data
+ */
+unsigned ProximityTracker::add_pair(CollisionGeometryPtr g1, CollisionGeometryPtr g2)
+{
+  // setup the pair data
+  PairData pdata;
+  pdata.geom1 = g1;
+  pdata.geom2 = g2;
+  pdata.dist = std::numeric_limits<Real>::max();
+  pdata.culled = false;
+  pdata.valid = false;
+  pdata.tri1 = pdata.tri2 = std::numeric_limits<unsigned>::max();
+  pdata.g1Tg2 = IDENTITY_4x4;
+
+  // add the pair
+  _pairs.push_back(pdata);
+  _pair_geoms.push_back(make_pair(get_geom_index(g1), get_geom_index(g2)));
+
+  return _pairs.size() - 1;
+}
+
+/// Registers all pairs of geometries checked by a collision detector
+void ProximityTracker::add_pairs(const CollisionDetection& coldet)
+{
+  const set<CollisionGeometryPtr>& geoms = coldet.get_collision_geometries();
+  for (set<CollisionGeometryPtr>::const_iterator i = geoms.begin(); i != geoms.end(); i++)
+  {
+    set<CollisionGeometryPtr>::const_iterator j = i;
+    for (j++; j != geoms.end(); j++)
+      if (coldet.is_checked(*i, *j))
+        add_pair(*i, *j);
+  }
+}
+
+/// Gets the index of the bounding data for a geometry, creating it if necessary
+unsigned ProximityTracker::get_geom_index(CollisionGeometryPtr g)
+{
+  map<CollisionGeometryPtr, unsigned>::const_iterator i = _geom_map.find(g);
+  if (i != _geom_map.end())
+    return i->second;
+
+  // create new (uncomputed) data for the geometry
+  GeomData gdata;
+  gdata.geom = g;
+  gdata.radius = (Real) 0.0;
+  _geoms.push_back(gdata);
+  _geom_map[g] = _geoms.size() - 1;
+  return _geoms.size() - 1;
+}
+
+/// Computes bounding spheres for a geometry and its triangles
+void ProximityTracker::update_geom_data(GeomData& gdata)
+{
+  // get the mesh
+  gdata.mesh = gdata.geom->get_geometry()->get_mesh();
+  const IndexedTriArray& mesh = *gdata.mesh;
+  const vector<Vector3>& verts = mesh.get_vertices();
+
+  // compute the bounding sphere of the mesh, centered at the center of the
+  // axis-aligned bounds of the vertices
+  gdata.center = ZEROS_3;
+  gdata.radius = (Real) 0.0;
+  if (!verts.empty())
+  {
+    Vector3 lo = verts.front(), hi = verts.front();
+    for (unsigned i=1; i< verts.size(); i++)
+      for (unsigned j=0; j< 3; j++)
+      {
+        lo[j] = std::min(lo[j], verts[i][j]);
+        hi[j] = std::max(hi[j], verts[i][j]);
+      }
+    gdata.center = (lo + hi) * (Real) 0.5;
+    for (unsigned i=0; i< verts.size(); i++)
+      gdata.radius = std::max(gdata.radius, (verts[i] - gdata.center).norm());
+  }
+
+  // compute bounding spheres for each triangle
+  const unsigned NTRIS = mesh.num_tris();
+  gdata.tri_centers.resize(NTRIS);
+  gdata.tri_radii.resize(NTRIS);
+  for (unsigned i=0; i< NTRIS; i++)
+  {
+    Triangle tri = mesh.get_triangle(i);
+    const Vector3 c = tri.calc_centroid();
+    gdata.tri_centers[i] = c;
+    gdata.tri_radii[i] = std::max((tri.a - c).norm(), std::max((tri.b - c).norm(), (tri.c - c).norm()));
+  }
+}
+
+/// Updates the distances between all registered pairs
+/**
+ * Distances are only recomputed for pairs whose relative transforms have
+ * changed (by more than motion_tolerance) since the last update.
+ * \return the minimum distance between any registered pair
+ * \note unlike CollisionDetection::calc_distances(), reported distances are
+ *       Euclidean (not squared) distances
+ */
+Real ProximityTracker::update()
+{
+  const Real INF = std::numeric_limits<Real>::max();
+
+  // update the bounding data for any geometries whose meshes have changed;
+  // any pairs that use those geometries must be recomputed
+  vector<bool> geom_changed(_geoms.size(), false);
+  for (unsigned i=0; i< _geoms.size(); i++)
+  {
+    PrimitivePtr p = _geoms[i].geom->get_geometry();
+    if (!_geoms[i].mesh || _geoms[i].mesh != p->get_mesh())
+    {
+      update_geom_data(_geoms[i]);
+      geom_changed[i] = true;
+    }
+  }
+
+  // update all pairs
+  Real min_dist = INF;
+  _num_updated = 0;
+  for (unsigned i=0; i< _pairs.size(); i++)
+  {
+    PairData& pdata = _pairs[i];
+    const GeomData& g1 = _geoms[_pair_geoms[i].first];
+    const GeomData& g2 = _geoms[_pair_geoms[i].second];
+
+    // compute the relative transform
+    const Matrix4& wTg1 = pdata.geom1->get_transform();
+    const Matrix4& wTg2 = pdata.geom2->get_transform();
+    Matrix4 g1Tg2 = Matrix4::inverse_transform(wTg1) * wTg2;
+
+    // if the pair has not moved, the distance is still valid
+    if (pdata.valid && !geom_changed[_pair_geoms[i].first] &&
+        !geom_changed[_pair_geoms[i].second] &&
+        g1Tg2.epsilon_equals(pdata.g1Tg2, motion_tolerance))
+    {
+      min_dist = std::min(min_dist, pdata.dist);
+      continue;
+    }
+
+    // store the new relative transform
+    pdata.g1Tg2 = g1Tg2;
+    pdata.valid = true;
+    _num_updated++;
+
+    // broad phase: cull the pair using the bounding spheres
+    Real sphere_dist = (g1Tg2.mult_point(g2.center) - g1.center).norm() - g1.radius - g2.radius;
+    if (sphere_dist > max_distance)
+    {
+      FILE_LOG(LOG_COLDET) << "ProximityTracker::update() - culled pair " << i << " (lower bound on distance: " << sphere_dist << ")" << std::endl;
+      pdata.culled = true;
+      pdata.dist = INF;
+      continue;
+    }
+
+    // narrow phase: compute the distance, starting from the closest features
+    pdata.culled = false;
+    Real sq_dist = calc_sq_dist(g1, g2, g1Tg2, pdata.tri1, pdata.tri2, pdata.cp1, pdata.cp2);
+    pdata.dist = std::sqrt(sq_dist);
+    min_dist = std::min(min_dist, pdata.dist);
+  }
+
+  FILE_LOG(LOG_COLDET) << "ProximityTracker::update() - recomputed " << _num_updated << " of " << _pairs.size() << " pairs; minimum distance: " << min_dist << std::endl;
+
+  return min_dist;
+}
+
+/// Calculates the closest points (and squared distance) between two geometries
+/**
+ * \param a bounding data for the first geometry
+ * \param b bounding data for the second geometry
+ * \param aTb the transform from b's frame to a's frame
+ * \param tri_a the closest triangle on a from the last computation (if any)
+ *        on input, the closest triangle on a on return
+ * \param tri_b the closest triangle on b from the last computation (if any)
+ *        on input, the closest triangle on b on return
+ * \param cpa the closest point to b on a (in a's frame)
+ * \param cpb the closest point to a on b (in b's frame)
+ * \return the squared distance between cpa and cpb
+ */
+Real ProximityTracker::calc_sq_dist(const GeomData& a, const GeomData& b, const Matrix4& aTb, unsigned& tri_a, unsigned& tri_b, Vector3& cpa, Vector3& cpb)
+{
+  const IndexedTriArray& a_mesh = *a.mesh;
+  const IndexedTriArray& b_mesh = *b.mesh;
+  const unsigned NA = a_mesh.num_tris();
+  const unsigned NB = b_mesh.num_tris();
+  Vector3 cpa_tmp, cpb_tmp;
+
+  // setup the minimum (squared) distance
+  Real min_dist = std::numeric_limits<Real>::max();
+
+  // seed the search using the closest features from the last computation
+  if (tri_a < NA && tri_b < NB)
+  {
+    Triangle tb = Triangle::transform(b_mesh.get_triangle(tri_b), aTb);
+    min_dist = Triangle::calc_sq_dist(a_mesh.get_triangle(tri_a), tb, cpa, cpb_tmp);
+    cpb = aTb.inverse_mult_point(cpb_tmp);
+  }
+
+  // transform the bounding spheres of b's triangles to a's frame
+  vector<Vector3> b_centers(NB);
+  for (unsigned j=0; j< NB; j++)
+    b_centers[j] = aTb.mult_point(b.tri_centers[j]);
+  const Vector3 b_center = aTb.mult_point(b.center);
+
+  // do pairwise distance checks, pruning using bounding spheres
+  for (unsigned i=0; i< NA; i++)
+  {
+    // see whether any triangle of b can be closer than the closest so far
+    Real lb = (a.tri_centers[i] - b_center).norm() - a.tri_radii[i] - b.radius;
+    if (lb > (Real) 0.0 && lb*lb >= min_dist)
+      continue;
+
+    // get the triangle
+    Triangle ta;
+    bool ta_init = false;
+
+    // loop over all triangles in b
+    for (unsigned j=0; j< NB; j++)
+    {
+      // see whether the triangles can be closer than the closest so far
+      lb = (a.tri_centers[i] - b_centers[j]).norm() - a.tri_radii[i] - b.tri_radii[j];
+      if (lb > (Real) 0.0 && lb*lb >= min_dist)
+        continue;
+
+      // get the first triangle, if necessary
+      if (!ta_init)
+      {
+        ta = a_mesh.get_triangle(i);
+        ta_init = true;
+      }
+
+      // get distance between the two triangles
+      Triangle tb = Triangle::transform(b_mesh.get_triangle(j), aTb);
+      Real dist = Triangle::calc_sq_dist(ta, tb, cpa_tmp, cpb_tmp);
+
+      // if it's the minimum distance, save the closest points and features
+      if (dist < min_dist)
+      {
+        min_dist = dist;
+        tri_a = i;
+        tri_b = j;
+        cpa = cpa_tmp;
+        cpb = aTb.inverse_mult_point(cpb_tmp);
+      }
+    }
+  }
+
+  return min_dist;
+}
+
@@ -2486,95 +2486,137 @@ unsigned RCArticulatedBody::num_joint_dof_explicit() const
 }
 
 /// Determines contact Jacobians
-void RCArticulatedBody::determine_contact_jacobians(const EventProblemData& q, 
-const VectorN& v, const MatrixN& M, MatrixN& Jc, MatrixN& Dc)
+/**
+ * The Jacobians are computed directly from the joint axes along the path from
+ * each contact link to the base (rather than by applying test impulses), and
+ * the inverse generalized inertia is then applied to the transposes of all
+ * contact Jacobians using a single solve with a matrix right hand side.
+ * \param q the event problem data
+ * \param M the generalized inertia matrix (axis-angle representation)
+ * \param Jc the contact normal Jacobian (N_CONTACTS x NGC), on return
+ * \param Dc the contact tangent Jacobian (2*N_CONTACTS x NGC), on return
+ */
+void RCArticulatedBody::determine_contact_jacobians(const EventProblemData& q, const MatrixN& M, MatrixN& Jc, MatrixN& Dc)
 {
-  SAFESTATIC VectorN vnew, vcurrent;
+  SAFESTATIC MatrixN JDcT, iM_JDcT, fM, col;
 
-  // see whether velocity data is valid
-  bool vvalid = !velocities_invalidated();
+  // get # of generalized coordinates (axis angle representation) 
+  const unsigned NGC = M.rows();
 
-  // get # of generalized coordinates (axis angle representation)
-  const unsigned NGC = v.size();
+  // setup the transposes of Jc and Dc side-by-side: [Jc' Dc']
+  JDcT.set_zero(NGC, q.N_CONTACTS*3);
+  Real* JcT = JDcT.begin();
+  Real* DcT = JDcT.begin() + NGC*q.N_CONTACTS;
+
+  // loop over all contact events involving this body 
+  const vector<unsigned>& contacts = q.get_super_body_contacts(get_this());
+  for (unsigned m=0; m< contacts.size(); m++)
+  {
+    // get the contact event
+    const unsigned i = contacts[m];
+    const Event& e = *q.contact_events[i];
 
-  // resize dJc, dDc
-  _iM_JcT.set_zero(NGC, q.N_CONTACTS);
-  _iM_DcT.set_zero(NGC, q.N_CONTACTS*2);
+    // get the contact point and directions
+    const Vector3& p = e.contact_point;
+    const Vector3& normal = e.contact_normal;
+    const Vector3& tan1 = e.contact_tan1;
+    const Vector3& tan2 = e.contact_tan2;
 
-  // copy generalized velocity
-  vcurrent.copy_from(v);
+    // get the columns of [Jc' Dc'] for this contact
+    Real* ncol = JcT + NGC*i;
+    Real* t1col = DcT + NGC*i*2;
+    Real* t2col = DcT + NGC*(i*2+1);
 
-  // loop over all contact events
-  for (unsigned i=0, ii=0; i< q.contact_events.size(); i++)
-  {
-    // get the articulated bodies of the contacts
-    SingleBodyPtr sb1 = q.contact_events[i]->contact_geom1->get_single_body();
-    SingleBodyPtr sb2 = q.contact_events[i]->contact_geom2->get_single_body();
-    ArticulatedBodyPtr ab1 = sb1->get_articulated_body();
-    ArticulatedBodyPtr ab2 = sb2->get_articulated_body();
-    
-    // see whether we can skip contact event
-    if (ab1.get() != this && ab2.get() != this)
+    // process both bodies of the contact
+    for (unsigned k=0; k< 2; k++)
     {
-      ii += 2;
-      continue;
+      // get the link 
+      CollisionGeometryPtr cg = (k == 0) ? e.contact_geom1 : e.contact_geom2;
+      RigidBodyPtr link = dynamic_pointer_cast<RigidBody>(cg->get_single_body());
+      if (!link || link->get_articulated_body() != get_this())
+        continue;
+
+      // the second body receives the negated impulse
+      const Real sign = (k == 0) ? (Real) 1.0 : (Real) -1.0;
+
+      // loop over the implicit joints from the link to the base
+      RigidBodyPtr l = link;
+      JointPtr j;
+      while ((j = l->get_inner_joint_implicit()))
+      {
+        // compute the Jacobian column(s) for the joint; only the top three
+        // (linear) dimensions are needed
+        calc_jacobian_column(j, p, col);
+        const unsigned ST_IDX = j->get_coord_index();
+        for (unsigned r=0; r< col.columns(); r++)
+        {
+          Vector3 lin(col(0,r), col(1,r), col(2,r));
+          ncol[ST_IDX+r] += sign*normal.dot(lin);
+          t1col[ST_IDX+r] += sign*tan1.dot(lin);
+          t2col[ST_IDX+r] += sign*tan2.dot(lin);
+        }
+
+        // set l to its parent
+        l = RigidBodyPtr(l->get_parent_link());
+      }
+
+      // add the base components: the velocity at p is xd + omega x (p - x),
+      // so the angular components are (p - x) x dir
+      if (_floating_base)
+      {
+        Vector3 r = p - _links.front()->get_position();
+        Vector3 rxn = Vector3::cross(r, normal);
+        Vector3 rxt1 = Vector3::cross(r, tan1);
+        Vector3 rxt2 = Vector3::cross(r, tan2);
+        for (unsigned d=0; d< 3; d++)
+        {
+          ncol[d] += sign*normal[d];
+          t1col[d] += sign*tan1[d];
+          t2col[d] += sign*tan2[d];
+          ncol[d+3] += sign*rxn[d];
+          t1col[d+3] += sign*rxt1[d];
+          t2col[d+3] += sign*rxt2[d];
+        }
+      }
     }
+  }
 
-    // get the rigid bodies corresponding to sb1 and sb2
-    RigidBodyPtr rb1 = dynamic_pointer_cast<RigidBody>(sb1);
-    RigidBodyPtr rb2 = dynamic_pointer_cast<RigidBody>(sb2);
-
-    // get the contact normal and contact point
-    const Vector3& p = q.contact_events[i]->contact_point;
-    const Vector3& normal = q.contact_events[i]->contact_normal;
-
-    // apply the impulse at the contact point
-    if (ab1 == get_this())
-      apply_impulse(normal, ZEROS_3, p, rb1);
-    if (ab2 == get_this())
-      apply_impulse(-normal, ZEROS_3, p, rb2);
-
-    // measure the change in velocity
-    get_generalized_velocity(DynamicBody::eAxisAngle, vnew);
-    vcurrent.negate() += vnew;
-    _iM_JcT.set_column(i, vcurrent);
-    vcurrent.copy_from(vnew);
-
-    // do the first tangent direction
-    if (ab1 == get_this())
-      apply_impulse(q.contact_events[i]->contact_tan1, ZEROS_3, p, rb1);
-    if (ab2 == get_this())
-      apply_impulse(-q.contact_events[i]->contact_tan1, ZEROS_3, p, rb2);
-
-    // measure the change in velocity
-    get_generalized_velocity(DynamicBody::eAxisAngle, vnew);
-    vcurrent.negate() += vnew;
-    _iM_DcT.set_column(ii++, vcurrent);
-    vcurrent.copy_from(vnew);     
-
-    // do the second tangent direction
-    if (ab1 == get_this())
-      apply_impulse(q.contact_events[i]->contact_tan2, ZEROS_3, p, rb1);
-    if (ab2 == get_this())
-      apply_impulse(-q.contact_events[i]->contact_tan2, ZEROS_3, p, rb2);
-
-    // measure the change in velocity
-    get_generalized_velocity(DynamicBody::eAxisAngle, vnew);
-    vcurrent.negate() += vnew;
-    _iM_DcT.set_column(ii++, vcurrent);
-    vcurrent.copy_from(vnew);     
-  }
-
-  // restore generalized velocity
-  set_generalized_velocity(DynamicBody::eAxisAngle, v);
+  // determine Jc and Dc 
+  JDcT.get_sub_mat(0, NGC, 0, q.N_CONTACTS, Jc, true);
+  JDcT.get_sub_mat(0, NGC, q.N_CONTACTS, q.N_CONTACTS*3, Dc, true);
+
+  // compute inv(M)*[Jc' Dc'] using a single solve; the factorization held
+  // by the CRB algorithm uses the axis-angle coordinates only for fixed-base
+  // bodies, so M is factored here for floating bases
+  if (algorithm_type == eCRB && !_floating_base)
+    _crb.M_solve(JDcT, iM_JDcT);
+  else
+  {
+    fM.copy_from(M);
+    if (LinAlg::factor_chol(fM))
+    {
+      iM_JDcT.copy_from(JDcT);
+      LinAlg::solve_chol_fast(fM, iM_JDcT);
+    }
+    else
+    {
+      LinAlg::pseudo_inverse(fM.copy_from(M), LinAlg::svd1);
+      fM.mult(JDcT, iM_JDcT);
+    }
+  }
 
-  // see whether to re-validate velocities
-  if (vvalid)
-    validate_velocities();
+  // store inv(M)*Jc' and inv(M)*Dc'
+  iM_JDcT.get_sub_mat(0, NGC, 0, q.N_CONTACTS, _iM_JcT);
+  iM_JDcT.get_sub_mat(0, NGC, q.N_CONTACTS, q.N_CONTACTS*3, _iM_DcT);
+}
 
-  // determine Jc and Dc
-  _iM_JcT.transpose_mult(M, Jc);
-  _iM_DcT.transpose_mult(M, Dc);
+/// Adds a matrix to the given rows of another matrix
+static void add_to_rows(const vector<unsigned>& rows, const MatrixN& src, MatrixN& dest)
+{
+  assert(src.rows() == rows.size() && src.columns() == dest.columns());
+  for (unsigned j=0; j< src.columns(); j++)
+    for (unsigned i=0; i< rows.size(); i++)
+      dest(rows[i], j) += src(i, j);
 }
 
 /// Updates the event data
@@ -2582,8 +2624,9 @@ void RCArticulatedBody::update_event_data(EventProblemData& q)
 {
   const unsigned SPATIAL_DIM = 6;
   SAFESTATIC MatrixN tmpM;
-  SAFESTATIC MatrixN M;
+  SAFESTATIC MatrixN M, Jc, Dc, iM_JcT, iM_DcT;
   SAFESTATIC VectorN tmpV, v;
+  SAFESTATIC vector<unsigned> tcontacts;
 
   // get the generalized velocity (axis angle)
   get_generalized_velocity(DynamicBody::eAxisAngle, v);
@@ -2592,7 +2635,7 @@ void RCArticulatedBody::update_event_data(EventProblemData& q)
   _crb.calc_generalized_inertia(DynamicBody::eAxisAngle, M);
 
   // determine contact normal and tangent Jacobians
-  determine_contact_jacobians(q, v, M, _Jc, _Dc);
+  determine_contact_jacobians(q, M, _Jc, _Dc);
 
   // setup Jx (neqx x ngc) and Dx (nedof x ngc)
   determine_explicit_constraint_jacobians(q, _Jx, _Dx);
@@ -2651,18 +2694,38 @@ void RCArticulatedBody::update_event_data(EventProblemData& q)
   solve_generalized_inertia_transpose(eAxisAngle, _Dx, _iM_DxT);
   solve_generalized_inertia_transpose(eAxisAngle, _Dt, _iM_DtT);
 
-  // update all matrices
-  q.Jc_iM_JcT += _Jc.mult(_iM_JcT, tmpM);
-  q.Jc_iM_DcT += _Jc.mult(_iM_DcT, tmpM);
-  q.Jc_iM_JlT += _Jc.mult(_iM_JlT, tmpM);
-  q.Jc_iM_DtT += _Jc.mult(_iM_DtT, tmpM);
-  q.Jc_iM_JxT += _Jc.mult(_iM_JxT, tmpM);
-  q.Jc_iM_DxT += _Jc.mult(_iM_DxT, tmpM);
-  q.Dc_iM_DcT += _Dc.mult(_iM_DcT, tmpM);
-  q.Dc_iM_JlT += _Dc.mult(_iM_JlT, tmpM);
-  q.Dc_iM_DtT += _Dc.mult(_iM_DtT, tmpM);
-  q.Dc_iM_JxT += _Dc.mult(_iM_JxT, tmpM);
-  q.Dc_iM_DxT += _Dc.mult(_iM_DxT, tmpM);
+  // get the contact events involving this body; the rows of Jc and Dc for
+  // all other contact events are zero, so only the blocks of the contact 
+  // terms for this body's events are computed 
+  const vector<unsigned>& contacts = q.get_super_body_contacts(get_this());
+  tcontacts.resize(contacts.size()*2);
+  for (unsigned i=0; i< contacts.size(); i++)
+  {
+    tcontacts[i*2] = contacts[i]*2;
+    tcontacts[i*2+1] = contacts[i]*2+1;
+  }
+  _Jc.select_rows(contacts.begin(), contacts.end(), Jc);
+  _Dc.select_rows(tcontacts.begin(), tcontacts.end(), Dc);
+  _iM_JcT.select_columns(contacts.begin(), contacts.end(), iM_JcT);
+  _iM_DcT.select_columns(tcontacts.begin(), tcontacts.end(), iM_DcT);
+
+  // update all matrices; the contact-contact terms form the contact block 
+  // of this body
+  if (!contacts.empty())
+  {
+    EventProblemData::ContactBlock& block = q.contact_blocks[q.get_super_body_index(get_this())];
+    block.Jc_iM_JcT += Jc.mult(iM_JcT, tmpM);
+    block.Jc_iM_DcT += Jc.mult(iM_DcT, tmpM);
+    block.Dc_iM_DcT += Dc.mult(iM_DcT, tmpM);
+  }
+  add_to_rows(contacts, Jc.mult(_iM_JlT, tmpM), q.Jc_iM_JlT);
+  add_to_rows(contacts, Jc.mult(_iM_DtT, tmpM), q.Jc_iM_DtT);
+  add_to_rows(contacts, Jc.mult(_iM_JxT, tmpM), q.Jc_iM_JxT);
+  add_to_rows(contacts, Jc.mult(_iM_DxT, tmpM), q.Jc_iM_DxT);
+  add_to_rows(tcontacts, Dc.mult(_iM_JlT, tmpM), q.Dc_iM_JlT);
+  add_to_rows(tcontacts, Dc.mult(_iM_DtT, tmpM), q.Dc_iM_DtT);
+  add_to_rows(tcontacts, Dc.mult(_iM_JxT, tmpM), q.Dc_iM_JxT);
+  add_to_rows(tcontacts, Dc.mult(_iM_DxT, tmpM), q.Dc_iM_DxT);
   q.Jl_iM_JlT += _Jl.mult(_iM_JlT, tmpM);
   q.Jl_iM_DtT += _Jl.mult(_iM_DtT, tmpM);
   q.Jl_iM_JxT += _Jl.mult(_iM_JxT, tmpM);
@@ -2675,8 +2738,12 @@ void RCArticulatedBody::update_event_data(EventProblemData& q)
   q.Dx_iM_DxT += _Dx.mult(_iM_DxT, tmpM);
 
   // update velocity vectors
-  q.Jc_v += _Jc.mult(v, tmpV);
-  q.Dc_v += _Dc.mult(v, tmpV);
+  Jc.mult(v, tmpV);
+  for (unsigned i=0; i< contacts.size(); i++)
+    q.Jc_v[contacts[i]] += tmpV[i];
+  Dc.mult(v, tmpV);
+  for (unsigned i=0; i< tcontacts.size(); i++)
+    q.Dc_v[tcontacts[i]] += tmpV[i];
   q.Jl_v += _Jl.mult(v, tmpV);
   q.Jx_v += _Jx.mult(v, tmpV);
   q.Dx_v += _Dx.mult(v, tmpV);
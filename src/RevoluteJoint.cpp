@@ -117,6 +117,9 @@ void RevoluteJoint::set_axis_local(const Vector3& axis)
   // set joint axis in outer link frame
   _v2 = inner->get_transform().mult_vector(naxis);
   _v2 = outer->get_transform().transpose_mult_vector(_v2);
+
+  // the joint axis has changed
+  invalidate_parameters();
 }        
 
 /// Sets the global axis for this joint
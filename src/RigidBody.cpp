@@ -241,6 +241,7 @@ void RigidBody::set_inertia(const Matrix3& inertia)
 
   // invalidate position, just in case
   invalidate_position();
+  invalidate_parameters();
 }
 
 /// Gets the spatial isolated inertia in link coordinates
@@ -265,6 +266,7 @@ void RigidBody::set_mass(Real mass)
 
   // invalidate position, just in case
   invalidate_position();
+  invalidate_parameters();
 }
 
 /// Sets the position for this rigid body
@@ -1925,9 +1927,87 @@ void RigidBody::update_velocity(const EventProblemData& q)
   FILE_LOG(LOG_CONTACT) << "RigidBody::update_velocity() exited" << std::endl;
 }
 
+/// Determines the contact events (in the event problem data) involving this body
+/**
+ * \param contacts the indices of the contact events, on return
+ * \param positions the positions of the contact events in the contact block
+ *        of this body's super body (see EventProblemData::contact_blocks), 
+ *        on return
+ * \param negated whether this body is the second body of each contact event
+ *        (i.e., whether the contact normal must be negated), on return
+ * \return the index of this body's super body in the problem data
+ * \note only the events involving this body's super body are examined
+ */
+unsigned RigidBody::determine_event_contacts(const EventProblemData& q, std::vector<unsigned>& contacts, std::vector<unsigned>& positions, std::vector<bool>& negated)
+{
+  ArticulatedBodyPtr abody = get_articulated_body();
+  DynamicBodyPtr super_body = (abody) ? (DynamicBodyPtr) abody : (DynamicBodyPtr) get_this();
+  const std::vector<unsigned>& sb_contacts = q.get_super_body_contacts(super_body);
+  contacts.clear();
+  positions.clear();
+  negated.clear();
+  for (unsigned k=0; k< sb_contacts.size(); k++)
+  {
+    // verify that it is the proper type
+    const unsigned i = sb_contacts[k];
+    assert(q.contact_events[i]->event_type == Event::eContact);
+
+    // get the two bodies of the contact
+    SingleBodyPtr sb1 = q.contact_events[i]->contact_geom1->get_single_body();
+    SingleBodyPtr sb2 = q.contact_events[i]->contact_geom2->get_single_body();
+
+    // if neither sb1 nor sb2 matches this, continue looping
+    if (sb1 != get_this() && sb2 != get_this())
+      continue;
+
+    // store the event and whether to negate the normal
+    contacts.push_back(i);
+    positions.push_back(k);
+    negated.push_back(sb2 == get_this());
+  }
+
+  return q.get_super_body_index(super_body);
+}
+
+/// Adds contributions to the event velocity vectors (Jc_v and Dc_v) only
+void RigidBody::update_event_velocities(EventProblemData& q)
+{
+  SAFESTATIC std::vector<unsigned> contacts, positions;
+  SAFESTATIC std::vector<bool> negated;
+
+  if (q.N_CONTACTS == 0 || !_enabled)
+    return;
+
+  // determine the contact events involving this body
+  determine_event_contacts(q, contacts, positions, negated);
+
+  // update Jc_v and Dc_v
+  for (unsigned a=0; a< contacts.size(); a++)
+  {
+    const unsigned i = contacts[a];
+    const Event& e = *q.contact_events[i];
+    Vector3 vec = _xd + Vector3::cross(_omega, e.contact_point - _x);
+    if (!negated[a])
+    {
+      q.Jc_v[i] += e.contact_normal.dot(vec);
+      q.Dc_v[i*2] += e.contact_tan1.dot(vec);
+      q.Dc_v[i*2+1] += e.contact_tan2.dot(vec);
+    }
+    else
+    {
+      q.Jc_v[i] -= e.contact_normal.dot(vec);
+      q.Dc_v[i*2] -= e.contact_tan1.dot(vec);
+      q.Dc_v[i*2+1] -= e.contact_tan2.dot(vec);
+    }
+  }
+}
+
 /// Adds contributions to the event matrices
 void RigidBody::update_event_data(EventProblemData& q) 
 {
+  SAFESTATIC std::vector<unsigned> contacts, positions;
+  SAFESTATIC std::vector<bool> negated;
+
   if (q.N_CONTACTS == 0 || !_enabled)
     return;
 
@@ -1938,22 +2018,19 @@ void RigidBody::update_event_data(EventProblemData& q)
   // NOTE: b/c this is an individual rigid body, we don't touch the constraint
   // or limit matrices or Ji
 
+  // determine the contact events involving this body; only entries for
+  // pairs of these events (in the contact block of this body's super body)
+  // are updated
+  const unsigned SB = determine_event_contacts(q, contacts, positions, negated);
+  if (contacts.empty())
+    return;
+  EventProblemData::ContactBlock& block = q.contact_blocks[SB];
+
   // 1. update Jc_iM_JcT and Jc_v
-  for (unsigned i=0; i< q.contact_events.size(); i++)
+  for (unsigned a=0; a< contacts.size(); a++)
   {
-    // verify that it is the proper type
-    assert(q.contact_events[i]->event_type == Event::eContact);
-
-    // get the two bodies of the contact
-    SingleBodyPtr sb1 = q.contact_events[i]->contact_geom1->get_single_body();
-    SingleBodyPtr sb2 = q.contact_events[i]->contact_geom2->get_single_body();
-
-    // if neither sb1 nor sb2 matches this, continue looping
-    if (sb1 != get_this() && sb2 != get_this())
-      continue;
-
-    // check whether to negate normal
-    bool negate1 = (sb2 == get_this());
+    const unsigned i = contacts[a];
+    const bool negate1 = negated[a];
 
     // prepare for computation
     Vector3 n1 = q.contact_events[i]->contact_normal;
@@ -1972,18 +2049,10 @@ void RigidBody::update_event_data(EventProblemData& q)
     cross1 = invJ * cross1;
 
     // loop again, note: the matrices are symmetric
-    for (unsigned j=i; j< q.contact_events.size(); j++)
+    for (unsigned b=a; b< contacts.size(); b++)
     {
-      // get the two bodies of the contact
-      SingleBodyPtr sb1 = q.contact_events[j]->contact_geom1->get_single_body();
-      SingleBodyPtr sb2 = q.contact_events[j]->contact_geom2->get_single_body();
-
-      // if neither sb1 nor sb2 matches this, continue looping
-      if (sb1 != get_this() && sb2 != get_this())
-        continue;
-
-      // check whether to negate normal
-      bool negate2 = (sb2 == get_this());
+      const unsigned j = contacts[b];
+      const bool negate2 = negated[b];
 
       // prepare for computation
       const Vector3& n2 = q.contact_events[j]->contact_normal;
@@ -1995,27 +2064,17 @@ void RigidBody::update_event_data(EventProblemData& q)
       Real sum = n1.dot(n2) + cross1.dot(cross2);
       if ((negate1 && !negate2) || (negate2 && !negate1))
         sum = -sum;
-      q.Jc_iM_JcT(i, j) += sum; 
-      q.Jc_iM_JcT(j, i) = q.Jc_iM_JcT(i, j);
+      const unsigned ai = positions[a], bj = positions[b];
+      block.Jc_iM_JcT(ai, bj) += sum; 
+      block.Jc_iM_JcT(bj, ai) = block.Jc_iM_JcT(ai, bj);
     }
   }
 
   // 2. update Dc_v
-  for (unsigned i=0, ii=0; i< q.contact_events.size(); i++)
+  for (unsigned a=0; a< contacts.size(); a++)
   {
-    // get the two bodies of the contact
-    SingleBodyPtr sb1 = q.contact_events[i]->contact_geom1->get_single_body();
-    SingleBodyPtr sb2 = q.contact_events[i]->contact_geom2->get_single_body();
-
-    // if neither sb1 nor sb2 matches this, continue looping
-    if (sb1 != get_this() && sb2 != get_this())
-    {
-      ii += 2;
-      continue;
-    }
-
-    // check whether to negate normal
-    bool negate = (sb2 == get_this());
+    const unsigned i = contacts[a];
+    const unsigned ii = i*2;
 
     // prepare for computation
     const Vector3& p = q.contact_events[i]->contact_point;
@@ -2029,31 +2088,23 @@ void RigidBody::update_event_data(EventProblemData& q)
     Vector3 vec =  _xd + Vector3::cross(_omega, r);
 
     // update Dc_v
-    if (!negate)
+    if (!negated[a])
     {
-      q.Dc_v[ii++] += d1.dot(vec);
-      q.Dc_v[ii++] += d2.dot(vec);
+      q.Dc_v[ii] += d1.dot(vec);
+      q.Dc_v[ii+1] += d2.dot(vec);
     }
     else
     {
-      q.Dc_v[ii++] -= d1.dot(vec);
-      q.Dc_v[ii++] -= d2.dot(vec);
+      q.Dc_v[ii] -= d1.dot(vec);
+      q.Dc_v[ii+1] -= d2.dot(vec);
     }
   } 
 
   // 3. update Dc_iM_JcT
-  for (unsigned i=0; i< q.contact_events.size(); i++)
+  for (unsigned a=0; a< contacts.size(); a++)
   {
-    // get the two bodies of the contact
-    SingleBodyPtr sb1 = q.contact_events[i]->contact_geom1->get_single_body();
-    SingleBodyPtr sb2 = q.contact_events[i]->contact_geom2->get_single_body();
-
-    // if neither sb1 nor sb2 matches this, continue looping
-    if (sb1 != get_this() && sb2 != get_this())
-      continue;
-
-    // check whether to negate normal
-    bool negate1 = (sb2 == get_this());
+    const unsigned i = contacts[a];
+    const bool negate1 = negated[a];
 
     // prepare for computation
     Vector3 n1 = q.contact_events[i]->contact_normal;
@@ -2066,30 +2117,20 @@ void RigidBody::update_event_data(EventProblemData& q)
     cross1 = invJ * cross1;
 
     // loop over all contacts 
-    for (unsigned j=0, jj=0; j< q.contact_events.size(); j++)
+    const unsigned ai = positions[a];
+    for (unsigned b=0; b< contacts.size(); b++)
     {
-      // get the two bodies of the contact
-      SingleBodyPtr sb1 = q.contact_events[j]->contact_geom1->get_single_body();
-      SingleBodyPtr sb2 = q.contact_events[j]->contact_geom2->get_single_body();
-
-      // if neither sb1 nor sb2 matches this, continue looping
-      if (sb1 != get_this() && sb2 != get_this())
-      {
-        jj += 2;
-        continue;
-      }
-
-      // check whether to negate normal
-      bool negate2 = (sb2 == get_this());
+      const unsigned jj = positions[b]*2;
+      const bool negate2 = negated[b];
       bool negate = ((negate1 && !negate2) || (negate2 && !negate1));
 
       // prepare for computation
-      const Vector3& p2 = q.contact_events[j]->contact_point;
+      const Vector3& p2 = q.contact_events[contacts[b]]->contact_point;
       Vector3 r2 = p2 - _x;
 
       // compute cross products for both tangent directions
-      const Vector3& d21 = q.contact_events[j]->contact_tan1;
-      const Vector3& d22 = q.contact_events[j]->contact_tan2;
+      const Vector3& d21 = q.contact_events[contacts[b]]->contact_tan1;
+      const Vector3& d22 = q.contact_events[contacts[b]]->contact_tan2;
       Vector3 cross21 = Vector3::cross(r2, d21);
       Vector3 cross22 = Vector3::cross(r2, d22);
 
@@ -2098,30 +2139,23 @@ void RigidBody::update_event_data(EventProblemData& q)
       Real sum2 = n1.dot(d22) + cross1.dot(cross22);
       if (!negate)
       {
-        q.Jc_iM_DcT(i,jj++) += sum1;
-        q.Jc_iM_DcT(i,jj++) += sum2;
+        block.Jc_iM_DcT(ai,jj) += sum1;
+        block.Jc_iM_DcT(ai,jj+1) += sum2;
       }
       else
       {
-        q.Jc_iM_DcT(i,jj++) -= sum1;
-        q.Jc_iM_DcT(i,jj++) -= sum2;
+        block.Jc_iM_DcT(ai,jj) -= sum1;
+        block.Jc_iM_DcT(ai,jj+1) -= sum2;
       }
     }
   }
  
   // 4. update Dc_iM_DcT
-  for (unsigned i=0, ii=0; i< q.contact_events.size(); i++, ii+=2)
+  for (unsigned a=0; a< contacts.size(); a++)
   {
-    // get the two bodies of the contact
-    SingleBodyPtr sb1 = q.contact_events[i]->contact_geom1->get_single_body();
-    SingleBodyPtr sb2 = q.contact_events[i]->contact_geom2->get_single_body();
-
-    // if neither sb1 nor sb2 matches this, continue looping
-    if (sb1 != get_this() && sb2 != get_this())
-      continue;
-
-    // check whether to negate
-    bool negate1 = (sb2 == get_this());
+    const unsigned i = contacts[a];
+    const unsigned ii = positions[a]*2;
+    const bool negate1 = negated[a];
 
     // get the moment arm 
     Vector3 r1 = q.contact_events[i]->contact_point - _x;
@@ -2141,18 +2175,11 @@ void RigidBody::update_event_data(EventProblemData& q)
     cross1b = invJ * cross1b;
 
     // loop over the remaining contacts 
-    for (unsigned j=i, jj=ii; j< q.contact_events.size(); j++, jj+= 2)
+    for (unsigned b=a; b< contacts.size(); b++)
     {
-      // get the two bodies of the contact
-      SingleBodyPtr sb1 = q.contact_events[j]->contact_geom1->get_single_body();
-      SingleBodyPtr sb2 = q.contact_events[j]->contact_geom2->get_single_body();
-
-      // if neither sb1 nor sb2 matches this, continue looping
-      if (sb1 != get_this() && sb2 != get_this())
-        continue;
-
-      // check whether to negate normal
-      bool negate2 = (sb2 == get_this());
+      const unsigned j = contacts[b];
+      const unsigned jj = positions[b]*2;
+      const bool negate2 = negated[b];
       bool negate = ((negate1 && !negate2) || (negate2 && !negate1));
 
       // compute the second moment arm
@@ -2174,50 +2201,26 @@ void RigidBody::update_event_data(EventProblemData& q)
 
       if (!negate)
       {
-        q.Dc_iM_DcT(ii, jj)     += sum1; 
-        q.Dc_iM_DcT(ii, jj+1)   += sum2; 
-        q.Dc_iM_DcT(ii+1, jj)   += sum3; 
-        q.Dc_iM_DcT(ii+1, jj+1) += sum4;
+        block.Dc_iM_DcT(ii, jj)     += sum1; 
+        block.Dc_iM_DcT(ii, jj+1)   += sum2; 
+        block.Dc_iM_DcT(ii+1, jj)   += sum3; 
+        block.Dc_iM_DcT(ii+1, jj+1) += sum4;
       }
       else
       {
-        q.Dc_iM_DcT(ii, jj)     -= sum1; 
-        q.Dc_iM_DcT(ii, jj+1)   -= sum2; 
-        q.Dc_iM_DcT(ii+1, jj)   -= sum3; 
-        q.Dc_iM_DcT(ii+1, jj+1) -= sum4;
+        block.Dc_iM_DcT(ii, jj)     -= sum1; 
+        block.Dc_iM_DcT(ii, jj+1)   -= sum2; 
+        block.Dc_iM_DcT(ii+1, jj)   -= sum3; 
+        block.Dc_iM_DcT(ii+1, jj+1) -= sum4;
       }
-    }
-  }
-
-  // ensure symmetry on Dc_iM_DcT
-  for (unsigned i=0, ii=0; i< q.contact_events.size(); i++, ii+=2)
-  {
-    // get the two bodies of the contact
-    SingleBodyPtr sb1 = q.contact_events[i]->contact_geom1->get_single_body();
-    SingleBodyPtr sb2 = q.contact_events[i]->contact_geom2->get_single_body();
-
-    // if neither sb1 nor sb2 matches this, continue looping
-    if (sb1 != get_this() && sb2 != get_this())
-      continue;
-
-    // loop over the remaining contacts 
-    for (unsigned j=i, jj=ii; j< q.contact_events.size(); j++, jj+= 2)
-    {
-      // get the two bodies of the contact
-      SingleBodyPtr sb1 = q.contact_events[j]->contact_geom1->get_single_body();
-      SingleBodyPtr sb2 = q.contact_events[j]->contact_geom2->get_single_body();
-
-      // if neither sb1 nor sb2 matches this, continue looping
-      if (sb1 != get_this() && sb2 != get_this())
-        continue;
 
       // enforce symmetry
-      q.Dc_iM_DcT(jj,ii) = q.Dc_iM_DcT(ii,jj);
-      q.Dc_iM_DcT(jj+1,ii) = q.Dc_iM_DcT(ii,jj+1);
-      q.Dc_iM_DcT(jj,ii+1) = q.Dc_iM_DcT(ii+1,jj);
-      q.Dc_iM_DcT(jj+1,ii+1) = q.Dc_iM_DcT(ii+1,jj+1);
+      block.Dc_iM_DcT(jj,ii) = block.Dc_iM_DcT(ii,jj);
+      block.Dc_iM_DcT(jj+1,ii) = block.Dc_iM_DcT(ii,jj+1);
+      block.Dc_iM_DcT(jj,ii+1) = block.Dc_iM_DcT(ii+1,jj);
+      block.Dc_iM_DcT(jj+1,ii+1) = block.Dc_iM_DcT(ii+1,jj+1);
     }
-  } 
+  }
 }
 
 /// Determines whether this link is a "ground" (fixed link)
@@ -2301,6 +2304,18 @@ void RigidBody::invalidate_velocity()
   abody->invalidate_velocities();
 }
 
+/// Informs an articulated body that the mass or inertia of this link changed
+void RigidBody::invalidate_parameters()
+{
+  // only relevant for articulated bodies...
+  if (_abody.expired())
+    return;
+
+  // get the articulated body and invalidate it
+  ArticulatedBodyPtr abody(_abody);
+  abody->invalidate_parameters();
+}
+
 /// Outputs the object state to the specified stream
 /**
  * This method outputs all of the low-level details to the stream
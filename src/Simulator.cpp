@@ -5,6 +5,7 @@
  ****************************************************************************/
 
 #include <iostream>
+#include <limits>
 #include <Moby/RecurrentForce.h>
 #include <Moby/ArticulatedBody.h>
 #include <Moby/RCArticulatedBody.h>
@@ -115,6 +116,10 @@ void Simulator::remove_dynamic_body(DynamicBodyPtr body)
   else
     _bodies.erase(i);
 
+  // reassign the body indices
+  unindex_body(body);
+  index_bodies();
+
   #ifdef USE_OSG
   // see whether the body is articulated 
   ArticulatedBodyPtr abody = dynamic_pointer_cast<ArticulatedBody>(body);
@@ -222,6 +227,44 @@ void Simulator::add_dynamic_body(DynamicBodyPtr body)
   // add the body to the list of bodies and sort the list of bodies
   _bodies.push_back(body); 
   std::sort(_bodies.begin(), _bodies.end());
+
+  // reassign the body indices
+  index_bodies();
+}
+
+/// Assigns dense indices to the bodies in the simulator
+/**
+ * The i'th body in _bodies gets index i; the links of articulated bodies
+ * get the indices following these.
+ */
+void Simulator::index_bodies()
+{
+  unsigned next = _bodies.size();
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    _bodies[i]->set_index(i);
+    ArticulatedBodyPtr abody = dynamic_pointer_cast<ArticulatedBody>(_bodies[i]);
+    if (abody)
+    {
+      const vector<RigidBodyPtr>& links = abody->get_links();
+      for (unsigned j=0; j< links.size(); j++)
+        links[j]->set_index(next++);
+    }
+  }
+}
+
+/// Clears the index of a body removed from the simulator
+void Simulator::unindex_body(DynamicBodyPtr body)
+{
+  const unsigned UINF = std::numeric_limits<unsigned>::max();
+  body->set_index(UINF);
+  ArticulatedBodyPtr abody = dynamic_pointer_cast<ArticulatedBody>(body);
+  if (abody)
+  {
+    const vector<RigidBodyPtr>& links = abody->get_links();
+    for (unsigned j=0; j< links.size(); j++)
+      links[j]->set_index(UINF);
+  }
 }
 
 /// Updates all visualization under the simulator
@@ -269,6 +312,8 @@ void Simulator::load_from_xml(XMLTreeConstPtr node, std::map<std::string, BasePt
   if (!child_nodes.empty())
   {
     // safe to clear the vector of bodies
+    BOOST_FOREACH(DynamicBodyPtr body, _bodies)
+      unindex_body(body);
     _bodies.clear();
 
     // process all DynamicBody child nodes
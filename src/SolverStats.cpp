@@ -0,0 +1,142 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#include <algorithm>
+#include <limits>
+#ifdef THREADED
+#include <pthread.h>
+#endif
+#include <Moby/SolverStats.h>
+
+using namespace Moby;
+
+#ifdef THREADED
+/// Key for the collector installed for each thread
+static pthread_key_t collector_key;
+
+/// Ensures that collector_key is created only once
+static pthread_once_t collector_key_once = PTHREAD_ONCE_INIT;
+
+/// Lock that serializes access to the collectors
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/// Creates collector_key
+static void create_collector_key()
+{
+  pthread_key_create(&collector_key, NULL);
+}
+#else
+/// The collector installed for the (only) thread
+static SolverStats* collector = NULL;
+#endif
+
+/// Sets the collector for the calling thread
+static void set_collector(SolverStats* s)
+{
+  #ifdef THREADED
+  pthread_once(&collector_key_once, &create_collector_key);
+  pthread_setspecific(collector_key, s);
+  #else
+  collector = s;
+  #endif
+}
+
+void (*SolverStats::callback)(const SolverStats&) = NULL;
+
+/// Resets all statistics
+void SolverStats::reset()
+{
+  n_lemke_calls = n_lemke_failures = n_lemke_pivots = max_lemke_pivots = 0;
+  n_lemke_escalations = n_lemke_escalations_solved = 0;
+  n_lemke_regularized_calls = n_lemke_regularized_failures = 0;
+  n_regularized_solutions = 0;
+  max_regularization_exp = std::numeric_limits<int>::min();
+  n_sqp_calls = n_sqp_failures = n_sqp_iterations = max_sqp_iterations = 0;
+  n_svd_solves = n_svd_fallbacks = 0;
+}
+
+/// Adds the statistics of s to these statistics
+SolverStats& SolverStats::operator+=(const SolverStats& s)
+{
+  n_lemke_calls += s.n_lemke_calls;
+  n_lemke_failures += s.n_lemke_failures;
+  n_lemke_pivots += s.n_lemke_pivots;
+  max_lemke_pivots = std::max(max_lemke_pivots, s.max_lemke_pivots);
+  n_lemke_escalations += s.n_lemke_escalations;
+  n_lemke_escalations_solved += s.n_lemke_escalations_solved;
+  n_lemke_regularized_calls += s.n_lemke_regularized_calls;
+  n_lemke_regularized_failures += s.n_lemke_regularized_failures;
+  n_regularized_solutions += s.n_regularized_solutions;
+  max_regularization_exp = std::max(max_regularization_exp, s.max_regularization_exp);
+  n_sqp_calls += s.n_sqp_calls;
+  n_sqp_failures += s.n_sqp_failures;
+  n_sqp_iterations += s.n_sqp_iterations;
+  max_sqp_iterations = std::max(max_sqp_iterations, s.max_sqp_iterations);
+  n_svd_solves += s.n_svd_solves;
+  n_svd_fallbacks += s.n_svd_fallbacks;
+  return *this;
+}
+
+/// Records the statistics of a single solver call
+/**
+ * The statistics are added to the collector installed for the calling 
+ * thread (if any) and then passed to the callback, if any.
+ */
+void SolverStats::record(const SolverStats& s)
+{
+  SolverStats* c = get_collector();
+  if (c)
+  {
+    #ifdef THREADED
+    pthread_mutex_lock(&stats_mutex);
+    #endif
+    *c += s;
+    #ifdef THREADED
+    pthread_mutex_unlock(&stats_mutex);
+    #endif
+  }
+
+  if (callback)
+    (*callback)(s);
+}
+
+/// Gets the collector installed for the calling thread (or NULL, if there is none)
+SolverStats* SolverStats::get_collector()
+{
+  #ifdef THREADED
+  pthread_once(&collector_key_once, &create_collector_key);
+  return (SolverStats*) pthread_getspecific(collector_key);
+  #else
+  return collector;
+  #endif
+}
+
+/// Installs the given collector (which may be NULL) for the calling thread
+SolverStatsScope::SolverStatsScope(SolverStats* collector)
+{
+  _prev = SolverStats::get_collector();
+  set_collector(collector);
+}
+
+/// Restores the collector that was installed for the calling thread before this scope
+SolverStatsScope::~SolverStatsScope()
+{
+  set_collector(_prev);
+}
+
+/// Writes the statistics to the specified stream
+std::ostream& Moby::operator<<(std::ostream& out, const SolverStats& s)
+{
+  out << "Lemke calls: " << s.n_lemke_calls << "  failures: " << s.n_lemke_failures << "  pivots: " << s.n_lemke_pivots << "  max pivots/call: " << s.max_lemke_pivots << "  escalations: " << s.n_lemke_escalations << "  solved by escalation: " << s.n_lemke_escalations_solved << std::endl;
+  out << "regularized Lemke calls: " << s.n_lemke_regularized_calls << "  failures: " << s.n_lemke_regularized_failures << "  regularized solutions: " << s.n_regularized_solutions;
+  if (s.n_regularized_solutions > 0)
+    out << "  max regularization: 1e" << s.max_regularization_exp;
+  out << std::endl;
+  out << "SQP calls: " << s.n_sqp_calls << "  failures: " << s.n_sqp_failures << "  iterations: " << s.n_sqp_iterations << "  max iterations/call: " << s.max_sqp_iterations << std::endl;
+  out << "SVD least squares solves: " << s.n_svd_solves << "  SVD fallbacks: " << s.n_svd_fallbacks << std::endl;
+  return out;
+}
+
@@ -0,0 +1,251 @@
+/****************************************************************************
+ * Copyright 2011 Evan Drumwright
+ * This library is distributed under the terms of the GNU Lesser General Public
+ * License (found in COPYING).
+ ****************************************************************************/
+
+#include <limits>
+#include <algorithm>
+#include <iterator>
+#include <Moby/Constants.h>
+#include <Moby/Log.h>
+#include <Moby/MissizeException.h>
+#include <Moby/SparseLDL.h>
+
+using std::vector;
+using namespace Moby;
+
+SparseLDL::SparseLDL()
+{
+}
+
+/// Computes a minimum degree ordering using the elimination graph of a symmetric matrix
+/**
+ * \param n the size of the matrix
+ * \param Ap the column pointers of the matrix
+ * \param Ai the row indices of the matrix
+ * \param P the ordering, on return (P[k] is the k'th vertex eliminated)
+ */
+void SparseLDL::calc_min_degree_ordering(unsigned n, const vector<unsigned>& Ap, const vector<unsigned>& Ai, vector<unsigned>& P)
+{
+  vector<vector<unsigned> > adj(n);
+  vector<unsigned> merged;
+  vector<bool> eliminated(n, false);
+
+  // setup the adjacency lists
+  for (unsigned j=0; j< n; j++)
+    for (unsigned p=Ap[j]; p< Ap[j+1]; p++)
+    {
+      const unsigned i = Ai[p];
+      if (i == j)
+        continue;
+      adj[i].push_back(j);
+      adj[j].push_back(i);
+    }
+  for (unsigned i=0; i< n; i++)
+  {
+    std::sort(adj[i].begin(), adj[i].end());
+    adj[i].erase(std::unique(adj[i].begin(), adj[i].end()), adj[i].end());
+  }
+
+  // eliminate vertices one at a time
+  P.resize(n);
+  for (unsigned k=0; k< n; k++)
+  {
+    // find the remaining vertex of minimum degree
+    unsigned v = n;
+    for (unsigned i=0; i< n; i++)
+      if (!eliminated[i] && (v == n || adj[i].size() < adj[v].size()))
+        v = i;
+
+    // eliminate it
+    P[k] = v;
+    eliminated[v] = true;
+
+    // the neighbors of v become a clique
+    const vector<unsigned>& nv = adj[v];
+    for (unsigned m=0; m< nv.size(); m++)
+    {
+      const unsigned a = nv[m];
+      merged.clear();
+      std::set_union(adj[a].begin(), adj[a].end(), nv.begin(), nv.end(), std::back_inserter(merged));
+      adj[a].clear();
+      for (unsigned r=0; r< merged.size(); r++)
+        if (merged[r] != a && merged[r] != v)
+          adj[a].push_back(merged[r]);
+    }
+    adj[v].clear();
+  }
+}
+
+/// Computes the ordering, elimination tree, and nonzero pattern of the factorization
+/**
+ * \param n the size of the matrix
+ * \param Ap the column pointers of the matrix (both triangles stored)
+ * \param Ai the row indices of the matrix
+ */
+void SparseLDL::analyze(unsigned n, const vector<unsigned>& Ap, const vector<unsigned>& Ai)
+{
+  const unsigned UINF = std::numeric_limits<unsigned>::max();
+
+  if (Ap.size() != n+1)
+    throw MissizeException();
+
+  // compute the ordering
+  calc_min_degree_ordering(n, Ap, Ai, _P);
+  _Pinv.resize(n);
+  for (unsigned k=0; k< n; k++)
+    _Pinv[_P[k]] = k;
+
+  // compute the elimination tree and the number of nonzeros in each column
+  // of L
+  _parent.resize(n);
+  _flag.resize(n);
+  _lnz.resize(n);
+  for (unsigned k=0; k< n; k++)
+  {
+    _parent[k] = UINF;
+    _flag[k] = k;
+    _lnz[k] = 0;
+    const unsigned kk = _P[k];
+    for (unsigned p=Ap[kk]; p< Ap[kk+1]; p++)
+    {
+      // traverse the path from i to the root of the tree, stopping at the
+      // first flagged node
+      unsigned i = _Pinv[Ai[p]];
+      if (i >= k)
+        continue;
+      for (; _flag[i] != k; i = _parent[i])
+      {
+        if (_parent[i] == UINF)
+          _parent[i] = k;
+        _lnz[i]++;
+        _flag[i] = k;
+      }
+    }
+  }
+
+  // setup the column pointers of L
+  _Lp.resize(n+1);
+  _Lp[0] = 0;
+  for (unsigned k=0; k< n; k++)
+    _Lp[k+1] = _Lp[k] + _lnz[k];
+
+  // allocate the factor and the work arrays
+  _Li.resize(_Lp[n]);
+  _Lx.resize(_Lp[n]);
+  _D.resize(n);
+  _Y.resize(n);
+  _pattern.resize(n);
+  _x.resize(n);
+
+  FILE_LOG(LOG_OPT) << "SparseLDL::analyze() - " << n << " x " << n << " matrix with " << Ap[n] << " nonzeros; " << _Lp[n] << " nonzeros in L" << std::endl;
+}
+
+/// Computes the numeric factorization of a matrix with the pattern given to analyze()
+/**
+ * \param Ap the column pointers of the matrix (both triangles stored)
+ * \param Ai the row indices of the matrix
+ * \param Ax the values of the matrix
+ * \return <b>false</b> if a zero pivot was encountered
+ */
+bool SparseLDL::factor(const vector<unsigned>& Ap, const vector<unsigned>& Ai, const vector<Real>& Ax)
+{
+  const unsigned n = size();
+
+  // compute the factorization one row of L at a time
+  for (unsigned k=0; k< n; k++)
+  {
+    // compute the nonzero pattern of the k'th row of L, in topological order
+    _Y[k] = (Real) 0.0;
+    unsigned top = n;
+    _flag[k] = k;
+    _lnz[k] = 0;
+    const unsigned kk = _P[k];
+    for (unsigned p=Ap[kk]; p< Ap[kk+1]; p++)
+    {
+      unsigned i = _Pinv[Ai[p]];
+      if (i > k)
+        continue;
+
+      // scatter A(i,k) into Y
+      _Y[i] += Ax[p];
+      unsigned len = 0;
+      for (; _flag[i] != k; i = _parent[i])
+      {
+        _pattern[len++] = i;
+        _flag[i] = k;
+      }
+      while (len > 0)
+        _pattern[--top] = _pattern[--len];
+    }
+
+    // compute the numerical values of the k'th row of L (a sparse triangular
+    // solve)
+    _D[k] = _Y[k];
+    _Y[k] = (Real) 0.0;
+    for (; top < n; top++)
+    {
+      const unsigned i = _pattern[top];
+      const Real yi = _Y[i];
+      _Y[i] = (Real) 0.0;
+      const unsigned p2 = _Lp[i] + _lnz[i];
+      for (unsigned p=_Lp[i]; p< p2; p++)
+        _Y[_Li[p]] -= _Lx[p] * yi;
+      const Real l_ki = yi / _D[i];
+      _D[k] -= l_ki * yi;
+      _Li[p2] = k;
+      _Lx[p2] = l_ki;
+      _lnz[i]++;
+    }
+
+    // check for a zero pivot
+    if (_D[k] == (Real) 0.0)
+    {
+      FILE_LOG(LOG_OPT) << "SparseLDL::factor() - zero pivot encountered at column " << k << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Solves the factorized system
+/**
+ * \param xb on input, the right hand side; on output, the solution
+ * \return a reference to xb
+ */
+VectorN& SparseLDL::solve(VectorN& xb) const
+{
+  const unsigned n = size();
+  if (xb.size() != n)
+    throw MissizeException();
+
+  // permute the right hand side
+  for (unsigned k=0; k< n; k++)
+    _x[k] = xb[_P[k]];
+
+  // solve L*x = b
+  for (unsigned j=0; j< n; j++)
+    for (unsigned p=_Lp[j]; p< _Lp[j+1]; p++)
+      _x[_Li[p]] -= _Lx[p] * _x[j];
+
+  // solve D*x = b
+  for (unsigned j=0; j< n; j++)
+    _x[j] /= _D[j];
+
+  // solve L'*x = b
+  for (unsigned jj=n; jj> 0; jj--)
+  {
+    const unsigned j = jj-1;
+    for (unsigned p=_Lp[j]; p< _Lp[j+1]; p++)
+      _x[j] -= _Lx[p] * _x[_Li[p]];
+  }
+
+  // undo the permutation
+  for (unsigned k=0; k< n; k++)
+    xb[_P[k]] = _x[k];
+
+  return xb;
+}
+
@@ -17,6 +17,7 @@
 #include <queue>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <Moby/Log.h>
 #include <Moby/Constants.h>
 #include <Moby/XMLTree.h>
@@ -37,6 +38,10 @@ using std::pair;
 using std::make_pair;
 using std::stack;
 using boost::dynamic_pointer_cast;
+using boost::weak_ptr;
+
+// static declarations
+map<string, pair<weak_ptr<const IndexedTriArray>, weak_ptr<const TriangleMeshPrimitive::BVHData> > > TriangleMeshPrimitive::_instances;
 
 /// Creates the triangle mesh primitive
 TriangleMeshPrimitive::TriangleMeshPrimitive()
@@ -98,9 +103,7 @@ void TriangleMeshPrimitive::set_deformable(bool flag)
 
   // vertices, mesh, and BVH are no longer valid 
   _mesh = shared_ptr<IndexedTriArray>();
-  _vertices = shared_ptr<vector<Vector3> >();
-  _mesh_vertices.clear();
-  _root = BVPtr();
+  _bvh = shared_ptr<BVHData>();
   _invalidated = true;
 }
 
@@ -109,9 +112,8 @@ void TriangleMeshPrimitive::set_edge_sample_length(Real len)
 {
   _edge_sample_length = len;
 
-  // vertices are no longer valid
-  _vertices = shared_ptr<vector<Vector3> >();
-  _mesh_vertices.clear();
+  // vertices are no longer valid (and they are built with the BVH)
+  _bvh = shared_ptr<BVHData>();
   _invalidated = true;
 }
 
@@ -245,6 +247,36 @@ void TriangleMeshPrimitive::load_from_xml(XMLTreeConstPtr node, map<string, Base
   string fname_lower = fname;
   std::transform(fname_lower.begin(), fname_lower.end(), fname_lower.begin(), (int(*)(int)) std::tolower);
 
+  // see whether to center the mesh
+  const XMLAttrib* center_attr = node->get_attrib("center");
+  bool center = (center_attr && center_attr->get_bool_value());
+
+  // see whether to share the mesh and BVH with other instances of this mesh
+  // (default is true)
+  const XMLAttrib* instance_attr = node->get_attrib("instance");
+  bool instance = (!instance_attr || instance_attr->get_bool_value());
+
+  // see whether the mesh has already been loaded using identical settings;
+  // if so, share its (immutable) mesh and bounding volume hierarchy 
+  string key;
+  if (instance && !is_deformable())
+  {
+    key = get_instance_key(fname, center, _T, _intersection_tolerance, _edge_sample_length);
+    map<string, pair<weak_ptr<const IndexedTriArray>, weak_ptr<const BVHData> > >::const_iterator inst_iter = _instances.find(key);
+    if (inst_iter != _instances.end())
+    {
+      shared_ptr<const IndexedTriArray> mesh = inst_iter->second.first.lock();
+      shared_ptr<const BVHData> bvh = inst_iter->second.second.lock();
+      if (mesh && bvh)
+      {
+        FILE_LOG(LOG_BV) << "TriangleMeshPrimitive::load_from_xml() - sharing mesh and BVH for instance of " << fname << endl;
+        set_mesh(mesh);
+        _bvh = bvh;
+        return;
+      }
+    }
+  }
+
   // get the type of file and construct the triangle mesh appropriately
   if (fname_lower.find(string(OBJ_EXT)) == fname_lower.size() - strlen(OBJ_EXT))
     set_mesh(shared_ptr<IndexedTriArray>(new IndexedTriArray(IndexedTriArray::read_from_obj(fname))));
@@ -254,11 +286,18 @@ void TriangleMeshPrimitive::load_from_xml(XMLTreeConstPtr node, map<string, Base
     cerr << "  for attribute 'filename'.  Valid extensions are '.obj' (Wavefront OBJ)" << endl;
   }
   
-  // see whether to center the mesh
-  const XMLAttrib* center_attr = node->get_attrib("center");
-  if (center_attr && center_attr->get_bool_value())
+  // center the mesh, if desired
+  if (center)
     this->center();
 
+  // build the BVH now and register the mesh so that later instances of the
+  // mesh may share it
+  if (instance && !is_deformable() && _mesh)
+  {
+    build_BB_tree();
+    _instances[key] = make_pair(weak_ptr<const IndexedTriArray>(_mesh), weak_ptr<const BVHData>(_bvh));
+  }
+
   // recompute mass properties
   calc_mass_properties();
 
@@ -266,6 +305,24 @@ void TriangleMeshPrimitive::load_from_xml(XMLTreeConstPtr node, map<string, Base
   update_visualization();
 }
 
+/// Gets the key used to identify instances of a mesh loaded from a file
+/**
+ * Meshes loaded from the same file with the same centering, transform, 
+ * intersection tolerance, and edge sample length yield identical meshes and
+ * bounding volume hierarchies.
+ */
+string TriangleMeshPrimitive::get_instance_key(const string& filename, bool center, const Matrix4& T, Real itol, Real esl)
+{
+  std::ostringstream key;
+  key.precision(std::numeric_limits<Real>::digits10 + 2);
+  key << filename << "|" << center << "|" << itol << "|" << esl;
+  for (unsigned i=0; i< 3; i++)
+    for (unsigned j=0; j< 4; j++)
+      key << "|" << T(i,j);
+
+  return key.str();
+}
+
 /// Implements Base::save_to_xml()
 void TriangleMeshPrimitive::save_to_xml(XMLTreePtr node, list<BaseConstPtr>& shared_objects) const
 {
@@ -319,16 +376,18 @@ void TriangleMeshPrimitive::set_mesh(boost::shared_ptr<const IndexedTriArray> me
   _mesh = mesh;
 
   // vertices and bounding volumes are no longer valid
-  _vertices = shared_ptr<vector<Vector3> >();
-  _mesh_vertices.clear();
-  _root = BVPtr();
+  _bvh = shared_ptr<BVHData>();
   _invalidated = true;
 
-  // map pointers to vertices
+  // map pointers to vertices (only used for self-intersection checks on
+  // deformable geometries)
   _mesh_vertex_map.clear();
-  const vector<Vector3>& verts = _mesh->get_vertices();
-  for (unsigned i=0; i< verts.size(); i++)
-    _mesh_vertex_map[&verts[i]] = i;
+  if (is_deformable())
+  {
+    const vector<Vector3>& verts = _mesh->get_vertices();
+    for (unsigned i=0; i< verts.size(); i++)
+      _mesh_vertex_map[&verts[i]] = i;
+  }
 
   // recalculate the mass properties
   if (!is_deformable())
@@ -423,10 +482,10 @@ void TriangleMeshPrimitive::calc_mass_properties()
 BVPtr TriangleMeshPrimitive::get_BVH_root()
 {
   // build the bounding box if necessary
-  if (!_root)
+  if (!_bvh)
     build_BB_tree();
 
-  return _root; 
+  return _bvh->root; 
 }
 
 /// Determines whether the point on a thick triangle is degenerate
@@ -516,8 +575,8 @@ bool TriangleMeshPrimitive::is_degen_point_on_tri(shared_ptr<AThickTri> tri, con
 /// Gets mesh data for the geometry with the specified bounding volume
 const std::pair<boost::shared_ptr<const IndexedTriArray>, std::list<unsigned> >& TriangleMeshPrimitive::get_sub_mesh(BVPtr bv)
 {
-  assert(_mesh_tris.find(bv) != _mesh_tris.end());
-  _smesh = make_pair(_mesh, _mesh_tris.find(bv)->second);
+  assert(_bvh && _bvh->mesh_tris.find(bv) != _bvh->mesh_tris.end());
+  _smesh = make_pair(_mesh, _bvh->mesh_tris.find(bv)->second);
   return _smesh;
 }
 
@@ -547,8 +606,8 @@ bool TriangleMeshPrimitive::point_inside(BVPtr bv, const Vector3& p, Vector3& no
   if (bv->is_leaf())
   {
     // get the triangles of the BV
-    assert(_tris.find(bv) != _tris.end());
-    const list<shared_ptr<AThickTri> >& tris = _tris.find(bv)->second;
+    assert(_bvh->tris.find(bv) != _bvh->tris.end());
+    const list<shared_ptr<AThickTri> >& tris = _bvh->tris.find(bv)->second;
     
     // see whether the point is inside/on one of the thick triangles
     BOOST_FOREACH(shared_ptr<AThickTri> tri, tris)
@@ -609,8 +668,8 @@ bool TriangleMeshPrimitive::intersect_seg(const Vector3* u, BVPtr bv, const Line
     if (bv->is_leaf())
     {
       // get the list of thick triangles 
-      assert(_tris.find(bv) != _tris.end());
-      const list<shared_ptr<AThickTri> >& tris = _tris.find(bv)->second;
+      assert(_bvh->tris.find(bv) != _bvh->tris.end());
+      const list<shared_ptr<AThickTri> >& tris = _bvh->tris.find(bv)->second;
     
       // expand the BV 
       BVPtr ebv;
@@ -750,8 +809,8 @@ bool TriangleMeshPrimitive::intersect_seg(BVPtr bv, const LineSeg3& seg, Real& t
     if (bv->is_leaf())
     {
       // get the list of thick triangles 
-      assert(_tris.find(bv) != _tris.end());
-      const list<shared_ptr<AThickTri> >& tris = _tris.find(bv)->second;
+      assert(_bvh->tris.find(bv) != _bvh->tris.end());
+      const list<shared_ptr<AThickTri> >& tris = _bvh->tris.find(bv)->second;
     
       // expand the BV 
       BVPtr ebv;
@@ -859,16 +918,17 @@ bool TriangleMeshPrimitive::intersect_seg(BVPtr bv, const LineSeg3& seg, Real& t
 void TriangleMeshPrimitive::get_vertices(BVPtr bv, vector<const Vector3*>& vertices) 
 {
   // if there are no vertices, we need to build them
-  if (!_vertices)
+  if (!_bvh)
     build_BB_tree();
 
   // get the mesh covered by the BV
-  map<BVPtr, list<unsigned> >::const_iterator v_iter = _mesh_vertices.find(bv);
+  map<BVPtr, list<unsigned> >::const_iterator v_iter = _bvh->mesh_vertices.find(bv);
   const list<unsigned>& vlist = v_iter->second;
 
   // get the vertex indices
+  const vector<Vector3>& bvh_vertices = *_bvh->vertices;
   for (list<unsigned>::const_iterator i = vlist.begin(); i != vlist.end(); i++)
-    vertices.push_back(&(*_vertices)[*i]);
+    vertices.push_back(&bvh_vertices[*i]);
 }
 
 /// Transforms this primitive
@@ -885,9 +945,7 @@ void TriangleMeshPrimitive::set_transform(const Matrix4& T)
     _mesh = shared_ptr<IndexedTriArray>(new IndexedTriArray(_mesh->transform(Trel)));
 
   // vertices and bounding volumes are no longer valid
-  _vertices = shared_ptr<vector<Vector3> >();
-  _mesh_vertices.clear();
-  _root = BVPtr();
+  _bvh = shared_ptr<BVHData>();
   _invalidated = true;
 
   // recalculate the mass properties
@@ -899,10 +957,7 @@ void TriangleMeshPrimitive::load_state(shared_ptr<void> state)
 {
   shared_ptr<TriangleMeshPrimitiveState> tps = boost::static_pointer_cast<TriangleMeshPrimitiveState>(state);
   Primitive::load_state(tps->pstate);
-  _root = tps->rootBVH;
-  _mesh_tris = tps->mesh_tris;
-  _mesh_vertices = tps->mesh_vertices;
-  _tris = tps->tris;
+  _bvh = tps->bvh;
 }
 
 /// Saves the state of this primitive
@@ -910,10 +965,7 @@ shared_ptr<void> TriangleMeshPrimitive::save_state() const
 {
   shared_ptr<TriangleMeshPrimitiveState> tps(new TriangleMeshPrimitiveState);
   tps->pstate = Primitive::save_state();
-  tps->rootBVH = _root;
-  tps->mesh_tris = _mesh_tris;
-  tps->mesh_vertices = _mesh_vertices;
-  tps->tris = _tris;
+  tps->bvh = _bvh;
 
   return tps;
 }
@@ -933,10 +985,9 @@ void TriangleMeshPrimitive::build_BB_tree()
 
   FILE_LOG(LOG_BV) << "TriangleMeshPrimitive::build_BB_tree() entered" << endl;
 
-  // clear any existing data
-  _mesh_tris.clear();
-  _mesh_vertices.clear();
-  _tris.clear();
+  // create new data; any existing data may be shared with other instances
+  // of the mesh, so it is not modified 
+  shared_ptr<BVHData> bvh(new BVHData);
 
   // get the vertices from the mesh
   const vector<Vector3>& vertices = _mesh->get_vertices();
@@ -954,7 +1005,7 @@ void TriangleMeshPrimitive::build_BB_tree()
     tris_idx.push_back(i);
 
   // setup mapping from BV to mesh
-  _mesh_tris[root] = tris_idx;
+  bvh->mesh_tris[root] = tris_idx;
 
   FILE_LOG(LOG_BV) << "  -- created root: " << root << endl;
 
@@ -991,7 +1042,7 @@ void TriangleMeshPrimitive::build_BB_tree()
       }
 
       // split the bounding box across the axis
-      if (split(_mesh, bb, child1, child2, axis))
+      if (split(_mesh, *bvh, bb, child1, child2, axis))
         break;
     }
 
@@ -1000,20 +1051,20 @@ void TriangleMeshPrimitive::build_BB_tree()
       continue;
 
     // child was divisible; remove thick triangles
-    _tris.erase(bb);
+    bvh->tris.erase(bb);
 
     // setup child pointers
     bb->children.push_back(child1);
     bb->children.push_back(child2);
 
     // get lists of triangles for children
-    assert(_mesh_tris.find(child1) != _mesh_tris.end());
-    assert(_mesh_tris.find(child2) != _mesh_tris.end());
-    const std::list<unsigned>& c1tris = _mesh_tris.find(child1)->second;
-    const std::list<unsigned>& c2tris = _mesh_tris.find(child2)->second;
+    assert(bvh->mesh_tris.find(child1) != bvh->mesh_tris.end());
+    assert(bvh->mesh_tris.find(child2) != bvh->mesh_tris.end());
+    const std::list<unsigned>& c1tris = bvh->mesh_tris.find(child1)->second;
+    const std::list<unsigned>& c2tris = bvh->mesh_tris.find(child2)->second;
 
     // create thick triangles for child1
-    list<shared_ptr<AThickTri> >& ttris1 = _tris[child1];
+    list<shared_ptr<AThickTri> >& ttris1 = bvh->tris[child1];
     BOOST_FOREACH(unsigned idx, c1tris)
     {
       try
@@ -1029,7 +1080,7 @@ void TriangleMeshPrimitive::build_BB_tree()
     }
     
     // create thick triangles for child2
-    list<shared_ptr<AThickTri> >& ttris2 = _tris[child2];
+    list<shared_ptr<AThickTri> >& ttris2 = bvh->tris[child2];
     BOOST_FOREACH(unsigned idx, c2tris)
     {
       try
@@ -1128,7 +1179,7 @@ void TriangleMeshPrimitive::build_BB_tree()
   }
 
   // save the root
-  _root = root;
+  bvh->root = root;
 
   // output how many triangles are in each bounding box
   if (LOGGING(LOG_BV))
@@ -1143,7 +1194,7 @@ void TriangleMeshPrimitive::build_BB_tree()
       S.pop();
       
       // get the triangles in this BV
-      const list<unsigned>& tris = _mesh_tris.find(node)->second;
+      const list<unsigned>& tris = bvh->mesh_tris.find(node)->second;
       std::ostringstream out;
       for (unsigned i=0; i< depth; i++)
         out << " ";
@@ -1157,7 +1208,10 @@ void TriangleMeshPrimitive::build_BB_tree()
   }
 
   // build set of mesh vertices
-  construct_mesh_vertices(_mesh);
+  construct_mesh_vertices(_mesh, *bvh);
+
+  // store the hierarchy
+  _bvh = bvh;
 
   FILE_LOG(LOG_BV) << "Primitive::build_BB_tree() exited" << endl;
 }
@@ -1169,18 +1223,16 @@ void TriangleMeshPrimitive::set_intersection_tolerance(Real tol)
 
   // mesh, vertices, and BVH are no longer valid
   _mesh = shared_ptr<IndexedTriArray>();
-  _vertices = shared_ptr<vector<Vector3> >();
-  _mesh_vertices.clear();
-  _root = BVPtr();
+  _bvh = shared_ptr<BVHData>();
 }
 
 /// Creates the set of mesh vertices
-void TriangleMeshPrimitive::construct_mesh_vertices(shared_ptr<const IndexedTriArray> mesh)
+void TriangleMeshPrimitive::construct_mesh_vertices(shared_ptr<const IndexedTriArray> mesh, BVHData& bvh) const
 {
   const unsigned EDGES_PER_TRI = 3;
 
   // clear the map of mesh vertices
-  _mesh_vertices.clear();
+  bvh.mesh_vertices.clear();
 
   // get the sets of vertices and facets from the mesh
   const vector<Vector3>& mesh_vertices = mesh->get_vertices();
@@ -1190,7 +1242,8 @@ void TriangleMeshPrimitive::construct_mesh_vertices(shared_ptr<const IndexedTriA
   vector<list<unsigned> > vf_map = mesh->determine_vertex_facet_map();
 
   // create a new vector of vertices
-  _vertices = shared_ptr<vector<Vector3> >(new vector<Vector3>(mesh_vertices));
+  bvh.vertices = shared_ptr<vector<Vector3> >(new vector<Vector3>(mesh_vertices));
+  vector<Vector3>& vertices = *bvh.vertices;
 
   // now, modify the vertices based on the intersection tolerance
   for (unsigned i=0; i< mesh_vertices.size(); i++)
@@ -1212,7 +1265,7 @@ void TriangleMeshPrimitive::construct_mesh_vertices(shared_ptr<const IndexedTriA
     // otherwise, normalize the normal and add intersection tolerance (in dir
     // of normal) to vertex i
     normal.normalize();
-    (*_vertices)[i] += normal*_intersection_tolerance;
+    vertices[i] += normal*_intersection_tolerance;
   }
 
   // now, add additional samples based on edges in the mesh
@@ -1242,14 +1295,14 @@ void TriangleMeshPrimitive::construct_mesh_vertices(shared_ptr<const IndexedTriA
           unsigned vi = q.front().first;
           unsigned vj = q.front().second;
           q.pop();
-          const Vector3& v1 = (*_vertices)[vi];
-          const Vector3& v2 = (*_vertices)[vj];
+          const Vector3& v1 = vertices[vi];
+          const Vector3& v2 = vertices[vj];
 
           // subdivide, adding a vertex as necessary
           if ((v1-v2).norm() > _edge_sample_length)
           {
-            unsigned vk = _vertices->size();
-            _vertices->push_back((v1+v2) * (Real) 0.5);
+            unsigned vk = vertices.size();
+            vertices.push_back((v1+v2) * (Real) 0.5);
             ess.push_back(vk);
             q.push(make_sorted_pair(vi,vk));
             q.push(make_sorted_pair(vk,vj));
@@ -1260,13 +1313,13 @@ void TriangleMeshPrimitive::construct_mesh_vertices(shared_ptr<const IndexedTriA
   }
 
   // iterate over all mesh triangles
-  for (map<BVPtr, list<unsigned> >::const_iterator i = _mesh_tris.begin(); i != _mesh_tris.end(); i++)
+  for (map<BVPtr, list<unsigned> >::const_iterator i = bvh.mesh_tris.begin(); i != bvh.mesh_tris.end(); i++)
   {
     // get the list of facets
     const list<unsigned>& covered_facets = i->second;
 
     // create the list of vertices for this BV
-    list<unsigned>& vlist = _mesh_vertices[i->first];
+    list<unsigned>& vlist = bvh.mesh_vertices[i->first];
 
     // get the edges referenced by each facet
     BOOST_FOREACH(unsigned j, covered_facets)
@@ -1292,7 +1345,7 @@ void TriangleMeshPrimitive::construct_mesh_vertices(shared_ptr<const IndexedTriA
 }
 
 /// Splits a collection of triangles along a splitting plane into 2 new meshes 
-void TriangleMeshPrimitive::split_tris(const Vector3& point, const Vector3& normal, const IndexedTriArray& orig_mesh, const list<unsigned>& ofacets, list<unsigned>& pfacets, list<unsigned>& nfacets) 
+void TriangleMeshPrimitive::split_tris(const Vector3& point, const Vector3& normal, const IndexedTriArray& orig_mesh, const list<unsigned>& ofacets, list<unsigned>& pfacets, list<unsigned>& nfacets) const
 {
   // get original vertices and facets
   const vector<Vector3>& vertices = orig_mesh.get_vertices();
@@ -1332,7 +1385,7 @@ void TriangleMeshPrimitive::split_tris(const Vector3& point, const Vector3& norm
 }
 
 /// Splits a bounding box  along a given axis into two new bounding boxes; returns true if split successful
-bool TriangleMeshPrimitive::split(shared_ptr<const IndexedTriArray> mesh, shared_ptr<BV> source, shared_ptr<BV>& tgt1, shared_ptr<BV>& tgt2, const Vector3& axis) 
+bool TriangleMeshPrimitive::split(shared_ptr<const IndexedTriArray> mesh, BVHData& bvh, shared_ptr<BV> source, shared_ptr<BV>& tgt1, shared_ptr<BV>& tgt2, const Vector3& axis) const
 {
   // setup two lists of triangles
   list<unsigned> ptris, ntris;
@@ -1342,8 +1395,8 @@ bool TriangleMeshPrimitive::split(shared_ptr<const IndexedTriArray> mesh, shared
   tgt2 = shared_ptr<BV>();
 
   // get the mesh and the list of triangles
-  assert(_mesh_tris.find(source) != _mesh_tris.end());
-  const list<unsigned>& tris = _mesh_tris.find(source)->second;
+  assert(bvh.mesh_tris.find(source) != bvh.mesh_tris.end());
+  const list<unsigned>& tris = bvh.mesh_tris.find(source)->second;
 
   // make sure that not trying to split a single triangle
   assert(tris.size() > 1); 
@@ -1377,8 +1430,8 @@ bool TriangleMeshPrimitive::split(shared_ptr<const IndexedTriArray> mesh, shared
   }
 
   // setup mesh data for the BVs
-  _mesh_tris[tgt1] = ptris;
-  _mesh_tris[tgt2] = ntris;
+  bvh.mesh_tris[tgt1] = ptris;
+  bvh.mesh_tris[tgt2] = ntris;
 
   return true;
 }
@@ -97,7 +97,7 @@ VectorN::VectorN(unsigned N, shared_array<Real> array)
 VectorN::VectorN(const VectorN& source)
 {
   _len = source._len;
-  _capacity = source._capacity;
+  _capacity = _len;
   _data = shared_array<Real>(new Real[_len]);
   operator=(source);
 }
@@ -363,7 +363,7 @@ VectorN& VectorN::resize(unsigned N, bool preserve)
     return *this;
 
   // see whether we can just change size 
-  if (N < _capacity)
+  if (N <= _capacity)
   {
     // if we're preserving, we don't need to do anything 
 